@@ -13,11 +13,18 @@
 // limitations under the License.
 
 #include <algorithm>
+#include <cmath>
+#include <deque>
+#include <memory>
 #include <utility>
 #include <vector>
 
+#include "absl/time/time.h"
 #include "mediapipe/calculators/core/flow_limiter_calculator.pb.h"
 #include "mediapipe/framework/calculator_framework.h"
+#include "mediapipe/framework/deps/clock.h"
+#include "mediapipe/framework/deps/monotonic_clock.h"
+#include "mediapipe/framework/profiler/metric_registry.h"
 #include "mediapipe/framework/port/ret_check.h"
 #include "mediapipe/framework/port/status.h"
 #include "mediapipe/util/header_util.h"
@@ -28,6 +35,8 @@ constexpr char kFinishedTag[] = "FINISHED";
 constexpr char kAllowTag[] = "ALLOW";
 constexpr char kMaxInFlightTag[] = "MAX_IN_FLIGHT";
 constexpr char kOptionsTag[] = "OPTIONS";
+constexpr char kClockTag[] = "CLOCK";
+constexpr char kStatsTag[] = "STATS";
 
 // FlowLimiterCalculator is used to limit the number of frames in flight
 // by dropping input frames when necessary.
@@ -66,6 +75,36 @@ constexpr char kOptionsTag[] = "OPTIONS";
 // dropping frames including the current timestamp.
 // "ALLOW = true"表示开始接受包含当前时间戳的帧，"ALLOW = false"表示开始丢弃包含当前时间戳的帧。
 //
+// With the "adaptive" option, the limits follow the latency of the frames,
+// measured from their arrival to their FINISHED signal. After each window of
+// finished frames, max_in_flight is multiplied by decrease_factor if the
+// latency_percentile of the window exceeds target_latency_us, and incremented
+// otherwise. Frames are queued only while the latency meets the target. The
+// optional "STATS" output stream receives a FlowLimiterStats after each
+// adjustment, and the optional "CLOCK" side packet, a
+// std::shared_ptr<mediapipe::Clock>, replaces the monotonic wall clock. The
+// adaptive options are read in Open(): the OPTIONS input stream can't enable,
+// disable or change them.
+//
+// Example config:
+// node {
+//   calculator: "FlowLimiterCalculator"
+//   input_stream: "raw_frames"
+//   input_stream: "FINISHED:finished"
+//   input_stream_info: {
+//     tag_index: 'FINISHED'
+//     back_edge: true
+//   }
+//   output_stream: "sampled_frames"
+//   output_stream: "STATS:flow_limiter_stats"
+//   options {
+//     [mediapipe.FlowLimiterCalculatorOptions.ext] {
+//       max_in_queue: 1
+//       adaptive { target_latency_us: 50000 }
+//     }
+//   }
+// }
+//
 // FlowLimiterCalculator provides limited support for multiple input streams.
 // The first input stream is treated as the main input stream and successive
 // input streams are treated as auxiliary input streams.  The auxiliary input
@@ -89,8 +128,14 @@ class FlowLimiterCalculator : public CalculatorBase {
     cc->Inputs().Get("FINISHED", 0).SetAny();
     cc->InputSidePackets().Tag(kMaxInFlightTag).Set<int>().Optional();
     cc->Outputs().Tag(kAllowTag).Set<bool>().Optional();
+    cc->Outputs().Tag(kStatsTag).Set<FlowLimiterStats>().Optional();
+    cc->InputSidePackets()
+        .Tag(kClockTag)
+        .Set<std::shared_ptr<Clock>>()
+        .Optional();
     cc->SetInputStreamHandler("ImmediateInputStreamHandler");
     cc->SetProcessTimestampBounds(true);
+    cc->UseService(kMetricRegistryService).Optional();
     return absl::OkStatus();
   }
 
@@ -102,6 +147,36 @@ class FlowLimiterCalculator : public CalculatorBase {
           cc->InputSidePackets().Tag(kMaxInFlightTag).Get<int>());
     }
     input_queues_.resize(cc->Inputs().NumEntries(""));
+    adaptive_ = options_.has_adaptive();
+    if (adaptive_) {
+      adaptive_options_ = options_.adaptive();
+      const auto& adaptive = adaptive_options_;
+      RET_CHECK_GE(adaptive.min_in_flight(), 1);
+      RET_CHECK_GE(adaptive.max_in_flight(), adaptive.min_in_flight());
+      RET_CHECK_GE(adaptive.window_size(), 1);
+      RET_CHECK_GT(adaptive.latency_percentile(), 0);
+      RET_CHECK_LE(adaptive.latency_percentile(), 1);
+      RET_CHECK_GT(adaptive.decrease_factor(), 0);
+      RET_CHECK_LT(adaptive.decrease_factor(), 1);
+      in_flight_limit_ =
+          std::clamp(options_.max_in_flight(), adaptive.min_in_flight(),
+                     adaptive.max_in_flight());
+    }
+    if (cc->InputSidePackets().HasTag(kClockTag)) {
+      clock_ =
+          cc->InputSidePackets().Tag(kClockTag).Get<std::shared_ptr<Clock>>();
+    } else {
+      clock_ = std::shared_ptr<Clock>(
+          MonotonicClock::CreateSynchronizedMonotonicClock());
+    }
+    if (cc->Service(kMetricRegistryService).IsAvailable()) {
+      dropped_packets_ =
+          cc->Service(kMetricRegistryService)
+              .GetObject()
+              .GetCounter(MetricRegistry::MetricKey(
+                  "mediapipe_flow_limiter_dropped_packets_total",
+                  {{"node", cc->NodeName()}}));
+    }
     RET_CHECK_OK(CopyInputHeadersToOutputs(cc->Inputs(), &(cc->Outputs())));
     return absl::OkStatus();
   }
@@ -109,7 +184,75 @@ class FlowLimiterCalculator : public CalculatorBase {
   // Returns true if an additional frame can be released for processing.
   // The "ALLOW" output stream indicates this condition at each input frame.
   bool ProcessingAllowed() {
-    return frames_in_flight_.size() < options_.max_in_flight();
+    return frames_in_flight_.size() < MaxInFlight();
+  }
+
+  // Returns the current limit on the frames in flight.
+  int MaxInFlight() const {
+    return adaptive_ ? in_flight_limit_ : options_.max_in_flight();
+  }
+
+  // Returns the current limit on the queued frames.
+  int MaxInQueue() const {
+    return adaptive_ && over_target_ ? 0 : options_.max_in_queue();
+  }
+
+  // Removes the oldest frame in flight, and records its latency if the limits
+  // are adaptive.
+  void FinishFrameInFlight(absl::Time now, CalculatorContext* cc) {
+    frames_in_flight_.pop_front();
+    if (!adaptive_) {
+      return;
+    }
+    latencies_.push_back(now - in_flight_arrival_times_.front());
+    in_flight_arrival_times_.pop_front();
+    if (static_cast<int>(latencies_.size()) >=
+        adaptive_options_.window_size()) {
+      AdjustLimits(cc);
+    }
+  }
+
+  // Adjusts the limits to the latencies of the last window of frames.
+  void AdjustLimits(CalculatorContext* cc) {
+    const auto& adaptive = adaptive_options_;
+    int rank = std::ceil(adaptive.latency_percentile() * latencies_.size()) - 1;
+    rank = std::clamp(rank, 0, static_cast<int>(latencies_.size()) - 1);
+    std::nth_element(latencies_.begin(), latencies_.begin() + rank,
+                     latencies_.end());
+    const absl::Duration latency = latencies_[rank];
+    latencies_.clear();
+
+    over_target_ = latency > absl::Microseconds(adaptive.target_latency_us());
+    if (over_target_) {
+      in_flight_limit_ = std::max(
+          adaptive.min_in_flight(),
+          static_cast<int>(in_flight_limit_ * adaptive.decrease_factor()));
+    } else {
+      in_flight_limit_ =
+          std::min(adaptive.max_in_flight(), in_flight_limit_ + 1);
+    }
+
+    if (cc->Outputs().HasTag(kStatsTag)) {
+      FlowLimiterStats stats;
+      stats.set_max_in_flight(MaxInFlight());
+      stats.set_max_in_queue(MaxInQueue());
+      stats.set_latency_us(absl::ToInt64Microseconds(latency));
+      const int64 window_frames = window_released_ + window_dropped_;
+      stats.set_drop_rate(window_frames > 0
+                              ? static_cast<double>(window_dropped_) /
+                                    window_frames
+                              : 0.0);
+      stats.set_released_frames(released_frames_);
+      stats.set_dropped_frames(dropped_frames_);
+      OutputStream& stream = cc->Outputs().Tag(kStatsTag);
+      Timestamp ts =
+          std::max(cc->InputTimestamp(), stream.NextTimestampBound());
+      if (ts < Timestamp::Max()) {
+        stream.AddPacket(MakePacket<FlowLimiterStats>(stats).At(ts));
+      }
+    }
+    window_released_ = 0;
+    window_dropped_ = 0;
   }
 
   // Outputs a packet indicating whether a frame was sent or dropped.
@@ -165,12 +308,15 @@ class FlowLimiterCalculator : public CalculatorBase {
     // LOG(ERROR) << "FlowLimiterCalculator--->.";
     options_ = tool::RetrieveOptions(options_, cc->Inputs());
 
+    const absl::Time now =
+        adaptive_ ? clock_->TimeNow() : absl::InfinitePast();
+
     // Process the FINISHED input stream.
     Packet finished_packet = cc->Inputs().Tag(kFinishedTag).Value();
     if (finished_packet.Timestamp() == cc->InputTimestamp()) {
       while (!frames_in_flight_.empty() &&
              frames_in_flight_.front() <= finished_packet.Timestamp()) {
-        frames_in_flight_.pop_front();
+        FinishFrameInFlight(now, cc);
       }
     }
 
@@ -179,6 +325,9 @@ class FlowLimiterCalculator : public CalculatorBase {
       Packet packet = cc->Inputs().Get("", i).Value();
       if (!packet.IsEmpty()) {
         input_queues_[i].push_back(packet);
+        if (i == 0 && adaptive_) {
+          arrival_times_.push_back(now);
+        }
       }
     }
 
@@ -190,7 +339,7 @@ class FlowLimiterCalculator : public CalculatorBase {
         latest_ts < Timestamp::Max()) {
       while (!frames_in_flight_.empty() &&
              (latest_ts - frames_in_flight_.front()) > timeout) {
-        frames_in_flight_.pop_front();
+        FinishFrameInFlight(now, cc);
       }
     }
 
@@ -202,15 +351,29 @@ class FlowLimiterCalculator : public CalculatorBase {
       cc->Outputs().Get("", 0).AddPacket(packet);
       SendAllow(true, packet.Timestamp(), cc);
       frames_in_flight_.push_back(packet.Timestamp());
+      if (adaptive_) {
+        in_flight_arrival_times_.push_back(arrival_times_.front());
+        arrival_times_.pop_front();
+      }
+      ++released_frames_;
+      ++window_released_;
     }
 
     // Limit the number of queued frames.
     // Note that frames can be dropped after frames are released because
     // frame-packets and FINISH-packets never arrive in the same Process call.
-    while (input_queue.size() > options_.max_in_queue()) {
+    while (input_queue.size() > MaxInQueue()) {
       Packet packet = input_queue.front();
       input_queue.pop_front();
+      if (adaptive_) {
+        arrival_times_.pop_front();
+      }
+      ++dropped_frames_;
+      ++window_dropped_;
       SendAllow(false, packet.Timestamp(), cc);
+      if (dropped_packets_) {
+        dropped_packets_->Increment();
+      }
     }
 
     // Propagate the input timestamp bound.
@@ -227,6 +390,16 @@ class FlowLimiterCalculator : public CalculatorBase {
     }
 
     ProcessAuxiliaryInputs(cc);
+
+    // Propagate the timestamp bound of the stats, which are output at input
+    // timestamps.
+    if (cc->Outputs().HasTag(kStatsTag)) {
+      OutputStream* stats_stream = &cc->Outputs().Tag(kStatsTag);
+      Timestamp bound = cc->InputTimestamp().NextAllowedInStream();
+      if (bound > stats_stream->NextTimestampBound()) {
+        SetNextTimestampBound(bound, stats_stream);
+      }
+    }
     return absl::OkStatus();
   }
 
@@ -234,6 +407,25 @@ class FlowLimiterCalculator : public CalculatorBase {
   FlowLimiterCalculatorOptions options_;
   std::vector<std::deque<Packet>> input_queues_;
   std::deque<Timestamp> frames_in_flight_;
+  // The arrival times of the frames in input_queues_[0] and in
+  // frames_in_flight_, which are only measured if the limits are adaptive.
+  std::deque<absl::Time> arrival_times_;
+  std::deque<absl::Time> in_flight_arrival_times_;
+
+  // The state of the adaptive limits. adaptive_ and adaptive_options_ are set
+  // in Open(), so that the OPTIONS input stream can't change them.
+  bool adaptive_ = false;
+  FlowLimiterCalculatorOptions::AdaptiveOptions adaptive_options_;
+  std::shared_ptr<Clock> clock_;
+  int in_flight_limit_ = 1;
+  bool over_target_ = false;
+  std::vector<absl::Duration> latencies_;
+  int64 released_frames_ = 0;
+  int64 dropped_frames_ = 0;
+  int64 window_released_ = 0;
+  int64 window_dropped_ = 0;
+  // Counts the dropped frames if a MetricRegistry is provided.
+  ShardedCounter* dropped_packets_ = nullptr;
 };
 REGISTER_CALCULATOR(FlowLimiterCalculator);
 
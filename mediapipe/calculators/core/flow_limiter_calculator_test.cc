@@ -28,6 +28,7 @@
 #include "mediapipe/framework/port/integral_types.h"
 #include "mediapipe/framework/port/parse_text_proto.h"
 #include "mediapipe/framework/port/status_matchers.h"
+#include "mediapipe/framework/profiler/metric_registry.h"
 #include "mediapipe/framework/timestamp.h"
 #include "mediapipe/framework/tool/simulation_clock.h"
 #include "mediapipe/framework/tool/simulation_clock_executor.h"
@@ -207,6 +208,46 @@ TEST_F(FlowLimiterCalculatorSemaphoreTest, FramesDropped) {
             (std::vector<int64>{0, 10, 20, 30, 40, 50, 60, 70, 80, 90}));
 }
 
+// Dropped frames and input queue sizes are reported to a MetricRegistry.
+TEST_F(FlowLimiterCalculatorSemaphoreTest, FramesDroppedAreCounted) {
+  InitializeGraph(1);
+  auto registry = std::make_shared<MetricRegistry>();
+  MP_ASSERT_OK(graph_.SetServiceObject(kMetricRegistryService, registry));
+  MP_ASSERT_OK(graph_.StartRun({}));
+
+  Packet allow_packet;
+  AddPacket("in_1", 0);
+  for (int i = 0; i < 3; i++) {
+    EXPECT_TRUE(allow_poller_->Next(&allow_packet));
+    AddPacket("in_1", i * 10 + 5);
+    AddPacket("in_1", i * 10 + 10);
+    EXPECT_TRUE(allow_poller_->Next(&allow_packet));
+    EXPECT_FALSE(allow_packet.Get<bool>());
+    exit_semaphore_.Release(1);
+  }
+  exit_semaphore_.Release(1);
+  MP_EXPECT_OK(graph_.CloseInputStream("in_1"));
+  MP_EXPECT_OK(graph_.WaitUntilDone());
+
+  EXPECT_EQ(registry
+                ->GetCounter(MetricRegistry::MetricKey(
+                    "mediapipe_flow_limiter_dropped_packets_total",
+                    {{"node", "FlowLimiterCalculator"}}))
+                ->Get(),
+            3);
+  const ShardedHistogram::Snapshot queue_sizes =
+      registry
+          ->GetHistogram(MetricRegistry::MetricKey(
+              "mediapipe_input_queue_size",
+              {{"node", "LambdaCalculator"}, {"stream", "in_1_sampled"}}))
+          ->GetSnapshot();
+  EXPECT_EQ(queue_sizes.count, out_1_packets_.size());
+  EXPECT_THAT(registry->ExportText(),
+              testing::HasSubstr(
+                  "mediapipe_flow_limiter_dropped_packets_total"
+                  "{node=\"FlowLimiterCalculator\"} 3\n"));
+}
+
 // A calculator that sleeps during Process.
 class SleepCalculator : public CalculatorBase {
  public:
@@ -311,6 +352,54 @@ class FlowLimiterCalculatorTest : public testing::Test {
     )pb");
   }
 
+  // A graph whose FlowLimiterCalculator outputs its stats and reads time from
+  // the test clock.
+  CalculatorGraphConfig AdaptiveGraphConfig() {
+    CalculatorGraphConfig config = InflightGraphConfig();
+    CalculatorGraphConfig::Node* limiter = config.mutable_node(0);
+    limiter->add_output_stream("STATS:stats");
+    limiter->add_input_side_packet("CLOCK:limiter_clock");
+    return config;
+  }
+
+  // Sends one input packet every 10 ms through the AdaptiveGraphConfig,
+  // whose SleepCalculator takes "sleep_time" per packet, and returns the
+  // FlowLimiterStats output.
+  std::vector<FlowLimiterStats> RunAdaptiveGraph(
+      const FlowLimiterCalculatorOptions& limiter_options, int64 sleep_time) {
+    std::vector<FlowLimiterStats> stats;
+    std::map<std::string, Packet> side_packets = {
+        {"limiter_options",
+         MakePacket<FlowLimiterCalculatorOptions>(limiter_options)},
+        {"limiter_clock",
+         MakePacket<std::shared_ptr<mediapipe::Clock>>(simulation_clock_)},
+        {"warmup_time", MakePacket<int64>(sleep_time)},
+        {"sleep_time", MakePacket<int64>(sleep_time)},
+        {"drop_timesamps", MakePacket<bool>(false)},
+        {"clock", MakePacket<mediapipe::Clock*>(clock_)},
+    };
+    MEDIAPIPE_CHECK_OK(graph_.Initialize(AdaptiveGraphConfig()));
+    MEDIAPIPE_CHECK_OK(graph_.ObserveOutputStream("out_1", [this](Packet p) {
+      out_1_packets_.push_back(p);
+      return absl::OkStatus();
+    }));
+    MEDIAPIPE_CHECK_OK(graph_.ObserveOutputStream("stats", [&](Packet p) {
+      stats.push_back(p.Get<FlowLimiterStats>());
+      return absl::OkStatus();
+    }));
+    simulation_clock_->ThreadStart();
+    MEDIAPIPE_CHECK_OK(graph_.StartRun(side_packets));
+    for (const Packet& packet : input_packets_) {
+      MEDIAPIPE_CHECK_OK(graph_.AddPacketToInputStream("in_1", packet));
+      clock_->Sleep(absl::Microseconds(10000));
+    }
+    MEDIAPIPE_CHECK_OK(graph_.CloseAllPacketSources());
+    clock_->Sleep(absl::Microseconds(400000));
+    MEDIAPIPE_CHECK_OK(graph_.WaitUntilDone());
+    simulation_clock_->ThreadFinish();
+    return stats;
+  }
+
   // Parse an absl::Time from RFC3339 format.
   absl::Time ParseTime(const std::string& date_time_str) {
     absl::Time result;
@@ -552,6 +641,153 @@ TEST_F(FlowLimiterCalculatorTest, FinishedDelayed) {
   EXPECT_EQ(out_1_packets_, expected_output);
 }
 
+// Shows that an adaptive FlowLimiterCalculator keeps the latency of the frames
+// close to the target latency. Frames arrive every 10 ms, and take 22 ms to
+// process, so each frame in flight adds about 22 ms of latency. Starting from
+// 1 frame in flight, the limit grows until the 50 ms target is exceeded, and
+// is then halved.
+TEST_F(FlowLimiterCalculatorTest, AdaptiveLimitsFollowTargetLatency) {
+  SetUpInputData();
+  SetUpSimulationClock();
+  auto limiter_options = ParseTextProtoOrDie<FlowLimiterCalculatorOptions>(R"pb(
+    max_in_flight: 1
+    max_in_queue: 1
+    adaptive {
+      target_latency_us: 50000
+      max_in_flight: 8
+      window_size: 4
+    }
+  )pb");
+  std::vector<FlowLimiterStats> stats =
+      RunAdaptiveGraph(limiter_options, /*sleep_time=*/22000);
+
+  ASSERT_FALSE(stats.empty());
+  int max_in_flight = 0;
+  int num_decreases = 0;
+  int64 released_frames = 0;
+  for (int i = 0; i < stats.size(); ++i) {
+    max_in_flight = std::max(max_in_flight, stats[i].max_in_flight());
+    if (stats[i].latency_us() > 50000) {
+      ++num_decreases;
+      EXPECT_EQ(stats[i].max_in_queue(), 0);
+    } else {
+      EXPECT_EQ(stats[i].max_in_queue(), 1);
+    }
+    EXPECT_GE(stats[i].released_frames(), released_frames);
+    released_frames = stats[i].released_frames();
+  }
+  EXPECT_GE(max_in_flight, 2);
+  EXPECT_LE(max_in_flight, 3);
+  EXPECT_GT(num_decreases, 0);
+  // Frames arrive about twice as fast as they are processed, and the frames
+  // released keep the SleepCalculator busy.
+  const FlowLimiterStats& last = stats.back();
+  EXPECT_GT(last.drop_rate(), 0.0);
+  EXPECT_GT(last.dropped_frames(), 30);
+  EXPECT_GT(last.released_frames(), 35);
+  EXPECT_LE(last.released_frames() + last.dropped_frames(),
+            input_packets_.size());
+}
+
+// Shows that the number of frames in flight grows to its maximum while the
+// latency stays under the target.
+TEST_F(FlowLimiterCalculatorTest, AdaptiveLimitsGrowUnderTarget) {
+  SetUpInputData();
+  SetUpSimulationClock();
+  auto limiter_options = ParseTextProtoOrDie<FlowLimiterCalculatorOptions>(R"pb(
+    max_in_flight: 1
+    adaptive {
+      target_latency_us: 1000000
+      max_in_flight: 3
+      window_size: 4
+    }
+  )pb");
+  std::vector<FlowLimiterStats> stats =
+      RunAdaptiveGraph(limiter_options, /*sleep_time=*/22000);
+
+  ASSERT_GE(stats.size(), 3);
+  EXPECT_EQ(stats[0].max_in_flight(), 2);
+  EXPECT_EQ(stats[1].max_in_flight(), 3);
+  for (const FlowLimiterStats& s : stats) {
+    EXPECT_LE(s.latency_us(), 1000000);
+  }
+  EXPECT_EQ(stats.back().max_in_flight(), 3);
+}
+
+// Shows that adaptive options outside their valid ranges fail the graph.
+TEST_F(FlowLimiterCalculatorTest, AdaptiveRejectsInvalidOptions) {
+  SetUpSimulationClock();
+  for (const std::string& adaptive :
+       {"decrease_factor: 0", "decrease_factor: 1", "latency_percentile: 0",
+        "latency_percentile: 1.5"}) {
+    auto limiter_options = ParseTextProtoOrDie<FlowLimiterCalculatorOptions>(
+        "max_in_flight: 1 adaptive { " + adaptive + " }");
+    std::map<std::string, Packet> side_packets = {
+        {"limiter_options",
+         MakePacket<FlowLimiterCalculatorOptions>(limiter_options)},
+        {"limiter_clock",
+         MakePacket<std::shared_ptr<mediapipe::Clock>>(simulation_clock_)},
+        {"warmup_time", MakePacket<int64>(0)},
+        {"sleep_time", MakePacket<int64>(0)},
+        {"drop_timesamps", MakePacket<bool>(false)},
+        {"clock", MakePacket<mediapipe::Clock*>(clock_)},
+    };
+    CalculatorGraph graph;
+    MP_ASSERT_OK(graph.Initialize(AdaptiveGraphConfig()));
+    absl::Status status = graph.StartRun(side_packets);
+    if (status.ok()) {
+      status = graph.WaitUntilDone();
+    }
+    EXPECT_FALSE(status.ok()) << adaptive;
+  }
+}
+
+// Shows that adaptive options arriving on the OPTIONS input stream after
+// Open() are ignored, so the limits configured in Open() stay in effect.
+TEST(FlowLimiterCalculatorOptionsTest, IgnoresAdaptiveOptionsStream) {
+  auto graph_config = ParseTextProtoOrDie<CalculatorGraphConfig>(R"pb(
+    input_stream: 'in'
+    input_stream: 'opts'
+    input_stream: 'finished'
+    node {
+      calculator: 'FlowLimiterCalculator'
+      input_stream: 'in'
+      input_stream: 'OPTIONS:opts'
+      input_stream: 'FINISHED:finished'
+      output_stream: 'out'
+      options {
+        [mediapipe.FlowLimiterCalculatorOptions.ext] {
+          max_in_flight: 3
+          max_in_queue: 0
+        }
+      }
+    }
+  )pb");
+  CalculatorGraph graph;
+  std::vector<Packet> out_packets;
+  MP_ASSERT_OK(graph.Initialize(graph_config));
+  MP_ASSERT_OK(graph.ObserveOutputStream("out", [&](const Packet& p) {
+    out_packets.push_back(p);
+    return absl::OkStatus();
+  }));
+  MP_ASSERT_OK(graph.StartRun({}));
+  auto adaptive_options = ParseTextProtoOrDie<FlowLimiterCalculatorOptions>(
+      R"pb(adaptive { max_in_flight: 8 })pb");
+  MP_ASSERT_OK(graph.AddPacketToInputStream(
+      "opts", MakePacket<FlowLimiterCalculatorOptions>(adaptive_options)
+                  .At(Timestamp(0))));
+  MP_ASSERT_OK(graph.WaitUntilIdle());
+  for (int i = 0; i < 3; ++i) {
+    MP_ASSERT_OK(graph.AddPacketToInputStream(
+        "in", MakePacket<int>(i).At(Timestamp(i))));
+  }
+  MP_ASSERT_OK(graph.WaitUntilIdle());
+  // All three frames fit within max_in_flight: 3 without finishing any.
+  EXPECT_EQ(out_packets.size(), 3);
+  MP_ASSERT_OK(graph.CloseAllInputStreams());
+  MP_ASSERT_OK(graph.WaitUntilDone());
+}
+
 // Shows that packets on auxiliary input streams are relesed for the same
 // timestamps as the main input stream, whether the auxiliary packets arrive
 // early or late.
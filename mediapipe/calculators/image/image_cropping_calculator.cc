@@ -18,6 +18,7 @@
 
 #include "mediapipe/framework/formats/image_frame.h"
 #include "mediapipe/framework/formats/image_frame_opencv.h"
+#include "mediapipe/framework/formats/image_frame_pool.h"
 #include "mediapipe/framework/formats/rect.pb.h"
 #include "mediapipe/framework/port/opencv_core_inc.h"
 #include "mediapipe/framework/port/opencv_imgproc_inc.h"
@@ -260,8 +261,12 @@ absl::Status ImageCroppingCalculator::RenderCpu(CalculatorContext* cc) {
                       /* flags = */ 0,
                       /* borderMode = */ border_mode);
 
-  std::unique_ptr<ImageFrame> output_frame(new ImageFrame(
-      input_img.Format(), cropped_image.cols, cropped_image.rows));
+  std::unique_ptr<ImageFrame> output_frame =
+      options_.use_shared_buffer_pool()
+          ? CreateImageFrameFromPool(input_img.Format(), cropped_image.cols,
+                                     cropped_image.rows)
+          : std::make_unique<ImageFrame>(
+                input_img.Format(), cropped_image.cols, cropped_image.rows);
   cv::Mat output_mat = formats::MatView(output_frame.get());
   cropped_image.copyTo(output_mat);
   cc->Outputs().Tag(kImageTag).Add(output_frame.release(),
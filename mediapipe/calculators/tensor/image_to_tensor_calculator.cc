@@ -18,6 +18,7 @@
 
 #include "mediapipe/calculators/tensor/image_to_tensor_calculator.pb.h"
 #include "mediapipe/calculators/tensor/image_to_tensor_converter.h"
+#include "mediapipe/calculators/tensor/image_to_tensor_converter_fused.h"
 #include "mediapipe/calculators/tensor/image_to_tensor_utils.h"
 #include "mediapipe/framework/api2/node.h"
 #include "mediapipe/framework/calculator_framework.h"
@@ -25,11 +26,13 @@
 #include "mediapipe/framework/formats/image_frame.h"
 #include "mediapipe/framework/formats/rect.pb.h"
 #include "mediapipe/framework/formats/tensor.h"
+#include "mediapipe/framework/formats/tensor_buffer_pool.h"
 #include "mediapipe/framework/port.h"
 #include "mediapipe/framework/port/canonical_errors.h"
 #include "mediapipe/framework/port/ret_check.h"
 #include "mediapipe/framework/port/status.h"
 #include "mediapipe/framework/port/statusor.h"
+#include "mediapipe/framework/port/threadpool.h"
 #include "mediapipe/gpu/gpu_origin.pb.h"
 
 #if !MEDIAPIPE_DISABLE_OPENCV
@@ -82,9 +85,19 @@ using GpuBuffer = mediapipe::GpuBuffer;
 //     Describes region of image to extract.
 //     @Optional: rect covering the whole image is used if not specified.
 //
+//   NORM_RECTS - std::vector<NormalizedRect> @Optional
+//     Describes several regions of image to extract at once. The image is
+//     read once and the regions are converted in parallel on CPU (see
+//     "num_threads" option) into a single batched tensor, which lets a
+//     batched inference calculator process all of them together. Nothing is
+//     output for an empty vector.
+//     Cannot be used together with NORM_RECT.
+//
 // Outputs:
 //   TENSORS - std::vector<Tensor>
 //     Vector containing a single Tensor populated with an extrated RGB image.
+//     With NORM_RECTS, the Tensor has the shape [N, height, width, 3] and
+//     holds the N regions in their input order.
 //     数组：包含一个提取的RGB图像的张量。
 //   MATRIX - std::array<float, 16> @Optional
 //     An std::array<float, 16> representing a 4x4 row-major-order matrix that
@@ -107,6 +120,11 @@ using GpuBuffer = mediapipe::GpuBuffer;
 //     例如,当输入图像10 x10(宽度x高度)和计算器选项中指定的输出尺寸20 x40和“keep_aspect_ratio”是true,
 //     计算器调整图片到20 x20并且将输入图像放到输出图像的的中间，在顶部和底部填充的10个像素。因此，结果数组是[0。0.25 f, f, 0。(10/40 = 0.25f)。
 //
+//   MATRICES - std::vector<std::array<float, 16>> @Optional
+//   LETTERBOX_PADDINGS - std::vector<std::array<float, 4>> @Optional
+//     The MATRIX and LETTERBOX_PADDING of each region of NORM_RECTS, which
+//     requires them in place of MATRIX and LETTERBOX_PADDING.
+//
 // Example:
 // node {
 //   calculator: "ImageToTensorCalculator"
@@ -134,13 +152,20 @@ class ImageToTensorCalculator : public Node {
   static constexpr Input<GpuBuffer>::Optional kInGpu{"IMAGE_GPU"};
   static constexpr Input<mediapipe::NormalizedRect>::Optional kInNormRect{
       "NORM_RECT"};
+  static constexpr Input<std::vector<mediapipe::NormalizedRect>>::Optional
+      kInNormRects{"NORM_RECTS"};
   static constexpr Output<std::vector<Tensor>> kOutTensors{"TENSORS"};
   static constexpr Output<std::array<float, 4>>::Optional kOutLetterboxPadding{
       "LETTERBOX_PADDING"};
   static constexpr Output<std::array<float, 16>>::Optional kOutMatrix{"MATRIX"};
+  static constexpr Output<std::vector<std::array<float, 4>>>::Optional
+      kOutLetterboxPaddings{"LETTERBOX_PADDINGS"};
+  static constexpr Output<std::vector<std::array<float, 16>>>::Optional
+      kOutMatrices{"MATRICES"};
 
-  MEDIAPIPE_NODE_CONTRACT(kIn, kInGpu, kInNormRect, kOutTensors,
-                          kOutLetterboxPadding, kOutMatrix);
+  MEDIAPIPE_NODE_CONTRACT(kIn, kInGpu, kInNormRect, kInNormRects, kOutTensors,
+                          kOutLetterboxPadding, kOutMatrix,
+                          kOutLetterboxPaddings, kOutMatrices);
 
   static absl::Status UpdateContract(CalculatorContract* cc) {
     const auto& options =
@@ -171,6 +196,22 @@ class ImageToTensorCalculator : public Node {
 
     RET_CHECK(kIn(cc).IsConnected() ^ kInGpu(cc).IsConnected())
         << "One and only one of IMAGE and IMAGE_GPU input is expected.";
+    if (kInNormRects(cc).IsConnected()) {
+      RET_CHECK(!kInNormRect(cc).IsConnected())
+          << "At most one of NORM_RECT and NORM_RECTS input is expected.";
+      RET_CHECK(!kOutLetterboxPadding(cc).IsConnected() &&
+                !kOutMatrix(cc).IsConnected())
+          << "NORM_RECTS input requires LETTERBOX_PADDINGS and MATRICES "
+             "outputs instead of LETTERBOX_PADDING and MATRIX.";
+    } else {
+      RET_CHECK(!kOutLetterboxPaddings(cc).IsConnected() &&
+                !kOutMatrices(cc).IsConnected())
+          << "LETTERBOX_PADDINGS and MATRICES outputs require NORM_RECTS "
+             "input.";
+    }
+    RET_CHECK_GE(options.num_threads(), 1)
+        << "At least one thread is required.";
+    cc->UseService(kTensorBufferPoolService).Optional();
 
 #if MEDIAPIPE_DISABLE_GPU
     if (kInGpu(cc).IsConnected()) {
@@ -201,6 +242,11 @@ class ImageToTensorCalculator : public Node {
         is_int_output_
             ? static_cast<float>(options_.output_tensor_int_range().max())
             : options_.output_tensor_float_range().max();
+    if (kInNormRects(cc).IsConnected() && options_.num_threads() > 1) {
+      thread_pool_ = std::make_unique<ThreadPool>("ImageToTensor",
+                                                  options_.num_threads());
+      thread_pool_->StartWorkers();
+    }
     return absl::OkStatus();
   }
 
@@ -210,6 +256,9 @@ class ImageToTensorCalculator : public Node {
       // Timestamp bound update happens automatically.
       return absl::OkStatus();
     }
+    if (kInNormRects(cc).IsConnected()) {
+      return ProcessNormRects(cc);
+    }
 
     absl::optional<mediapipe::NormalizedRect> norm_rect;
     if (kInNormRect(cc).IsConnected()) {
@@ -265,6 +314,60 @@ class ImageToTensorCalculator : public Node {
   }
 
  private:
+  // Extracts all regions of NORM_RECTS into one batched tensor.
+  absl::Status ProcessNormRects(CalculatorContext* cc) {
+    if (kInNormRects(cc).IsEmpty() || kInNormRects(cc)->empty()) {
+      // Timestamp bound update happens automatically.
+      return absl::OkStatus();
+    }
+
+    ASSIGN_OR_RETURN(auto image, GetInputImage(cc));
+    const Size size{image->width(), image->height()};
+    const std::vector<mediapipe::NormalizedRect>& norm_rects =
+        *kInNormRects(cc);
+    std::vector<RotatedRect> rois;
+    rois.reserve(norm_rects.size());
+    auto paddings = std::make_unique<std::vector<std::array<float, 4>>>();
+    auto matrices = std::make_unique<std::vector<std::array<float, 16>>>();
+    for (const mediapipe::NormalizedRect& norm_rect : norm_rects) {
+      RotatedRect roi = GetRoi(size.width, size.height, norm_rect);
+      ASSIGN_OR_RETURN(auto padding, PadRoi(options_.output_tensor_width(),
+                                            options_.output_tensor_height(),
+                                            options_.keep_aspect_ratio(),
+                                            &roi));
+      paddings->push_back(padding);
+      if (kOutMatrices(cc).IsConnected()) {
+        std::array<float, 16> matrix;
+        GetRotatedSubRectToRectTransformMatrix(roi, size.width, size.height,
+                                               /*flip_horizontaly=*/false,
+                                               &matrix);
+        matrices->push_back(matrix);
+      }
+      rois.push_back(roi);
+    }
+    if (kOutLetterboxPaddings(cc).IsConnected()) {
+      kOutLetterboxPaddings(cc).Send(std::move(paddings));
+    }
+    if (kOutMatrices(cc).IsConnected()) {
+      kOutMatrices(cc).Send(std::move(matrices));
+    }
+
+    // Lazy initialization of the GPU or CPU converter.
+    MP_RETURN_IF_ERROR(InitConverterIfNecessary(cc, *image.get()));
+
+    ASSIGN_OR_RETURN(
+        Tensor tensor,
+        (image->UsesGpu() ? gpu_converter_ : cpu_converter_)
+            ->ConvertBatch(*image, rois, {output_width_, output_height_},
+                           range_min_, range_max_, thread_pool_.get()));
+
+    auto result = std::make_unique<std::vector<Tensor>>();
+    result->push_back(std::move(tensor));
+    kOutTensors(cc).Send(std::move(result));
+
+    return absl::OkStatus();
+  }
+
   bool DoesGpuInputStartAtBottom() {
     return options_.gpu_origin() != mediapipe::GpuOrigin_Mode_TOP_LEFT;
   }
@@ -343,16 +446,29 @@ class ImageToTensorCalculator : public Node {
       }
     } else {
       if (!cpu_converter_) {
+        const Tensor::ElementType tensor_type =
+            is_int_output_ ? Tensor::ElementType::kUInt8
+                           : Tensor::ElementType::kFloat32;
+        const auto cpu_converter = options_.cpu_converter();
 #if !MEDIAPIPE_DISABLE_OPENCV
-        ASSIGN_OR_RETURN(cpu_converter_,
-                         CreateOpenCvConverter(
-                             cc, GetBorderMode(),
-                             is_int_output_ ? Tensor::ElementType::kUInt8
-                                            : Tensor::ElementType::kFloat32));
+        if (cpu_converter !=
+            mediapipe::ImageToTensorCalculatorOptions::CPU_CONVERTER_FUSED) {
+          ASSIGN_OR_RETURN(
+              cpu_converter_,
+              CreateOpenCvConverter(cc, GetBorderMode(), tensor_type));
+        }
 #else
-        LOG(FATAL) << "Cannot create image to tensor opencv converter since "
-                      "MEDIAPIPE_DISABLE_OPENCV is defined.";
+        if (cpu_converter ==
+            mediapipe::ImageToTensorCalculatorOptions::CPU_CONVERTER_OPENCV) {
+          LOG(FATAL) << "Cannot create image to tensor opencv converter since "
+                        "MEDIAPIPE_DISABLE_OPENCV is defined.";
+        }
 #endif  // !MEDIAPIPE_DISABLE_OPENCV
+        if (!cpu_converter_) {
+          ASSIGN_OR_RETURN(
+              cpu_converter_,
+              CreateFusedConverter(cc, GetBorderMode(), tensor_type));
+        }
       }
     }
     return absl::OkStatus();
@@ -360,6 +476,8 @@ class ImageToTensorCalculator : public Node {
 
   std::unique_ptr<ImageToTensorConverter> gpu_converter_;
   std::unique_ptr<ImageToTensorConverter> cpu_converter_;
+  // Converts the regions of NORM_RECTS in parallel, if num_threads > 1.
+  std::unique_ptr<ThreadPool> thread_pool_;
   mediapipe::ImageToTensorCalculatorOptions options_;
   int output_width_ = 0;
   int output_height_ = 0;
@@ -12,11 +12,15 @@
 // See the License for the specific language governing permissions and
 // limitations under the License.
 
+#include <algorithm>
+#include <array>
 #include <cmath>
+#include <string>
 #include <vector>
 
 #include "absl/flags/flag.h"
 #include "absl/memory/memory.h"
+#include "absl/strings/str_cat.h"
 #include "absl/strings/substitute.h"
 #include "mediapipe/calculators/tensor/image_to_tensor_converter.h"
 #include "mediapipe/calculators/tensor/image_to_tensor_utils.h"
@@ -29,6 +33,7 @@
 #include "mediapipe/framework/formats/image_frame_opencv.h"
 #include "mediapipe/framework/formats/rect.pb.h"
 #include "mediapipe/framework/formats/tensor.h"
+#include "mediapipe/framework/port/gmock.h"
 #include "mediapipe/framework/port/gtest.h"
 #include "mediapipe/framework/port/integral_types.h"
 #include "mediapipe/framework/port/opencv_core_inc.h"
@@ -62,7 +67,8 @@ void RunTestWithInputImagePacket(const Packet& input_image_packet,
                                  int tensor_height, bool keep_aspect,
                                  absl::optional<BorderMode> border_mode,
                                  const mediapipe::NormalizedRect& roi,
-                                 bool output_int_tensor) {
+                                 bool output_int_tensor,
+                                 const std::string& cpu_converter) {
   std::string border_mode_str;
   if (border_mode) {
     switch (*border_mode) {
@@ -105,6 +111,7 @@ void RunTestWithInputImagePacket(const Packet& input_image_packet,
               keep_aspect_ratio: $2
               $3 # output range
               $4 # border mode
+              $5 # cpu converter
             }
           }
         }
@@ -113,7 +120,8 @@ void RunTestWithInputImagePacket(const Packet& input_image_packet,
                        /*$1=*/tensor_height,
                        /*$2=*/keep_aspect ? "true" : "false",
                        /*$3=*/output_tensor_range,
-                       /*$4=*/border_mode_str));
+                       /*$4=*/border_mode_str,
+                       /*$5=*/cpu_converter));
 
   std::vector<Packet> output_packets;
   tool::AddVectorSink("tensor", &graph_config, &output_packets);
@@ -189,6 +197,10 @@ enum class InputType { kImageFrame, kImage };
 const std::vector<InputType> kInputTypesToTest = {InputType::kImageFrame,
                                                   InputType::kImage};
 
+// The default (OpenCV) and the fused CPU converters.
+const std::vector<std::string> kCpuConvertersToTest = {
+    "", "cpu_converter: CPU_CONVERTER_FUSED"};
+
 void RunTest(cv::Mat input, cv::Mat expected_result,
              std::vector<float> float_range, std::vector<int> int_range,
              int tensor_width, int tensor_height, bool keep_aspect,
@@ -196,19 +208,21 @@ void RunTest(cv::Mat input, cv::Mat expected_result,
              const mediapipe::NormalizedRect& roi) {
   ASSERT_EQ(2, float_range.size());
   ASSERT_EQ(2, int_range.size());
-  for (auto input_type : kInputTypesToTest) {
-    RunTestWithInputImagePacket(
-        input_type == InputType::kImageFrame ? MakeImageFramePacket(input)
-                                             : MakeImagePacket(input),
-        expected_result, float_range[0], float_range[1], tensor_width,
-        tensor_height, keep_aspect, border_mode, roi,
-        /*output_int_tensor=*/false);
-    RunTestWithInputImagePacket(
-        input_type == InputType::kImageFrame ? MakeImageFramePacket(input)
-                                             : MakeImagePacket(input),
-        expected_result, int_range[0], int_range[1], tensor_width,
-        tensor_height, keep_aspect, border_mode, roi,
-        /*output_int_tensor=*/true);
+  for (const std::string& cpu_converter : kCpuConvertersToTest) {
+    for (auto input_type : kInputTypesToTest) {
+      RunTestWithInputImagePacket(
+          input_type == InputType::kImageFrame ? MakeImageFramePacket(input)
+                                               : MakeImagePacket(input),
+          expected_result, float_range[0], float_range[1], tensor_width,
+          tensor_height, keep_aspect, border_mode, roi,
+          /*output_int_tensor=*/false, cpu_converter);
+      RunTestWithInputImagePacket(
+          input_type == InputType::kImageFrame ? MakeImageFramePacket(input)
+                                               : MakeImagePacket(input),
+          expected_result, int_range[0], int_range[1], tensor_width,
+          tensor_height, keep_aspect, border_mode, roi,
+          /*output_int_tensor=*/true, cpu_converter);
+    }
   }
 }
 
@@ -464,5 +478,144 @@ TEST(ImageToTensorCalculatorTest, NoOpExceptRangeBorderZero) {
           BorderMode::kZero, roi);
 }
 
+// Converts "input" with a graph that receives the regions "rects" on its
+// "rect_tag" input, and returns the packets of the TENSORS output followed by
+// those of the "matrix_tag" output.
+std::vector<Packet> RunRegionsGraph(cv::Mat input, const std::string& rect_tag,
+                                    Packet rects, const std::string& matrix_tag,
+                                    const std::string& options) {
+  auto graph_config = mediapipe::ParseTextProtoOrDie<CalculatorGraphConfig>(
+      absl::Substitute(R"(
+        input_stream: "input_image"
+        input_stream: "roi"
+        node {
+          calculator: "ImageToTensorCalculator"
+          input_stream: "IMAGE:input_image"
+          input_stream: "$0:roi"
+          output_stream: "TENSORS:tensor"
+          output_stream: "$1:matrix"
+          options {
+            [mediapipe.ImageToTensorCalculatorOptions.ext] {
+              output_tensor_width: 64
+              output_tensor_height: 48
+              keep_aspect_ratio: true
+              output_tensor_float_range { min: -1 max: 1 }
+              $2
+            }
+          }
+        }
+      )",
+                       rect_tag, matrix_tag, options));
+  std::vector<Packet> tensor_packets;
+  std::vector<Packet> matrix_packets;
+  tool::AddVectorSink("tensor", &graph_config, &tensor_packets);
+  tool::AddVectorSink("matrix", &graph_config, &matrix_packets);
+
+  CalculatorGraph graph;
+  MP_EXPECT_OK(graph.Initialize(graph_config));
+  MP_EXPECT_OK(graph.StartRun({}));
+  MP_EXPECT_OK(graph.AddPacketToInputStream(
+      "input_image", MakeImageFramePacket(input).At(Timestamp(0))));
+  MP_EXPECT_OK(graph.AddPacketToInputStream("roi", rects.At(Timestamp(0))));
+  MP_EXPECT_OK(graph.CloseAllInputStreams());
+  MP_EXPECT_OK(graph.WaitUntilDone());
+  tensor_packets.insert(tensor_packets.end(), matrix_packets.begin(),
+                        matrix_packets.end());
+  return tensor_packets;
+}
+
+std::vector<mediapipe::NormalizedRect> GetTestRects() {
+  std::vector<mediapipe::NormalizedRect> rects(3);
+  rects[0].set_x_center(0.65f);
+  rects[0].set_y_center(0.4f);
+  rects[0].set_width(0.5f);
+  rects[0].set_height(0.5f);
+  rects[1].set_x_center(0.3f);
+  rects[1].set_y_center(0.6f);
+  rects[1].set_width(0.2f);
+  rects[1].set_height(0.6f);
+  rects[1].set_rotation(M_PI * 30.0f / 180.0f);
+  // Partially outside of the image.
+  rects[2].set_x_center(0.9f);
+  rects[2].set_y_center(0.1f);
+  rects[2].set_width(0.4f);
+  rects[2].set_height(0.3f);
+  rects[2].set_rotation(M_PI * -90.0f / 180.0f);
+  return rects;
+}
+
+TEST(ImageToTensorCalculatorTest, NormRectsMatchNormRect) {
+  const cv::Mat input =
+      GetRgb("/mediapipe/calculators/tensor/testdata/image_to_tensor/input.jpg");
+  const std::vector<mediapipe::NormalizedRect> rects = GetTestRects();
+  for (const std::string& cpu_converter : kCpuConvertersToTest) {
+    for (const std::string& num_threads : {"", "num_threads: 3"}) {
+      const std::string options = absl::StrCat(cpu_converter, " ", num_threads);
+      SCOPED_TRACE(options);
+      std::vector<Packet> batch = RunRegionsGraph(
+          input, "NORM_RECTS",
+          MakePacket<std::vector<mediapipe::NormalizedRect>>(rects),
+          "MATRICES", options);
+      ASSERT_EQ(batch.size(), 2);
+      const std::vector<Tensor>& batch_tensors =
+          batch[0].Get<std::vector<Tensor>>();
+      ASSERT_EQ(batch_tensors.size(), 1);
+      const Tensor& batch_tensor = batch_tensors[0];
+      EXPECT_EQ(batch_tensor.shape().dims, std::vector<int>({3, 48, 64, 3}));
+      const auto& matrices =
+          batch[1].Get<std::vector<std::array<float, 16>>>();
+      ASSERT_EQ(matrices.size(), rects.size());
+
+      auto batch_view = batch_tensor.GetCpuReadView();
+      for (int i = 0; i < rects.size(); ++i) {
+        std::vector<Packet> single =
+            RunRegionsGraph(input, "NORM_RECT", MakePacket<mediapipe::NormalizedRect>(rects[i]),
+                            "MATRIX", options);
+        ASSERT_EQ(single.size(), 2);
+        const Tensor& tensor = single[0].Get<std::vector<Tensor>>()[0];
+        auto view = tensor.GetCpuReadView();
+        const int size = tensor.shape().num_elements();
+        const float* batch_values = batch_view.buffer<float>() + i * size;
+        EXPECT_TRUE(std::equal(batch_values, batch_values + size,
+                               view.buffer<float>()))
+            << "region " << i;
+        const auto& matrix = single[1].Get<std::array<float, 16>>();
+        EXPECT_EQ(matrices[i], matrix);
+      }
+    }
+  }
+}
+
+TEST(ImageToTensorCalculatorTest, EmptyNormRectsOutputNothing) {
+  std::vector<Packet> outputs = RunRegionsGraph(
+      GetRgb("/mediapipe/calculators/tensor/testdata/image_to_tensor/input.jpg"),
+      "NORM_RECTS", MakePacket<std::vector<mediapipe::NormalizedRect>>(),
+      "MATRICES", "");
+  EXPECT_THAT(outputs, testing::IsEmpty());
+}
+
+TEST(ImageToTensorCalculatorTest, NormRectsRejectSingleRegionOutputs) {
+  auto graph_config = mediapipe::ParseTextProtoOrDie<CalculatorGraphConfig>(R"(
+    input_stream: "input_image"
+    input_stream: "rois"
+    node {
+      calculator: "ImageToTensorCalculator"
+      input_stream: "IMAGE:input_image"
+      input_stream: "NORM_RECTS:rois"
+      output_stream: "TENSORS:tensor"
+      output_stream: "MATRIX:matrix"
+      options {
+        [mediapipe.ImageToTensorCalculatorOptions.ext] {
+          output_tensor_width: 64
+          output_tensor_height: 48
+          output_tensor_float_range { min: 0 max: 1 }
+        }
+      }
+    }
+  )");
+  CalculatorGraph graph;
+  EXPECT_FALSE(graph.Initialize(graph_config).ok());
+}
+
 }  // namespace
 }  // namespace mediapipe
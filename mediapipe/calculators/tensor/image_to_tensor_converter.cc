@@ -0,0 +1,66 @@
+// Copyright 2022 The MediaPipe Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "mediapipe/calculators/tensor/image_to_tensor_converter.h"
+
+#include <cstring>
+
+#include "absl/synchronization/blocking_counter.h"
+#include "absl/types/optional.h"
+#include "mediapipe/framework/port/ret_check.h"
+
+namespace mediapipe {
+
+absl::StatusOr<Tensor> ImageToTensorConverter::ConvertBatch(
+    const mediapipe::Image& input, const std::vector<RotatedRect>& rois,
+    const Size& output_dims, float range_min, float range_max,
+    ThreadPool* thread_pool) {
+  RET_CHECK(!rois.empty()) << "At least one region is required.";
+  absl::optional<Tensor> batch;
+  for (int i = 0; i < rois.size(); ++i) {
+    ASSIGN_OR_RETURN(Tensor tensor, Convert(input, rois[i], output_dims,
+                                            range_min, range_max));
+    if (!batch) {
+      Tensor::Shape shape = tensor.shape();
+      RET_CHECK(!shape.dims.empty() && shape.dims[0] == 1);
+      shape.dims[0] = rois.size();
+      batch.emplace(tensor.element_type(), shape);
+    }
+    auto source = tensor.GetCpuReadView();
+    auto batch_view = batch->GetCpuWriteView();
+    std::memcpy(batch_view.buffer<uint8>() + i * tensor.bytes(),
+                source.buffer<uint8>(), tensor.bytes());
+  }
+  return std::move(*batch);
+}
+
+void ParallelForEachRoi(int size, ThreadPool* thread_pool,
+                        const std::function<void(int)>& fn) {
+  if (thread_pool == nullptr || size <= 1) {
+    for (int i = 0; i < size; ++i) {
+      fn(i);
+    }
+    return;
+  }
+  absl::BlockingCounter counter(size);
+  for (int i = 0; i < size; ++i) {
+    thread_pool->Schedule([&fn, &counter, i] {
+      fn(i);
+      counter.DecrementCount();
+    });
+  }
+  counter.Wait();
+}
+
+}  // namespace mediapipe
@@ -15,10 +15,14 @@
 #ifndef MEDIAPIPE_CALCULATORS_TENSOR_IMAGE_TO_TENSOR_CONVERTER_H_
 #define MEDIAPIPE_CALCULATORS_TENSOR_IMAGE_TO_TENSOR_CONVERTER_H_
 
+#include <functional>
+#include <vector>
+
 #include "mediapipe/calculators/tensor/image_to_tensor_utils.h"
 #include "mediapipe/framework/formats/image.h"
 #include "mediapipe/framework/formats/tensor.h"
 #include "mediapipe/framework/port/statusor.h"
+#include "mediapipe/framework/port/threadpool.h"
 
 namespace mediapipe {
 
@@ -49,8 +53,28 @@ class ImageToTensorConverter {
                                          const RotatedRect& roi,
                                          const Size& output_dims,
                                          float range_min, float range_max) = 0;
+
+  // Converts several regions of the same image to one batched tensor.
+  // @rois describes the (non-empty list of) regions to extract. Region i is
+  // written to entry i of the output tensor, which has the shape
+  // [rois.size(), output_dims.height, output_dims.width, channels].
+  // @thread_pool, if not null, may be used to convert the regions in
+  // parallel.
+  //
+  // The default implementation calls Convert() for each region in turn and
+  // copies the results into the batch through CPU views.
+  virtual absl::StatusOr<Tensor> ConvertBatch(
+      const mediapipe::Image& input, const std::vector<RotatedRect>& rois,
+      const Size& output_dims, float range_min, float range_max,
+      ThreadPool* thread_pool);
 };
 
+// Calls @fn for each index in [0, @size) and returns once all calls are done.
+// The calls are spread over @thread_pool if it is not null, and made on the
+// calling thread otherwise.
+void ParallelForEachRoi(int size, ThreadPool* thread_pool,
+                        const std::function<void(int)>& fn);
+
 }  // namespace mediapipe
 
 #endif  // MEDIAPIPE_CALCULATORS_TENSOR_IMAGE_TO_TENSOR_CONVERTER_H_
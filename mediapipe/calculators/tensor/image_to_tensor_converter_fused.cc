@@ -0,0 +1,499 @@
+// Copyright 2022 The MediaPipe Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "mediapipe/calculators/tensor/image_to_tensor_converter_fused.h"
+
+#include <algorithm>
+#include <cmath>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include "absl/memory/memory.h"
+#include "absl/strings/str_cat.h"
+#include "mediapipe/calculators/tensor/image_to_tensor_converter.h"
+#include "mediapipe/calculators/tensor/image_to_tensor_utils.h"
+#include "mediapipe/framework/calculator_framework.h"
+#include "mediapipe/framework/formats/image.h"
+#include "mediapipe/framework/formats/image_format.pb.h"
+#include "mediapipe/framework/formats/tensor.h"
+#include "mediapipe/framework/formats/tensor_buffer_pool.h"
+#include "mediapipe/framework/port/canonical_errors.h"
+#include "mediapipe/framework/port/integral_types.h"
+#include "mediapipe/framework/port/ret_check.h"
+#include "mediapipe/framework/port/statusor.h"
+#include "mediapipe/framework/port/threadpool.h"
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__aarch64__)
+#include <arm_neon.h>
+#endif
+
+namespace mediapipe {
+
+namespace {
+
+constexpr int kNumChannels = 3;
+
+// The source pixels of an SRGB or SRGBA image.
+struct SourceImage {
+  const uint8* data;
+  int width;
+  int height;
+  int step;
+  int channels;
+};
+
+// Maps the output pixel (x, y) to the source position
+// (origin_x + x * dx_x + y * dy_x, origin_y + x * dx_y + y * dy_y).
+struct AffineMap {
+  float origin_x;
+  float origin_y;
+  float dx_x;
+  float dx_y;
+  float dy_x;
+  float dy_y;
+};
+
+// Maps the output tensor corners to the corners of "roi", the same way as the
+// perspective transform of the OpenCV converter: the top left corner of the
+// tensor to the top left corner of the unrotated rect, and so on.
+AffineMap GetAffineMap(const RotatedRect& roi, const Size& output_dims) {
+  const float cos_r = std::cos(roi.rotation);
+  const float sin_r = std::sin(roi.rotation);
+  AffineMap map;
+  map.dx_x = cos_r * roi.width / output_dims.width;
+  map.dx_y = sin_r * roi.width / output_dims.width;
+  map.dy_x = -sin_r * roi.height / output_dims.height;
+  map.dy_y = cos_r * roi.height / output_dims.height;
+  map.origin_x =
+      roi.center_x - 0.5f * cos_r * roi.width + 0.5f * sin_r * roi.height;
+  map.origin_y =
+      roi.center_y - 0.5f * sin_r * roi.width - 0.5f * cos_r * roi.height;
+  return map;
+}
+
+inline float Lerp(float a, float b, float t) { return a + t * (b - a); }
+
+// Unlike std::floor, compiles to a few instructions without SSE4.1.
+inline int Floor(float value) {
+  const int truncated = static_cast<int>(value);
+  return truncated > value ? truncated - 1 : truncated;
+}
+
+// Returns the source pixel at (x, y), or nullptr if it lies outside the image
+// and the border is zero.
+inline const uint8* Tap(const SourceImage& src, BorderMode border_mode, int x,
+                        int y) {
+  if (x < 0 || x >= src.width || y < 0 || y >= src.height) {
+    if (border_mode == BorderMode::kZero) return nullptr;
+    x = std::min(std::max(x, 0), src.width - 1);
+    y = std::min(std::max(y, 0), src.height - 1);
+  }
+  return src.data + y * src.step + x * src.channels;
+}
+
+inline float TapValue(const uint8* tap, int channel) {
+  return tap ? tap[channel] : 0.0f;
+}
+
+inline void StoreValue(float value, float* out) { *out = value; }
+
+// Saturates and rounds half to even, like the vector conversions below.
+// Adding 2^23 leaves no bits for the fraction, so the sum is rounded in the
+// current (default: to nearest even) rounding mode, without a call to libm.
+inline void StoreValue(float value, uint8* out) {
+  constexpr float kRound = 8388608.0f;
+  const float clamped = std::min(std::max(value, 0.0f), 255.0f);
+  *out = static_cast<uint8>((clamped + kRound) - kRound);
+}
+
+// Samples the source at (x, y) with bilinear interpolation and writes the
+// transformed RGB values to "out".
+template <typename T>
+inline void ConvertPixel(const SourceImage& src, BorderMode border_mode,
+                         const ValueTransformation& transform, float x, float y,
+                         T* out) {
+  // All positions beyond one pixel outside the image sample only the border,
+  // so clamping them keeps the conversion to int in range.
+  x = x > -1.0f ? std::min(x, static_cast<float>(src.width)) : -1.0f;
+  y = y > -1.0f ? std::min(y, static_cast<float>(src.height)) : -1.0f;
+  const int x0 = Floor(x);
+  const int y0 = Floor(y);
+  const float wx = x - x0;
+  const float wy = y - y0;
+  const uint8* top_left;
+  const uint8* top_right;
+  const uint8* bottom_left;
+  const uint8* bottom_right;
+  if (x0 >= 0 && y0 >= 0 && x0 < src.width - 1 && y0 < src.height - 1) {
+    top_left = src.data + y0 * src.step + x0 * src.channels;
+    top_right = top_left + src.channels;
+    bottom_left = top_left + src.step;
+    bottom_right = bottom_left + src.channels;
+  } else {
+    top_left = Tap(src, border_mode, x0, y0);
+    top_right = Tap(src, border_mode, x0 + 1, y0);
+    bottom_left = Tap(src, border_mode, x0, y0 + 1);
+    bottom_right = Tap(src, border_mode, x0 + 1, y0 + 1);
+  }
+  for (int c = 0; c < kNumChannels; ++c) {
+    const float top =
+        Lerp(TapValue(top_left, c), TapValue(top_right, c), wx);
+    const float bottom =
+        Lerp(TapValue(bottom_left, c), TapValue(bottom_right, c), wx);
+    StoreValue(Lerp(top, bottom, wy) * transform.scale + transform.offset,
+               out + c);
+  }
+}
+
+// ConvertInteriorBlock() converts kBlockSize consecutive pixels of a row,
+// starting at output column x of a row that starts at source position
+// (row_x, row_y), and writes them to "out". It returns false, without writing
+// anything, unless all of the pixels can be sampled without the border.
+
+#if defined(__AVX2__)
+
+constexpr int kBlockSize = 8;
+
+template <int kChannel>
+inline __m256 ChannelValues(__m256i pixels) {
+  return _mm256_cvtepi32_ps(_mm256_and_si256(
+      _mm256_srli_epi32(pixels, 8 * kChannel), _mm256_set1_epi32(0xff)));
+}
+
+inline __m256 Lerp(__m256 a, __m256 b, __m256 t) {
+  return _mm256_add_ps(a, _mm256_mul_ps(t, _mm256_sub_ps(b, a)));
+}
+
+// Interleaves the per-channel values of 8 pixels into RGB order.
+inline void Interleave(__m256 r, __m256 g, __m256 b, __m256 rgb[3]) {
+  const __m256i index0 = _mm256_setr_epi32(0, 0, 0, 1, 1, 1, 2, 2);
+  const __m256i index1 = _mm256_setr_epi32(2, 3, 3, 3, 4, 4, 4, 5);
+  const __m256i index2 = _mm256_setr_epi32(5, 5, 6, 6, 6, 7, 7, 7);
+  // r0 g0 b0 r1 g1 b1 r2 g2
+  rgb[0] = _mm256_blend_ps(
+      _mm256_blend_ps(_mm256_permutevar8x32_ps(r, index0),
+                      _mm256_permutevar8x32_ps(g, index0), 0x92),
+      _mm256_permutevar8x32_ps(b, index0), 0x24);
+  // b2 r3 g3 b3 r4 g4 b4 r5
+  rgb[1] = _mm256_blend_ps(
+      _mm256_blend_ps(_mm256_permutevar8x32_ps(r, index1),
+                      _mm256_permutevar8x32_ps(g, index1), 0x24),
+      _mm256_permutevar8x32_ps(b, index1), 0x49);
+  // g5 b5 r6 g6 b6 r7 g7 b7
+  rgb[2] = _mm256_blend_ps(
+      _mm256_blend_ps(_mm256_permutevar8x32_ps(r, index2),
+                      _mm256_permutevar8x32_ps(g, index2), 0x49),
+      _mm256_permutevar8x32_ps(b, index2), 0x92);
+}
+
+inline void StoreBlock(const __m256 rgb[3], float* out) {
+  _mm256_storeu_ps(out, rgb[0]);
+  _mm256_storeu_ps(out + 8, rgb[1]);
+  _mm256_storeu_ps(out + 16, rgb[2]);
+}
+
+inline void StoreBlock(const __m256 rgb[3], uint8* out) {
+  // _mm256_cvtps_epi32 rounds half to even. The packs saturate to [0, 255]
+  // and interleave 128-bit lanes, which the permutes undo.
+  const __m256i rgb01 = _mm256_permute4x64_epi64(
+      _mm256_packs_epi32(_mm256_cvtps_epi32(rgb[0]), _mm256_cvtps_epi32(rgb[1])),
+      0xD8);
+  const __m256i rgb2 = _mm256_cvtps_epi32(rgb[2]);
+  const __m256i rgb22 =
+      _mm256_permute4x64_epi64(_mm256_packs_epi32(rgb2, rgb2), 0xD8);
+  const __m256i bytes =
+      _mm256_permute4x64_epi64(_mm256_packus_epi16(rgb01, rgb22), 0xD8);
+  _mm_storeu_si128(reinterpret_cast<__m128i*>(out),
+                   _mm256_castsi256_si128(bytes));
+  _mm_storel_epi64(reinterpret_cast<__m128i*>(out + 16),
+                   _mm256_extracti128_si256(bytes, 1));
+}
+
+template <typename T>
+inline bool ConvertInteriorBlock(const SourceImage& src, const AffineMap& map,
+                                 const ValueTransformation& transform,
+                                 float row_x, float row_y, int x, T* out) {
+  const __m256 xs = _mm256_add_ps(_mm256_set1_ps(x),
+                                  _mm256_setr_ps(0, 1, 2, 3, 4, 5, 6, 7));
+  const __m256 sx = _mm256_add_ps(_mm256_set1_ps(row_x),
+                                  _mm256_mul_ps(xs, _mm256_set1_ps(map.dx_x)));
+  const __m256 sy = _mm256_add_ps(_mm256_set1_ps(row_y),
+                                  _mm256_mul_ps(xs, _mm256_set1_ps(map.dx_y)));
+  const __m256 floor_x = _mm256_floor_ps(sx);
+  const __m256 floor_y = _mm256_floor_ps(sy);
+  // The comparisons are false for NaN, too.
+  const __m256 inside = _mm256_and_ps(
+      _mm256_and_ps(_mm256_cmp_ps(floor_x, _mm256_setzero_ps(), _CMP_GE_OQ),
+                    _mm256_cmp_ps(floor_x, _mm256_set1_ps(src.width - 2),
+                                  _CMP_LE_OQ)),
+      _mm256_and_ps(_mm256_cmp_ps(floor_y, _mm256_setzero_ps(), _CMP_GE_OQ),
+                    _mm256_cmp_ps(floor_y, _mm256_set1_ps(src.height - 2),
+                                  _CMP_LE_OQ)));
+  if (_mm256_movemask_ps(inside) != 0xff) return false;
+
+  const __m256i offsets = _mm256_add_epi32(
+      _mm256_mullo_epi32(_mm256_cvttps_epi32(floor_y),
+                         _mm256_set1_epi32(src.step)),
+      _mm256_mullo_epi32(_mm256_cvttps_epi32(floor_x),
+                         _mm256_set1_epi32(src.channels)));
+  // Each tap is gathered as 4 bytes. For SRGB, that reads one byte past the
+  // bottom right pixel, which may lie past the end of the image.
+  const int max_offset = (src.height - 1) * src.step +
+                         src.width * src.channels - src.step - src.channels -
+                         4;
+  if (_mm256_movemask_epi8(
+          _mm256_cmpgt_epi32(offsets, _mm256_set1_epi32(max_offset)))) {
+    return false;
+  }
+
+  const int* data = reinterpret_cast<const int*>(src.data);
+  const __m256i top_left = _mm256_i32gather_epi32(data, offsets, 1);
+  const __m256i top_right = _mm256_i32gather_epi32(
+      reinterpret_cast<const int*>(src.data + src.channels), offsets, 1);
+  const __m256i bottom_left = _mm256_i32gather_epi32(
+      reinterpret_cast<const int*>(src.data + src.step), offsets, 1);
+  const __m256i bottom_right = _mm256_i32gather_epi32(
+      reinterpret_cast<const int*>(src.data + src.step + src.channels),
+      offsets, 1);
+  const __m256 wx = _mm256_sub_ps(sx, floor_x);
+  const __m256 wy = _mm256_sub_ps(sy, floor_y);
+  const __m256 scale = _mm256_set1_ps(transform.scale);
+  const __m256 offset = _mm256_set1_ps(transform.offset);
+  auto interpolate = [&](__m256 tl, __m256 tr, __m256 bl, __m256 br) {
+    const __m256 value = Lerp(Lerp(tl, tr, wx), Lerp(bl, br, wx), wy);
+    return _mm256_add_ps(_mm256_mul_ps(value, scale), offset);
+  };
+  const __m256 r = interpolate(
+      ChannelValues<0>(top_left), ChannelValues<0>(top_right),
+      ChannelValues<0>(bottom_left), ChannelValues<0>(bottom_right));
+  const __m256 g = interpolate(
+      ChannelValues<1>(top_left), ChannelValues<1>(top_right),
+      ChannelValues<1>(bottom_left), ChannelValues<1>(bottom_right));
+  const __m256 b = interpolate(
+      ChannelValues<2>(top_left), ChannelValues<2>(top_right),
+      ChannelValues<2>(bottom_left), ChannelValues<2>(bottom_right));
+  __m256 rgb[3];
+  Interleave(r, g, b, rgb);
+  StoreBlock(rgb, out);
+  return true;
+}
+
+#elif defined(__aarch64__)
+
+constexpr int kBlockSize = 8;
+
+inline float32x4_t Lerp(float32x4_t a, float32x4_t b, float32x4_t t) {
+  return vmlaq_f32(a, t, vsubq_f32(b, a));
+}
+
+// values[c][h] holds channel c of pixels 4 * h to 4 * h + 3.
+inline void StoreBlock(const float32x4_t values[3][2], float* out) {
+  for (int h = 0; h < 2; ++h) {
+    float32x4x3_t rgb;
+    rgb.val[0] = values[0][h];
+    rgb.val[1] = values[1][h];
+    rgb.val[2] = values[2][h];
+    vst3q_f32(out + 12 * h, rgb);
+  }
+}
+
+inline void StoreBlock(const float32x4_t values[3][2], uint8* out) {
+  // vcvtnq_s32_f32 rounds half to even; the narrowing moves saturate.
+  uint8x8x3_t rgb;
+  for (int c = 0; c < kNumChannels; ++c) {
+    rgb.val[c] = vqmovn_u16(
+        vcombine_u16(vqmovun_s32(vcvtnq_s32_f32(values[c][0])),
+                     vqmovun_s32(vcvtnq_s32_f32(values[c][1]))));
+  }
+  vst3_u8(out, rgb);
+}
+
+template <typename T>
+inline bool ConvertInteriorBlock(const SourceImage& src, const AffineMap& map,
+                                 const ValueTransformation& transform,
+                                 float row_x, float row_y, int x, T* out) {
+  const float32x4_t lanes = {0.0f, 1.0f, 2.0f, 3.0f};
+  int32 offsets[kBlockSize];
+  float32x4_t wx[2];
+  float32x4_t wy[2];
+  for (int h = 0; h < 2; ++h) {
+    const float32x4_t xs = vaddq_f32(vdupq_n_f32(x + 4 * h), lanes);
+    const float32x4_t sx =
+        vmlaq_f32(vdupq_n_f32(row_x), xs, vdupq_n_f32(map.dx_x));
+    const float32x4_t sy =
+        vmlaq_f32(vdupq_n_f32(row_y), xs, vdupq_n_f32(map.dx_y));
+    const float32x4_t floor_x = vrndmq_f32(sx);
+    const float32x4_t floor_y = vrndmq_f32(sy);
+    // The comparisons are false for NaN, too.
+    const uint32x4_t inside = vandq_u32(
+        vandq_u32(vcgeq_f32(floor_x, vdupq_n_f32(0.0f)),
+                  vcleq_f32(floor_x, vdupq_n_f32(src.width - 2))),
+        vandq_u32(vcgeq_f32(floor_y, vdupq_n_f32(0.0f)),
+                  vcleq_f32(floor_y, vdupq_n_f32(src.height - 2))));
+    if (vminvq_u32(inside) == 0) return false;
+    vst1q_s32(offsets + 4 * h,
+              vmlaq_n_s32(vmulq_n_s32(vcvtq_s32_f32(floor_x), src.channels),
+                          vcvtq_s32_f32(floor_y), src.step));
+    wx[h] = vsubq_f32(sx, floor_x);
+    wy[h] = vsubq_f32(sy, floor_y);
+  }
+
+  // NEON has no gather, so the taps are loaded one byte at a time.
+  const float32x4_t scale = vdupq_n_f32(transform.scale);
+  const float32x4_t offset = vdupq_n_f32(transform.offset);
+  float32x4_t values[kNumChannels][2];
+  for (int c = 0; c < kNumChannels; ++c) {
+    for (int h = 0; h < 2; ++h) {
+      float taps[4][4];
+      for (int i = 0; i < 4; ++i) {
+        const uint8* top = src.data + offsets[4 * h + i] + c;
+        taps[0][i] = top[0];
+        taps[1][i] = top[src.channels];
+        taps[2][i] = top[src.step];
+        taps[3][i] = top[src.step + src.channels];
+      }
+      const float32x4_t value =
+          Lerp(Lerp(vld1q_f32(taps[0]), vld1q_f32(taps[1]), wx[h]),
+               Lerp(vld1q_f32(taps[2]), vld1q_f32(taps[3]), wx[h]), wy[h]);
+      values[c][h] = vmlaq_f32(offset, value, scale);
+    }
+  }
+  StoreBlock(values, out);
+  return true;
+}
+
+#else
+
+constexpr int kBlockSize = 0;
+
+template <typename T>
+inline bool ConvertInteriorBlock(const SourceImage& src, const AffineMap& map,
+                                 const ValueTransformation& transform,
+                                 float row_x, float row_y, int x, T* out) {
+  return false;
+}
+
+#endif  // defined(__AVX2__)
+
+template <typename T>
+void ConvertImage(const SourceImage& src, const AffineMap& map,
+                  BorderMode border_mode, const ValueTransformation& transform,
+                  const Size& output_dims, T* out) {
+  for (int y = 0; y < output_dims.height; ++y) {
+    const float row_x = map.origin_x + y * map.dy_x;
+    const float row_y = map.origin_y + y * map.dy_y;
+    T* row = out + y * output_dims.width * kNumChannels;
+    int x = 0;
+    if (kBlockSize > 0) {
+      for (; x + kBlockSize <= output_dims.width; x += kBlockSize) {
+        if (ConvertInteriorBlock(src, map, transform, row_x, row_y, x,
+                                 row + x * kNumChannels)) {
+          continue;
+        }
+        for (int i = x; i < x + kBlockSize; ++i) {
+          ConvertPixel(src, border_mode, transform, row_x + i * map.dx_x,
+                       row_y + i * map.dx_y, row + i * kNumChannels);
+        }
+      }
+    }
+    for (; x < output_dims.width; ++x) {
+      ConvertPixel(src, border_mode, transform, row_x + x * map.dx_x,
+                   row_y + x * map.dx_y, row + x * kNumChannels);
+    }
+  }
+}
+
+class FusedProcessor : public ImageToTensorConverter {
+ public:
+  FusedProcessor(BorderMode border_mode, Tensor::ElementType tensor_type,
+                 std::shared_ptr<SharedBufferPool> buffer_pool)
+      : border_mode_(border_mode),
+        tensor_type_(tensor_type),
+        buffer_pool_(std::move(buffer_pool)) {}
+
+  absl::StatusOr<Tensor> Convert(const mediapipe::Image& input,
+                                 const RotatedRect& roi,
+                                 const Size& output_dims, float range_min,
+                                 float range_max) override {
+    return ConvertBatch(input, {roi}, output_dims, range_min, range_max,
+                        /*thread_pool=*/nullptr);
+  }
+
+  absl::StatusOr<Tensor> ConvertBatch(const mediapipe::Image& input,
+                                      const std::vector<RotatedRect>& rois,
+                                      const Size& output_dims, float range_min,
+                                      float range_max,
+                                      ThreadPool* thread_pool) override {
+    if (input.image_format() != mediapipe::ImageFormat::SRGB &&
+        input.image_format() != mediapipe::ImageFormat::SRGBA) {
+      return InvalidArgumentError(
+          absl::StrCat("Only RGBA/RGB formats are supported, passed format: ",
+                       static_cast<uint32_t>(input.image_format())));
+    }
+    RET_CHECK(!rois.empty()) << "At least one region is required.";
+    constexpr float kInputImageRangeMin = 0.0f;
+    constexpr float kInputImageRangeMax = 255.0f;
+    ASSIGN_OR_RETURN(
+        auto transform,
+        GetValueRangeTransformation(kInputImageRangeMin, kInputImageRangeMax,
+                                    range_min, range_max));
+
+    const int num_rois = rois.size();
+    Tensor tensor(tensor_type_,
+                  Tensor::Shape{num_rois, output_dims.height,
+                                output_dims.width, kNumChannels},
+                  buffer_pool_);
+    auto buffer_view = tensor.GetCpuWriteView();
+    mediapipe::PixelReadLock lock(input);
+    const SourceImage src = {lock.Pixels(), input.width(), input.height(),
+                             input.step(), input.channels()};
+    const int roi_size = output_dims.height * output_dims.width * kNumChannels;
+    ParallelForEachRoi(num_rois, thread_pool, [&](int i) {
+      const AffineMap map = GetAffineMap(rois[i], output_dims);
+      if (tensor_type_ == Tensor::ElementType::kUInt8) {
+        ConvertImage(src, map, border_mode_, transform, output_dims,
+                     buffer_view.buffer<uint8>() + i * roi_size);
+      } else {
+        ConvertImage(src, map, border_mode_, transform, output_dims,
+                     buffer_view.buffer<float>() + i * roi_size);
+      }
+    });
+    return tensor;
+  }
+
+ private:
+  BorderMode border_mode_;
+  Tensor::ElementType tensor_type_;
+  // The pool of the output tensor buffers, or null.
+  std::shared_ptr<SharedBufferPool> buffer_pool_;
+};
+
+}  // namespace
+
+absl::StatusOr<std::unique_ptr<ImageToTensorConverter>> CreateFusedConverter(
+    CalculatorContext* cc, BorderMode border_mode,
+    Tensor::ElementType tensor_type) {
+  std::shared_ptr<SharedBufferPool> buffer_pool;
+  if (cc->Service(kTensorBufferPoolService).IsAvailable()) {
+    buffer_pool =
+        cc->Service(kTensorBufferPoolService).GetObject().buffer_pool();
+  }
+  return absl::make_unique<FusedProcessor>(border_mode, tensor_type,
+                                           std::move(buffer_pool));
+}
+
+}  // namespace mediapipe
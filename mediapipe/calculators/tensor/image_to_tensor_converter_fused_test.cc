@@ -0,0 +1,186 @@
+// Copyright 2022 The MediaPipe Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Compares the fused CPU converter with the OpenCV converter and measures
+// both. To run the benchmarks with the AVX2 kernels:
+// $ bazel run -c opt --copt=-mavx2 \
+//   mediapipe/calculators/tensor:image_to_tensor_converter_fused_test -- \
+//   --benchmark_filter=all
+
+#include "mediapipe/calculators/tensor/image_to_tensor_converter_fused.h"
+
+#include <algorithm>
+#include <cmath>
+#include <memory>
+#include <vector>
+
+#include "absl/strings/str_cat.h"
+#include "mediapipe/calculators/tensor/image_to_tensor_converter.h"
+#include "mediapipe/calculators/tensor/image_to_tensor_converter_opencv.h"
+#include "mediapipe/calculators/tensor/image_to_tensor_utils.h"
+#include "mediapipe/framework/formats/image.h"
+#include "mediapipe/framework/formats/image_format.pb.h"
+#include "mediapipe/framework/formats/image_frame.h"
+#include "mediapipe/framework/formats/tensor.h"
+#include "mediapipe/framework/port/benchmark.h"
+#include "mediapipe/framework/port/gtest.h"
+#include "mediapipe/framework/port/integral_types.h"
+#include "mediapipe/framework/port/status_matchers.h"
+
+namespace mediapipe {
+namespace {
+
+// Returns an image with smooth gradients, so that the small differences
+// between the interpolation of the converters stay small in the output.
+Image MakeTestImage(ImageFormat::Format format, int width, int height) {
+  auto frame = std::make_shared<ImageFrame>(format, width, height);
+  const int channels = frame->NumberOfChannels();
+  for (int y = 0; y < height; ++y) {
+    uint8* row = frame->MutablePixelData() + y * frame->WidthStep();
+    for (int x = 0; x < width; ++x) {
+      row[x * channels] = 127.5f + 127.5f * std::sin(x * 0.05f);
+      row[x * channels + 1] = 127.5f + 127.5f * std::cos(y * 0.07f);
+      row[x * channels + 2] = 255 * (x + y) / (width + height);
+      if (channels == 4) row[x * channels + 3] = 255;
+    }
+  }
+  return Image(std::move(frame));
+}
+
+// Returns the tensor values mapped back to [0, 255].
+std::vector<float> GetValues(const Tensor& tensor, float range_min,
+                             float range_max) {
+  auto view = tensor.GetCpuReadView();
+  const float scale = 255.0f / (range_max - range_min);
+  std::vector<float> values(tensor.shape().num_elements());
+  for (int i = 0; i < values.size(); ++i) {
+    values[i] = tensor.element_type() == Tensor::ElementType::kUInt8
+                    ? view.buffer<uint8>()[i]
+                    : (view.buffer<float>()[i] - range_min) * scale;
+  }
+  return values;
+}
+
+struct TestCase {
+  RotatedRect roi;
+  Size output_dims;
+};
+
+TEST(ImageToTensorConverterFusedTest, MatchesOpenCvConverter) {
+  const std::vector<TestCase> test_cases = {
+      // Crop and downscale.
+      {{/*center_x=*/200, /*center_y=*/150, /*width=*/256, /*height=*/192,
+        /*rotation=*/0},
+       {128, 96}},
+      // Letterbox: the ROI extends past the top and bottom of the image.
+      {{160, 120, 320, 400, 0}, {192, 240}},
+      // Rotation and upscale.
+      {{100, 80, 60, 90, static_cast<float>(M_PI / 6)}, {96, 144}},
+      // Rotation by 90 degrees, partly outside of the image.
+      {{300, 40, 120, 120, static_cast<float>(M_PI / 2)}, {67, 67}},
+      // Entirely outside of the image.
+      {{-200, -200, 50, 50, 1.0f}, {16, 16}},
+  };
+  for (const ImageFormat::Format format :
+       {ImageFormat::SRGB, ImageFormat::SRGBA}) {
+    const Image image = MakeTestImage(format, 320, 240);
+    for (const BorderMode border_mode :
+         {BorderMode::kZero, BorderMode::kReplicate}) {
+      for (const Tensor::ElementType tensor_type :
+           {Tensor::ElementType::kFloat32, Tensor::ElementType::kUInt8}) {
+        const float range_min =
+            tensor_type == Tensor::ElementType::kUInt8 ? 0.0f : -1.0f;
+        const float range_max =
+            tensor_type == Tensor::ElementType::kUInt8 ? 255.0f : 1.0f;
+        auto fused = CreateFusedConverter(nullptr, border_mode, tensor_type);
+        MP_ASSERT_OK(fused);
+        auto opencv = CreateOpenCvConverter(nullptr, border_mode, tensor_type);
+        MP_ASSERT_OK(opencv);
+        for (int i = 0; i < test_cases.size(); ++i) {
+          SCOPED_TRACE(absl::StrCat("format: ", format, " border_mode: ",
+                                    static_cast<int>(border_mode),
+                                    " tensor_type: ",
+                                    static_cast<int>(tensor_type),
+                                    " test case: ", i));
+          const TestCase& test_case = test_cases[i];
+          auto fused_tensor =
+              (*fused)->Convert(image, test_case.roi, test_case.output_dims,
+                                range_min, range_max);
+          MP_ASSERT_OK(fused_tensor);
+          auto opencv_tensor =
+              (*opencv)->Convert(image, test_case.roi, test_case.output_dims,
+                                 range_min, range_max);
+          MP_ASSERT_OK(opencv_tensor);
+          EXPECT_EQ(fused_tensor->element_type(), tensor_type);
+          EXPECT_EQ(fused_tensor->shape().dims, opencv_tensor->shape().dims);
+          const std::vector<float> fused_values =
+              GetValues(*fused_tensor, range_min, range_max);
+          const std::vector<float> opencv_values =
+              GetValues(*opencv_tensor, range_min, range_max);
+          ASSERT_EQ(fused_values.size(), opencv_values.size());
+          float max_difference = 0.0f;
+          for (int j = 0; j < fused_values.size(); ++j) {
+            max_difference = std::max(
+                max_difference, std::abs(fused_values[j] - opencv_values[j]));
+          }
+          // OpenCV quantizes the interpolation weights to 1/32.
+          EXPECT_LE(max_difference, 2.0f);
+        }
+      }
+    }
+  }
+}
+
+TEST(ImageToTensorConverterFusedTest, RejectsUnsupportedFormat) {
+  const Image image(std::make_shared<ImageFrame>(ImageFormat::GRAY8, 8, 8));
+  auto converter = CreateFusedConverter(nullptr, BorderMode::kReplicate,
+                                        Tensor::ElementType::kFloat32);
+  MP_ASSERT_OK(converter);
+  EXPECT_EQ((*converter)
+                ->Convert(image, {4, 4, 8, 8, 0}, {4, 4}, /*range_min=*/0.0f,
+                          /*range_max=*/1.0f)
+                .status()
+                .code(),
+            absl::StatusCode::kInvalidArgument);
+}
+
+// Converts a rotated crop of a 640x480 image into a 256x256 tensor.
+// state.range(0) selects the fused (1) or the OpenCV (0) converter and
+// state.range(1) selects uint8 (1) or float (0) output.
+void BM_ConvertCpuImage(benchmark::State& state) {
+  const BorderMode border_mode = BorderMode::kZero;
+  const Tensor::ElementType tensor_type = state.range(1)
+                                              ? Tensor::ElementType::kUInt8
+                                              : Tensor::ElementType::kFloat32;
+  auto converter =
+      (state.range(0) ? CreateFusedConverter(nullptr, border_mode, tensor_type)
+                      : CreateOpenCvConverter(nullptr, border_mode,
+                                              tensor_type))
+          .value();
+  const float range_max =
+      tensor_type == Tensor::ElementType::kUInt8 ? 255.0f : 1.0f;
+  const Image image = MakeTestImage(ImageFormat::SRGB, 640, 480);
+  const RotatedRect roi = {320, 240, 400, 400, 0.3f};
+  const Size output_dims = {256, 256};
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(
+        converter->Convert(image, roi, output_dims, 0.0f, range_max).value());
+  }
+  state.SetItemsProcessed(state.iterations() * output_dims.width *
+                          output_dims.height);
+}
+BENCHMARK(BM_ConvertCpuImage)->ArgsProduct({{0, 1}, {0, 1}});
+
+}  // namespace
+}  // namespace mediapipe
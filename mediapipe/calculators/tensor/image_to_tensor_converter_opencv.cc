@@ -16,6 +16,8 @@
 
 #include <cmath>
 #include <memory>
+#include <utility>
+#include <vector>
 
 #include "mediapipe/calculators/tensor/image_to_tensor_converter.h"
 #include "mediapipe/calculators/tensor/image_to_tensor_utils.h"
@@ -24,10 +26,13 @@
 #include "mediapipe/framework/formats/image_format.pb.h"
 #include "mediapipe/framework/formats/image_opencv.h"
 #include "mediapipe/framework/formats/tensor.h"
+#include "mediapipe/framework/formats/tensor_buffer_pool.h"
 #include "mediapipe/framework/port/canonical_errors.h"
 #include "mediapipe/framework/port/opencv_core_inc.h"
 #include "mediapipe/framework/port/opencv_imgproc_inc.h"
+#include "mediapipe/framework/port/ret_check.h"
 #include "mediapipe/framework/port/statusor.h"
+#include "mediapipe/framework/port/threadpool.h"
 
 namespace mediapipe {
 
@@ -35,8 +40,9 @@ namespace {
 
 class OpenCvProcessor : public ImageToTensorConverter {
  public:
-  OpenCvProcessor(BorderMode border_mode, Tensor::ElementType tensor_type)
-      : tensor_type_(tensor_type) {
+  OpenCvProcessor(BorderMode border_mode, Tensor::ElementType tensor_type,
+                  std::shared_ptr<SharedBufferPool> buffer_pool)
+      : tensor_type_(tensor_type), buffer_pool_(std::move(buffer_pool)) {
     switch (border_mode) {
       case BorderMode::kReplicate:
         border_mode_ = cv::BORDER_REPLICATE;
@@ -52,27 +58,58 @@ class OpenCvProcessor : public ImageToTensorConverter {
                                  const RotatedRect& roi,
                                  const Size& output_dims, float range_min,
                                  float range_max) override {
+    return ConvertBatch(input, {roi}, output_dims, range_min, range_max,
+                        /*thread_pool=*/nullptr);
+  }
+
+  absl::StatusOr<Tensor> ConvertBatch(const mediapipe::Image& input,
+                                      const std::vector<RotatedRect>& rois,
+                                      const Size& output_dims, float range_min,
+                                      float range_max,
+                                      ThreadPool* thread_pool) override {
     if (input.image_format() != mediapipe::ImageFormat::SRGB &&
         input.image_format() != mediapipe::ImageFormat::SRGBA) {
       return InvalidArgumentError(
           absl::StrCat("Only RGBA/RGB formats are supported, passed format: ",
                        static_cast<uint32_t>(input.image_format())));
     }
+    RET_CHECK(!rois.empty()) << "At least one region is required.";
+    constexpr float kInputImageRangeMin = 0.0f;
+    constexpr float kInputImageRangeMax = 255.0f;
+    ASSIGN_OR_RETURN(
+        auto transform,
+        GetValueRangeTransformation(kInputImageRangeMin, kInputImageRangeMax,
+                                    range_min, range_max));
     auto src = mediapipe::formats::MatView(&input);
 
     constexpr int kNumChannels = 3;
-    Tensor tensor(tensor_type_, Tensor::Shape{1, output_dims.height,
-                                              output_dims.width, kNumChannels});
+    const int num_rois = rois.size();
+    Tensor tensor(tensor_type_,
+                  Tensor::Shape{num_rois, output_dims.height,
+                                output_dims.width, kNumChannels},
+                  buffer_pool_);
     auto buffer_view = tensor.GetCpuWriteView();
-    cv::Mat dst;
-    if (tensor_type_ == Tensor::ElementType::kUInt8) {
-      dst = cv::Mat(output_dims.height, output_dims.width, mat_type_,
-                    buffer_view.buffer<uint8>());
-    } else {
-      dst = cv::Mat(output_dims.height, output_dims.width, mat_type_,
-                    buffer_view.buffer<float>());
-    }
+    const int roi_size = output_dims.height * output_dims.width * kNumChannels;
+    ParallelForEachRoi(num_rois, thread_pool, [&](int i) {
+      cv::Mat dst;
+      if (tensor_type_ == Tensor::ElementType::kUInt8) {
+        dst = cv::Mat(output_dims.height, output_dims.width, mat_type_,
+                      buffer_view.buffer<uint8>() + i * roi_size);
+      } else {
+        dst = cv::Mat(output_dims.height, output_dims.width, mat_type_,
+                      buffer_view.buffer<float>() + i * roi_size);
+      }
+      ConvertRoi(*src, rois[i], output_dims, transform, dst);
+    });
+    return tensor;
+  }
 
+ private:
+  // Extracts @roi from @src and writes it, converted to the value range, to
+  // @dst.
+  void ConvertRoi(const cv::Mat& src, const RotatedRect& roi,
+                  const Size& output_dims,
+                  const ValueTransformation& transform, cv::Mat& dst) {
     const cv::RotatedRect rotated_rect(cv::Point2f(roi.center_x, roi.center_y),
                                        cv::Size2f(roi.width, roi.height),
                                        roi.rotation * 180.f / M_PI);
@@ -92,30 +129,24 @@ class OpenCvProcessor : public ImageToTensorConverter {
     cv::Mat projection_matrix =
         cv::getPerspectiveTransform(src_points, dst_points);
     cv::Mat transformed;
-    cv::warpPerspective(*src, transformed, projection_matrix,
+    cv::warpPerspective(src, transformed, projection_matrix,
                         cv::Size(dst_width, dst_height),
                         /*flags=*/cv::INTER_LINEAR,
                         /*borderMode=*/border_mode_);
 
-    if (transformed.channels() > kNumChannels) {
+    if (transformed.channels() > dst.channels()) {
       cv::Mat proper_channels_mat;
       cv::cvtColor(transformed, proper_channels_mat, cv::COLOR_RGBA2RGB);
       transformed = proper_channels_mat;
     }
 
-    constexpr float kInputImageRangeMin = 0.0f;
-    constexpr float kInputImageRangeMax = 255.0f;
-    ASSIGN_OR_RETURN(
-        auto transform,
-        GetValueRangeTransformation(kInputImageRangeMin, kInputImageRangeMax,
-                                    range_min, range_max));
     transformed.convertTo(dst, mat_type_, transform.scale, transform.offset);
-    return tensor;
   }
 
- private:
   enum cv::BorderTypes border_mode_;
   Tensor::ElementType tensor_type_;
+  // The pool of the output tensor buffers, or null.
+  std::shared_ptr<SharedBufferPool> buffer_pool_;
   int mat_type_;
 };
 
@@ -124,7 +155,13 @@ class OpenCvProcessor : public ImageToTensorConverter {
 absl::StatusOr<std::unique_ptr<ImageToTensorConverter>> CreateOpenCvConverter(
     CalculatorContext* cc, BorderMode border_mode,
     Tensor::ElementType tensor_type) {
-  return absl::make_unique<OpenCvProcessor>(border_mode, tensor_type);
+  std::shared_ptr<SharedBufferPool> buffer_pool;
+  if (cc->Service(kTensorBufferPoolService).IsAvailable()) {
+    buffer_pool =
+        cc->Service(kTensorBufferPoolService).GetObject().buffer_pool();
+  }
+  return absl::make_unique<OpenCvProcessor>(border_mode, tensor_type,
+                                            std::move(buffer_pool));
 }
 
 }  // namespace mediapipe
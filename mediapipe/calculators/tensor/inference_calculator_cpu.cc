@@ -12,13 +12,19 @@
 // See the License for the specific language governing permissions and
 // limitations under the License.
 
+#include <algorithm>
+#include <cstdint>
 #include <cstring>
+#include <deque>
 #include <memory>
 #include <string>
 #include <vector>
 
 #include "absl/memory/memory.h"
+#include "absl/time/clock.h"
+#include "absl/time/time.h"
 #include "mediapipe/calculators/tensor/inference_calculator.h"
+#include "mediapipe/framework/formats/tensor_buffer_pool.h"
 
 #if defined(MEDIAPIPE_ANDROID)
 #include "tensorflow/lite/delegates/nnapi/nnapi_delegate.h"
@@ -77,11 +83,64 @@ class InferenceCalculatorCpuImpl
   absl::Status LoadDelegate(CalculatorContext* cc);
   absl::Status LoadDelegateAndAllocateTensors(CalculatorContext* cc);
 
+  // Runs the pending packets in batches of up to max_batch_size_ input
+  // tensor sets and sends their outputs.
+  absl::Status RunPendingBatches(CalculatorContext* cc);
+  // Runs one Invoke() call on the input tensor sets of "packets" and sends
+  // one output packet for each of them.
+  absl::Status RunBatch(CalculatorContext* cc,
+                        const std::vector<Packet<std::vector<Tensor>>>& packets,
+                        int batch_size);
+  // With batching across timestamps, advances the output timestamp bound to
+  // the first pending packet, or past the input timestamp if none is pending.
+  void SetOutputTimestampBound(CalculatorContext* cc);
+  // Resizes the batch dimension of the model inputs, if needed.
+  absl::Status ResizeBatch(int batch_size);
+  // Returns true if the model inputs and outputs can be bound to Tensor CPU
+  // buffers.
+  bool CanBindTensors() const;
+  // Runs inference on "input_tensors" with the Tensor CPU buffers bound to
+  // the interpreter, and sends the outputs.
+  absl::Status RunWithBoundTensors(CalculatorContext* cc,
+                                   const std::vector<Tensor>& input_tensors);
+  // Returns the number of input tensor sets in a TENSORS packet.
+  int NumTensorSets(const std::vector<Tensor>& input_tensors) const {
+    return std::max<int>(1, input_tensors.size() / input_shapes_.size());
+  }
+
   // TfLite requires us to keep the model alive as long as the interpreter is.
   Packet<TfLiteModelPtr> model_packet_;
   std::unique_ptr<tflite::Interpreter> interpreter_;
   TfLiteDelegatePtr delegate_;
   bool has_quantized_input_;
+
+  // Batching state. See InferenceCalculatorOptions::Batching.
+  int max_batch_size_ = 1;
+  absl::Duration max_wait_ = absl::ZeroDuration();
+  // The shapes of the model inputs for a single input tensor set.
+  std::vector<std::vector<int>> input_shapes_;
+  // The number of input tensor sets the interpreter is currently sized for.
+  int current_batch_size_ = 1;
+  struct PendingPacket {
+    Packet<std::vector<Tensor>> packet;
+    absl::Time arrival_time;
+  };
+  std::deque<PendingPacket> pending_packets_;
+  int num_pending_sets_ = 0;
+
+  // True if Tensor CPU buffers are bound to the interpreter. See
+  // InferenceCalculatorOptions::bind_cpu_tensors.
+  bool bind_tensors_ = false;
+  std::vector<std::vector<int>> output_shapes_;
+  // The buffers bound to the model inputs, then to the model outputs. The
+  // interpreter re-plans its arena only when one of them changes.
+  std::vector<const void*> bound_buffers_;
+  // Aligned copies of the inputs that cannot be bound directly, allocated on
+  // first use.
+  std::vector<std::unique_ptr<Tensor>> staging_inputs_;
+  // The pool of the output tensor buffers, if the graph provides
+  // kTensorBufferPoolService.
+  std::shared_ptr<SharedBufferPool> output_buffer_pool_;
 };
 
 absl::Status InferenceCalculatorCpuImpl::UpdateContract(
@@ -89,62 +148,299 @@ absl::Status InferenceCalculatorCpuImpl::UpdateContract(
   const auto& options = cc->Options<::mediapipe::InferenceCalculatorOptions>();
   RET_CHECK(!options.model_path().empty() ^ kSideInModel(cc).IsConnected())
       << "Either model as side packet or model path in options is required.";
+  RET_CHECK_GE(options.batching().max_batch_size(), 1);
+  RET_CHECK_GE(options.batching().max_wait_us(), 0);
+  RET_CHECK(!options.bind_cpu_tensors() ||
+            (options.batching().max_batch_size() == 1 &&
+             options.batching().max_wait_us() == 0))
+      << "bind_cpu_tensors cannot be combined with batching.";
+  if (options.batching().max_wait_us() > 0) {
+    // Outputs of earlier timestamps are sent while processing later ones.
+    cc->SetTimestampOffset(TimestampDiff::Unset());
+    // Process() also runs when the input timestamp bound advances without a
+    // packet, to flush a pending batch that has waited max_wait_us and to
+    // propagate the output timestamp bound.
+    cc->SetProcessTimestampBounds(true);
+  }
+  cc->UseService(kTensorBufferPoolService).Optional();
 
   return absl::OkStatus();
 }
 
 absl::Status InferenceCalculatorCpuImpl::Open(CalculatorContext* cc) {
+  const auto& batching =
+      cc->Options<mediapipe::InferenceCalculatorOptions>().batching();
+  max_batch_size_ = batching.max_batch_size();
+  max_wait_ = absl::Microseconds(batching.max_wait_us());
   MP_RETURN_IF_ERROR(LoadModel(cc));
-  return LoadDelegateAndAllocateTensors(cc);
+  MP_RETURN_IF_ERROR(LoadDelegateAndAllocateTensors(cc));
+  bind_tensors_ =
+      cc->Options<mediapipe::InferenceCalculatorOptions>().bind_cpu_tensors() &&
+      CanBindTensors();
+  if (cc->Service(kTensorBufferPoolService).IsAvailable()) {
+    output_buffer_pool_ =
+        cc->Service(kTensorBufferPoolService).GetObject().buffer_pool();
+  }
+  return absl::OkStatus();
 }
 
 absl::Status InferenceCalculatorCpuImpl::Process(CalculatorContext* cc) {
   if (kInTensors(cc).IsEmpty()) {
+    if (!pending_packets_.empty() &&
+        absl::Now() - pending_packets_.front().arrival_time >= max_wait_) {
+      MP_RETURN_IF_ERROR(RunPendingBatches(cc));
+    }
+    SetOutputTimestampBound(cc);
     return absl::OkStatus();
   }
   const auto& input_tensors = *kInTensors(cc);
   RET_CHECK(!input_tensors.empty());
-  auto output_tensors = absl::make_unique<std::vector<Tensor>>();
+  RET_CHECK(input_tensors.size() <= input_shapes_.size() ||
+            input_tensors.size() % input_shapes_.size() == 0)
+      << "Expected a multiple of " << input_shapes_.size()
+      << " input tensors, got " << input_tensors.size();
+  if (bind_tensors_) {
+    RET_CHECK_EQ(input_tensors.size(), input_shapes_.size())
+        << "bind_cpu_tensors requires one tensor per model input.";
+    return RunWithBoundTensors(cc, input_tensors);
+  }
 
-  // Read CPU input into tensors.
-  for (int i = 0; i < input_tensors.size(); ++i) {
-    const Tensor* input_tensor = &input_tensors[i];
-    auto input_tensor_view = input_tensor->GetCpuReadView();
-    if (has_quantized_input_) {
-      // TODO: Support more quantized tensor types.
-      auto input_tensor_buffer = input_tensor_view.buffer<uint8>();
-      uint8* local_tensor_buffer = interpreter_->typed_input_tensor<uint8>(i);
-      std::memcpy(local_tensor_buffer, input_tensor_buffer,
-                  input_tensor->bytes());
-    } else {
-      auto input_tensor_buffer = input_tensor_view.buffer<float>();
-      float* local_tensor_buffer = interpreter_->typed_input_tensor<float>(i);
-      std::memcpy(local_tensor_buffer, input_tensor_buffer,
-                  input_tensor->bytes());
+  const absl::Time now = absl::Now();
+  pending_packets_.push_back(
+      {kInTensors(cc).packet().As<std::vector<Tensor>>(), now});
+  num_pending_sets_ += NumTensorSets(input_tensors);
+  if (max_wait_ > absl::ZeroDuration() &&
+      num_pending_sets_ < max_batch_size_ &&
+      now - pending_packets_.front().arrival_time < max_wait_) {
+    SetOutputTimestampBound(cc);
+    return absl::OkStatus();
+  }
+  MP_RETURN_IF_ERROR(RunPendingBatches(cc));
+  SetOutputTimestampBound(cc);
+  return absl::OkStatus();
+}
+
+void InferenceCalculatorCpuImpl::SetOutputTimestampBound(
+    CalculatorContext* cc) {
+  if (max_wait_ == absl::ZeroDuration()) {
+    // The timestamp offset propagates the bound.
+    return;
+  }
+  kOutTensors(cc).SetNextTimestampBound(
+      pending_packets_.empty() ? cc->InputTimestamp().NextAllowedInStream()
+                               : pending_packets_.front().packet.timestamp());
+}
+
+absl::Status InferenceCalculatorCpuImpl::RunPendingBatches(
+    CalculatorContext* cc) {
+  std::vector<Packet<std::vector<Tensor>>> batch;
+  int batch_size = 0;
+  while (!pending_packets_.empty()) {
+    const int num_sets = NumTensorSets(pending_packets_.front().packet.Get());
+    if (!batch.empty() && batch_size + num_sets > max_batch_size_) {
+      MP_RETURN_IF_ERROR(RunBatch(cc, batch, batch_size));
+      batch.clear();
+      batch_size = 0;
+    }
+    batch.push_back(std::move(pending_packets_.front().packet));
+    batch_size += num_sets;
+    pending_packets_.pop_front();
+  }
+  num_pending_sets_ = 0;
+  if (!batch.empty()) {
+    MP_RETURN_IF_ERROR(RunBatch(cc, batch, batch_size));
+  }
+  return absl::OkStatus();
+}
+
+absl::Status InferenceCalculatorCpuImpl::RunBatch(
+    CalculatorContext* cc,
+    const std::vector<Packet<std::vector<Tensor>>>& packets, int batch_size) {
+  MP_RETURN_IF_ERROR(ResizeBatch(batch_size));
+  const int num_inputs = input_shapes_.size();
+
+  // Read CPU input into tensors. Input i of set j goes to the j-th slice of
+  // model input i.
+  int set_index = 0;
+  for (const auto& packet : packets) {
+    const std::vector<Tensor>& input_tensors = packet.Get();
+    for (int i = 0; i < input_tensors.size(); ++i) {
+      const Tensor* input_tensor = &input_tensors[i];
+      const int model_input = i % num_inputs;
+      const size_t offset =
+          (set_index + i / num_inputs) * input_tensor->bytes();
+      auto input_tensor_view = input_tensor->GetCpuReadView();
+      if (has_quantized_input_) {
+        // TODO: Support more quantized tensor types.
+        auto input_tensor_buffer = input_tensor_view.buffer<uint8>();
+        uint8* local_tensor_buffer =
+            interpreter_->typed_input_tensor<uint8>(model_input);
+        RET_CHECK_LE(offset + input_tensor->bytes(),
+                     interpreter_->input_tensor(model_input)->bytes);
+        std::memcpy(local_tensor_buffer + offset, input_tensor_buffer,
+                    input_tensor->bytes());
+      } else {
+        auto input_tensor_buffer = input_tensor_view.buffer<float>();
+        float* local_tensor_buffer =
+            interpreter_->typed_input_tensor<float>(model_input);
+        RET_CHECK_LE(offset + input_tensor->bytes(),
+                     interpreter_->input_tensor(model_input)->bytes);
+        std::memcpy(reinterpret_cast<uint8*>(local_tensor_buffer) + offset,
+                    input_tensor_buffer, input_tensor->bytes());
+      }
     }
+    set_index += NumTensorSets(input_tensors);
   }
 
   // Run inference.
   RET_CHECK_EQ(interpreter_->Invoke(), kTfLiteOk);
 
-  // Output result tensors (CPU).
+  // Output result tensors (CPU), split along the batch dimension.
   const auto& tensor_indexes = interpreter_->outputs();
-  output_tensors->reserve(tensor_indexes.size());
-  for (int i = 0; i < tensor_indexes.size(); ++i) {
-    TfLiteTensor* tensor = interpreter_->tensor(tensor_indexes[i]);
-    output_tensors->emplace_back(
-        Tensor::ElementType::kFloat32,
-        Tensor::Shape{std::vector<int>{
-            tensor->dims->data, tensor->dims->data + tensor->dims->size}});
-    auto cpu_view = output_tensors->back().GetCpuWriteView();
-    std::memcpy(cpu_view.buffer<float>(), tensor->data.f,
-                output_tensors->back().bytes());
+  set_index = 0;
+  for (const auto& packet : packets) {
+    const int num_sets = NumTensorSets(packet.Get());
+    auto output_tensors = absl::make_unique<std::vector<Tensor>>();
+    output_tensors->reserve(num_sets * tensor_indexes.size());
+    for (int j = set_index; j < set_index + num_sets; ++j) {
+      for (int i = 0; i < tensor_indexes.size(); ++i) {
+        TfLiteTensor* tensor = interpreter_->tensor(tensor_indexes[i]);
+        std::vector<int> dims{tensor->dims->data,
+                              tensor->dims->data + tensor->dims->size};
+        if (batch_size > 1) {
+          RET_CHECK(!dims.empty() && dims[0] % batch_size == 0)
+              << "Output " << i << " cannot be split into " << batch_size
+              << " sets.";
+          dims[0] /= batch_size;
+        }
+        output_tensors->emplace_back(Tensor::ElementType::kFloat32,
+                                     Tensor::Shape{dims}, output_buffer_pool_);
+        auto cpu_view = output_tensors->back().GetCpuWriteView();
+        const size_t bytes = output_tensors->back().bytes();
+        std::memcpy(cpu_view.buffer<float>(),
+                    reinterpret_cast<const uint8*>(tensor->data.f) + j * bytes,
+                    bytes);
+      }
+    }
+    set_index += num_sets;
+    kOutTensors(cc).Send(std::move(output_tensors), packet.timestamp());
+  }
+  return absl::OkStatus();
+}
+
+absl::Status InferenceCalculatorCpuImpl::ResizeBatch(int batch_size) {
+  if (batch_size == current_batch_size_) {
+    return absl::OkStatus();
+  }
+  const auto& input_indexes = interpreter_->inputs();
+  for (int i = 0; i < input_indexes.size(); ++i) {
+    std::vector<int> dims = input_shapes_[i];
+    RET_CHECK(!dims.empty()) << "Batching requires a batch dimension.";
+    dims[0] *= batch_size;
+    RET_CHECK_EQ(interpreter_->ResizeInputTensor(input_indexes[i], dims),
+                 kTfLiteOk);
   }
+  RET_CHECK_EQ(interpreter_->AllocateTensors(), kTfLiteOk);
+  current_batch_size_ = batch_size;
+  return absl::OkStatus();
+}
+
+bool InferenceCalculatorCpuImpl::CanBindTensors() const {
+  if (has_quantized_input_) return false;
+  for (int index : interpreter_->inputs()) {
+    const TfLiteTensor* tensor = interpreter_->tensor(index);
+    if (tensor->type != kTfLiteFloat32 ||
+        tensor->allocation_type != kTfLiteArenaRw) {
+      return false;
+    }
+  }
+  for (int index : interpreter_->outputs()) {
+    const TfLiteTensor* tensor = interpreter_->tensor(index);
+    if (tensor->type != kTfLiteFloat32 ||
+        tensor->allocation_type != kTfLiteArenaRw ||
+        std::find(interpreter_->inputs().begin(), interpreter_->inputs().end(),
+                  index) != interpreter_->inputs().end()) {
+      return false;
+    }
+  }
+  return true;
+}
+
+absl::Status InferenceCalculatorCpuImpl::RunWithBoundTensors(
+    CalculatorContext* cc, const std::vector<Tensor>& input_tensors) {
+  // The views keep the Tensor buffers locked until Invoke() returns.
+  std::vector<Tensor::CpuReadView> input_views;
+  std::vector<Tensor::CpuWriteView> staging_views;
+  input_views.reserve(input_tensors.size());
+  bool buffers_changed = false;
+  const auto& input_indexes = interpreter_->inputs();
+  for (int i = 0; i < input_tensors.size(); ++i) {
+    const TfLiteTensor* tensor = interpreter_->tensor(input_indexes[i]);
+    RET_CHECK_EQ(input_tensors[i].bytes(), tensor->bytes)
+        << "Input " << i << " does not match the model input size.";
+    input_views.push_back(input_tensors[i].GetCpuReadView());
+    void* buffer = const_cast<void*>(input_views.back().buffer<void>());
+    if (reinterpret_cast<uintptr_t>(buffer) % Tensor::kCpuBufferAlignment !=
+        0) {
+      if (!staging_inputs_[i]) {
+        staging_inputs_[i] = absl::make_unique<Tensor>(
+            Tensor::ElementType::kFloat32, Tensor::Shape{input_shapes_[i]});
+      }
+      staging_views.push_back(staging_inputs_[i]->GetCpuWriteView());
+      std::memcpy(staging_views.back().buffer<void>(), buffer, tensor->bytes);
+      buffer = staging_views.back().buffer<void>();
+    }
+    if (buffer != bound_buffers_[i]) {
+      RET_CHECK_EQ(interpreter_->SetCustomAllocationForTensor(
+                       input_indexes[i], {buffer, tensor->bytes}),
+                   kTfLiteOk);
+      bound_buffers_[i] = buffer;
+      buffers_changed = true;
+    }
+  }
+
+  // Output result tensors (CPU), written by the interpreter in place.
+  const auto& output_indexes = interpreter_->outputs();
+  auto output_tensors = absl::make_unique<std::vector<Tensor>>();
+  std::vector<Tensor::CpuWriteView> output_views;
+  // Views refer to their Tensor, so the Tensors must not move.
+  output_tensors->reserve(output_indexes.size());
+  output_views.reserve(output_indexes.size());
+  for (int i = 0; i < output_indexes.size(); ++i) {
+    output_tensors->emplace_back(Tensor::ElementType::kFloat32,
+                                 Tensor::Shape{output_shapes_[i]},
+                                 output_buffer_pool_);
+    output_views.push_back(output_tensors->back().GetCpuWriteView());
+    void* buffer = output_views.back().buffer<void>();
+    const void*& bound_buffer = bound_buffers_[input_indexes.size() + i];
+    if (buffer != bound_buffer) {
+      RET_CHECK_EQ(interpreter_->SetCustomAllocationForTensor(
+                       output_indexes[i],
+                       {buffer,
+                        static_cast<size_t>(output_tensors->back().bytes())}),
+                   kTfLiteOk);
+      bound_buffer = buffer;
+      buffers_changed = true;
+    }
+  }
+
+  // Custom allocations take effect on the next AllocateTensors(), which
+  // re-plans the whole arena. Buffers from a TensorBufferPool in steady
+  // state, and the staging inputs, keep their addresses from frame to
+  // frame, so this is skipped for most frames.
+  if (buffers_changed) {
+    RET_CHECK_EQ(interpreter_->AllocateTensors(), kTfLiteOk);
+  }
+  RET_CHECK_EQ(interpreter_->Invoke(), kTfLiteOk);
+  output_views.clear();
   kOutTensors(cc).Send(std::move(output_tensors));
   return absl::OkStatus();
 }
 
 absl::Status InferenceCalculatorCpuImpl::Close(CalculatorContext* cc) {
+  if (!pending_packets_.empty()) {
+    MP_RETURN_IF_ERROR(RunPendingBatches(cc));
+  }
   interpreter_ = nullptr;
   delegate_ = nullptr;
   return absl::OkStatus();
@@ -179,6 +475,20 @@ absl::Status InferenceCalculatorCpuImpl::LoadDelegateAndAllocateTensors(
   has_quantized_input_ =
       interpreter_->tensor(interpreter_->inputs()[0])->quantization.type ==
       kTfLiteAffineQuantization;
+  input_shapes_.clear();
+  for (int index : interpreter_->inputs()) {
+    const TfLiteIntArray* dims = interpreter_->tensor(index)->dims;
+    input_shapes_.emplace_back(dims->data, dims->data + dims->size);
+  }
+  output_shapes_.clear();
+  for (int index : interpreter_->outputs()) {
+    const TfLiteIntArray* dims = interpreter_->tensor(index)->dims;
+    output_shapes_.emplace_back(dims->data, dims->data + dims->size);
+  }
+  staging_inputs_.clear();
+  staging_inputs_.resize(input_shapes_.size());
+  bound_buffers_.assign(input_shapes_.size() + output_shapes_.size(), nullptr);
+  current_batch_size_ = 1;
   return absl::OkStatus();
 }
 
@@ -23,7 +23,9 @@
 #include "mediapipe/framework/calculator_framework.h"
 #include "mediapipe/framework/formats/detection.pb.h"
 #include "mediapipe/framework/formats/image_frame.h"
+#include "mediapipe/framework/formats/tensor_buffer_pool.h"
 #include "mediapipe/framework/graph_test_base.h"
+#include "mediapipe/framework/port/benchmark.h"
 #include "mediapipe/framework/port/file_helpers.h"
 #include "mediapipe/framework/port/gmock.h"
 #include "mediapipe/framework/port/gtest.h"
@@ -166,6 +168,54 @@ INSTANTIATE_TEST_SUITE_P(Implementation, InferenceCalculatorTest,
                            return info.param.name;
                          });
 
+// Runs the face detection graph on CPU, one frame per iteration. If
+// state.range(0) is 1, the graph is given a TensorBufferPool and the tensor
+// buffer allocations per frame are reported, which drop to zero once the pool
+// holds a buffer for every tensor of a frame.
+void BM_FaceDetectionTensorAllocations(benchmark::State& state) {
+  const bool use_pool = state.range(0);
+  CalculatorGraphConfig config;
+  CHECK(LoadTestGraph(
+      &config, file::JoinPath(GetTestRootDir(),
+                              "mediapipe/calculators/tensor/"
+                              "testdata/face_detection_test.binarypb")));
+  std::vector<mediapipe::Packet> detection_packets;
+  tool::AddVectorSink("detections", &config, &detection_packets);
+  std::unique_ptr<ImageFrame> input_image = LoadTestPng(
+      file::JoinPath(GetTestRootDir(), "mediapipe/objc/testdata/sergey.png"));
+  CHECK(input_image);
+  mediapipe::Packet input_packet = Adopt(input_image.release());
+
+  CalculatorGraph graph;
+  auto pool = std::make_shared<TensorBufferPool>();
+  if (use_pool) {
+    MEDIAPIPE_CHECK_OK(graph.SetServiceObject(kTensorBufferPoolService, pool));
+  }
+  MEDIAPIPE_CHECK_OK(graph.Initialize(config));
+  MEDIAPIPE_CHECK_OK(graph.StartRun({}));
+  // Warms up the graph and the pool.
+  int64 timestamp = 0;
+  MEDIAPIPE_CHECK_OK(graph.AddPacketToInputStream(
+      "image", input_packet.At(Timestamp(timestamp++))));
+  MEDIAPIPE_CHECK_OK(graph.WaitUntilIdle());
+  detection_packets.clear();
+  const int64 misses_before = pool->GetStats().miss_count;
+  for (auto _ : state) {
+    MEDIAPIPE_CHECK_OK(graph.AddPacketToInputStream(
+        "image", input_packet.At(Timestamp(timestamp++))));
+    MEDIAPIPE_CHECK_OK(graph.WaitUntilIdle());
+    detection_packets.clear();
+  }
+  if (use_pool) {
+    state.counters["tensor_allocs_per_frame"] =
+        static_cast<double>(pool->GetStats().miss_count - misses_before) /
+        state.iterations();
+  }
+  MEDIAPIPE_CHECK_OK(graph.CloseAllPacketSources());
+  MEDIAPIPE_CHECK_OK(graph.WaitUntilDone());
+}
+BENCHMARK(BM_FaceDetectionTensorAllocations)->Arg(0)->Arg(1);
+
 }  // namespace
 }  // namespace api2
 }  // namespace mediapipe
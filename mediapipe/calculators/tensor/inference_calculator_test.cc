@@ -11,23 +11,33 @@
 // WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
 // See the License for the specific language governing permissions and
 // limitations under the License.
+//
+// To run the benchmarks:
+// $ bazel run -c opt mediapipe/calculators/tensor:inference_calculator_test \
+//   -- --benchmark_filter=all
 
+#include <algorithm>
+#include <cstring>
 #include <memory>
 #include <string>
 #include <vector>
 
 #include "absl/strings/str_replace.h"
+#include "absl/time/clock.h"
+#include "absl/time/time.h"
 #include "absl/strings/string_view.h"
 #include "mediapipe/calculators/tensor/inference_calculator.pb.h"
 #include "mediapipe/framework/calculator_framework.h"
 #include "mediapipe/framework/calculator_runner.h"
 #include "mediapipe/framework/deps/file_path.h"
 #include "mediapipe/framework/formats/tensor.h"
+#include "mediapipe/framework/port/benchmark.h"
 #include "mediapipe/framework/port/gmock.h"
 #include "mediapipe/framework/port/gtest.h"
 #include "mediapipe/framework/port/integral_types.h"
 #include "mediapipe/framework/port/parse_text_proto.h"
 #include "mediapipe/framework/port/status_matchers.h"  // NOLINT
+#include "mediapipe/framework/tool/sink.h"
 #include "mediapipe/framework/tool/validate_type.h"
 #include "tensorflow/lite/error_reporter.h"
 #include "tensorflow/lite/kernels/register.h"
@@ -114,6 +124,13 @@ TEST(InferenceCalculatorTest, SmokeTest) {
   DoSmokeTest(absl::StrReplaceAll(
       graph_proto,
       {{"$delegate", "delegate { xnnpack { num_threads: 10 } }"}}));
+  // Test binding the Tensor buffers instead of copying them.
+  DoSmokeTest(absl::StrReplaceAll(
+      graph_proto,
+      {{"$delegate", "delegate { tflite {} } bind_cpu_tensors: true"}}));
+  DoSmokeTest(absl::StrReplaceAll(
+      graph_proto,
+      {{"$delegate", "delegate { xnnpack {} } bind_cpu_tensors: true"}}));
 }
 
 TEST(InferenceCalculatorTest, SmokeTest_ModelAsInputSidePacket) {
@@ -157,4 +174,267 @@ TEST(InferenceCalculatorTest, SmokeTest_ModelAsInputSidePacket) {
   DoSmokeTest(graph_proto);
 }
 
+// Returns one [1, 8, 8, 3] tensor per value, filled with that value.
+std::unique_ptr<std::vector<Tensor>> MakeInputTensors(
+    const std::vector<float>& values) {
+  auto input_vec = absl::make_unique<std::vector<Tensor>>();
+  for (float value : values) {
+    input_vec->emplace_back(Tensor::ElementType::kFloat32,
+                            Tensor::Shape{1, 8, 8, 3});
+    auto view = input_vec->back().GetCpuWriteView();
+    std::fill_n(view.buffer<float>(), 8 * 8 * 3, value);
+  }
+  return input_vec;
+}
+
+// Expects each output tensor to have the shape of a single input and to be
+// filled with three times the corresponding value.
+void ExpectAddModelOutputs(const Packet& packet,
+                           const std::vector<float>& values) {
+  const std::vector<Tensor>& result_vec = packet.Get<std::vector<Tensor>>();
+  ASSERT_EQ(values.size(), result_vec.size());
+  for (int i = 0; i < values.size(); ++i) {
+    EXPECT_THAT(result_vec[i].shape().dims, testing::ElementsAre(1, 8, 8, 3));
+    auto view = result_vec[i].GetCpuReadView();
+    const float* result_buffer = view.buffer<float>();
+    for (int j = 0; j < 8 * 8 * 3; ++j) {
+      ASSERT_EQ(3 * values[i], result_buffer[j]);
+    }
+  }
+}
+
+// Bound tensors give the right outputs whether or not their buffers keep
+// their addresses from frame to frame.
+TEST(InferenceCalculatorTest, BindsTensorsAcrossFrames) {
+  CalculatorGraphConfig graph_config =
+      ParseTextProtoOrDie<CalculatorGraphConfig>(R"(
+        input_stream: "tensor_in"
+        node {
+          calculator: "InferenceCalculator"
+          input_stream: "TENSORS:tensor_in"
+          output_stream: "TENSORS:tensor_out"
+          options {
+            [mediapipe.InferenceCalculatorOptions.ext] {
+              model_path: "mediapipe/calculators/tensor/testdata/add.bin"
+              delegate { tflite {} }
+              bind_cpu_tensors: true
+            }
+          }
+        }
+      )");
+  std::vector<Packet> output_packets;
+  tool::AddVectorSink("tensor_out", &graph_config, &output_packets);
+  CalculatorGraph graph(graph_config);
+  MP_ASSERT_OK(graph.StartRun({}));
+  for (int i = 0; i < 4; ++i) {
+    MP_ASSERT_OK(graph.AddPacketToInputStream(
+        "tensor_in",
+        Adopt(MakeInputTensors({static_cast<float>(i)}).release())
+            .At(Timestamp(i))));
+    MP_ASSERT_OK(graph.WaitUntilIdle());
+    ASSERT_EQ(i + 1, output_packets.size());
+    ExpectAddModelOutputs(output_packets[i], {static_cast<float>(i)});
+    // Releasing the output lets the next frame reuse its buffer.
+    if (i % 2 == 1) {
+      output_packets[i] = Packet();
+    }
+  }
+  MP_ASSERT_OK(graph.CloseInputStream("tensor_in"));
+  MP_ASSERT_OK(graph.WaitUntilDone());
+}
+
+constexpr char kBatchingGraph[] = R"(
+  input_stream: "tensor_in"
+  node {
+    calculator: "InferenceCalculator"
+    input_stream: "TENSORS:tensor_in"
+    output_stream: "TENSORS:tensor_out"
+    options {
+      [mediapipe.InferenceCalculatorOptions.ext] {
+        model_path: "mediapipe/calculators/tensor/testdata/add.bin"
+        delegate { tflite {} }
+        $batching
+      }
+    }
+  }
+)";
+
+TEST(InferenceCalculatorTest, BatchesTensorSetsWithinPacket) {
+  CalculatorGraphConfig graph_config =
+      ParseTextProtoOrDie<CalculatorGraphConfig>(absl::StrReplaceAll(
+          kBatchingGraph, {{"$batching", "batching { max_batch_size: 4 }"}}));
+  std::vector<Packet> output_packets;
+  tool::AddVectorSink("tensor_out", &graph_config, &output_packets);
+  CalculatorGraph graph(graph_config);
+  MP_ASSERT_OK(graph.StartRun({}));
+
+  // Three sets in one packet run as one batch, then a single set runs on its
+  // own.
+  MP_ASSERT_OK(graph.AddPacketToInputStream(
+      "tensor_in", Adopt(MakeInputTensors({1, 2, 3}).release())
+                       .At(Timestamp(0))));
+  MP_ASSERT_OK(graph.AddPacketToInputStream(
+      "tensor_in", Adopt(MakeInputTensors({4}).release()).At(Timestamp(1))));
+  MP_ASSERT_OK(graph.WaitUntilIdle());
+  ASSERT_EQ(2, output_packets.size());
+  EXPECT_EQ(Timestamp(0), output_packets[0].Timestamp());
+  ExpectAddModelOutputs(output_packets[0], {1, 2, 3});
+  EXPECT_EQ(Timestamp(1), output_packets[1].Timestamp());
+  ExpectAddModelOutputs(output_packets[1], {4});
+
+  MP_ASSERT_OK(graph.CloseInputStream("tensor_in"));
+  MP_ASSERT_OK(graph.WaitUntilDone());
+}
+
+TEST(InferenceCalculatorTest, BatchesTensorSetsAcrossTimestamps) {
+  CalculatorGraphConfig graph_config =
+      ParseTextProtoOrDie<CalculatorGraphConfig>(absl::StrReplaceAll(
+          kBatchingGraph,
+          {{"$batching",
+            "batching { max_batch_size: 2 max_wait_us: 60000000 }"}}));
+  std::vector<Packet> output_packets;
+  tool::AddVectorSink("tensor_out", &graph_config, &output_packets);
+  CalculatorGraph graph(graph_config);
+  MP_ASSERT_OK(graph.StartRun({}));
+
+  for (int i = 0; i < 3; ++i) {
+    MP_ASSERT_OK(graph.AddPacketToInputStream(
+        "tensor_in",
+        Adopt(MakeInputTensors({static_cast<float>(i)}).release())
+            .At(Timestamp(i))));
+  }
+  // The first two packets fill a batch. The third one waits for more input.
+  MP_ASSERT_OK(graph.WaitUntilIdle());
+  ASSERT_EQ(2, output_packets.size());
+
+  // Closing the input runs the partial batch.
+  MP_ASSERT_OK(graph.CloseInputStream("tensor_in"));
+  MP_ASSERT_OK(graph.WaitUntilDone());
+  ASSERT_EQ(3, output_packets.size());
+  for (int i = 0; i < 3; ++i) {
+    EXPECT_EQ(Timestamp(i), output_packets[i].Timestamp());
+    ExpectAddModelOutputs(output_packets[i], {static_cast<float>(i)});
+  }
+}
+
+// A partial batch that has waited max_wait_us runs when the input timestamp
+// bound advances without a packet.
+TEST(InferenceCalculatorTest, FlushesPartialBatchWhenInputBoundAdvances) {
+  CalculatorGraphConfig graph_config =
+      ParseTextProtoOrDie<CalculatorGraphConfig>(R"(
+        input_stream: "tensor"
+        input_stream: "allow"
+        node {
+          calculator: "GateCalculator"
+          input_stream: "tensor"
+          input_stream: "ALLOW:allow"
+          output_stream: "tensor_in"
+        }
+        node {
+          calculator: "InferenceCalculator"
+          input_stream: "TENSORS:tensor_in"
+          output_stream: "TENSORS:tensor_out"
+          options {
+            [mediapipe.InferenceCalculatorOptions.ext] {
+              model_path: "mediapipe/calculators/tensor/testdata/add.bin"
+              delegate { tflite {} }
+              batching { max_batch_size: 4 max_wait_us: 1000 }
+            }
+          }
+        }
+      )");
+  std::vector<Packet> output_packets;
+  tool::AddVectorSink("tensor_out", &graph_config, &output_packets);
+  CalculatorGraph graph(graph_config);
+  MP_ASSERT_OK(graph.StartRun({}));
+
+  auto add_input = [&graph](int64 timestamp, bool allow) {
+    MP_ASSERT_OK(graph.AddPacketToInputStream(
+        "tensor", Adopt(MakeInputTensors({static_cast<float>(timestamp)})
+                            .release())
+                      .At(Timestamp(timestamp))));
+    MP_ASSERT_OK(graph.AddPacketToInputStream(
+        "allow", MakePacket<bool>(allow).At(Timestamp(timestamp))));
+  };
+  add_input(0, true);
+  MP_ASSERT_OK(graph.WaitUntilIdle());
+  EXPECT_TRUE(output_packets.empty());
+
+  // The gate drops the packet at timestamp 1 and only advances the bound.
+  absl::SleepFor(absl::Milliseconds(2));
+  add_input(1, false);
+  MP_ASSERT_OK(graph.WaitUntilIdle());
+  ASSERT_EQ(1, output_packets.size());
+  EXPECT_EQ(Timestamp(0), output_packets[0].Timestamp());
+  ExpectAddModelOutputs(output_packets[0], {0});
+
+  MP_ASSERT_OK(graph.CloseAllInputStreams());
+  MP_ASSERT_OK(graph.WaitUntilDone());
+}
+
+// Compares copying tensors into and out of the interpreter with binding the
+// Tensor buffers, for selfie segmentation sized tensors. The add model is
+// resized to [1, 256, 256, 3]. state.range(0) selects copying (0), binding a
+// new output buffer every frame (1), or binding buffers that keep their
+// addresses, like those of a TensorBufferPool in steady state (2). Only a
+// changed address requires AllocateTensors().
+void BM_CpuTensorBinding(benchmark::State& state) {
+  const bool bind = state.range(0) > 0;
+  const bool stable_buffers = state.range(0) == 2;
+  auto model = tflite::FlatBufferModel::BuildFromFile(
+      "mediapipe/calculators/tensor/testdata/add.bin");
+  CHECK(model);
+  tflite::ops::builtin::BuiltinOpResolverWithoutDefaultDelegates op_resolver;
+  std::unique_ptr<tflite::Interpreter> interpreter;
+  tflite::InterpreterBuilder(*model, op_resolver)(&interpreter);
+  CHECK(interpreter);
+  const int input = interpreter->inputs()[0];
+  const int output = interpreter->outputs()[0];
+  CHECK_EQ(interpreter->ResizeInputTensor(input, {1, 256, 256, 3}),
+           kTfLiteOk);
+  CHECK_EQ(interpreter->AllocateTensors(), kTfLiteOk);
+
+  Tensor input_tensor(Tensor::ElementType::kFloat32,
+                      Tensor::Shape{1, 256, 256, 3});
+  {
+    auto view = input_tensor.GetCpuWriteView();
+    std::fill_n(view.buffer<float>(), 256 * 256 * 3, 1.0f);
+  }
+  Tensor stable_output_tensor(Tensor::ElementType::kFloat32,
+                              Tensor::Shape{1, 256, 256, 3});
+  bool bound = false;
+  for (auto _ : state) {
+    Tensor new_output_tensor(Tensor::ElementType::kFloat32,
+                             Tensor::Shape{1, 256, 256, 3});
+    Tensor& output_tensor =
+        stable_buffers ? stable_output_tensor : new_output_tensor;
+    auto input_view = input_tensor.GetCpuReadView();
+    auto output_view = output_tensor.GetCpuWriteView();
+    if (bind && !(stable_buffers && bound)) {
+      CHECK_EQ(interpreter->SetCustomAllocationForTensor(
+                   input, {const_cast<void*>(input_view.buffer<void>()),
+                           static_cast<size_t>(input_tensor.bytes())}),
+               kTfLiteOk);
+      CHECK_EQ(interpreter->SetCustomAllocationForTensor(
+                   output, {output_view.buffer<void>(),
+                            static_cast<size_t>(output_tensor.bytes())}),
+               kTfLiteOk);
+      CHECK_EQ(interpreter->AllocateTensors(), kTfLiteOk);
+      bound = true;
+    } else if (!bind) {
+      std::memcpy(interpreter->typed_tensor<float>(input),
+                  input_view.buffer<float>(), input_tensor.bytes());
+    }
+    CHECK_EQ(interpreter->Invoke(), kTfLiteOk);
+    if (!bind) {
+      std::memcpy(output_view.buffer<float>(),
+                  interpreter->typed_tensor<float>(output),
+                  output_tensor.bytes());
+    }
+    benchmark::DoNotOptimize(output_view.buffer<float>());
+  }
+  state.SetBytesProcessed(state.iterations() * 2 * input_tensor.bytes());
+}
+BENCHMARK(BM_CpuTensorBinding)->Arg(0)->Arg(1)->Arg(2);
+
 }  // namespace mediapipe
@@ -19,7 +19,9 @@
 #include "mediapipe/framework/calculator_framework.h"
 #include "mediapipe/framework/formats/image_frame.h"
 #include "mediapipe/framework/formats/matrix.h"
+#include "mediapipe/framework/formats/shared_buffer_pool.h"
 #include "mediapipe/framework/formats/tensor.h"
+#include "mediapipe/framework/formats/tensor_buffer_pool.h"
 #include "mediapipe/framework/port.h"
 #include "mediapipe/framework/port/ret_check.h"
 #include "mediapipe/util/resource_util.h"
@@ -136,6 +138,8 @@ class TensorConverterCalculator : public CalculatorBase {
   bool flip_vertically_ = false;
   bool row_major_matrix_ = false;
   int max_num_channels_ = 3;
+  // Pool of the CPU output tensor buffers, if enabled.
+  std::shared_ptr<SharedBufferPool> cpu_buffer_pool_;
 };
 REGISTER_CALCULATOR(TensorConverterCalculator);
 
@@ -166,6 +170,7 @@ absl::Status TensorConverterCalculator::GetContract(CalculatorContract* cc) {
 
   RET_CHECK(cc->Outputs().HasTag(kTensorsTag));
   cc->Outputs().Tag(kTensorsTag).Set<std::vector<Tensor>>();
+  cc->UseService(kTensorBufferPoolService).Optional();
   return absl::OkStatus();
 }
 
@@ -173,6 +178,11 @@ absl::Status TensorConverterCalculator::Open(CalculatorContext* cc) {
   cc->SetOffset(TimestampDiff(0));
 
   MP_RETURN_IF_ERROR(LoadOptions(cc));
+  // The pool of the graph takes precedence over the shared pool.
+  if (cc->Service(kTensorBufferPoolService).IsAvailable()) {
+    cpu_buffer_pool_ =
+        cc->Service(kTensorBufferPoolService).GetObject().buffer_pool();
+  }
 
 #if !MEDIAPIPE_DISABLE_GPU
   if (cc->Inputs().HasTag(kGpuBufferTag)) {
@@ -245,7 +255,7 @@ absl::Status TensorConverterCalculator::ProcessCPU(CalculatorContext* cc) {
 
     output_tensors->emplace_back(
         Tensor::ElementType::kFloat32,
-        Tensor::Shape{1, height, width, channels_preserved});
+        Tensor::Shape{1, height, width, channels_preserved}, cpu_buffer_pool_);
     auto cpu_view = output_tensors->back().GetCpuWriteView();
 
     // Copy image data into tensor.
@@ -268,7 +278,8 @@ absl::Status TensorConverterCalculator::ProcessCPU(CalculatorContext* cc) {
     const int width = matrix.cols();
     const int channels = 1;
     output_tensors->emplace_back(Tensor::ElementType::kFloat32,
-                                 Tensor::Shape{1, height, width, channels});
+                                 Tensor::Shape{1, height, width, channels},
+                                 cpu_buffer_pool_);
     MP_RETURN_IF_ERROR(CopyMatrixToTensor(
         matrix, output_tensors->back().GetCpuWriteView().buffer<float>()));
   } else {
@@ -603,6 +614,10 @@ absl::Status TensorConverterCalculator::LoadOptions(CalculatorContext* cc) {
   CHECK_GE(max_num_channels_, 1);
   CHECK_LE(max_num_channels_, 4);
   CHECK_NE(max_num_channels_, 2);
+
+  if (options.use_shared_buffer_pool()) {
+    cpu_buffer_pool_ = SharedBufferPool::GetShared();
+  }
   return absl::OkStatus();
 }
 
@@ -23,7 +23,9 @@
 #include "mediapipe/framework/formats/image_frame.h"
 #include "mediapipe/framework/formats/image_frame_opencv.h"
 #include "mediapipe/framework/formats/matrix.h"
+#include "mediapipe/framework/formats/shared_buffer_pool.h"
 #include "mediapipe/framework/formats/tensor.h"
+#include "mediapipe/framework/formats/tensor_buffer_pool.h"
 #include "mediapipe/framework/port/gtest.h"
 #include "mediapipe/framework/port/integral_types.h"
 #include "mediapipe/framework/port/parse_text_proto.h"
@@ -320,4 +322,83 @@ TEST_F(TensorConverterCalculatorTest, SetOutputRange) {
   }
 }
 
+TEST_F(TensorConverterCalculatorTest, UsesSharedBufferPool) {
+  CalculatorGraph graph;
+  CalculatorGraphConfig graph_config =
+      mediapipe::ParseTextProtoOrDie<CalculatorGraphConfig>(R"pb(
+        input_stream: "input_image"
+        node {
+          calculator: "TensorConverterCalculator"
+          input_stream: "IMAGE:input_image"
+          output_stream: "TENSORS:tensor"
+          options {
+            [mediapipe.TensorConverterCalculatorOptions.ext] {
+              use_shared_buffer_pool: true
+            }
+          }
+        }
+      )pb");
+  std::vector<Packet> output_packets;
+  tool::AddVectorSink("tensor", &graph_config, &output_packets);
+
+  MP_ASSERT_OK(graph.Initialize(graph_config));
+  MP_ASSERT_OK(graph.StartRun({}));
+  const SharedBufferPool::Stats stats_before =
+      SharedBufferPool::Get().GetStats();
+  for (int i = 0; i < 2; ++i) {
+    auto input_image = absl::make_unique<ImageFrame>(ImageFormat::SRGB, 8, 8);
+    input_image->SetToZero();
+    MP_ASSERT_OK(graph.AddPacketToInputStream(
+        "input_image", Adopt(input_image.release()).At(Timestamp(i))));
+    MP_ASSERT_OK(graph.WaitUntilIdle());
+    // Releases the tensor buffer to the pool.
+    output_packets.clear();
+  }
+  const SharedBufferPool::Stats stats = SharedBufferPool::Get().GetStats();
+  EXPECT_EQ(stats.hit_count + stats.miss_count -
+                (stats_before.hit_count + stats_before.miss_count),
+            2);
+  EXPECT_GE(stats.hit_count - stats_before.hit_count, 1);
+
+  MP_ASSERT_OK(graph.CloseInputStream("input_image"));
+  MP_ASSERT_OK(graph.WaitUntilDone());
+}
+
+TEST_F(TensorConverterCalculatorTest, UsesTensorBufferPoolService) {
+  CalculatorGraph graph;
+  CalculatorGraphConfig graph_config =
+      mediapipe::ParseTextProtoOrDie<CalculatorGraphConfig>(R"pb(
+        input_stream: "input_image"
+        node {
+          calculator: "TensorConverterCalculator"
+          input_stream: "IMAGE:input_image"
+          output_stream: "TENSORS:tensor"
+        }
+      )pb");
+  std::vector<Packet> output_packets;
+  tool::AddVectorSink("tensor", &graph_config, &output_packets);
+  auto pool = std::make_shared<TensorBufferPool>();
+  MP_ASSERT_OK(graph.SetServiceObject(kTensorBufferPoolService, pool));
+
+  MP_ASSERT_OK(graph.Initialize(graph_config));
+  MP_ASSERT_OK(graph.StartRun({}));
+  for (int i = 0; i < 5; ++i) {
+    auto input_image = absl::make_unique<ImageFrame>(ImageFormat::SRGB, 8, 8);
+    input_image->SetToZero();
+    MP_ASSERT_OK(graph.AddPacketToInputStream(
+        "input_image", Adopt(input_image.release()).At(Timestamp(i))));
+    MP_ASSERT_OK(graph.WaitUntilIdle());
+    ASSERT_EQ(output_packets.size(), 1);
+    // Releases the tensor buffer to the pool.
+    output_packets.clear();
+  }
+  // Only the first frame allocates a tensor buffer.
+  const SharedBufferPool::Stats stats = pool->GetStats();
+  EXPECT_EQ(stats.miss_count, 1);
+  EXPECT_EQ(stats.hit_count, 4);
+
+  MP_ASSERT_OK(graph.CloseInputStream("input_image"));
+  MP_ASSERT_OK(graph.WaitUntilDone());
+}
+
 }  // namespace mediapipe
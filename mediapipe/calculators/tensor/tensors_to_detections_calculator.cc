@@ -12,12 +12,16 @@
 // See the License for the specific language governing permissions and
 // limitations under the License.
 
+#include <algorithm>
+#include <cmath>
 #include <unordered_map>
 #include <vector>
 
 #include "absl/strings/str_format.h"
 #include "absl/types/span.h"
 #include "mediapipe/calculators/tensor/tensors_to_detections_calculator.pb.h"
+#include "mediapipe/calculators/util/non_max_suppression.h"
+#include "mediapipe/calculators/util/non_max_suppression_calculator.pb.h"
 #include "mediapipe/framework/api2/node.h"
 #include "mediapipe/framework/calculator_framework.h"
 #include "mediapipe/framework/deps/file_path.h"
@@ -26,6 +30,7 @@
 #include "mediapipe/framework/formats/object_detection/anchor.pb.h"
 #include "mediapipe/framework/formats/tensor.h"
 #include "mediapipe/framework/port.h"
+#include "mediapipe/framework/port/rectangle.h"
 #include "mediapipe/framework/port/ret_check.h"
 
 // Note: On Apple platforms MEDIAPIPE_DISABLE_GL_COMPUTE is automatically
@@ -91,6 +96,37 @@ void ConvertAnchorsToRawValues(const std::vector<Anchor>& anchors,
   }
 }
 
+// A detection decoded on the CPU, before it is retained by non-maximum
+// suppression. The box is stored as in the relative bounding box of the output
+// Detection.
+struct DecodedDetection {
+  float xmin = 0.0f;
+  float ymin = 0.0f;
+  float width = 0.0f;
+  float height = 0.0f;
+  float score = 0.0f;
+  int class_id = 0;
+};
+
+// The detections decoded for a frame, in plain arrays that are reused from
+// frame to frame.
+struct DecodedDetections {
+  std::vector<DecodedDetection> detections;
+  // The (x, y) keypoints of the detections, num_keypoints per detection.
+  std::vector<float> keypoints;
+  // The boxes and scores of the detections, as read by non-maximum
+  // suppression.
+  std::vector<Rectangle_f> boxes;
+  std::vector<float> scores;
+
+  void Clear() {
+    detections.clear();
+    keypoints.clear();
+    boxes.clear();
+    scores.clear();
+  }
+};
+
 }  // namespace
 
 // Convert result Tensors from object detection models into MediaPipe
@@ -117,6 +153,12 @@ void ConvertAnchorsToRawValues(const std::vector<Anchor>& anchors,
 // Output:
 //  DETECTIONS - Result MediaPipe detections.
 //
+// If the non_max_suppression options are set, non-maximum suppression runs
+// within the calculator and DETECTIONS only holds the retained detections, as
+// NonMaxSuppressionCalculator would output them. Boxes are then decoded only if
+// their score passes the score thresholds, and Detection protos are only
+// created for the retained boxes.
+//
 // Usage example:
 // node {
 //   calculator: "TensorsToDetectionsCalculator"
@@ -163,10 +205,23 @@ class TensorsToDetectionsCalculator : public Node {
   absl::Status DecodeBoxes(const float* raw_boxes,
                            const std::vector<Anchor>& anchors,
                            std::vector<float>* boxes);
+  // Decodes the num_coords_ values of a single box.
+  void DecodeBox(const float* raw_box, const Anchor& anchor, float* box);
+  // Whether a detection with this score may be output.
+  bool PassesScoreThreshold(float score) const;
   absl::Status ConvertToDetections(const float* detection_boxes,
                                    const float* detection_scores,
                                    const int* detection_classes,
                                    std::vector<Detection>* output_detections);
+  // Runs non-maximum suppression on "num_detections" decoded boxes and only
+  // converts the retained ones to detections.
+  absl::Status SuppressAndConvertToDetections(
+      const float* detection_boxes, const float* detection_scores,
+      const int* detection_classes, int num_detections,
+      std::vector<Detection>* output_detections);
+  // Converts a decoded detection with its num_keypoints (x, y) keypoints.
+  Detection ConvertToDetection(const DecodedDetection& decoded_detection,
+                               const float* keypoints) const;
   Detection ConvertToDetection(float box_ymin, float box_xmin, float box_ymax,
                                float box_xmax, float score, int class_id,
                                bool flip_vertically);
@@ -179,6 +234,13 @@ class TensorsToDetectionsCalculator : public Node {
   ::mediapipe::TensorsToDetectionsCalculatorOptions options_;
   std::vector<Anchor> anchors_;
 
+  // Buffers of the decoded boxes when non-maximum suppression runs within the
+  // calculator.
+  std::vector<float> candidate_boxes_;
+  std::vector<float> candidate_scores_;
+  std::vector<int> candidate_classes_;
+  DecodedDetections decoded_detections_;
+
 #ifndef MEDIAPIPE_DISABLE_GL_COMPUTE
   mediapipe::GlCalculatorHelper gpu_helper_;
   GLuint decode_program_;
@@ -296,8 +358,6 @@ absl::Status TensorsToDetectionsCalculator::ProcessCPU(
       }
       anchors_init_ = true;
     }
-    std::vector<float> boxes(num_boxes_ * num_coords_);
-    MP_RETURN_IF_ERROR(DecodeBoxes(raw_boxes, anchors_, &boxes));
 
     std::vector<float> detection_scores(num_boxes_);
     std::vector<int> detection_classes(num_boxes_);
@@ -331,9 +391,33 @@ absl::Status TensorsToDetectionsCalculator::ProcessCPU(
       detection_classes[i] = class_id;
     }
 
-    MP_RETURN_IF_ERROR(
-        ConvertToDetections(boxes.data(), detection_scores.data(),
-                            detection_classes.data(), output_detections));
+    if (options_.has_non_max_suppression()) {
+      // Only decode the boxes which may be output.
+      candidate_boxes_.clear();
+      candidate_scores_.clear();
+      candidate_classes_.clear();
+      for (int i = 0; i < num_boxes_; ++i) {
+        if (!PassesScoreThreshold(detection_scores[i])) {
+          continue;
+        }
+        candidate_boxes_.resize(candidate_boxes_.size() + num_coords_);
+        DecodeBox(raw_boxes + i * num_coords_, anchors_[i],
+                  candidate_boxes_.data() + candidate_boxes_.size() -
+                      num_coords_);
+        candidate_scores_.push_back(detection_scores[i]);
+        candidate_classes_.push_back(detection_classes[i]);
+      }
+      MP_RETURN_IF_ERROR(SuppressAndConvertToDetections(
+          candidate_boxes_.data(), candidate_scores_.data(),
+          candidate_classes_.data(), candidate_scores_.size(),
+          output_detections));
+    } else {
+      std::vector<float> boxes(num_boxes_ * num_coords_);
+      MP_RETURN_IF_ERROR(DecodeBoxes(raw_boxes, anchors_, &boxes));
+      MP_RETURN_IF_ERROR(
+          ConvertToDetections(boxes.data(), detection_scores.data(),
+                              detection_classes.data(), output_detections));
+    }
   } else {
     // Postprocessing on CPU with postprocessing op (e.g. anchor decoding and
     // non-maximum suppression) within the model.
@@ -590,6 +674,13 @@ absl::Status TensorsToDetectionsCalculator::LoadOptions(CalculatorContext* cc) {
     }
   }
 
+  if (options_.has_non_max_suppression()) {
+    RET_CHECK_NE(options_.non_max_suppression().max_num_detections(), 0)
+        << "max_num_detections=0 is not a valid value. Please choose a "
+        << "positive number of you want to limit the number of output "
+        << "detections, or set -1 if you do not want any limit.";
+  }
+
   return absl::OkStatus();
 }
 
@@ -597,69 +688,93 @@ absl::Status TensorsToDetectionsCalculator::DecodeBoxes(
     const float* raw_boxes, const std::vector<Anchor>& anchors,
     std::vector<float>* boxes) {
   for (int i = 0; i < num_boxes_; ++i) {
-    const int box_offset = i * num_coords_ + options_.box_coord_offset();
-
-    float y_center = raw_boxes[box_offset];
-    float x_center = raw_boxes[box_offset + 1];
-    float h = raw_boxes[box_offset + 2];
-    float w = raw_boxes[box_offset + 3];
-    if (options_.reverse_output_order()) {
-      x_center = raw_boxes[box_offset];
-      y_center = raw_boxes[box_offset + 1];
-      w = raw_boxes[box_offset + 2];
-      h = raw_boxes[box_offset + 3];
-    }
+    DecodeBox(raw_boxes + i * num_coords_, anchors[i],
+              boxes->data() + i * num_coords_);
+  }
 
-    x_center =
-        x_center / options_.x_scale() * anchors[i].w() + anchors[i].x_center();
-    y_center =
-        y_center / options_.y_scale() * anchors[i].h() + anchors[i].y_center();
+  return absl::OkStatus();
+}
 
-    if (options_.apply_exponential_on_box_size()) {
-      h = std::exp(h / options_.h_scale()) * anchors[i].h();
-      w = std::exp(w / options_.w_scale()) * anchors[i].w();
-    } else {
-      h = h / options_.h_scale() * anchors[i].h();
-      w = w / options_.w_scale() * anchors[i].w();
-    }
+void TensorsToDetectionsCalculator::DecodeBox(const float* raw_box,
+                                              const Anchor& anchor,
+                                              float* box) {
+  const int box_offset = options_.box_coord_offset();
+
+  float y_center = raw_box[box_offset];
+  float x_center = raw_box[box_offset + 1];
+  float h = raw_box[box_offset + 2];
+  float w = raw_box[box_offset + 3];
+  if (options_.reverse_output_order()) {
+    x_center = raw_box[box_offset];
+    y_center = raw_box[box_offset + 1];
+    w = raw_box[box_offset + 2];
+    h = raw_box[box_offset + 3];
+  }
 
-    const float ymin = y_center - h / 2.f;
-    const float xmin = x_center - w / 2.f;
-    const float ymax = y_center + h / 2.f;
-    const float xmax = x_center + w / 2.f;
-
-    (*boxes)[i * num_coords_ + 0] = ymin;
-    (*boxes)[i * num_coords_ + 1] = xmin;
-    (*boxes)[i * num_coords_ + 2] = ymax;
-    (*boxes)[i * num_coords_ + 3] = xmax;
-
-    if (options_.num_keypoints()) {
-      for (int k = 0; k < options_.num_keypoints(); ++k) {
-        const int offset = i * num_coords_ + options_.keypoint_coord_offset() +
-                           k * options_.num_values_per_keypoint();
-
-        float keypoint_y = raw_boxes[offset];
-        float keypoint_x = raw_boxes[offset + 1];
-        if (options_.reverse_output_order()) {
-          keypoint_x = raw_boxes[offset];
-          keypoint_y = raw_boxes[offset + 1];
-        }
+  x_center = x_center / options_.x_scale() * anchor.w() + anchor.x_center();
+  y_center = y_center / options_.y_scale() * anchor.h() + anchor.y_center();
+
+  if (options_.apply_exponential_on_box_size()) {
+    h = std::exp(h / options_.h_scale()) * anchor.h();
+    w = std::exp(w / options_.w_scale()) * anchor.w();
+  } else {
+    h = h / options_.h_scale() * anchor.h();
+    w = w / options_.w_scale() * anchor.w();
+  }
 
-        (*boxes)[offset] = keypoint_x / options_.x_scale() * anchors[i].w() +
-                           anchors[i].x_center();
-        (*boxes)[offset + 1] =
-            keypoint_y / options_.y_scale() * anchors[i].h() +
-            anchors[i].y_center();
+  const float ymin = y_center - h / 2.f;
+  const float xmin = x_center - w / 2.f;
+  const float ymax = y_center + h / 2.f;
+  const float xmax = x_center + w / 2.f;
+
+  box[0] = ymin;
+  box[1] = xmin;
+  box[2] = ymax;
+  box[3] = xmax;
+
+  if (options_.num_keypoints()) {
+    for (int k = 0; k < options_.num_keypoints(); ++k) {
+      const int offset = options_.keypoint_coord_offset() +
+                         k * options_.num_values_per_keypoint();
+
+      float keypoint_y = raw_box[offset];
+      float keypoint_x = raw_box[offset + 1];
+      if (options_.reverse_output_order()) {
+        keypoint_x = raw_box[offset];
+        keypoint_y = raw_box[offset + 1];
       }
+
+      box[offset] = keypoint_x / options_.x_scale() * anchor.w() +
+                    anchor.x_center();
+      box[offset + 1] = keypoint_y / options_.y_scale() * anchor.h() +
+                        anchor.y_center();
     }
   }
+}
 
-  return absl::OkStatus();
+bool TensorsToDetectionsCalculator::PassesScoreThreshold(float score) const {
+  if (options_.has_min_score_thresh() && score < options_.min_score_thresh()) {
+    return false;
+  }
+  // Weighted non-maximum suppression averages the boxes below
+  // min_score_threshold into the retained ones, so they are only skipped by
+  // the default algorithm.
+  const auto& nms_options = options_.non_max_suppression();
+  return !options_.has_non_max_suppression() ||
+         nms_options.algorithm() ==
+             NonMaxSuppressionCalculatorOptions::WEIGHTED ||
+         nms_options.min_score_threshold() <= 0 ||
+         score >= nms_options.min_score_threshold();
 }
 
 absl::Status TensorsToDetectionsCalculator::ConvertToDetections(
     const float* detection_boxes, const float* detection_scores,
     const int* detection_classes, std::vector<Detection>* output_detections) {
+  if (options_.has_non_max_suppression()) {
+    return SuppressAndConvertToDetections(detection_boxes, detection_scores,
+                                          detection_classes, num_boxes_,
+                                          output_detections);
+  }
   for (int i = 0; i < num_boxes_; ++i) {
     if (options_.has_min_score_thresh() &&
         detection_scores[i] < options_.min_score_thresh()) {
@@ -698,6 +813,120 @@ absl::Status TensorsToDetectionsCalculator::ConvertToDetections(
   return absl::OkStatus();
 }
 
+absl::Status TensorsToDetectionsCalculator::SuppressAndConvertToDetections(
+    const float* detection_boxes, const float* detection_scores,
+    const int* detection_classes, int num_detections,
+    std::vector<Detection>* output_detections) {
+  const bool flip_vertically = options_.flip_vertically();
+  const int num_keypoints = options_.num_keypoints();
+  DecodedDetections& decoded = decoded_detections_;
+  decoded.Clear();
+  for (int i = 0; i < num_detections; ++i) {
+    if (!PassesScoreThreshold(detection_scores[i])) {
+      continue;
+    }
+    const float* box = detection_boxes + i * num_coords_;
+    DecodedDetection detection;
+    detection.xmin = box[1];
+    detection.ymin = flip_vertically ? 1.f - box[2] : box[0];
+    detection.width = box[3] - box[1];
+    detection.height = box[2] - box[0];
+    detection.score = detection_scores[i];
+    detection.class_id = detection_classes[i];
+    // Filter out the boxes that ConvertToDetections() filters out.
+    if (detection.width < 0 || detection.height < 0 ||
+        std::isnan(detection.width) || std::isnan(detection.height)) {
+      continue;
+    }
+    for (int k = 0; k < num_keypoints; ++k) {
+      const float* keypoint = box + options_.keypoint_coord_offset() +
+                              k * options_.num_values_per_keypoint();
+      decoded.keypoints.push_back(keypoint[0]);
+      decoded.keypoints.push_back(flip_vertically ? 1.f - keypoint[1]
+                                                  : keypoint[1]);
+    }
+    decoded.detections.push_back(detection);
+    decoded.boxes.emplace_back(detection.xmin, detection.ymin, detection.width,
+                               detection.height);
+    decoded.scores.push_back(detection.score);
+  }
+
+  const auto& nms_options = options_.non_max_suppression();
+  if (nms_options.algorithm() != NonMaxSuppressionCalculatorOptions::WEIGHTED) {
+    for (int index : NonMaxSuppressionIndices(nms_options, decoded.boxes,
+                                              decoded.scores)) {
+      output_detections->push_back(ConvertToDetection(
+          decoded.detections[index],
+          decoded.keypoints.data() + index * num_keypoints * 2));
+    }
+    return absl::OkStatus();
+  }
+
+  std::vector<float> keypoints(num_keypoints * 2);
+  for (const WeightedNmsCluster& cluster : WeightedNonMaxSuppressionClusters(
+           nms_options, decoded.boxes, decoded.scores)) {
+    DecodedDetection detection = decoded.detections[cluster.head];
+    std::copy_n(decoded.keypoints.data() + cluster.head * num_keypoints * 2,
+                num_keypoints * 2, keypoints.begin());
+    if (!cluster.members.empty()) {
+      float w_xmin = 0.0f;
+      float w_ymin = 0.0f;
+      float w_xmax = 0.0f;
+      float w_ymax = 0.0f;
+      float total_score = 0.0f;
+      std::fill(keypoints.begin(), keypoints.end(), 0.0f);
+      for (const int member : cluster.members) {
+        const DecodedDetection& member_detection = decoded.detections[member];
+        const float score = member_detection.score;
+        total_score += score;
+        w_xmin += member_detection.xmin * score;
+        w_ymin += member_detection.ymin * score;
+        w_xmax += (member_detection.xmin + member_detection.width) * score;
+        w_ymax += (member_detection.ymin + member_detection.height) * score;
+        const float* member_keypoints =
+            decoded.keypoints.data() + member * num_keypoints * 2;
+        for (int i = 0; i < num_keypoints * 2; ++i) {
+          keypoints[i] += member_keypoints[i] * score;
+        }
+      }
+      detection.xmin = w_xmin / total_score;
+      detection.ymin = w_ymin / total_score;
+      detection.width = (w_xmax / total_score) - detection.xmin;
+      detection.height = (w_ymax / total_score) - detection.ymin;
+      for (float& keypoint : keypoints) {
+        keypoint /= total_score;
+      }
+    }
+    output_detections->push_back(
+        ConvertToDetection(detection, keypoints.data()));
+  }
+  return absl::OkStatus();
+}
+
+Detection TensorsToDetectionsCalculator::ConvertToDetection(
+    const DecodedDetection& decoded_detection, const float* keypoints) const {
+  Detection detection;
+  detection.add_score(decoded_detection.score);
+  detection.add_label_id(decoded_detection.class_id);
+
+  LocationData* location_data = detection.mutable_location_data();
+  location_data->set_format(LocationData::RELATIVE_BOUNDING_BOX);
+
+  LocationData::RelativeBoundingBox* relative_bbox =
+      location_data->mutable_relative_bounding_box();
+  relative_bbox->set_xmin(decoded_detection.xmin);
+  relative_bbox->set_ymin(decoded_detection.ymin);
+  relative_bbox->set_width(decoded_detection.width);
+  relative_bbox->set_height(decoded_detection.height);
+
+  for (int k = 0; k < options_.num_keypoints(); ++k) {
+    auto* keypoint = location_data->add_relative_keypoints();
+    keypoint->set_x(keypoints[k * 2]);
+    keypoint->set_y(keypoints[k * 2 + 1]);
+  }
+  return detection;
+}
+
 Detection TensorsToDetectionsCalculator::ConvertToDetection(
     float box_ymin, float box_xmin, float box_ymax, float box_xmax, float score,
     int class_id, bool flip_vertically) {
@@ -0,0 +1,329 @@
+// Copyright 2022 The MediaPipe Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Compares the non-maximum suppression within TensorsToDetectionsCalculator
+// with a NonMaxSuppressionCalculator following it, and measures both. To run
+// the benchmarks:
+// $ bazel run -c opt \
+//   mediapipe/calculators/tensor:tensors_to_detections_calculator_test -- \
+//   --benchmark_filter=all
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "absl/strings/str_cat.h"
+#include "absl/strings/substitute.h"
+#include "mediapipe/calculators/tensor/tensors_to_detections_calculator.pb.h"
+#include "mediapipe/calculators/util/non_max_suppression_calculator.pb.h"
+#include "mediapipe/framework/calculator.pb.h"
+#include "mediapipe/framework/calculator_framework.h"
+#include "mediapipe/framework/calculator_runner.h"
+#include "mediapipe/framework/formats/detection.pb.h"
+#include "mediapipe/framework/formats/object_detection/anchor.pb.h"
+#include "mediapipe/framework/formats/tensor.h"
+#include "mediapipe/framework/port/benchmark.h"
+#include "mediapipe/framework/port/gmock.h"
+#include "mediapipe/framework/port/gtest.h"
+#include "mediapipe/framework/port/integral_types.h"
+#include "mediapipe/framework/port/parse_text_proto.h"
+#include "mediapipe/framework/port/status_matchers.h"
+
+namespace mediapipe {
+namespace {
+
+using Node = ::mediapipe::CalculatorGraphConfig::Node;
+
+constexpr int kNumKeypoints = 6;
+constexpr int kNumCoords = 4 + kNumKeypoints * 2;
+constexpr float kScale = 128.0f;
+
+// Returns anchors on a 16x16 grid, two per cell, like the anchors of the face
+// detection model.
+std::vector<Anchor> MakeAnchors(int num_boxes) {
+  std::vector<Anchor> anchors(num_boxes);
+  for (int i = 0; i < num_boxes; ++i) {
+    const int cell = (i / 2) % 256;
+    anchors[i].set_x_center((cell % 16 + 0.5f) / 16.0f);
+    anchors[i].set_y_center((cell / 16 + 0.5f) / 16.0f);
+    anchors[i].set_w(1.0f);
+    anchors[i].set_h(1.0f);
+  }
+  return anchors;
+}
+
+// Returns the box and score tensors of a model predicting a few objects, each
+// of them by the anchors around it.
+std::vector<Tensor> MakeTensors(const std::vector<Anchor>& anchors,
+                                std::mt19937* rng) {
+  const int num_boxes = anchors.size();
+  std::uniform_real_distribution<float> uniform(0.0f, 1.0f);
+  std::vector<std::vector<float>> objects(5);
+  for (auto& object : objects) {
+    const float size = 0.1f + 0.2f * uniform(*rng);
+    object = {uniform(*rng), uniform(*rng), size, size * (0.8f + uniform(*rng))};
+  }
+  std::vector<Tensor> tensors;
+  tensors.emplace_back(Tensor::ElementType::kFloat32,
+                       Tensor::Shape{1, num_boxes, kNumCoords});
+  tensors.emplace_back(Tensor::ElementType::kFloat32,
+                       Tensor::Shape{1, num_boxes, 1});
+  auto boxes_view = tensors[0].GetCpuWriteView();
+  float* raw_boxes = boxes_view.buffer<float>();
+  auto scores_view = tensors[1].GetCpuWriteView();
+  float* raw_scores = scores_view.buffer<float>();
+  for (int i = 0; i < num_boxes; ++i) {
+    const Anchor& anchor = anchors[i];
+    const std::vector<float>* nearest = &objects[0];
+    float nearest_distance = 1e9f;
+    for (const auto& object : objects) {
+      const float distance = std::hypot(object[0] - anchor.x_center(),
+                                        object[1] - anchor.y_center());
+      if (distance < nearest_distance) {
+        nearest_distance = distance;
+        nearest = &object;
+      }
+    }
+    // Raw values are offsets from the anchor scaled by kScale, in
+    // (y_center, x_center, h, w) order.
+    const auto noise = [&]() { return 0.01f * (uniform(*rng) - 0.5f); };
+    float* raw_box = raw_boxes + i * kNumCoords;
+    raw_box[0] = ((*nearest)[1] - anchor.y_center() + noise()) * kScale;
+    raw_box[1] = ((*nearest)[0] - anchor.x_center() + noise()) * kScale;
+    raw_box[2] = ((*nearest)[3] + noise()) * kScale;
+    raw_box[3] = ((*nearest)[2] + noise()) * kScale;
+    // A few degenerate boxes, which are never output.
+    if ((*rng)() % 100 == 0) raw_box[2] = -raw_box[2];
+    for (int k = 0; k < kNumKeypoints; ++k) {
+      raw_box[4 + k * 2] = raw_box[0] + noise() * kScale;
+      raw_box[4 + k * 2 + 1] = raw_box[1] + noise() * kScale;
+    }
+    // Logits decreasing with the distance to the object, quantized so that
+    // some scores are equal.
+    raw_scores[i] =
+        std::round(4.0f - 60.0f * nearest_distance + 2.0f * uniform(*rng));
+  }
+  return tensors;
+}
+
+// Returns the options of TensorsToDetectionsCalculator for "num_boxes" boxes,
+// without non-maximum suppression.
+TensorsToDetectionsCalculatorOptions MakeOptions(int num_boxes,
+                                                 bool flip_vertically) {
+  return ParseTextProtoOrDie<TensorsToDetectionsCalculatorOptions>(
+      absl::Substitute(R"pb(
+                         num_classes: 1
+                         num_boxes: $0
+                         num_coords: $1
+                         box_coord_offset: 0
+                         keypoint_coord_offset: 4
+                         num_keypoints: $2
+                         num_values_per_keypoint: 2
+                         sigmoid_score: true
+                         score_clipping_thresh: 100.0
+                         x_scale: $3
+                         y_scale: $3
+                         h_scale: $3
+                         w_scale: $3
+                         min_score_thresh: 0.5
+                         flip_vertically: $4
+                       )pb",
+                       num_boxes, kNumCoords, kNumKeypoints, kScale,
+                       flip_vertically ? "true" : "false"));
+}
+
+Node MakeNode(const std::string& calculator, const std::string& input_stream,
+              const std::string& output_stream) {
+  Node node;
+  node.set_calculator(calculator);
+  node.add_input_stream(input_stream);
+  node.add_output_stream(output_stream);
+  return node;
+}
+
+// Runs a single TensorsToDetectionsCalculator and returns its output.
+std::vector<Detection> RunTensorsToDetections(
+    const TensorsToDetectionsCalculatorOptions& options,
+    const std::vector<Anchor>& anchors, std::vector<Tensor> tensors) {
+  Node node = MakeNode("TensorsToDetectionsCalculator", "TENSORS:tensors",
+                       "DETECTIONS:detections");
+  node.add_input_side_packet("ANCHORS:anchors");
+  *node.mutable_options()->MutableExtension(
+      TensorsToDetectionsCalculatorOptions::ext) = options;
+  CalculatorRunner runner(node);
+  runner.MutableSidePackets()->Tag("ANCHORS") = MakePacket<std::vector<Anchor>>(
+      anchors);
+  runner.MutableInputs()->Tag("TENSORS").packets.push_back(
+      MakePacket<std::vector<Tensor>>(std::move(tensors)).At(Timestamp(0)));
+  MP_EXPECT_OK(runner.Run());
+  const auto& packets = runner.Outputs().Tag("DETECTIONS").packets;
+  EXPECT_EQ(packets.size(), 1);
+  return packets.empty() ? std::vector<Detection>()
+                         : packets[0].Get<std::vector<Detection>>();
+}
+
+// Runs a NonMaxSuppressionCalculator on "detections" and returns its output.
+std::vector<Detection> RunNonMaxSuppression(
+    const NonMaxSuppressionCalculatorOptions& options,
+    const std::vector<Detection>& detections) {
+  Node node =
+      MakeNode("NonMaxSuppressionCalculator", "detections", "nms_detections");
+  *node.mutable_options()->MutableExtension(
+      NonMaxSuppressionCalculatorOptions::ext) = options;
+  CalculatorRunner runner(node);
+  runner.MutableInputs()->Index(0).packets.push_back(
+      MakePacket<std::vector<Detection>>(detections).At(Timestamp(0)));
+  MP_EXPECT_OK(runner.Run());
+  const auto& packets = runner.Outputs().Index(0).packets;
+  return packets.empty() ? std::vector<Detection>()
+                         : packets[0].Get<std::vector<Detection>>();
+}
+
+TEST(TensorsToDetectionsCalculatorTest, NonMaxSuppressionMatchesCalculator) {
+  constexpr int kNumBoxes = 896;
+  const std::vector<Anchor> anchors = MakeAnchors(kNumBoxes);
+  std::mt19937 rng(42);
+  for (int trial = 0; trial < 10; ++trial) {
+    for (const bool flip_vertically : {false, true}) {
+      for (const auto algorithm : {NonMaxSuppressionCalculatorOptions::DEFAULT,
+                                   NonMaxSuppressionCalculatorOptions::WEIGHTED}) {
+        for (const float min_score_threshold : {-1.0f, 0.8f}) {
+          SCOPED_TRACE(absl::StrCat(
+              "trial: ", trial, " flip_vertically: ", flip_vertically,
+              " algorithm: ", algorithm,
+              " min_score_threshold: ", min_score_threshold));
+          NonMaxSuppressionCalculatorOptions nms_options;
+          nms_options.set_algorithm(algorithm);
+          nms_options.set_min_suppression_threshold(0.3f);
+          nms_options.set_overlap_type(
+              NonMaxSuppressionCalculatorOptions::INTERSECTION_OVER_UNION);
+          nms_options.set_min_score_threshold(min_score_threshold);
+          nms_options.set_return_empty_detections(true);
+          TensorsToDetectionsCalculatorOptions options =
+              MakeOptions(kNumBoxes, flip_vertically);
+          const std::vector<Tensor> tensors = MakeTensors(anchors, &rng);
+          const auto copy_tensors = [&tensors]() {
+            std::vector<Tensor> copy;
+            for (const Tensor& tensor : tensors) {
+              copy.emplace_back(tensor.element_type(), tensor.shape());
+              auto read_view = tensor.GetCpuReadView();
+              auto write_view = copy.back().GetCpuWriteView();
+              std::copy_n(read_view.buffer<float>(),
+                          tensor.shape().num_elements(),
+                          write_view.buffer<float>());
+            }
+            return copy;
+          };
+          const std::vector<Detection> expected = RunNonMaxSuppression(
+              nms_options,
+              RunTensorsToDetections(options, anchors, copy_tensors()));
+          *options.mutable_non_max_suppression() = nms_options;
+          const std::vector<Detection> detections =
+              RunTensorsToDetections(options, anchors, copy_tensors());
+          ASSERT_FALSE(expected.empty());
+          ASSERT_EQ(detections.size(), expected.size());
+          for (size_t i = 0; i < detections.size(); ++i) {
+            EXPECT_THAT(detections[i], EqualsProto(expected[i]));
+          }
+        }
+      }
+    }
+  }
+}
+
+TEST(TensorsToDetectionsCalculatorTest, NonMaxSuppressionLimitsDetections) {
+  constexpr int kNumBoxes = 896;
+  const std::vector<Anchor> anchors = MakeAnchors(kNumBoxes);
+  std::mt19937 rng(42);
+  TensorsToDetectionsCalculatorOptions options =
+      MakeOptions(kNumBoxes, /*flip_vertically=*/false);
+  options.mutable_non_max_suppression()->set_max_num_detections(1);
+  options.mutable_non_max_suppression()->set_min_suppression_threshold(0.3f);
+  const std::vector<Detection> detections =
+      RunTensorsToDetections(options, anchors, MakeTensors(anchors, &rng));
+  ASSERT_EQ(detections.size(), 1);
+  EXPECT_GE(detections[0].score(0), 0.5f);
+}
+
+// Decodes state.range(1) boxes and suppresses the overlapping ones.
+// state.range(0) selects non-maximum suppression within
+// TensorsToDetectionsCalculator (1) or in a NonMaxSuppressionCalculator (0).
+// The calculators run on the graph threads, so the real time is measured.
+void BM_TensorsToDetections(benchmark::State& state) {
+  const bool fused = state.range(0);
+  const int num_boxes = state.range(1);
+  const std::vector<Anchor> anchors = MakeAnchors(num_boxes);
+  std::mt19937 rng(42);
+  std::vector<Tensor> tensors = MakeTensors(anchors, &rng);
+
+  TensorsToDetectionsCalculatorOptions options =
+      MakeOptions(num_boxes, /*flip_vertically=*/false);
+  NonMaxSuppressionCalculatorOptions nms_options;
+  nms_options.set_algorithm(NonMaxSuppressionCalculatorOptions::WEIGHTED);
+  nms_options.set_min_suppression_threshold(0.3f);
+  nms_options.set_overlap_type(
+      NonMaxSuppressionCalculatorOptions::INTERSECTION_OVER_UNION);
+  if (fused) {
+    *options.mutable_non_max_suppression() = nms_options;
+  }
+  CalculatorGraphConfig config;
+  config.add_input_stream("tensors");
+  config.add_input_side_packet("anchors");
+  Node* node = config.add_node();
+  *node = MakeNode("TensorsToDetectionsCalculator", "TENSORS:tensors",
+                   "DETECTIONS:detections");
+  node->add_input_side_packet("ANCHORS:anchors");
+  *node->mutable_options()->MutableExtension(
+      TensorsToDetectionsCalculatorOptions::ext) = options;
+  std::string output_stream = "detections";
+  if (!fused) {
+    node = config.add_node();
+    *node =
+        MakeNode("NonMaxSuppressionCalculator", "detections", "nms_detections");
+    *node->mutable_options()->MutableExtension(
+        NonMaxSuppressionCalculatorOptions::ext) = nms_options;
+    output_stream = "nms_detections";
+  }
+
+  CalculatorGraph graph;
+  MP_ASSERT_OK(graph.Initialize(config));
+  int num_detections = 0;
+  MP_ASSERT_OK(graph.ObserveOutputStream(
+      output_stream, [&num_detections](const Packet& packet) {
+        num_detections += packet.Get<std::vector<Detection>>().size();
+        return absl::OkStatus();
+      }));
+  MP_ASSERT_OK(graph.StartRun(
+      {{"anchors", MakePacket<std::vector<Anchor>>(anchors)}}));
+  const Packet tensors_packet =
+      MakePacket<std::vector<Tensor>>(std::move(tensors));
+  int64 timestamp = 0;
+  for (auto _ : state) {
+    MP_ASSERT_OK(graph.AddPacketToInputStream(
+        "tensors", tensors_packet.At(Timestamp(timestamp++))));
+    MP_ASSERT_OK(graph.WaitUntilIdle());
+  }
+  MP_ASSERT_OK(graph.CloseAllInputStreams());
+  MP_ASSERT_OK(graph.WaitUntilDone());
+  benchmark::DoNotOptimize(num_detections);
+  state.SetItemsProcessed(state.iterations() * num_boxes);
+}
+BENCHMARK(BM_TensorsToDetections)
+    ->ArgsProduct({{0, 1}, {896, 2944}})
+    ->UseRealTime();
+
+}  // namespace
+}  // namespace mediapipe
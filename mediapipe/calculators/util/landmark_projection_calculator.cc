@@ -114,6 +114,7 @@ class LandmarkProjectionCalculator : public CalculatorBase {
          id != cc->Outputs().EndId(kLandmarksTag); ++id) {
       cc->Outputs().Get(id).Set<NormalizedLandmarkList>();
     }
+    cc->SetStateless(true);
 
     return absl::OkStatus();
   }
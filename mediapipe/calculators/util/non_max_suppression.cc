@@ -0,0 +1,382 @@
+// Copyright 2022 The MediaPipe Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "mediapipe/calculators/util/non_max_suppression.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+#include "mediapipe/framework/port/integral_types.h"
+#include "mediapipe/framework/port/logging.h"
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__aarch64__)
+#include <arm_neon.h>
+#endif
+
+namespace mediapipe {
+
+namespace {
+
+// Number of boxes tested for intersection at once.
+constexpr int kBlockSize = 8;
+// Maximum number of grid cells along each axis.
+constexpr int kMaxGridSize = 16;
+// Minimum number of boxes sorted at once when max_num_detections limits the
+// output.
+constexpr std::size_t kMinSortChunk = 32;
+
+// A box index and its score, sorted by decreasing score, then by increasing
+// index, so that the order does not depend on the sorting algorithm.
+struct ScoredIndex {
+  bool operator<(const ScoredIndex& other) const {
+    return score > other.score || (score == other.score && index < other.index);
+  }
+  float score;
+  int index;
+};
+
+// Returns whether "box" is separated from the box [xmin, xmax] x [ymin, ymax]
+// along x or y. Uses the comparisons of Rectangle::Intersects, so that it is
+// false for all boxes intersecting "box" (and for NaN coordinates).
+inline bool IsSeparated(float xmin, float ymin, float xmax, float ymax,
+                        const Rectangle_f& box) {
+  return xmax < box.xmin() || box.xmax() < xmin || ymax < box.ymin() ||
+         box.ymax() < ymin;
+}
+
+// Returns a mask with bit i set if box i of the block, 0 <= i < kBlockSize,
+// may intersect "box", i.e. is not separated from it. The block holds the
+// kBlockSize values of xmin, then of ymin, xmax and ymax.
+inline uint32 BlockMayIntersect(const float* block, const Rectangle_f& box) {
+  const float* xmin = block;
+  const float* ymin = block + kBlockSize;
+  const float* xmax = block + 2 * kBlockSize;
+  const float* ymax = block + 3 * kBlockSize;
+#if defined(__AVX2__)
+  const __m256 separated_x = _mm256_or_ps(
+      _mm256_cmp_ps(_mm256_loadu_ps(xmax), _mm256_set1_ps(box.xmin()),
+                    _CMP_LT_OQ),
+      _mm256_cmp_ps(_mm256_set1_ps(box.xmax()), _mm256_loadu_ps(xmin),
+                    _CMP_LT_OQ));
+  const __m256 separated_y = _mm256_or_ps(
+      _mm256_cmp_ps(_mm256_loadu_ps(ymax), _mm256_set1_ps(box.ymin()),
+                    _CMP_LT_OQ),
+      _mm256_cmp_ps(_mm256_set1_ps(box.ymax()), _mm256_loadu_ps(ymin),
+                    _CMP_LT_OQ));
+  return ~_mm256_movemask_ps(_mm256_or_ps(separated_x, separated_y)) & 0xff;
+#elif defined(__aarch64__)
+  static const uint32 kLaneBits[4] = {1, 2, 4, 8};
+  const uint32x4_t lane_bits = vld1q_u32(kLaneBits);
+  uint32 mask = 0;
+  for (int i = 0; i < kBlockSize; i += 4) {
+    const uint32x4_t separated = vorrq_u32(
+        vorrq_u32(vcltq_f32(vld1q_f32(xmax + i), vdupq_n_f32(box.xmin())),
+                  vcltq_f32(vdupq_n_f32(box.xmax()), vld1q_f32(xmin + i))),
+        vorrq_u32(vcltq_f32(vld1q_f32(ymax + i), vdupq_n_f32(box.ymin())),
+                  vcltq_f32(vdupq_n_f32(box.ymax()), vld1q_f32(ymin + i))));
+    mask |= vaddvq_u32(vbicq_u32(lane_bits, separated)) << i;
+  }
+  return mask;
+#else
+  uint32 mask = 0;
+  for (int i = 0; i < kBlockSize; ++i) {
+    mask |= static_cast<uint32>(
+                !IsSeparated(xmin[i], ymin[i], xmax[i], ymax[i], box))
+            << i;
+  }
+  return mask;
+#endif  // defined(__AVX2__)
+}
+
+// Returns the number of grid cells along an axis for boxes spanning "extent"
+// with an average size of "mean_size": cells about as large as the boxes, so
+// that each box overlaps few cells, and at most "max_size" cells.
+int GridSize(float extent, float mean_size, int max_size) {
+  const float size = extent / mean_size;
+  // Also handles NaN.
+  if (!(size >= 2.0f)) return 1;
+  return std::min(static_cast<float>(max_size), size);
+}
+
+// Uniform grid over a set of boxes. Each cell holds the inserted boxes that
+// overlap it, in blocks of kBlockSize boxes in structure-of-arrays layout, so
+// that the boxes that may intersect a query box are found by testing only the
+// cells it overlaps, a block at a time.
+class BoxGrid {
+ public:
+  // Covers the given "candidates" of "boxes", which are the only boxes that
+  // may be inserted or queried. If "exhaustive", every inserted box is
+  // reported by ForEachMayIntersect(), intersecting or not.
+  BoxGrid(const std::vector<Rectangle_f>& boxes,
+          const std::vector<ScoredIndex>& candidates, bool exhaustive)
+      : boxes_(boxes), exhaustive_(exhaustive), last_query_(boxes.size(), -1) {
+    float xmin = 0.0f, ymin = 0.0f, xmax = 0.0f, ymax = 0.0f;
+    double total_width = 0.0, total_height = 0.0;
+    bool finite = true;
+    for (int i = 0; i < candidates.size(); ++i) {
+      const Rectangle_f& box = boxes[candidates[i].index];
+      finite = finite && std::isfinite(box.xmin()) &&
+               std::isfinite(box.ymin()) && std::isfinite(box.xmax()) &&
+               std::isfinite(box.ymax());
+      xmin = i == 0 ? box.xmin() : std::min(xmin, box.xmin());
+      ymin = i == 0 ? box.ymin() : std::min(ymin, box.ymin());
+      xmax = i == 0 ? box.xmax() : std::max(xmax, box.xmax());
+      ymax = i == 0 ? box.ymax() : std::max(ymax, box.ymax());
+      total_width += std::max(0.0f, box.Width());
+      total_height += std::max(0.0f, box.Height());
+    }
+    // The cells are only used if all the coordinates are finite, so that the
+    // mapping to cells is monotonic.
+    if (!exhaustive && finite && !candidates.empty()) {
+      const int max_size = std::min(
+          kMaxGridSize, static_cast<int>(std::sqrt(candidates.size() / 4.0)));
+      grid_width_ =
+          GridSize(xmax - xmin, total_width / candidates.size(), max_size);
+      grid_height_ =
+          GridSize(ymax - ymin, total_height / candidates.size(), max_size);
+      origin_x_ = xmin;
+      origin_y_ = ymin;
+      scale_x_ = grid_width_ / (xmax - xmin);
+      scale_y_ = grid_height_ / (ymax - ymin);
+      // The extent may overflow.
+      if (!(scale_x_ > 0.0f && std::isfinite(scale_x_))) grid_width_ = 1;
+      if (!(scale_y_ > 0.0f && std::isfinite(scale_y_))) grid_height_ = 1;
+    }
+    cells_.resize(grid_width_ * grid_height_);
+  }
+
+  void Insert(int index) {
+    const Rectangle_f& box = boxes_[index];
+    for (int y = CellY(box.ymin()); y <= CellY(box.ymax()); ++y) {
+      for (int x = CellX(box.xmin()); x <= CellX(box.xmax()); ++x) {
+        Cell& cell = cells_[y * grid_width_ + x];
+        const int lane = cell.index.size() % kBlockSize;
+        if (lane == 0) {
+          cell.blocks.resize(cell.blocks.size() + 4 * kBlockSize);
+        }
+        float* block = &cell.blocks[cell.blocks.size() - 4 * kBlockSize];
+        block[lane] = box.xmin();
+        block[kBlockSize + lane] = box.ymin();
+        block[2 * kBlockSize + lane] = box.xmax();
+        block[3 * kBlockSize + lane] = box.ymax();
+        cell.index.push_back(index);
+      }
+    }
+  }
+
+  // Calls fn(index) once for each inserted box that may intersect "box",
+  // which includes all the inserted boxes that intersect it, until fn returns
+  // true. Returns whether it did.
+  template <typename Fn>
+  bool ForEachMayIntersect(const Rectangle_f& box, Fn fn) {
+    ++query_;
+    for (int y = CellY(box.ymin()); y <= CellY(box.ymax()); ++y) {
+      for (int x = CellX(box.xmin()); x <= CellX(box.xmax()); ++x) {
+        const Cell& cell = cells_[y * grid_width_ + x];
+        const int size = cell.index.size();
+        for (int begin = 0; begin < size; begin += kBlockSize) {
+          const int count = std::min(kBlockSize, size - begin);
+          uint32 mask = (1u << count) - 1;
+          if (!exhaustive_) {
+            mask &= BlockMayIntersect(&cell.blocks[begin * 4], box);
+          }
+          for (int i = 0; mask != 0; ++i, mask >>= 1) {
+            if (!(mask & 1)) continue;
+            const int index = cell.index[begin + i];
+            // A box overlapping several cells of the query is visited once.
+            if (last_query_[index] == query_) continue;
+            last_query_[index] = query_;
+            if (fn(index)) return true;
+          }
+        }
+      }
+    }
+    return false;
+  }
+
+ private:
+  struct Cell {
+    // Blocks of kBlockSize boxes, see BlockMayIntersect().
+    std::vector<float> blocks;
+    std::vector<int> index;
+  };
+
+  // Returns the cell containing coordinate x (or y). The mapping is monotonic,
+  // so boxes that intersect share a cell.
+  int CellX(float x) const {
+    return Cell1D(x, origin_x_, scale_x_, grid_width_);
+  }
+  int CellY(float y) const {
+    return Cell1D(y, origin_y_, scale_y_, grid_height_);
+  }
+  static int Cell1D(float value, float origin, float scale, int grid_size) {
+    if (grid_size == 1) return 0;
+    return std::min(grid_size - 1,
+                    std::max(0, static_cast<int>((value - origin) * scale)));
+  }
+
+  const std::vector<Rectangle_f>& boxes_;
+  const bool exhaustive_;
+  int grid_width_ = 1;
+  int grid_height_ = 1;
+  float origin_x_ = 0.0f;
+  float origin_y_ = 0.0f;
+  float scale_x_ = 0.0f;
+  float scale_y_ = 0.0f;
+  std::vector<Cell> cells_;
+  // For each box, the last query that visited it.
+  std::vector<int> last_query_;
+  int query_ = 0;
+};
+
+// Non-intersecting boxes have a similarity of 0, so they only need to be
+// compared if 0 suppresses.
+bool ZeroSimilaritySuppresses(
+    const NonMaxSuppressionCalculatorOptions& options) {
+  return 0.0f > options.min_suppression_threshold();
+}
+
+}  // namespace
+
+float OverlapSimilarity(
+    const NonMaxSuppressionCalculatorOptions::OverlapType overlap_type,
+    const Rectangle_f& rect1, const Rectangle_f& rect2) {
+  if (!rect1.Intersects(rect2)) return 0.0f;
+  const float intersection_area = Rectangle_f(rect1).Intersect(rect2).Area();
+  float normalization;
+  switch (overlap_type) {
+    case NonMaxSuppressionCalculatorOptions::JACCARD:
+      normalization = Rectangle_f(rect1).Union(rect2).Area();
+      break;
+    case NonMaxSuppressionCalculatorOptions::MODIFIED_JACCARD:
+      normalization = rect2.Area();
+      break;
+    case NonMaxSuppressionCalculatorOptions::INTERSECTION_OVER_UNION:
+      normalization = rect1.Area() + rect2.Area() - intersection_area;
+      break;
+    default:
+      LOG(FATAL) << "Unrecognized overlap type: " << overlap_type;
+  }
+  return normalization > 0.0f ? intersection_area / normalization : 0.0f;
+}
+
+std::vector<int> NonMaxSuppressionIndices(
+    const NonMaxSuppressionCalculatorOptions& options,
+    const std::vector<Rectangle_f>& boxes, const std::vector<float>& scores) {
+  // Boxes below min_score_threshold would come last and end the search.
+  const bool has_min_score = options.min_score_threshold() > 0;
+  std::vector<ScoredIndex> order;
+  order.reserve(scores.size());
+  for (int i = 0; i < scores.size(); ++i) {
+    if (has_min_score && scores[i] < options.min_score_threshold()) continue;
+    order.push_back({scores[i], i});
+  }
+  const std::size_t max_num_detections =
+      options.max_num_detections() > -1 ? options.max_num_detections()
+                                        : scores.size();
+
+  std::vector<int> retained;
+  retained.reserve(std::min(max_num_detections, order.size()));
+  BoxGrid grid(boxes, order,
+               /*exhaustive=*/ZeroSimilaritySuppresses(options));
+  std::size_t sorted_end = 0;
+  std::size_t sort_chunk = std::max(2 * max_num_detections, kMinSortChunk);
+  for (std::size_t i = 0;
+       i < order.size() && retained.size() < max_num_detections; ++i) {
+    if (i == sorted_end) {
+      // Sorts the next boxes only when they are needed.
+      sorted_end = std::min(order.size(), sorted_end + sort_chunk);
+      if (sorted_end == order.size()) {
+        std::sort(order.begin() + i, order.end());
+      } else {
+        std::partial_sort(order.begin() + i, order.begin() + sorted_end,
+                          order.end());
+      }
+      sort_chunk *= 2;
+    }
+    const int index = order[i].index;
+    const Rectangle_f& box = boxes[index];
+    const bool suppressed =
+        grid.ForEachMayIntersect(box, [&](int retained_index) {
+          return OverlapSimilarity(options.overlap_type(),
+                                   boxes[retained_index],
+                                   box) > options.min_suppression_threshold();
+        });
+    if (!suppressed) {
+      retained.push_back(index);
+      grid.Insert(index);
+    }
+  }
+  return retained;
+}
+
+std::vector<WeightedNmsCluster> WeightedNonMaxSuppressionClusters(
+    const NonMaxSuppressionCalculatorOptions& options,
+    const std::vector<Rectangle_f>& boxes, const std::vector<float>& scores) {
+  std::vector<ScoredIndex> order;
+  order.reserve(scores.size());
+  for (int i = 0; i < scores.size(); ++i) {
+    order.push_back({scores[i], i});
+  }
+  std::sort(order.begin(), order.end());
+  std::vector<int> rank(order.size());
+  for (int i = 0; i < order.size(); ++i) {
+    rank[order[i].index] = i;
+  }
+
+  BoxGrid grid(boxes, order,
+               /*exhaustive=*/ZeroSimilaritySuppresses(options));
+  for (const ScoredIndex& scored_index : order) {
+    grid.Insert(scored_index.index);
+  }
+  std::vector<bool> removed(order.size(), false);
+  std::vector<WeightedNmsCluster> clusters;
+  for (int next = 0; next < order.size();) {
+    const int head = order[next].index;
+    if (options.min_score_threshold() > 0 &&
+        scores[head] < options.min_score_threshold()) {
+      break;
+    }
+    WeightedNmsCluster cluster;
+    cluster.head = head;
+    grid.ForEachMayIntersect(boxes[head], [&](int index) {
+      if (!removed[index] &&
+          OverlapSimilarity(options.overlap_type(), boxes[index],
+                            boxes[head]) >
+              options.min_suppression_threshold()) {
+        cluster.members.push_back(index);
+      }
+      return false;
+    });
+    std::sort(cluster.members.begin(), cluster.members.end(),
+              [&rank](int index_0, int index_1) {
+                return rank[index_0] < rank[index_1];
+              });
+    for (int index : cluster.members) {
+      removed[index] = true;
+    }
+    const bool last = cluster.members.empty();
+    clusters.push_back(std::move(cluster));
+    if (last) break;
+    while (next < order.size() && removed[order[next].index]) ++next;
+  }
+  return clusters;
+}
+
+}  // namespace mediapipe
@@ -0,0 +1,71 @@
+// Copyright 2022 The MediaPipe Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef MEDIAPIPE_CALCULATORS_UTIL_NON_MAX_SUPPRESSION_H_
+#define MEDIAPIPE_CALCULATORS_UTIL_NON_MAX_SUPPRESSION_H_
+
+#include <vector>
+
+#include "mediapipe/calculators/util/non_max_suppression_calculator.pb.h"
+#include "mediapipe/framework/port/rectangle.h"
+
+namespace mediapipe {
+
+// Computes an overlap similarity between two rectangles. Similarity measure is
+// defined by overlap_type parameter.
+float OverlapSimilarity(
+    NonMaxSuppressionCalculatorOptions::OverlapType overlap_type,
+    const Rectangle_f& rect1, const Rectangle_f& rect2);
+
+// Runs non-maximum suppression on boxes[i] with score scores[i], following
+// max_num_detections, min_score_threshold, min_suppression_threshold and
+// overlap_type of "options". Boxes are visited by decreasing score (ties by
+// increasing index) and a box is retained unless a retained box overlaps it
+// by more than min_suppression_threshold. Boxes scoring below
+// min_score_threshold are never read.
+//
+// Returns the indices of the retained boxes, by decreasing score.
+//
+// Only the highest scoring boxes are sorted when max_num_detections limits the
+// output, and the retained boxes are kept in a uniform grid, so that a box is
+// only compared with the retained boxes around it. Blocks of boxes are
+// tested for intersection with AVX2 or NEON (AArch64) when the target supports
+// them. The result is the same as comparing each box with all retained boxes.
+std::vector<int> NonMaxSuppressionIndices(
+    const NonMaxSuppressionCalculatorOptions& options,
+    const std::vector<Rectangle_f>& boxes, const std::vector<float>& scores);
+
+// A box retained by weighted non-maximum suppression and the boxes to average
+// into it.
+struct WeightedNmsCluster {
+  // Index of the highest scoring box of the cluster.
+  int head = 0;
+  // Indices of the remaining boxes, including "head", that overlap "head" by
+  // more than min_suppression_threshold, by decreasing score. If empty, "head"
+  // is output as is and is the last cluster.
+  std::vector<int> members;
+};
+
+// Runs weighted non-maximum suppression on boxes[i] with score scores[i],
+// following min_score_threshold, min_suppression_threshold and overlap_type of
+// "options": the highest scoring remaining box and all remaining boxes
+// overlapping it form a cluster, until no box remains. Boxes are ordered as in
+// NonMaxSuppressionIndices() and found through the same grid.
+std::vector<WeightedNmsCluster> WeightedNonMaxSuppressionClusters(
+    const NonMaxSuppressionCalculatorOptions& options,
+    const std::vector<Rectangle_f>& boxes, const std::vector<float>& scores);
+
+}  // namespace mediapipe
+
+#endif  // MEDIAPIPE_CALCULATORS_UTIL_NON_MAX_SUPPRESSION_H_
@@ -0,0 +1,256 @@
+// Copyright 2022 The MediaPipe Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Compares the non-maximum suppression functions with a straightforward
+// implementation comparing all pairs of boxes, and measures both. To run the
+// benchmarks with the AVX2 kernels:
+// $ bazel run -c opt --copt=-mavx2 \
+//   mediapipe/calculators/util:non_max_suppression_test -- \
+//   --benchmark_filter=all
+
+#include "mediapipe/calculators/util/non_max_suppression.h"
+
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+#include <random>
+#include <utility>
+#include <vector>
+
+#include "absl/strings/str_cat.h"
+#include "mediapipe/calculators/util/non_max_suppression_calculator.pb.h"
+#include "mediapipe/framework/port/benchmark.h"
+#include "mediapipe/framework/port/gmock.h"
+#include "mediapipe/framework/port/gtest.h"
+#include "mediapipe/framework/port/rectangle.h"
+
+namespace mediapipe {
+namespace {
+
+using ::testing::ElementsAre;
+
+// Returns the box indices by decreasing score, then by increasing index.
+std::vector<int> SortByScore(const std::vector<float>& scores) {
+  std::vector<int> order(scores.size());
+  std::iota(order.begin(), order.end(), 0);
+  std::sort(order.begin(), order.end(), [&scores](int i, int j) {
+    return scores[i] > scores[j] || (scores[i] == scores[j] && i < j);
+  });
+  return order;
+}
+
+// Compares each box with all retained boxes.
+std::vector<int> ReferenceNonMaxSuppression(
+    const NonMaxSuppressionCalculatorOptions& options,
+    const std::vector<Rectangle_f>& boxes, const std::vector<float>& scores) {
+  const int max_num_detections = options.max_num_detections() > -1
+                                     ? options.max_num_detections()
+                                     : static_cast<int>(scores.size());
+  std::vector<int> retained;
+  for (int index : SortByScore(scores)) {
+    if (options.min_score_threshold() > 0 &&
+        scores[index] < options.min_score_threshold()) {
+      break;
+    }
+    bool suppressed = false;
+    for (int retained_index : retained) {
+      if (OverlapSimilarity(options.overlap_type(), boxes[retained_index],
+                            boxes[index]) >
+          options.min_suppression_threshold()) {
+        suppressed = true;
+        break;
+      }
+    }
+    if (!suppressed) {
+      retained.push_back(index);
+    }
+    if (retained.size() >= max_num_detections) {
+      break;
+    }
+  }
+  return retained;
+}
+
+// Compares the highest scoring remaining box with all remaining boxes.
+std::vector<WeightedNmsCluster> ReferenceWeightedNonMaxSuppression(
+    const NonMaxSuppressionCalculatorOptions& options,
+    const std::vector<Rectangle_f>& boxes, const std::vector<float>& scores) {
+  std::vector<WeightedNmsCluster> clusters;
+  std::vector<int> remained_indices = SortByScore(scores);
+  while (!remained_indices.empty()) {
+    const int head = remained_indices[0];
+    if (options.min_score_threshold() > 0 &&
+        scores[head] < options.min_score_threshold()) {
+      break;
+    }
+    WeightedNmsCluster cluster;
+    cluster.head = head;
+    std::vector<int> remained;
+    for (int index : remained_indices) {
+      if (OverlapSimilarity(options.overlap_type(), boxes[index],
+                            boxes[head]) >
+          options.min_suppression_threshold()) {
+        cluster.members.push_back(index);
+      } else {
+        remained.push_back(index);
+      }
+    }
+    const bool last = cluster.members.empty();
+    clusters.push_back(std::move(cluster));
+    if (last) break;
+    remained_indices = std::move(remained);
+  }
+  return clusters;
+}
+
+// Returns "num_boxes" boxes around a few centers, like the detections decoded
+// from dense anchors, with some degenerate boxes and boxes partly outside of
+// [0, 1]. Scores are quantized so that some of them are equal.
+void MakeRandomBoxes(int num_boxes, std::mt19937* rng,
+                     std::vector<Rectangle_f>* boxes,
+                     std::vector<float>* scores) {
+  std::uniform_real_distribution<float> uniform(0.0f, 1.0f);
+  std::vector<std::pair<float, float>> centers(1 + num_boxes / 20);
+  for (auto& center : centers) {
+    center = {uniform(*rng), uniform(*rng)};
+  }
+  boxes->clear();
+  scores->clear();
+  for (int i = 0; i < num_boxes; ++i) {
+    const auto& center = centers[(*rng)() % centers.size()];
+    const float size = 0.02f + 0.3f * uniform(*rng);
+    const float x = center.first + 0.1f * (uniform(*rng) - 0.5f) - size / 2;
+    const float y = center.second + 0.1f * (uniform(*rng) - 0.5f) - size / 2;
+    float width = size * (0.5f + uniform(*rng));
+    float height = size * (0.5f + uniform(*rng));
+    if ((*rng)() % 50 == 0) width = 0.0f;
+    if ((*rng)() % 50 == 0) height = -height;
+    boxes->push_back(Rectangle_f(x, y, width, height));
+    scores->push_back(std::round(uniform(*rng) * 100.0f) / 100.0f);
+  }
+}
+
+NonMaxSuppressionCalculatorOptions MakeOptions(
+    NonMaxSuppressionCalculatorOptions::OverlapType overlap_type,
+    float min_suppression_threshold, int max_num_detections,
+    float min_score_threshold) {
+  NonMaxSuppressionCalculatorOptions options;
+  options.set_overlap_type(overlap_type);
+  options.set_min_suppression_threshold(min_suppression_threshold);
+  options.set_max_num_detections(max_num_detections);
+  options.set_min_score_threshold(min_score_threshold);
+  return options;
+}
+
+TEST(NonMaxSuppressionTest, MatchesReferenceOnRandomBoxes) {
+  std::mt19937 rng(42);
+  std::vector<Rectangle_f> boxes;
+  std::vector<float> scores;
+  for (int trial = 0; trial < 100; ++trial) {
+    MakeRandomBoxes(1 + rng() % 600, &rng, &boxes, &scores);
+    for (const auto overlap_type :
+         {NonMaxSuppressionCalculatorOptions::JACCARD,
+          NonMaxSuppressionCalculatorOptions::MODIFIED_JACCARD,
+          NonMaxSuppressionCalculatorOptions::INTERSECTION_OVER_UNION}) {
+      for (const float min_suppression_threshold : {-0.1f, 0.0f, 0.3f, 0.7f}) {
+        for (const int max_num_detections : {-1, 1, 10}) {
+          for (const float min_score_threshold : {-1.0f, 0.5f}) {
+            SCOPED_TRACE(absl::StrCat(
+                "trial: ", trial, " num_boxes: ", boxes.size(),
+                " overlap_type: ", overlap_type,
+                " min_suppression_threshold: ", min_suppression_threshold,
+                " max_num_detections: ", max_num_detections,
+                " min_score_threshold: ", min_score_threshold));
+            const NonMaxSuppressionCalculatorOptions options =
+                MakeOptions(overlap_type, min_suppression_threshold,
+                            max_num_detections, min_score_threshold);
+            ASSERT_EQ(NonMaxSuppressionIndices(options, boxes, scores),
+                      ReferenceNonMaxSuppression(options, boxes, scores));
+            // Weighted NMS ignores max_num_detections.
+            if (max_num_detections != -1) continue;
+            const std::vector<WeightedNmsCluster> clusters =
+                WeightedNonMaxSuppressionClusters(options, boxes, scores);
+            const std::vector<WeightedNmsCluster> reference_clusters =
+                ReferenceWeightedNonMaxSuppression(options, boxes, scores);
+            ASSERT_EQ(clusters.size(), reference_clusters.size());
+            for (int i = 0; i < clusters.size(); ++i) {
+              ASSERT_EQ(clusters[i].head, reference_clusters[i].head);
+              ASSERT_EQ(clusters[i].members, reference_clusters[i].members);
+            }
+          }
+        }
+      }
+    }
+  }
+}
+
+TEST(NonMaxSuppressionTest, BreaksTiesByIndex) {
+  const std::vector<Rectangle_f> boxes = {
+      Rectangle_f(0.0f, 0.0f, 0.5f, 0.5f), Rectangle_f(0.6f, 0.6f, 0.2f, 0.2f),
+      Rectangle_f(0.0f, 0.0f, 0.5f, 0.5f), Rectangle_f(0.6f, 0.6f, 0.2f, 0.2f)};
+  const std::vector<float> scores = {0.5f, 0.5f, 0.5f, 0.9f};
+  const NonMaxSuppressionCalculatorOptions options = MakeOptions(
+      NonMaxSuppressionCalculatorOptions::JACCARD, 0.3f, -1, -1.0f);
+  EXPECT_THAT(NonMaxSuppressionIndices(options, boxes, scores),
+              ElementsAre(3, 0));
+  const std::vector<WeightedNmsCluster> clusters =
+      WeightedNonMaxSuppressionClusters(options, boxes, scores);
+  ASSERT_EQ(clusters.size(), 2);
+  EXPECT_EQ(clusters[0].head, 3);
+  EXPECT_THAT(clusters[0].members, ElementsAre(3, 1));
+  EXPECT_EQ(clusters[1].head, 0);
+  EXPECT_THAT(clusters[1].members, ElementsAre(0, 2));
+}
+
+// Runs non-maximum suppression on state.range(1) boxes. state.range(0) selects
+// the functions under test (1) or the reference implementation (0).
+void BM_NonMaxSuppression(benchmark::State& state) {
+  std::mt19937 rng(42);
+  std::vector<Rectangle_f> boxes;
+  std::vector<float> scores;
+  MakeRandomBoxes(state.range(1), &rng, &boxes, &scores);
+  const NonMaxSuppressionCalculatorOptions options = MakeOptions(
+      NonMaxSuppressionCalculatorOptions::INTERSECTION_OVER_UNION, 0.3f, -1,
+      -1.0f);
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(
+        state.range(0) ? NonMaxSuppressionIndices(options, boxes, scores)
+                       : ReferenceNonMaxSuppression(options, boxes, scores));
+  }
+  state.SetItemsProcessed(state.iterations() * boxes.size());
+}
+BENCHMARK(BM_NonMaxSuppression)->ArgsProduct({{0, 1}, {100, 1000, 5000}});
+
+// Same as above with weighted non-maximum suppression.
+void BM_WeightedNonMaxSuppression(benchmark::State& state) {
+  std::mt19937 rng(42);
+  std::vector<Rectangle_f> boxes;
+  std::vector<float> scores;
+  MakeRandomBoxes(state.range(1), &rng, &boxes, &scores);
+  const NonMaxSuppressionCalculatorOptions options = MakeOptions(
+      NonMaxSuppressionCalculatorOptions::INTERSECTION_OVER_UNION, 0.3f, -1,
+      -1.0f);
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(
+        state.range(0)
+            ? WeightedNonMaxSuppressionClusters(options, boxes, scores)
+            : ReferenceWeightedNonMaxSuppression(options, boxes, scores));
+  }
+  state.SetItemsProcessed(state.iterations() * boxes.size());
+}
+BENCHMARK(BM_WeightedNonMaxSuppression)
+    ->ArgsProduct({{0, 1}, {100, 1000, 5000}});
+
+}  // namespace
+}  // namespace mediapipe
@@ -0,0 +1,138 @@
+// Copyright 2022 The MediaPipe Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <memory>
+#include <string>
+
+#include "absl/memory/memory.h"
+#include "mediapipe/framework/calculator_framework.h"
+#include "mediapipe/framework/formats/image_frame.h"
+#include "mediapipe/framework/formats/video_stream_header.h"
+#include "mediapipe/framework/formats/yuv_image.h"
+#include "mediapipe/framework/port/ret_check.h"
+#include "mediapipe/framework/port/status.h"
+#include "mediapipe/framework/tool/options_util.h"
+#include "mediapipe/util/video_decoder.h"
+#include "mediapipe/util/video_decoder.pb.h"
+
+namespace mediapipe {
+
+namespace {
+
+constexpr char kInputFilePathTag[] = "INPUT_FILE_PATH";
+constexpr char kOptionsTag[] = "OPTIONS";
+constexpr char kVideoPrestreamTag[] = "VIDEO_PRESTREAM";
+constexpr char kVideoTag[] = "VIDEO";
+
+}  // namespace
+
+// Decodes a video stream of a media file with FFmpeg. Unlike
+// OpenCvVideoDecoderCalculator, it decodes with several threads, outputs
+// either YUV frames without copying them or RGB frames converted into pooled
+// buffers, and can decode a time range of the file.
+//
+// Output Streams:
+//   VIDEO: Output video frames (ImageFrame, or YUVImage if output_format is
+//       YUV_I420).
+//   VIDEO_PRESTREAM:
+//       Optional video header information output at
+//       Timestamp::PreStream() for the corresponding stream.
+// Input Side Packets:
+//   INPUT_FILE_PATH: The input file path.
+//   OPTIONS: Optional VideoDecoderOptions overriding the node options, for
+//       example to decode a different time range per run. The output_format
+//       must match the node options.
+//
+// Example config:
+// node {
+//   calculator: "FFmpegVideoDecoderCalculator"
+//   input_side_packet: "INPUT_FILE_PATH:input_file_path"
+//   output_stream: "VIDEO:video_frames"
+//   output_stream: "VIDEO_PRESTREAM:video_header"
+//   options {
+//     [mediapipe.VideoDecoderOptions.ext] {
+//       output_format: YUV_I420
+//       start_time: 10
+//       end_time: 20
+//     }
+//   }
+// }
+class FFmpegVideoDecoderCalculator : public CalculatorBase {
+ public:
+  static absl::Status GetContract(CalculatorContract* cc);
+
+  absl::Status Open(CalculatorContext* cc) override;
+  absl::Status Process(CalculatorContext* cc) override;
+  absl::Status Close(CalculatorContext* cc) override;
+
+ private:
+  std::unique_ptr<VideoDecoder> decoder_;
+};
+
+absl::Status FFmpegVideoDecoderCalculator::GetContract(
+    CalculatorContract* cc) {
+  cc->InputSidePackets().Tag(kInputFilePathTag).Set<std::string>();
+  if (cc->InputSidePackets().HasTag(kOptionsTag)) {
+    cc->InputSidePackets().Tag(kOptionsTag).Set<VideoDecoderOptions>();
+  }
+  if (cc->Options<VideoDecoderOptions>().output_format() ==
+      VideoDecoderOptions::YUV_I420) {
+    cc->Outputs().Tag(kVideoTag).Set<YUVImage>();
+  } else {
+    cc->Outputs().Tag(kVideoTag).Set<ImageFrame>();
+  }
+  if (cc->Outputs().HasTag(kVideoPrestreamTag)) {
+    cc->Outputs().Tag(kVideoPrestreamTag).Set<VideoHeader>();
+  }
+  return absl::OkStatus();
+}
+
+absl::Status FFmpegVideoDecoderCalculator::Open(CalculatorContext* cc) {
+  const std::string& input_file_path =
+      cc->InputSidePackets().Tag(kInputFilePathTag).Get<std::string>();
+  const auto& decoder_options = tool::RetrieveOptions(
+      cc->Options<VideoDecoderOptions>(), cc->InputSidePackets(), kOptionsTag);
+  RET_CHECK_EQ(decoder_options.output_format(),
+               cc->Options<VideoDecoderOptions>().output_format())
+      << "The OPTIONS side packet cannot change the output_format.";
+  decoder_ = absl::make_unique<VideoDecoder>();
+  MP_RETURN_IF_ERROR(decoder_->Initialize(input_file_path, decoder_options));
+
+  if (cc->Outputs().HasTag(kVideoPrestreamTag)) {
+    auto header = absl::make_unique<VideoHeader>();
+    MP_RETURN_IF_ERROR(decoder_->FillVideoHeader(header.get()));
+    cc->Outputs()
+        .Tag(kVideoPrestreamTag)
+        .Add(header.release(), Timestamp::PreStream());
+    cc->Outputs().Tag(kVideoPrestreamTag).Close();
+  }
+  return absl::OkStatus();
+}
+
+absl::Status FFmpegVideoDecoderCalculator::Process(CalculatorContext* cc) {
+  Packet data;
+  auto status = decoder_->GetData(&data);
+  if (status.ok()) {
+    cc->Outputs().Tag(kVideoTag).AddPacket(data);
+  }
+  return status;
+}
+
+absl::Status FFmpegVideoDecoderCalculator::Close(CalculatorContext* cc) {
+  return decoder_ ? decoder_->Close() : absl::OkStatus();
+}
+
+REGISTER_CALCULATOR(FFmpegVideoDecoderCalculator);
+
+}  // namespace mediapipe
@@ -0,0 +1,187 @@
+// Copyright 2022 The MediaPipe Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <string>
+
+#include "absl/memory/memory.h"
+#include "absl/strings/substitute.h"
+#include "mediapipe/framework/calculator_runner.h"
+#include "mediapipe/framework/deps/file_path.h"
+#include "mediapipe/framework/formats/image_frame.h"
+#include "mediapipe/framework/formats/image_frame_opencv.h"
+#include "mediapipe/framework/formats/video_stream_header.h"
+#include "mediapipe/framework/formats/yuv_image.h"
+#include "mediapipe/framework/port/benchmark.h"
+#include "mediapipe/framework/port/gmock.h"
+#include "mediapipe/framework/port/gtest.h"
+#include "mediapipe/framework/port/opencv_core_inc.h"
+#include "mediapipe/framework/port/parse_text_proto.h"
+#include "mediapipe/framework/port/status_matchers.h"
+#include "mediapipe/util/video_decoder.pb.h"
+
+namespace mediapipe {
+
+namespace {
+
+constexpr char kVideoTag[] = "VIDEO";
+constexpr char kVideoPrestreamTag[] = "VIDEO_PRESTREAM";
+constexpr char kInputFilePathTag[] = "INPUT_FILE_PATH";
+
+std::string TestVideoPath() {
+  return file::JoinPath("./",
+                        "/mediapipe/calculators/video/"
+                        "testdata/format_MP4_AVC720P_AAC.video");
+}
+
+// Returns a runner of "calculator" decoding the test video.
+std::unique_ptr<CalculatorRunner> CreateRunner(const std::string& calculator,
+                                               const std::string& options) {
+  auto runner = absl::make_unique<CalculatorRunner>(
+      ParseTextProtoOrDie<CalculatorGraphConfig::Node>(absl::Substitute(
+          R"pb(
+            calculator: "$0"
+            input_side_packet: "INPUT_FILE_PATH:input_file_path"
+            output_stream: "VIDEO:video"
+            output_stream: "VIDEO_PRESTREAM:video_prestream"
+            $1
+          )pb",
+          calculator, options)));
+  runner->MutableSidePackets()->Tag(kInputFilePathTag) =
+      MakePacket<std::string>(TestVideoPath());
+  return runner;
+}
+
+std::string DecoderOptions(const std::string& options) {
+  return absl::Substitute(
+      "options { [mediapipe.VideoDecoderOptions.ext] { $0 } }", options);
+}
+
+TEST(FFmpegVideoDecoderCalculatorTest, DecodesRgbFrames) {
+  auto runner = CreateRunner("FFmpegVideoDecoderCalculator", "");
+  MP_ASSERT_OK(runner->Run());
+
+  const auto& header_packets =
+      runner->Outputs().Tag(kVideoPrestreamTag).packets;
+  ASSERT_EQ(header_packets.size(), 1);
+  const VideoHeader& header = header_packets[0].Get<VideoHeader>();
+  EXPECT_EQ(ImageFormat::SRGB, header.format);
+  EXPECT_EQ(1280, header.width);
+  EXPECT_EQ(640, header.height);
+  EXPECT_FLOAT_EQ(30.0f, header.frame_rate);
+  EXPECT_NEAR(6.0f, header.duration, 0.1f);
+
+  const auto& packets = runner->Outputs().Tag(kVideoTag).packets;
+  EXPECT_EQ(packets.size(), 180);
+  for (int i = 0; i < packets.size(); ++i) {
+    if (i > 0) {
+      EXPECT_LT(packets[i - 1].Timestamp(), packets[i].Timestamp());
+    }
+    const ImageFrame& frame = packets[i].Get<ImageFrame>();
+    EXPECT_EQ(ImageFormat::SRGB, frame.Format());
+    cv::Mat output_mat = formats::MatView(&frame);
+    EXPECT_EQ(1280, output_mat.size().width);
+    EXPECT_EQ(640, output_mat.size().height);
+    cv::Scalar s = cv::mean(output_mat);
+    for (int c = 0; c < 3; ++c) {
+      EXPECT_GT(s[c], 0);
+      EXPECT_LT(s[c], 255);
+    }
+  }
+}
+
+TEST(FFmpegVideoDecoderCalculatorTest, DecodesYuvFrames) {
+  auto runner = CreateRunner("FFmpegVideoDecoderCalculator",
+                             DecoderOptions("output_format: YUV_I420"));
+  MP_ASSERT_OK(runner->Run());
+
+  const VideoHeader& header = runner->Outputs()
+                                  .Tag(kVideoPrestreamTag)
+                                  .packets[0]
+                                  .Get<VideoHeader>();
+  EXPECT_EQ(ImageFormat::YCBCR420P, header.format);
+
+  const auto& packets = runner->Outputs().Tag(kVideoTag).packets;
+  EXPECT_EQ(packets.size(), 180);
+  for (const Packet& packet : packets) {
+    const YUVImage& image = packet.Get<YUVImage>();
+    EXPECT_EQ(libyuv::FOURCC_I420, image.fourcc());
+    EXPECT_EQ(1280, image.width());
+    EXPECT_EQ(640, image.height());
+    EXPECT_GE(image.stride(0), 1280);
+    EXPECT_GE(image.stride(1), 640);
+  }
+}
+
+// Decoding a time range seeks to the keyframe before the start time, and
+// outputs only the frames within the range.
+TEST(FFmpegVideoDecoderCalculatorTest, DecodesTimeRange) {
+  auto runner = CreateRunner(
+      "FFmpegVideoDecoderCalculator",
+      DecoderOptions("start_time: 2 end_time: 3 num_threads: 2"));
+  MP_ASSERT_OK(runner->Run());
+
+  const auto& packets = runner->Outputs().Tag(kVideoTag).packets;
+  ASSERT_GE(packets.size(), 29);
+  EXPECT_LE(packets.size(), 31);
+  for (const Packet& packet : packets) {
+    EXPECT_GE(packet.Timestamp(), Timestamp::FromSeconds(2));
+    EXPECT_LE(packet.Timestamp(), Timestamp::FromSeconds(3));
+  }
+}
+
+TEST(FFmpegVideoDecoderCalculatorTest, TimeRangeFromSidePacket) {
+  auto runner = CreateRunner("FFmpegVideoDecoderCalculator",
+                             R"pb(input_side_packet: "OPTIONS:options")pb");
+  VideoDecoderOptions options;
+  options.set_end_time(1);
+  runner->MutableSidePackets()->Tag("OPTIONS") =
+      MakePacket<VideoDecoderOptions>(options);
+  MP_ASSERT_OK(runner->Run());
+
+  const auto& packets = runner->Outputs().Tag(kVideoTag).packets;
+  ASSERT_FALSE(packets.empty());
+  EXPECT_LE(packets.back().Timestamp(), Timestamp::FromSeconds(1));
+}
+
+// Decodes the test video with OpenCvVideoDecoderCalculator (0), or with
+// FFmpegVideoDecoderCalculator outputting RGB (1) or YUV (2) frames.
+void BM_DecodeVideo(benchmark::State& state) {
+  std::string calculator = "FFmpegVideoDecoderCalculator";
+  std::string options;
+  switch (state.range(0)) {
+    case 0:
+      calculator = "OpenCvVideoDecoderCalculator";
+      break;
+    case 2:
+      options = DecoderOptions("output_format: YUV_I420");
+      break;
+  }
+  int64 num_frames = 0;
+  for (auto _ : state) {
+    auto runner = CreateRunner(calculator, options);
+    CHECK(runner->Run().ok());
+    num_frames += runner->Outputs().Tag(kVideoTag).packets.size();
+  }
+  // Reported as frames per second.
+  state.SetItemsProcessed(num_frames);
+}
+BENCHMARK(BM_DecodeVideo)
+    ->Arg(0)
+    ->Arg(1)
+    ->Arg(2)
+    ->Unit(benchmark::kMillisecond);
+
+}  // namespace
+
+}  // namespace mediapipe
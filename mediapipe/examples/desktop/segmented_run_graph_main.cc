@@ -0,0 +1,124 @@
+// Copyright 2022 The MediaPipe Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// A main function to process a video file with a MediaPipe graph split into
+// segments running in parallel, see SegmentedVideoRunner. With
+// --compare_serial, the file is also processed by a single graph and the
+// speedup is reported.
+#include <cstdlib>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "absl/flags/flag.h"
+#include "absl/flags/parse.h"
+#include "absl/strings/str_split.h"
+#include "absl/time/clock.h"
+#include "absl/time/time.h"
+#include "mediapipe/framework/calculator_framework.h"
+#include "mediapipe/framework/port/file_helpers.h"
+#include "mediapipe/framework/port/parse_text_proto.h"
+#include "mediapipe/framework/port/ret_check.h"
+#include "mediapipe/framework/port/status.h"
+#include "mediapipe/util/cpu_util.h"
+#include "mediapipe/util/segmented_video_runner.h"
+
+ABSL_FLAG(std::string, calculator_graph_config_file, "",
+          "Name of file containing text format CalculatorGraphConfig proto.");
+ABSL_FLAG(std::string, input_video_path, "", "Full path of video to load.");
+ABSL_FLAG(std::string, output_streams, "",
+          "Comma-separated list of the output streams to stitch.");
+ABSL_FLAG(int, num_segments, 0,
+          "The number of segments. 0 uses one segment per CPU core.");
+ABSL_FLAG(int, max_parallel_graphs, 0,
+          "The maximum number of graphs running at the same time. 0 runs "
+          "the graphs of all the segments at once.");
+ABSL_FLAG(int, max_queued_packets, 100,
+          "The maximum number of packets queued per output stream by each "
+          "graph waiting to be stitched. -1 leaves the queues unbounded.");
+ABSL_FLAG(int, overlap_ms, 0,
+          "The time decoded before each segment to warm up the calculators "
+          "whose outputs depend on earlier frames.");
+ABSL_FLAG(bool, compare_serial, false,
+          "If true, also processes the video with a single graph and reports "
+          "the speedup of the segmented run.");
+
+// Processes the video in "num_segments" segments, and returns the wall time.
+absl::StatusOr<absl::Duration> RunSegments(
+    const mediapipe::CalculatorGraphConfig& config, int num_segments) {
+  mediapipe::SegmentedVideoRunnerOptions options;
+  options.num_segments = num_segments;
+  options.max_parallel_graphs = absl::GetFlag(FLAGS_max_parallel_graphs);
+  options.max_queued_packets = absl::GetFlag(FLAGS_max_queued_packets);
+  options.overlap = absl::Milliseconds(absl::GetFlag(FLAGS_overlap_ms));
+  options.output_streams =
+      absl::StrSplit(absl::GetFlag(FLAGS_output_streams), ',',
+                     absl::SkipEmpty());
+  mediapipe::SegmentedVideoRunner runner(options);
+
+  std::vector<int> num_packets(options.output_streams.size());
+  const absl::Time start_time = absl::Now();
+  MP_RETURN_IF_ERROR(runner.Run(
+      config, absl::GetFlag(FLAGS_input_video_path), {},
+      [&num_packets](int stream_index, const mediapipe::Packet& packet) {
+        ++num_packets[stream_index];
+        return absl::OkStatus();
+      }));
+  const absl::Duration wall_time = absl::Now() - start_time;
+  for (int i = 0; i < options.output_streams.size(); ++i) {
+    LOG(INFO) << "Stream " << options.output_streams[i] << ": "
+              << num_packets[i] << " packets.";
+  }
+  LOG(INFO) << "Processed " << num_segments << " segments in "
+            << absl::FormatDuration(wall_time) << ".";
+  return wall_time;
+}
+
+absl::Status RunMPPGraph() {
+  std::string calculator_graph_config_contents;
+  MP_RETURN_IF_ERROR(mediapipe::file::GetContents(
+      absl::GetFlag(FLAGS_calculator_graph_config_file),
+      &calculator_graph_config_contents));
+  mediapipe::CalculatorGraphConfig config =
+      mediapipe::ParseTextProtoOrDie<mediapipe::CalculatorGraphConfig>(
+          calculator_graph_config_contents);
+  RET_CHECK(!absl::GetFlag(FLAGS_input_video_path).empty())
+      << "--input_video_path must be specified.";
+
+  const int num_segments = absl::GetFlag(FLAGS_num_segments) > 0
+                               ? absl::GetFlag(FLAGS_num_segments)
+                               : mediapipe::NumCPUCores();
+  ASSIGN_OR_RETURN(absl::Duration segmented_time,
+                   RunSegments(config, num_segments));
+  if (absl::GetFlag(FLAGS_compare_serial)) {
+    ASSIGN_OR_RETURN(absl::Duration serial_time, RunSegments(config, 1));
+    LOG(INFO) << "Speedup with " << num_segments << " segments on "
+              << mediapipe::NumCPUCores()
+              << " cores: " << serial_time / segmented_time << "x.";
+  }
+  return absl::OkStatus();
+}
+
+int main(int argc, char** argv) {
+  google::InitGoogleLogging(argv[0]);
+  absl::ParseCommandLine(argc, argv);
+  absl::Status run_status = RunMPPGraph();
+  if (!run_status.ok()) {
+    LOG(ERROR) << "Failed to run the graph: " << run_status.message();
+    return EXIT_FAILURE;
+  } else {
+    LOG(INFO) << "Success!";
+  }
+  return EXIT_SUCCESS;
+}
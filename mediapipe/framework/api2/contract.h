@@ -58,6 +58,18 @@ class TimestampChange {
   int64_t offset_;
 };
 
+// Declares that the node's Process() can run for several timestamps at once.
+// See CalculatorContract::SetStateless.
+class Stateless {
+ public:
+  constexpr Stateless() {}
+
+  absl::Status AddToContract(CalculatorContract* cc) const {
+    cc->SetStateless(true);
+    return {};
+  }
+};
+
 namespace internal {
 
 template <class Base>
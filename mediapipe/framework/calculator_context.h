@@ -16,7 +16,7 @@
 #define MEDIAPIPE_FRAMEWORK_CALCULATOR_CONTEXT_H_
 
 #include <memory>
-#include <queue>
+#include <deque>
 #include <string>
 #include <utility>
 
@@ -85,6 +85,24 @@ class CalculatorContext {
                                      : input_timestamps_.front();
   }
 
+  // Returns the number of input timestamps handled by the current Process()
+  // call. It is one unless the calculator processes batches of input sets,
+  // see CalculatorContract::SetProcessBatches(). The input set at position i
+  // of a batch is read with:
+  //
+  //   for (int i = 0; i < cc->BatchSize(); ++i) {
+  //     const Timestamp timestamp = cc->BatchTimestamp(i);
+  //     const Packet& packet = cc->Inputs().Tag("AUDIO").BatchValue(i);
+  //     ...
+  //   }
+  int BatchSize() const { return batch_size_; }
+
+  // Returns the input timestamp at position "index" of the current batch.
+  // BatchTimestamp(0) is InputTimestamp().
+  Timestamp BatchTimestamp(int index) const {
+    return input_timestamps_[index];
+  }
+
   // Returns a reference to the input side packet set.
   const PacketSet& InputSidePackets() const;
   // Returns a reference to the output side packet collection.
@@ -127,16 +145,18 @@ class CalculatorContext {
 
   // Adds a new input timestamp by the friend class CalculatorContextManager.
   void PushInputTimestamp(Timestamp input_timestamp) {
-    input_timestamps_.push(input_timestamp);
+    input_timestamps_.push_back(input_timestamp);
   }
 
   void PopInputTimestamp() {
     CHECK(!input_timestamps_.empty());
-    input_timestamps_.pop();
+    input_timestamps_.pop_front();
   }
 
   void SetGraphStatus(const absl::Status& status) { graph_status_ = status; }
 
+  void SetBatchSize(int batch_size) { batch_size_ = batch_size; }
+
   // Interface for the friend class Calculator.
   const InputStreamSet& InputStreams() const;
   const OutputStreamSet& OutputStreams() const;
@@ -153,7 +173,9 @@ class CalculatorContext {
   mutable std::unique_ptr<InputStreamSet> input_streams_;
   mutable std::unique_ptr<OutputStreamSet> output_streams_;
   // The queue of timestamp values to Process() in this calculator context.
-  std::queue<Timestamp> input_timestamps_;
+  std::deque<Timestamp> input_timestamps_;
+  // The number of input timestamps handled by the current Process() call.
+  int batch_size_ = 1;
 
   // The status of the graph run. Only used when Close() is called.
   absl::Status graph_status_;
@@ -107,4 +107,12 @@ bool CalculatorContextManager::HasActiveContexts() {
   return !active_contexts_.empty();
 }
 
+int CalculatorContextManager::NumActiveContexts() {
+  if (!calculator_run_in_parallel_) {
+    return 0;
+  }
+  absl::MutexLock lock(&contexts_mutex_);
+  return active_contexts_.size();
+}
+
 }  // namespace mediapipe
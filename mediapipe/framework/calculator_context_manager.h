@@ -85,6 +85,9 @@ class CalculatorContextManager {
   // Returns true if active_contexts_ is non-empty.
   bool HasActiveContexts() ABSL_LOCKS_EXCLUDED(contexts_mutex_);
 
+  // Returns the number of contexts in active_contexts_.
+  int NumActiveContexts() ABSL_LOCKS_EXCLUDED(contexts_mutex_);
+
   int NumberOfContextTimestamps(
       const CalculatorContext& calculator_context) const {
     return calculator_context.NumberOfTimestamps();
@@ -112,6 +115,12 @@ class CalculatorContextManager {
     calculator_context->SetGraphStatus(status);
   }
 
+  void SetBatchSizeInContext(CalculatorContext* calculator_context,
+                             int batch_size) {
+    CHECK(calculator_context);
+    calculator_context->SetBatchSize(batch_size);
+  }
+
  private:
   CalculatorState* calculator_state_;
   std::shared_ptr<tool::TagMap> input_tag_map_;
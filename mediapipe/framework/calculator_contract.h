@@ -124,6 +124,15 @@ class CalculatorContract {
   }
   bool GetProcessTimestampBounds() const { return process_timestamps_; }
 
+  // When true, a batching input stream handler such as
+  // BatchingInputStreamHandler passes all the input sets of a batch to a
+  // single Process() call, see CalculatorContext::BatchSize(). Otherwise,
+  // Process() is called once for each input set of the batch.
+  void SetProcessBatches(bool process_batches) {
+    process_batches_ = process_batches;
+  }
+  bool GetProcessBatches() const { return process_batches_; }
+
   // Specifies the maximum difference between input and output timestamps.
   // When specified, the mediapipe framework automatically computes output
   // timestamp bounds based on input timestamps.  The special value
@@ -131,6 +140,14 @@ class CalculatorContract {
   void SetTimestampOffset(TimestampDiff offset) { timestamp_offset_ = offset; }
   TimestampDiff GetTimestampOffset() const { return timestamp_offset_; }
 
+  // Declares that Process() depends only on the inputs of the current
+  // timestamp, the input side packets and the state set up in Open(), and is
+  // safe to call from several threads at once.  Unless the node config sets
+  // max_in_flight, the framework then runs Process() for up to one timestamp
+  // per CPU core concurrently, and emits the outputs in timestamp order.
+  void SetStateless(bool stateless) { stateless_ = stateless; }
+  bool IsStateless() const { return stateless_; }
+
   class GraphServiceRequest {
    public:
     // APIs that should be used by calculators.
@@ -182,6 +199,8 @@ class CalculatorContract {
   std::string node_name_;
   std::map<std::string, GraphServiceRequest> service_requests_;
   bool process_timestamps_ = false;
+  bool stateless_ = false;
+  bool process_batches_ = false;
   TimestampDiff timestamp_offset_ = TimestampDiff::Unset();
 
   friend class CalculatorNode;
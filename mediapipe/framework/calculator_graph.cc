@@ -17,6 +17,7 @@
 #include <stdio.h>
 
 #include <algorithm>
+#include <iterator>
 #include <map>
 #include <memory>
 #include <queue>
@@ -37,6 +38,7 @@
 #include "mediapipe/framework/calculator_base.h"
 #include "mediapipe/framework/counter_factory.h"
 #include "mediapipe/framework/delegating_executor.h"
+#include "mediapipe/framework/formats/shared_buffer_pool.h"
 #include "mediapipe/framework/graph_service_manager.h"
 #include "mediapipe/framework/input_stream_manager.h"
 #include "mediapipe/framework/mediapipe_profiling.h"
@@ -52,11 +54,13 @@
 #include "mediapipe/framework/port/source_location.h"
 #include "mediapipe/framework/port/status.h"
 #include "mediapipe/framework/port/status_builder.h"
+#include "mediapipe/framework/profiler/metric_registry.h"
 #include "mediapipe/framework/status_handler.h"
 #include "mediapipe/framework/status_handler.pb.h"
 #include "mediapipe/framework/thread_pool_executor.h"
 #include "mediapipe/framework/thread_pool_executor.pb.h"
 #include "mediapipe/framework/tool/fill_packet_set.h"
+#include "mediapipe/framework/tool/name_util.h"
 #include "mediapipe/framework/tool/status_util.h"
 #include "mediapipe/framework/tool/tag_map.h"
 #include "mediapipe/framework/tool/validate.h"
@@ -77,6 +81,19 @@ namespace {
 constexpr int kMaxNumAccumulatedErrors = 1000;
 constexpr char kApplicationThreadExecutorType[] = "ApplicationThreadExecutor";
 
+// Exports the statistics of the buffer pool shared by all the graphs.
+void CollectSharedBufferPoolMetrics(MetricRegistry* registry) {
+  const SharedBufferPool::Stats stats = SharedBufferPool::Get().GetStats();
+  registry->GetGauge("mediapipe_shared_buffer_pool_hits")
+      ->Set(stats.hit_count);
+  registry->GetGauge("mediapipe_shared_buffer_pool_misses")
+      ->Set(stats.miss_count);
+  registry->GetGauge("mediapipe_shared_buffer_pool_bytes_in_use")
+      ->Set(stats.bytes_in_use);
+  registry->GetGauge("mediapipe_shared_buffer_pool_bytes_available")
+      ->Set(stats.bytes_available);
+}
+
 }  // namespace
 
 void CalculatorGraph::ScheduleAllOpenableNodes() {
@@ -177,6 +194,13 @@ absl::Status CalculatorGraph::InitializeStreams() {
     const EdgeInfo& edge_info = validated_graph_->InputStreamInfos()[index];
     MP_RETURN_IF_ERROR(input_stream_managers_[index].Initialize(
         edge_info.name, edge_info.packet_type, edge_info.back_edge));
+    if (validated_graph_->Config().lock_free_input_streams()) {
+      // The staging buffer only needs to absorb the packets that arrive
+      // between two runs of the consumer; it overflows into the queue.
+      const int max_queue_size = validated_graph_->Config().max_queue_size();
+      input_stream_managers_[index].EnableLockFreeQueue(
+          max_queue_size > 0 ? max_queue_size : 100);
+    }
   }
 
   // Create and initialize the output streams.
@@ -390,6 +414,13 @@ absl::Status CalculatorGraph::InitializeDefaultExecutor(
         mediapipe::NumCPUCores(),
         std::max({validated_graph_->Config().node().size(),
                   validated_graph_->Config().packet_generator().size(), 1}));
+    // A stateless calculator can keep every core busy by itself.
+    for (const NodeTypeInfo& node_info : validated_graph_->CalculatorInfos()) {
+      if (node_info.Contract().IsStateless()) {
+        num_threads = mediapipe::NumCPUCores();
+        break;
+      }
+    }
   }
   MP_RETURN_IF_ERROR(
       CreateDefaultThreadPool(default_executor_options, num_threads));
@@ -397,11 +428,11 @@ absl::Status CalculatorGraph::InitializeDefaultExecutor(
 }
 
 absl::Status CalculatorGraph::Initialize(
-    std::unique_ptr<ValidatedGraphConfig> validated_graph,
+    std::shared_ptr<const ValidatedGraphConfig> validated_graph,
     const std::map<std::string, Packet>& side_packets) {
   RET_CHECK(!initialized_).SetNoLogging()
       << "CalculatorGraph can be initialized only once.";
-  RET_CHECK(validated_graph->Initialized()).SetNoLogging()
+  RET_CHECK(validated_graph && validated_graph->Initialized()).SetNoLogging()
       << "validated_graph is not initialized.";
   validated_graph_ = std::move(validated_graph);
 
@@ -619,6 +650,50 @@ absl::StatusOr<std::map<std::string, Packet>> CalculatorGraph::PrepareGpu(
 }
 #endif  // !MEDIAPIPE_DISABLE_GPU
 
+absl::StatusOr<std::vector<bool>> CalculatorGraph::CriticalPathNodes()
+    const {
+  const int num_nodes = validated_graph_->CalculatorInfos().size();
+  std::vector<int> stream_indexes;
+  for (const std::string& tag_and_name :
+       validated_graph_->Config().output_stream()) {
+    std::string tag, name;
+    MP_RETURN_IF_ERROR(tool::ParseTagAndName(tag_and_name, &tag, &name));
+    stream_indexes.push_back(validated_graph_->OutputStreamIndex(name));
+  }
+  for (const auto& graph_output_stream : graph_output_streams_) {
+    stream_indexes.push_back(validated_graph_->OutputStreamIndex(
+        graph_output_stream->input_stream()->Name()));
+  }
+  if (stream_indexes.empty()) {
+    return std::vector<bool>(num_nodes, true);
+  }
+  // Walk upstream from the observed streams.
+  std::vector<bool> critical_nodes(num_nodes, false);
+  while (!stream_indexes.empty()) {
+    const int stream_index = stream_indexes.back();
+    stream_indexes.pop_back();
+    if (stream_index < 0) continue;
+    const NodeTypeInfo::NodeRef& node =
+        validated_graph_->OutputStreamInfos()[stream_index].parent_node;
+    if (node.type != NodeTypeInfo::NodeType::CALCULATOR ||
+        critical_nodes[node.index]) {
+      continue;
+    }
+    critical_nodes[node.index] = true;
+    const NodeTypeInfo& node_info =
+        validated_graph_->CalculatorInfos()[node.index];
+    const int base_index = node_info.InputStreamBaseIndex();
+    for (int i = 0; i < node_info.InputStreamTypes().NumEntries(); ++i) {
+      const EdgeInfo& edge_info =
+          validated_graph_->InputStreamInfos()[base_index + i];
+      if (!edge_info.back_edge) {
+        stream_indexes.push_back(edge_info.upstream);
+      }
+    }
+  }
+  return critical_nodes;
+}
+
 absl::Status CalculatorGraph::PrepareForRun(
     const std::map<std::string, Packet>& extra_side_packets,
     const std::map<std::string, Packet>& stream_headers) {
@@ -685,6 +760,15 @@ absl::Status CalculatorGraph::PrepareForRun(
     RET_CHECK(default_executor);
   }
   scheduler_.Reset();
+  const SchedulerConfig& scheduler_config =
+      validated_graph_->Config().scheduler_config();
+  if (scheduler_config.policy() == SchedulerConfig::EARLIEST_DEADLINE_FIRST) {
+    RET_CHECK_GE(scheduler_config.latency_budget(), 0)
+        << "SchedulerConfig latency_budget must not be negative.";
+    ASSIGN_OR_RETURN(std::vector<bool> critical_nodes, CriticalPathNodes());
+    scheduler_.SetEarliestDeadlineFirst(scheduler_config.latency_budget(),
+                                        std::move(critical_nodes));
+  }
 
   MP_RETURN_IF_ERROR(InitializePacketGeneratorNodes(non_scheduled_generators));
 
@@ -700,6 +784,34 @@ absl::Status CalculatorGraph::PrepareForRun(
                                graph_input_streams_.size());
   }
 
+  // Report the queue sizes and throttling events of the input streams if a
+  // MetricRegistry is provided.
+  std::shared_ptr<MetricRegistry> metric_registry =
+      service_manager_.GetServiceObject(kMetricRegistryService);
+  for (int index = 0; index < validated_graph_->InputStreamInfos().size();
+       ++index) {
+    ShardedHistogram* queue_size_histogram = nullptr;
+    ShardedCounter* became_full_counter = nullptr;
+    if (metric_registry) {
+      const EdgeInfo& edge_info = validated_graph_->InputStreamInfos()[index];
+      const MetricRegistry::Labels labels = {
+          {"node", tool::CanonicalNodeName(validated_graph_->Config(),
+                                           edge_info.parent_node.index)},
+          {"stream", edge_info.name}};
+      queue_size_histogram = metric_registry->GetHistogram(
+          MetricRegistry::MetricKey("mediapipe_input_queue_size", labels));
+      became_full_counter = metric_registry->GetCounter(
+          MetricRegistry::MetricKey("mediapipe_input_queue_full_total",
+                                    labels));
+    }
+    input_stream_managers_[index].SetQueueMetrics(queue_size_histogram,
+                                                  became_full_counter);
+  }
+  if (metric_registry) {
+    metric_registry->SetCollector("mediapipe_shared_buffer_pool",
+                                  &CollectSharedBufferPoolMetrics);
+  }
+
   for (auto& item : graph_input_streams_) {
     item.second->PrepareForRun(
         std::bind(&CalculatorGraph::RecordError, this, std::placeholders::_1));
@@ -846,66 +958,89 @@ absl::Status CalculatorGraph::AddPacketToInputStreamInternal(
       stream_name);
   int node_id = mediapipe::FindOrDie(graph_input_stream_node_ids_, stream_name);
   CHECK_GE(node_id, validated_graph_->CalculatorInfos().size());
-  {
-    absl::MutexLock lock(&full_input_streams_mutex_);
-    if (full_input_streams_.empty()) {
-      return mediapipe::FailedPreconditionErrorBuilder(MEDIAPIPE_LOC)
-             << "CalculatorGraph::AddPacketToInputStream() is called before "
-                "StartRun()";
+  // Moves the packet into the stream only if it is not const.
+  return AddPacketsToGraphInputStream(stream->get(), node_id,
+                                      std::make_move_iterator(&packet),
+                                      std::make_move_iterator(&packet + 1));
+}
+
+absl::Status CalculatorGraph::WaitUntilGraphInputStreamAccepts(int node_id) {
+  absl::MutexLock lock(&full_input_streams_mutex_);
+  if (full_input_streams_.empty()) {
+    return mediapipe::FailedPreconditionErrorBuilder(MEDIAPIPE_LOC)
+           << "CalculatorGraph::AddPacketToInputStream() is called before "
+              "StartRun()";
+  }
+  if (graph_input_stream_add_mode_ ==
+      GraphInputStreamAddMode::ADD_IF_NOT_FULL) {
+    if (has_error_) {
+      absl::Status error_status;
+      GetCombinedErrors("Graph has errors: ", &error_status);
+      return error_status;
     }
-    if (graph_input_stream_add_mode_ ==
-        GraphInputStreamAddMode::ADD_IF_NOT_FULL) {
-      if (has_error_) {
-        absl::Status error_status;
-        GetCombinedErrors("Graph has errors: ", &error_status);
-        return error_status;
-      }
-      // Return with StatusUnavailable if this stream is being throttled.
-      if (!full_input_streams_[node_id].empty()) {
-        return mediapipe::UnavailableErrorBuilder(MEDIAPIPE_LOC)
-               << "Graph is throttled.";
-      }
-    } else if (graph_input_stream_add_mode_ ==
-               GraphInputStreamAddMode::WAIT_TILL_NOT_FULL) {
-      // Wait until this stream is not being throttled.
-      // TODO: instead of checking has_error_, we could just check
-      // if the graph is done. That could also be indicated by returning an
-      // error from WaitUntilGraphInputStreamUnthrottled.
-      while (!has_error_ && !full_input_streams_[node_id].empty()) {
-        // TODO: allow waiting for a specific stream?
-        scheduler_.WaitUntilGraphInputStreamUnthrottled(
-            &full_input_streams_mutex_);
-      }
-      if (has_error_) {
-        absl::Status error_status;
-        GetCombinedErrors("Graph has errors: ", &error_status);
-        return error_status;
-      }
+    // Return with StatusUnavailable if this stream is being throttled.
+    if (!full_input_streams_[node_id].empty()) {
+      return mediapipe::UnavailableErrorBuilder(MEDIAPIPE_LOC)
+             << "Graph is throttled.";
+    }
+  } else if (graph_input_stream_add_mode_ ==
+             GraphInputStreamAddMode::WAIT_TILL_NOT_FULL) {
+    // Wait until this stream is not being throttled.
+    // TODO: instead of checking has_error_, we could just check
+    // if the graph is done. That could also be indicated by returning an
+    // error from WaitUntilGraphInputStreamUnthrottled.
+    while (!has_error_ && !full_input_streams_[node_id].empty()) {
+      // TODO: allow waiting for a specific stream?
+      scheduler_.WaitUntilGraphInputStreamUnthrottled(
+          &full_input_streams_mutex_);
+    }
+    if (has_error_) {
+      absl::Status error_status;
+      GetCombinedErrors("Graph has errors: ", &error_status);
+      return error_status;
     }
   }
+  return absl::OkStatus();
+}
 
-  // Adding profiling info for a new packet entering the graph.
-  const std::string* stream_id = &(*stream)->GetManager()->Name();
-  profiler_->LogEvent(TraceEvent(TraceEvent::PROCESS)
-                          .set_is_finish(true)
-                          .set_input_ts(packet.Timestamp())
-                          .set_stream_id(stream_id)
-                          .set_packet_ts(packet.Timestamp())
-                          .set_packet_data_id(&packet));
-
-  // InputStreamManager is thread safe. GraphInputStream is not, so this method
-  // should not be called by multiple threads concurrently. Note that this could
-  // potentially lead to the max queue size being exceeded by one packet at most
-  // because we don't have the lock over the input stream.
-  (*stream)->AddPacket(std::forward<T>(packet));
+template <typename Iterator>
+absl::Status CalculatorGraph::AddPacketsToGraphInputStream(
+    GraphInputStream* stream, int node_id, Iterator begin, Iterator end) {
+  if (begin == end) {
+    return absl::OkStatus();
+  }
+  MP_RETURN_IF_ERROR(WaitUntilGraphInputStreamAccepts(node_id));
+
+  const std::string* stream_id = &stream->GetManager()->Name();
+  for (Iterator it = begin; it != end; ++it) {
+    // Adding profiling info for a new packet entering the graph.
+    const Packet& packet = *it;
+    profiler_->LogEvent(TraceEvent(TraceEvent::PROCESS)
+                            .set_is_finish(true)
+                            .set_input_ts(packet.Timestamp())
+                            .set_stream_id(stream_id)
+                            .set_packet_ts(packet.Timestamp())
+                            .set_packet_data_id(&packet));
+
+    // InputStreamManager is thread safe. GraphInputStream is not, so this
+    // method should not be called by multiple threads concurrently. Note that
+    // this could potentially lead to the max queue size being exceeded by the
+    // number of added packets because we don't have the lock over the input
+    // stream.
+    stream->AddPacket(*it);
+    if (has_error_) {
+      // Like AddPacketToInputStream(), stop at the first invalid packet.
+      break;
+    }
+  }
   if (has_error_) {
     absl::Status error_status;
     GetCombinedErrors("Graph has errors: ", &error_status);
     return error_status;
   }
-  (*stream)->PropagateUpdatesToMirrors();
+  stream->PropagateUpdatesToMirrors();
 
-  VLOG(2) << "Packet added directly to: " << stream_name;
+  VLOG(2) << "Packets added directly to: " << *stream_id;
   // Note: one reason why we need to call the scheduler here is that we have
   // re-throttled the graph input streams, and we may need to unthrottle them
   // again if the graph is still idle. Unthrottling basically only lets in one
@@ -914,6 +1049,44 @@ absl::Status CalculatorGraph::AddPacketToInputStreamInternal(
   return absl::OkStatus();
 }
 
+absl::StatusOr<CalculatorGraph::GraphInputStreamHandle>
+CalculatorGraph::GetGraphInputStreamHandle(const std::string& stream_name) {
+  std::unique_ptr<GraphInputStream>* stream =
+      mediapipe::FindOrNull(graph_input_streams_, stream_name);
+  RET_CHECK(stream).SetNoLogging() << absl::Substitute(
+      "GetGraphInputStreamHandle called on input stream \"$0\" which is not "
+      "a graph input stream.",
+      stream_name);
+  int node_id = mediapipe::FindOrDie(graph_input_stream_node_ids_, stream_name);
+  return GraphInputStreamHandle(this, stream->get(), node_id);
+}
+
+absl::Status CalculatorGraph::GraphInputStreamHandle::AddPacket(
+    const Packet& packet) {
+  return graph_->AddPacketsToGraphInputStream(stream_, node_id_, &packet,
+                                              &packet + 1);
+}
+
+absl::Status CalculatorGraph::GraphInputStreamHandle::AddPacket(
+    Packet&& packet) {
+  return graph_->AddPacketsToGraphInputStream(
+      stream_, node_id_, std::make_move_iterator(&packet),
+      std::make_move_iterator(&packet + 1));
+}
+
+absl::Status CalculatorGraph::GraphInputStreamHandle::AddPackets(
+    absl::Span<const Packet> packets) {
+  return graph_->AddPacketsToGraphInputStream(stream_, node_id_,
+                                              packets.begin(), packets.end());
+}
+
+absl::Status CalculatorGraph::GraphInputStreamHandle::AddPackets(
+    std::vector<Packet>&& packets) {
+  return graph_->AddPacketsToGraphInputStream(
+      stream_, node_id_, std::make_move_iterator(packets.begin()),
+      std::make_move_iterator(packets.end()));
+}
+
 absl::Status CalculatorGraph::SetInputStreamMaxQueueSize(
     const std::string& stream_name, int max_queue_size) {
   // graph_input_streams_ has not been filled in yet, so we'll check this when
@@ -1184,6 +1357,14 @@ bool CalculatorGraph::UnthrottleSources() {
     }
     int new_size = stream->QueueSize() + 1;
     stream->SetMaxQueueSize(new_size);
+    if (auto metric_registry =
+            service_manager_.GetServiceObject(kMetricRegistryService)) {
+      metric_registry
+          ->GetCounter(MetricRegistry::MetricKey(
+              "mediapipe_resolved_deadlocks_total",
+              {{"stream", stream->Name()}}))
+          ->Increment();
+    }
     LOG_EVERY_N(WARNING, 100)
         << "Resolved a deadlock by increasing max_queue_size of input stream: "
         << stream->Name() << " to: " << new_size
@@ -31,6 +31,7 @@
 #include "absl/container/flat_hash_map.h"
 #include "absl/container/flat_hash_set.h"
 #include "absl/synchronization/mutex.h"
+#include "absl/types/span.h"
 #include "mediapipe/framework/calculator.pb.h"
 #include "mediapipe/framework/calculator_base.h"
 #include "mediapipe/framework/calculator_node.h"
@@ -144,6 +145,14 @@ class CalculatorGraph {
       const std::string& graph_type = "",
       const Subgraph::SubgraphOptions* options = nullptr);
 
+  // Initializes the graph from an initialized ValidatedGraphConfig, which
+  // skips the expansion and validation of the graph config. The
+  // ValidatedGraphConfig can be shared by several graphs, see
+  // ValidatedGraphConfigCache.
+  absl::Status Initialize(
+      std::shared_ptr<const ValidatedGraphConfig> validated_graph,
+      const std::map<std::string, Packet>& side_packets = {});
+
   // Returns the canonicalized CalculatorGraphConfig for this graph.
   const CalculatorGraphConfig& Config() const {
     return validated_graph_->Config();
@@ -254,6 +263,16 @@ class CalculatorGraph {
   absl::Status AddPacketToInputStream(const std::string& stream_name,
                                       Packet&& packet);
 
+  // A graph input stream resolved by GetGraphInputStreamHandle(), to add
+  // packets without looking up the stream by name. See below.
+  class GraphInputStreamHandle;
+
+  // Returns a handle to add packets to the graph input stream "stream_name".
+  // The handle can be obtained once the graph is initialized and remains valid
+  // across runs, as long as the CalculatorGraph exists.
+  absl::StatusOr<GraphInputStreamHandle> GetGraphInputStreamHandle(
+      const std::string& stream_name);
+
   // Sets the queue size of a graph input stream, overriding the graph default.
   absl::Status SetInputStreamMaxQueueSize(const std::string& stream_name,
                                           int max_queue_size);
@@ -441,10 +460,6 @@ class CalculatorGraph {
     OutputStreamShard shard_;
   };
 
-  // Initializes the graph from a ValidatedGraphConfig object.
-  absl::Status Initialize(std::unique_ptr<ValidatedGraphConfig> validated_graph,
-                          const std::map<std::string, Packet>& side_packets);
-
   // AddPacketToInputStreamInternal template is called by either
   // AddPacketToInputStream(Packet&& packet) or
   // AddPacketToInputStream(const Packet& packet).
@@ -452,6 +467,21 @@ class CalculatorGraph {
   absl::Status AddPacketToInputStreamInternal(const std::string& stream_name,
                                               T&& packet);
 
+  // Waits until the graph input stream with virtual node id "node_id" can
+  // accept packets, following graph_input_stream_add_mode_. Returns an error
+  // if the graph is not running or has errors, or if the stream is throttled
+  // in the ADD_IF_NOT_FULL mode.
+  absl::Status WaitUntilGraphInputStreamAccepts(int node_id)
+      ABSL_LOCKS_EXCLUDED(full_input_streams_mutex_);
+
+  // Adds "packets" to "stream", the graph input stream with virtual node id
+  // "node_id", then propagates them and notifies the scheduler once. Packets
+  // are moved from the range if "Iterator" dereferences to an rvalue.
+  template <typename Iterator>
+  absl::Status AddPacketsToGraphInputStream(GraphInputStream* stream,
+                                            int node_id, Iterator begin,
+                                            Iterator end);
+
   // Sets the executor that will run the nodes assigned to the executor
   // named |name|.  If |name| is empty, this sets the default executor.
   // Does not check that the graph is uninitialized and |name| is not a
@@ -490,6 +520,11 @@ class CalculatorGraph {
   // Iterates through all nodes and schedules any that can be opened.
   void ScheduleAllOpenableNodes();
 
+  // Returns, indexed by node id, whether each calculator feeds an output
+  // stream of the graph or an observed or polled stream, directly or through
+  // other calculators. If no stream is observed, every calculator is marked.
+  absl::StatusOr<std::vector<bool>> CriticalPathNodes() const;
+
   // Does the bulk of the work for StartRun but does not start the scheduler.
   absl::Status PrepareForRun(
       const std::map<std::string, Packet>& extra_side_packets,
@@ -539,7 +574,7 @@ class CalculatorGraph {
   PacketType any_packet_type_;
 
   // The ValidatedGraphConfig object defining this CalculatorGraph.
-  std::unique_ptr<ValidatedGraphConfig> validated_graph_;
+  std::shared_ptr<const ValidatedGraphConfig> validated_graph_;
 
   // The PacketGeneratorGraph to use to generate all the input side packets.
   PacketGeneratorGraph packet_generator_graph_;
@@ -642,6 +677,46 @@ class CalculatorGraph {
   internal::Scheduler scheduler_;
 };
 
+// Adds packets to a graph input stream without looking it up by name. A batch
+// added by AddPackets() waits for the stream to be unthrottled once, is
+// propagated to the graph once and notifies the scheduler once, so that it may
+// exceed the max_queue_size of the graph by the size of the batch. As with
+// CalculatorGraph::AddPacketToInputStream(), packets must be added to a stream
+// by a single thread at a time.
+//
+// Example:
+//   MP_RETURN_IF_ERROR(graph.StartRun({}));
+//   ASSIGN_OR_RETURN(auto input, graph.GetGraphInputStreamHandle("input"));
+//   for (...) {
+//     MP_RETURN_IF_ERROR(input.AddPackets(packets));
+//   }
+class CalculatorGraph::GraphInputStreamHandle {
+ public:
+  // Same as CalculatorGraph::AddPacketToInputStream().
+  absl::Status AddPacket(const Packet& packet);
+  absl::Status AddPacket(Packet&& packet);
+
+  // Adds "packets", by increasing timestamp. On error, the packets preceding
+  // the erroneous one may have been added.
+  absl::Status AddPackets(absl::Span<const Packet> packets);
+
+  // Same as above, but moves the packets into the stream.
+  absl::Status AddPackets(std::vector<Packet>&& packets);
+
+  const std::string& Name() const { return stream_->GetManager()->Name(); }
+
+ private:
+  friend class CalculatorGraph;
+
+  GraphInputStreamHandle(CalculatorGraph* graph, GraphInputStream* stream,
+                         int node_id)
+      : graph_(graph), stream_(stream), node_id_(node_id) {}
+
+  CalculatorGraph* graph_;
+  GraphInputStream* stream_;
+  int node_id_;
+};
+
 }  // namespace mediapipe
 
 #endif  // MEDIAPIPE_FRAMEWORK_CALCULATOR_GRAPH_H_
@@ -0,0 +1,279 @@
+// Copyright 2022 The MediaPipe Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Tests the SchedulerConfig policies and measures the latency of an observed
+// output stream while the graph is overloaded. To run the benchmark:
+// $ bazel run -c opt mediapipe/framework:calculator_graph_scheduling_test -- \
+//   --benchmark_filter=all
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "absl/strings/str_cat.h"
+#include "absl/time/clock.h"
+#include "absl/time/time.h"
+#include "mediapipe/framework/calculator_framework.h"
+#include "mediapipe/framework/port/benchmark.h"
+#include "mediapipe/framework/port/gmock.h"
+#include "mediapipe/framework/port/gtest.h"
+#include "mediapipe/framework/port/parse_text_proto.h"
+#include "mediapipe/framework/port/status_matchers.h"
+
+namespace mediapipe {
+namespace {
+
+// Passes its input through. If the "SPIN_US" side packet is present, it
+// first busy-waits for that many microseconds. If the "LOG" side packet is
+// present, it records "<node name>@<timestamp>" for each call to Process.
+class SpinPassThroughCalculator : public CalculatorBase {
+ public:
+  static absl::Status GetContract(CalculatorContract* cc) {
+    cc->Inputs().Index(0).SetAny();
+    cc->Outputs().Index(0).SetSameAs(&cc->Inputs().Index(0));
+    if (cc->InputSidePackets().HasTag("SPIN_US")) {
+      cc->InputSidePackets().Tag("SPIN_US").Set<int>();
+    }
+    if (cc->InputSidePackets().HasTag("LOG")) {
+      cc->InputSidePackets().Tag("LOG").Set<std::vector<std::string>*>();
+    }
+    return absl::OkStatus();
+  }
+
+  absl::Status Open(CalculatorContext* cc) final {
+    if (cc->InputSidePackets().HasTag("SPIN_US")) {
+      spin_time_ =
+          absl::Microseconds(cc->InputSidePackets().Tag("SPIN_US").Get<int>());
+    }
+    if (cc->InputSidePackets().HasTag("LOG")) {
+      log_ = cc->InputSidePackets()
+                 .Tag("LOG")
+                 .Get<std::vector<std::string>*>();
+    }
+    cc->SetOffset(TimestampDiff(0));
+    return absl::OkStatus();
+  }
+
+  absl::Status Process(CalculatorContext* cc) final {
+    const absl::Time end = absl::Now() + spin_time_;
+    while (absl::Now() < end) {
+    }
+    if (log_) {
+      log_->push_back(
+          absl::StrCat(cc->NodeName(), "@", cc->InputTimestamp().Value()));
+    }
+    cc->Outputs().Index(0).AddPacket(cc->Inputs().Index(0).Value());
+    return absl::OkStatus();
+  }
+
+ private:
+  absl::Duration spin_time_ = absl::ZeroDuration();
+  std::vector<std::string>* log_ = nullptr;
+};
+REGISTER_CALCULATOR(SpinPassThroughCalculator);
+
+// Node "fast" feeds the observed stream "out". Nodes "slow1" and "slow2"
+// consume the same input but nothing observes their output. The graph runs on
+// the application thread, so that the order of the calls to Process follows
+// the scheduler queue exactly.
+CalculatorGraphConfig GetConfig(const std::string& scheduler_config) {
+  CalculatorGraphConfig config =
+      ParseTextProtoOrDie<CalculatorGraphConfig>(R"pb(
+        input_stream: "in"
+        input_side_packet: "log"
+        num_threads: 0
+        node {
+          name: "fast"
+          calculator: "SpinPassThroughCalculator"
+          input_stream: "in"
+          output_stream: "out"
+          input_side_packet: "LOG:log"
+        }
+        node {
+          name: "slow1"
+          calculator: "SpinPassThroughCalculator"
+          input_stream: "in"
+          output_stream: "side1"
+          input_side_packet: "LOG:log"
+        }
+        node {
+          name: "slow2"
+          calculator: "SpinPassThroughCalculator"
+          input_stream: "side1"
+          output_stream: "side2"
+          input_side_packet: "LOG:log"
+        }
+      )pb");
+  *config.mutable_scheduler_config() =
+      ParseTextProtoOrDie<SchedulerConfig>(scheduler_config);
+  return config;
+}
+
+// Sends packets at timestamps 0 to 3 through the graph, observing "out" if
+// requested, and returns the calls to Process in the order they ran.
+std::vector<std::string> RunAndLog(const std::string& scheduler_config,
+                                   bool observe_output) {
+  std::vector<std::string> log;
+  CalculatorGraph graph;
+  MEDIAPIPE_CHECK_OK(graph.Initialize(GetConfig(scheduler_config)));
+  if (observe_output) {
+    MEDIAPIPE_CHECK_OK(graph.ObserveOutputStream(
+        "out", [](const Packet&) { return absl::OkStatus(); }));
+  }
+  MEDIAPIPE_CHECK_OK(graph.StartRun(
+      {{"log", MakePacket<std::vector<std::string>*>(&log)}}));
+  for (int i = 0; i < 4; ++i) {
+    MEDIAPIPE_CHECK_OK(graph.AddPacketToInputStream(
+        "in", MakePacket<int>(i).At(Timestamp(i))));
+  }
+  MEDIAPIPE_CHECK_OK(graph.CloseAllInputStreams());
+  MEDIAPIPE_CHECK_OK(graph.WaitUntilDone());
+  return log;
+}
+
+TEST(CalculatorGraphSchedulingTest, DefaultPolicyRunsLaterNodesFirst) {
+  std::vector<std::string> log = RunAndLog("", /*observe_output=*/true);
+  ASSERT_EQ(12, log.size());
+  // "slow1" comes later in the config than "fast", so it runs first.
+  EXPECT_EQ("slow1@0", log[0]);
+  EXPECT_THAT(log, testing::Contains("fast@0"));
+}
+
+TEST(CalculatorGraphSchedulingTest, EarliestDeadlineFirstPrefersCriticalPath) {
+  std::vector<std::string> log =
+      RunAndLog("policy: EARLIEST_DEADLINE_FIRST latency_budget: 100",
+                /*observe_output=*/true);
+  ASSERT_EQ(12, log.size());
+  // All timestamps are within the latency budget, so the calculator feeding
+  // the observed stream runs for every timestamp before the others.
+  EXPECT_THAT(std::vector<std::string>(log.begin(), log.begin() + 4),
+              testing::ElementsAre("fast@0", "fast@1", "fast@2", "fast@3"));
+}
+
+TEST(CalculatorGraphSchedulingTest, EarliestDeadlineFirstLimitsLag) {
+  std::vector<std::string> log =
+      RunAndLog("policy: EARLIEST_DEADLINE_FIRST latency_budget: 1",
+                /*observe_output=*/true);
+  ASSERT_EQ(12, log.size());
+  // The calculators off the critical path at timestamp t have the same
+  // deadline as "fast" at t + 1, and win the tie since they come later in the
+  // config, so they lag by at most one timestamp.
+  EXPECT_THAT(std::vector<std::string>(log.begin(), log.begin() + 4),
+              testing::ElementsAre("fast@0", "slow1@0", "slow2@0", "fast@1"));
+}
+
+TEST(CalculatorGraphSchedulingTest, EarliestDeadlineFirstRunsInTimestampOrder) {
+  // Nothing is observed, so every node is on the critical path, and each
+  // timestamp is completed before the next one is started.
+  std::vector<std::string> log =
+      RunAndLog("policy: EARLIEST_DEADLINE_FIRST", /*observe_output=*/false);
+  ASSERT_EQ(12, log.size());
+  for (int i = 0; i < 4; ++i) {
+    std::vector<std::string> calls(log.begin() + 3 * i,
+                                   log.begin() + 3 * (i + 1));
+    EXPECT_THAT(calls, testing::UnorderedElementsAre(absl::StrCat("fast@", i),
+                                                     absl::StrCat("slow1@", i),
+                                                     absl::StrCat("slow2@", i)));
+  }
+}
+
+TEST(CalculatorGraphSchedulingTest, RejectsNegativeLatencyBudget) {
+  std::vector<std::string> log;
+  CalculatorGraph graph;
+  MP_ASSERT_OK(graph.Initialize(GetConfig(
+      "policy: EARLIEST_DEADLINE_FIRST latency_budget: -1")));
+  EXPECT_FALSE(
+      graph
+          .StartRun({{"log", MakePacket<std::vector<std::string>*>(&log)}})
+          .ok());
+}
+
+// Feeds packets in real time at a rate the graph cannot keep up with, and
+// reports the percentiles of the latency of the observed stream "out", from
+// AddPacketToInputStream to the observer. Only "fast" feeds "out"; "slow1"
+// and "slow2" take most of the time. state.range(0) selects
+// EARLIEST_DEADLINE_FIRST (1) or DEFAULT (0).
+void BM_ObservedOutputLatencyUnderOverload(benchmark::State& state) {
+  constexpr int kNumPackets = 200;
+  constexpr int kPeriodUs = 400;
+  constexpr int kFastUs = 100;
+  constexpr int kSlowUs = 250;
+  CalculatorGraphConfig config =
+      ParseTextProtoOrDie<CalculatorGraphConfig>(absl::StrCat(R"pb(
+        input_stream: "in"
+        num_threads: 1
+        max_queue_size: -1
+        node {
+          calculator: "SpinPassThroughCalculator"
+          input_stream: "in"
+          output_stream: "out"
+          input_side_packet: "SPIN_US:fast"
+        }
+        node {
+          calculator: "SpinPassThroughCalculator"
+          input_stream: "in"
+          output_stream: "side1"
+          input_side_packet: "SPIN_US:slow"
+        }
+        node {
+          calculator: "SpinPassThroughCalculator"
+          input_stream: "side1"
+          output_stream: "side2"
+          input_side_packet: "SPIN_US:slow"
+        }
+      )pb"));
+  if (state.range(0)) {
+    config.mutable_scheduler_config()->set_policy(
+        SchedulerConfig::EARLIEST_DEADLINE_FIRST);
+    // Let "slow1" and "slow2" fall behind by up to 100 ms.
+    config.mutable_scheduler_config()->set_latency_budget(100000);
+  }
+  std::vector<absl::Time> send_times(kNumPackets);
+  std::vector<double> latencies_us;
+  for (auto _ : state) {
+    latencies_us.clear();
+    CalculatorGraph graph;
+    MEDIAPIPE_CHECK_OK(graph.Initialize(config));
+    MEDIAPIPE_CHECK_OK(graph.ObserveOutputStream(
+        "out", [&send_times, &latencies_us](const Packet& packet) {
+          const int i = packet.Timestamp().Value() / kPeriodUs;
+          latencies_us.push_back(
+              absl::ToDoubleMicroseconds(absl::Now() - send_times[i]));
+          return absl::OkStatus();
+        }));
+    MEDIAPIPE_CHECK_OK(graph.StartRun({{"fast", MakePacket<int>(kFastUs)},
+                                       {"slow", MakePacket<int>(kSlowUs)}}));
+    const absl::Time start = absl::Now();
+    for (int i = 0; i < kNumPackets; ++i) {
+      absl::SleepFor(start + absl::Microseconds(i * kPeriodUs) - absl::Now());
+      send_times[i] = absl::Now();
+      MEDIAPIPE_CHECK_OK(graph.AddPacketToInputStream(
+          "in", MakePacket<int>(i).At(Timestamp(i * kPeriodUs))));
+    }
+    MEDIAPIPE_CHECK_OK(graph.CloseAllInputStreams());
+    MEDIAPIPE_CHECK_OK(graph.WaitUntilDone());
+  }
+  std::sort(latencies_us.begin(), latencies_us.end());
+  state.counters["p50_us"] = latencies_us[latencies_us.size() / 2];
+  state.counters["p99_us"] = latencies_us[latencies_us.size() * 99 / 100];
+  state.counters["max_us"] = latencies_us.back();
+}
+BENCHMARK(BM_ObservedOutputLatencyUnderOverload)
+    ->Arg(0)
+    ->Arg(1)
+    ->UseRealTime()
+    ->Unit(benchmark::kMillisecond);
+
+}  // namespace
+}  // namespace mediapipe
@@ -1494,6 +1494,13 @@ TEST(CalculatorGraph, RunsCorrectlyOnApplicationThread) {
   RunComprehensiveTest(&graph, proto, /*define_node_5=*/true);
 }
 
+TEST(CalculatorGraph, RunsCorrectlyWithLockFreeInputStreams) {
+  CalculatorGraph graph;
+  CalculatorGraphConfig proto = GetConfig();
+  proto.set_lock_free_input_streams(true);
+  RunComprehensiveTest(&graph, proto, /*define_node_5=*/true);
+}
+
 TEST(CalculatorGraph, RunsCorrectlyWithExternalExecutor) {
   CalculatorGraph graph;
   MP_ASSERT_OK(graph.SetExecutor("", std::make_shared<ThreadPoolExecutor>(1)));
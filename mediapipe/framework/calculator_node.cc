@@ -14,6 +14,7 @@
 
 #include "mediapipe/framework/calculator_node.h"
 
+#include <algorithm>
 #include <set>
 #include <string>
 #include <unordered_map>
@@ -47,6 +48,7 @@
 #include "mediapipe/framework/tool/tag_map.h"
 #include "mediapipe/framework/tool/validate_name.h"
 #include "mediapipe/gpu/graph_support.h"
+#include "mediapipe/util/cpu_util.h"
 
 namespace mediapipe {
 
@@ -146,15 +148,22 @@ absl::Status CalculatorNode::Initialize(
         "node_ref is not a calculator or packet generator");
   }
 
+  const CalculatorContract& contract = node_type_info_->Contract();
+
   max_in_flight_ = node_config->max_in_flight();
+  if (max_in_flight_ == 0 && contract.IsStateless() &&
+      node_config->input_stream_size() > 0) {
+    max_in_flight_ = NumCPUCores();
+  }
   max_in_flight_ = max_in_flight_ ? max_in_flight_ : 1;
+  // Bounds the completed invocations buffered for reordering to
+  // max_in_flight_.
+  max_active_contexts_ = 2 * max_in_flight_;
   if (!node_config->executor().empty()) {
     executor_ = node_config->executor();
   }
   source_layer_ = node_config->source_layer();
 
-  const CalculatorContract& contract = node_type_info_->Contract();
-
   uses_gpu_ =
       node_type_info_->InputSidePacketTypes().HasTag(kGpuSharedTagName) ||
       ContainsKey(node_type_info_->Contract().ServiceRequests(),
@@ -214,6 +223,7 @@ absl::Status CalculatorNode::Initialize(
   }
   input_stream_handler_->SetProcessTimestampBounds(
       contract.GetProcessTimestampBounds());
+  process_batches_ = contract.GetProcessBatches();
 
   return InitializeInputStreams(input_stream_managers, output_stream_managers);
 }
@@ -315,6 +325,8 @@ absl::Status CalculatorNode::InitializeInputStreamHandler(
                        /*calculator_run_in_parallel=*/max_in_flight_ > 1),
                    _ << "\"" << input_stream_handler_name
                      << "\" is not a registered input stream handler.");
+  MP_RETURN_IF_ERROR(input_stream_handler_->ValidateOptions())
+      << "Invalid options for \"" << input_stream_handler_name << "\".";
 
   return absl::OkStatus();
 }
@@ -664,7 +676,7 @@ void CalculatorNode::SchedulingLoop() {
       scheduling_state_ = kIdle;
       return;
     }
-    max_allowance = max_in_flight_ - current_in_flight_;
+    max_allowance = MaxAllowance();
   }
   while (true) {
     Timestamp input_bound;
@@ -679,9 +691,9 @@ void CalculatorNode::SchedulingLoop() {
 
     {
       absl::MutexLock lock(&status_mutex_);
-      if (scheduling_state_ == kSchedulingPending &&
-          current_in_flight_ < max_in_flight_) {
-        max_allowance = max_in_flight_ - current_in_flight_;
+      const int allowance = MaxAllowance();
+      if (scheduling_state_ == kSchedulingPending && allowance > 0) {
+        max_allowance = allowance;
         scheduling_state_ = kScheduling;
       } else {
         scheduling_state_ = kIdle;
@@ -691,6 +703,16 @@ void CalculatorNode::SchedulingLoop() {
   }
 }
 
+int CalculatorNode::MaxAllowance() {
+  int max_allowance = max_in_flight_ - current_in_flight_;
+  if (max_in_flight_ > 1) {
+    max_allowance = std::min(
+        max_allowance, max_active_contexts_ -
+                           calculator_context_manager_.NumActiveContexts());
+  }
+  return max_allowance;
+}
+
 bool CalculatorNode::ReadyForOpen() const {
   absl::MutexLock lock(&status_mutex_);
   return input_stream_headers_ready_ && input_side_packets_ready_;
@@ -855,8 +877,59 @@ absl::Status CalculatorNode::ProcessNode(
         << ", max_in_flight_:" << max_in_flight_;
     for (int i = 0; i < num_invocations; ++i) {
       const Timestamp input_timestamp = calculator_context->InputTimestamp();
-      // The node is ready for Process().
-      if (input_timestamp.IsAllowedInStream()) {
+      int batch_size = 1;
+      if (process_batches_) {
+        while (i + batch_size < num_invocations &&
+               calculator_context->BatchTimestamp(batch_size)
+                   .IsAllowedInStream()) {
+          ++batch_size;
+        }
+      }
+      if (batch_size > 1 && input_timestamp.IsAllowedInStream()) {
+        // The node is ready for one Process() call on the whole batch.
+        for (int j = 0; j < batch_size; ++j) {
+          input_stream_handler_->FinalizeInputSet(
+              calculator_context->BatchTimestamp(j), inputs);
+        }
+        output_stream_handler_->PrepareOutputs(input_timestamp, outputs);
+        calculator_context_manager_.SetBatchSizeInContext(calculator_context,
+                                                          batch_size);
+        const Timestamp last_timestamp =
+            calculator_context->BatchTimestamp(batch_size - 1);
+
+        VLOG(2) << "Calling Calculator::Process() for node: " << DebugName()
+                << " timestamps: " << input_timestamp << " to "
+                << last_timestamp;
+
+        if (OutputsAreConstant(calculator_context)) {
+          // Do nothing.
+          result = absl::OkStatus();
+        } else {
+          MEDIAPIPE_PROFILING(PROCESS, calculator_context);
+          LegacyCalculatorSupport::Scoped<CalculatorContext> s(
+              calculator_context);
+          result = calculator_->Process(calculator_context);
+        }
+
+        calculator_context_manager_.SetBatchSizeInContext(calculator_context,
+                                                          1);
+        for (int j = 0; j < batch_size; ++j) {
+          input_stream_handler_->ClearCurrentInputs(calculator_context);
+        }
+        i += batch_size - 1;
+
+        if (!result.ok() && result != tool::StatusStop()) {
+          return mediapipe::StatusBuilder(result, MEDIAPIPE_LOC).SetPrepend()
+                 << absl::Substitute(
+                        "Calculator::Process() for node \"$0\" failed: ",
+                        DebugName());
+        }
+        output_stream_handler_->PostProcess(last_timestamp);
+        if (result == tool::StatusStop()) {
+          return result;
+        }
+      } else if (input_timestamp.IsAllowedInStream()) {
+        // The node is ready for Process().
         input_stream_handler_->FinalizeInputSet(input_timestamp, inputs);
         output_stream_handler_->PrepareOutputs(input_timestamp, outputs);
 
@@ -273,6 +273,11 @@ class CalculatorNode {
   // the latest input timestamp bound if no invocations can be scheduled.
   void SchedulingLoop();
 
+  // Returns the number of invocations that SchedulingLoop() may schedule now,
+  // which is limited by max_in_flight_ and, for parallel nodes, by the number
+  // of completed invocations waiting for earlier ones to complete.
+  int MaxAllowance() ABSL_EXCLUSIVE_LOCKS_REQUIRED(status_mutex_);
+
   // Closes the input and output streams.
   void CloseInputStreams() ABSL_LOCKS_EXCLUDED(status_mutex_);
   void CloseOutputStreams(OutputStreamShardSet* outputs)
@@ -307,6 +312,12 @@ class CalculatorNode {
 
   // The max number of invocations that can be scheduled in parallel.
   int max_in_flight_ = 1;
+  // The max number of calculator contexts of a parallel node, which includes
+  // the invocations in flight and the completed invocations whose outputs
+  // wait to be propagated in timestamp order.
+  int max_active_contexts_ = 1;
+  // True if Process() handles all the input sets of a batch at once.
+  bool process_batches_ = false;
   // The following two variables are used for the concurrency control of node
   // scheduling.
   //
@@ -19,22 +19,27 @@
 //
 // TODO: Add more tests to verify the correctness of parallel execution.
 
+#include <algorithm>
+#include <functional>
 #include <memory>
 #include <random>
 #include <string>
 #include <vector>
 
 #include "absl/memory/memory.h"
+#include "absl/strings/substitute.h"
 #include "absl/synchronization/mutex.h"
 #include "absl/time/clock.h"
 #include "absl/time/time.h"
 #include "mediapipe/framework/calculator_framework.h"
+#include "mediapipe/framework/port/benchmark.h"
 #include "mediapipe/framework/port/gmock.h"
 #include "mediapipe/framework/port/gtest.h"
 #include "mediapipe/framework/port/integral_types.h"
 #include "mediapipe/framework/port/parse_text_proto.h"
 #include "mediapipe/framework/port/status.h"
 #include "mediapipe/framework/port/status_matchers.h"
+#include "mediapipe/util/cpu_util.h"
 
 namespace mediapipe {
 
@@ -153,5 +158,235 @@ TEST_F(ParallelExecutionTest, SlowPlusOneCalculatorsTest) {
   }
 }
 
+// Counts the invocations of StatelessTrackingCalculator.
+struct InvocationStats {
+  absl::Mutex mutex;
+  // The number of Process() calls started.
+  int started ABSL_GUARDED_BY(mutex) = 0;
+  // The number of Process() calls running now, and the largest number that
+  // have run at once.
+  int running ABSL_GUARDED_BY(mutex) = 0;
+  int max_running ABSL_GUARDED_BY(mutex) = 0;
+  // Process() returns once "max_running" reaches "wait_for_running".
+  int wait_for_running ABSL_GUARDED_BY(mutex) = 0;
+  // If "hold_first" is true, Process() at timestamp 0 returns once "released"
+  // is true.
+  bool hold_first ABSL_GUARDED_BY(mutex) = false;
+  bool released ABSL_GUARDED_BY(mutex) = false;
+};
+
+// Passes its input through, and records its invocations in the
+// InvocationStats given as the input side packet.
+class StatelessTrackingCalculator : public CalculatorBase {
+ public:
+  static absl::Status GetContract(CalculatorContract* cc) {
+    cc->Inputs().Index(0).Set<int>();
+    cc->Outputs().Index(0).Set<int>();
+    cc->InputSidePackets().Index(0).Set<InvocationStats*>();
+    cc->SetStateless(true);
+    return absl::OkStatus();
+  }
+
+  absl::Status Open(CalculatorContext* cc) final {
+    cc->SetOffset(TimestampDiff(0));
+    stats_ = cc->InputSidePackets().Index(0).Get<InvocationStats*>();
+    return absl::OkStatus();
+  }
+
+  absl::Status Process(CalculatorContext* cc) final {
+    {
+      absl::MutexLock lock(&stats_->mutex);
+      ++stats_->started;
+      ++stats_->running;
+      stats_->max_running = std::max(stats_->max_running, stats_->running);
+      stats_->mutex.AwaitWithTimeout(
+          absl::Condition(
+              +[](InvocationStats* stats) {
+                return stats->max_running >= stats->wait_for_running;
+              },
+              stats_),
+          absl::Seconds(10));
+      if (stats_->hold_first && cc->InputTimestamp() == Timestamp(0)) {
+        stats_->mutex.AwaitWithTimeout(
+            absl::Condition(&stats_->released), absl::Seconds(10));
+      }
+      --stats_->running;
+    }
+    cc->Outputs().Index(0).AddPacket(cc->Inputs().Index(0).Value());
+    return absl::OkStatus();
+  }
+
+ private:
+  InvocationStats* stats_ = nullptr;
+};
+REGISTER_CALCULATOR(StatelessTrackingCalculator);
+
+class StatelessExecutionTest : public ParallelExecutionTest {
+ protected:
+  void StartGraph(const std::string& max_in_flight) {
+    CalculatorGraphConfig graph_config =
+        mediapipe::ParseTextProtoOrDie<CalculatorGraphConfig>(
+            absl::Substitute(R"pb(
+                               input_stream: "input"
+                               node {
+                                 calculator: "StatelessTrackingCalculator"
+                                 input_stream: "input"
+                                 output_stream: "output"
+                                 input_side_packet: "stats"
+                                 $0
+                               }
+                               node {
+                                 calculator: "CallbackCalculator"
+                                 input_stream: "output"
+                                 input_side_packet: "CALLBACK:callback"
+                               }
+                               num_threads: 4
+                             )pb",
+                             max_in_flight));
+    MP_ASSERT_OK(graph_.Initialize(graph_config));
+    MP_ASSERT_OK(graph_.StartRun(
+        {{"stats", MakePacket<InvocationStats*>(&stats_)},
+         {"callback",
+          MakePacket<std::function<void(const Packet&)>>(
+              std::bind(&ParallelExecutionTest::AddThreadSafeVectorSink, this,
+                        std::placeholders::_1))}}));
+  }
+
+  void AddInputs(int count) {
+    for (int i = 0; i < count; ++i) {
+      MP_ASSERT_OK(graph_.AddPacketToInputStream(
+          "input", MakePacket<int>(i).At(Timestamp(i))));
+    }
+  }
+
+  // Closes the input stream, waits until the graph is done, and checks that
+  // the outputs were emitted in timestamp order.
+  void FinishGraph(int count) {
+    MP_ASSERT_OK(graph_.CloseInputStream("input"));
+    MP_ASSERT_OK(graph_.WaitUntilDone());
+    absl::ReaderMutexLock lock(&output_packets_mutex_);
+    ASSERT_EQ(output_packets_.size(), count);
+    for (int i = 0; i < count; ++i) {
+      EXPECT_EQ(output_packets_[i].Get<int>(), i);
+      EXPECT_EQ(output_packets_[i].Timestamp(), Timestamp(i));
+    }
+  }
+
+  CalculatorGraph graph_;
+  InvocationStats stats_;
+};
+
+// A stateless node without max_in_flight runs one timestamp per core.
+TEST_F(StatelessExecutionTest, RunsTimestampsConcurrently) {
+  const int expected_running = std::min(NumCPUCores(), 4);
+  {
+    absl::MutexLock lock(&stats_.mutex);
+    stats_.wait_for_running = expected_running;
+  }
+  StartGraph("");
+  AddInputs(20);
+  FinishGraph(20);
+  absl::MutexLock lock(&stats_.mutex);
+  EXPECT_EQ(stats_.max_running, expected_running);
+}
+
+// While the invocation at timestamp 0 is blocked, the node completes at most
+// max_in_flight later invocations, which wait to be emitted after it.
+TEST_F(StatelessExecutionTest, BoundsReorderBuffer) {
+  {
+    absl::MutexLock lock(&stats_.mutex);
+    stats_.hold_first = true;
+  }
+  StartGraph("max_in_flight: 2");
+  AddInputs(10);
+  {
+    absl::MutexLock lock(&stats_.mutex);
+    // Timestamp 0 and one more in flight, and two completed.
+    stats_.mutex.AwaitWithTimeout(
+        absl::Condition(
+            +[](InvocationStats* stats) { return stats->started >= 4; },
+            &stats_),
+        absl::Seconds(10));
+  }
+  absl::SleepFor(absl::Milliseconds(100));
+  {
+    absl::MutexLock lock(&stats_.mutex);
+    EXPECT_EQ(stats_.started, 4);
+    stats_.released = true;
+  }
+  FinishGraph(10);
+}
+
+// Passes its input through after a fixed amount of computation.
+class StatelessBusyCalculator : public CalculatorBase {
+ public:
+  static absl::Status GetContract(CalculatorContract* cc) {
+    cc->Inputs().Index(0).Set<int>();
+    cc->Outputs().Index(0).Set<int>();
+    cc->SetStateless(true);
+    return absl::OkStatus();
+  }
+
+  absl::Status Open(CalculatorContext* cc) final {
+    cc->SetOffset(TimestampDiff(0));
+    return absl::OkStatus();
+  }
+
+  absl::Status Process(CalculatorContext* cc) final {
+    BusySleep(absl::Microseconds(500));
+    cc->Outputs().Index(0).AddPacket(cc->Inputs().Index(0).Value());
+    return absl::OkStatus();
+  }
+};
+REGISTER_CALCULATOR(StatelessBusyCalculator);
+
+// Measures the throughput of a stateless node running on state.range(0)
+// threads.
+void BM_StatelessThroughput(benchmark::State& state) {
+  const int num_threads = state.range(0);
+  constexpr int kNumPackets = 64;
+  CalculatorGraphConfig graph_config =
+      mediapipe::ParseTextProtoOrDie<CalculatorGraphConfig>(absl::Substitute(
+          R"pb(
+            input_stream: "input"
+            output_stream: "output"
+            node {
+              calculator: "StatelessBusyCalculator"
+              input_stream: "input"
+              output_stream: "output"
+              max_in_flight: $0
+            }
+            num_threads: $0
+          )pb",
+          num_threads));
+  CalculatorGraph graph;
+  CHECK(graph.Initialize(graph_config).ok());
+  int num_outputs = 0;
+  CHECK(graph
+            .ObserveOutputStream("output",
+                                 [&num_outputs](const Packet&) {
+                                   ++num_outputs;
+                                   return absl::OkStatus();
+                                 })
+            .ok());
+  for (auto _ : state) {
+    CHECK(graph.StartRun({}).ok());
+    for (int i = 0; i < kNumPackets; ++i) {
+      CHECK(graph
+                .AddPacketToInputStream("input",
+                                        MakePacket<int>(i).At(Timestamp(i)))
+                .ok());
+    }
+    CHECK(graph.CloseAllInputStreams().ok());
+    CHECK(graph.WaitUntilDone().ok());
+  }
+  CHECK_EQ(num_outputs, state.iterations() * kNumPackets);
+  state.SetItemsProcessed(state.iterations() * kNumPackets);
+}
+BENCHMARK(BM_StatelessThroughput)
+    ->RangeMultiplier(2)
+    ->Range(1, 8)
+    ->UseRealTime();
+
 }  // namespace
 }  // namespace mediapipe
@@ -18,38 +18,9 @@
 
 #include "absl/strings/string_view.h"
 #include "absl/synchronization/mutex.h"
+#include "mediapipe/framework/profiler/metric_registry.h"
 
 namespace mediapipe {
-namespace {
-
-// Counter implementation when we're not using Flume.
-// TODO: Consider using Dax atomic counters instead of this.
-// This class is thread safe.
-class BasicCounter : public Counter {
- public:
-  explicit BasicCounter(const std::string& name) : value_(0) {}
-
-  void Increment() ABSL_LOCKS_EXCLUDED(mu_) override {
-    absl::WriterMutexLock lock(&mu_);
-    ++value_;
-  }
-
-  void IncrementBy(int amount) ABSL_LOCKS_EXCLUDED(mu_) override {
-    absl::WriterMutexLock lock(&mu_);
-    value_ += amount;
-  }
-
-  int64 Get() ABSL_LOCKS_EXCLUDED(mu_) override {
-    absl::ReaderMutexLock lock(&mu_);
-    return value_;
-  }
-
- private:
-  absl::Mutex mu_;
-  int64 value_ ABSL_GUARDED_BY(mu_);
-};
-
-}  // namespace
 
 CounterSet::CounterSet() {}
 
@@ -84,7 +55,7 @@ std::map<std::string, int64> CounterSet::GetCountersValues()
 }
 
 Counter* BasicCounterFactory::GetCounter(const std::string& name) {
-  return counter_set_.Emplace<BasicCounter>(name, name);
+  return counter_set_.Emplace<ShardedCounter>(name);
 }
 
 }  // namespace mediapipe
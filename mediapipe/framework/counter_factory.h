@@ -52,6 +52,14 @@ class CounterSet {
   template <typename CounterType, typename... Args>
   Counter* Emplace(const std::string& name, Args&&... args)
       ABSL_LOCKS_EXCLUDED(mu_) {
+    {
+      // Counters are usually looked up far more often than they are added.
+      absl::ReaderMutexLock lock(&mu_);
+      std::unique_ptr<Counter>* existing_counter = FindOrNull(counters_, name);
+      if (existing_counter) {
+        return existing_counter->get();
+      }
+    }
     absl::WriterMutexLock lock(&mu_);
     std::unique_ptr<Counter>* existing_counter = FindOrNull(counters_, name);
     if (existing_counter) {
@@ -85,7 +93,10 @@ class CounterFactory {
   CounterSet counter_set_;
 };
 
-// Counter factory that makes the counters be our own basic counters.
+// Counter factory that makes ShardedCounters, which can be incremented from
+// many threads without contention. Looking a counter up by name still takes
+// a lock, so calculators incrementing a counter for every packet should look
+// it up once, in Open().
 class BasicCounterFactory : public CounterFactory {
  public:
   ~BasicCounterFactory() override {}
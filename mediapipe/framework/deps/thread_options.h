@@ -26,7 +26,8 @@ namespace mediapipe {
 // the field descriptions.
 class ThreadOptions {
  public:
-  ThreadOptions() : stack_size_(0), nice_priority_level_(0) {}
+  ThreadOptions()
+      : stack_size_(0), nice_priority_level_(0), pin_threads_to_cores_(false) {}
 
   // Set the thread stack size (in bytes).  Passing stack_size==0 resets
   // the stack size to the default value for the system. The system default
@@ -46,6 +47,14 @@ class ThreadOptions {
     return *this;
   }
 
+  // If true, a thread pool binds each of its worker threads to a single
+  // processor instead of letting all of them float over cpu_set(). Only
+  // honored by thread pools that support it (see WorkStealingThreadPool).
+  ThreadOptions& set_pin_threads_to_cores(bool pin_threads_to_cores) {
+    pin_threads_to_cores_ = pin_threads_to_cores;
+    return *this;
+  }
+
   ThreadOptions& set_name_prefix(const std::string& name_prefix) {
     name_prefix_ = name_prefix;
     return *this;
@@ -57,13 +66,16 @@ class ThreadOptions {
 
   const std::set<int>& cpu_set() const { return cpu_set_; }
 
+  bool pin_threads_to_cores() const { return pin_threads_to_cores_; }
+
   std::string name_prefix() const { return name_prefix_; }
 
  private:
-  size_t stack_size_;        // Size of thread stack
-  int nice_priority_level_;  // Nice priority level of the workers
-  std::set<int> cpu_set_;    // CPU set for affinity setting
-  std::string name_prefix_;  // Name of the thread
+  size_t stack_size_;          // Size of thread stack
+  int nice_priority_level_;    // Nice priority level of the workers
+  std::set<int> cpu_set_;      // CPU set for affinity setting
+  bool pin_threads_to_cores_;  // Bind each worker to a single CPU
+  std::string name_prefix_;    // Name of the thread
 };
 
 }  // namespace mediapipe
@@ -0,0 +1,252 @@
+// Copyright 2022 The MediaPipe Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "mediapipe/framework/deps/work_stealing_threadpool.h"
+
+#include <errno.h>
+#include <string.h>
+
+#if defined(__linux__) || defined(__APPLE__)
+#include <pthread.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#include <algorithm>
+#include <iterator>
+#include <set>
+#include <utility>
+
+#include "absl/strings/str_join.h"
+#include "mediapipe/framework/deps/threadpool.h"
+#include "mediapipe/framework/port/logging.h"
+
+namespace mediapipe {
+
+namespace {
+
+// Identifies the pool and queue owned by the calling thread, if the calling
+// thread is a worker of a WorkStealingThreadPool.
+thread_local const void* current_pool = nullptr;
+thread_local int current_worker_index = -1;
+
+// Returns the processor that the worker with the given index is bound to
+// when ThreadOptions::pin_threads_to_cores() is set.
+int ProcessorForWorker(const ThreadOptions& thread_options, int worker_index) {
+  const std::set<int>& cpu_set = thread_options.cpu_set();
+  if (!cpu_set.empty()) {
+    auto it = cpu_set.begin();
+    std::advance(it, worker_index % cpu_set.size());
+    return *it;
+  }
+  const int num_processors =
+      std::max(1u, std::thread::hardware_concurrency());
+  return worker_index % num_processors;
+}
+
+}  // namespace
+
+WorkStealingThreadPool::WorkStealingThreadPool(const std::string& name_prefix,
+                                               int num_threads)
+    : WorkStealingThreadPool(ThreadOptions(), name_prefix, num_threads) {}
+
+WorkStealingThreadPool::WorkStealingThreadPool(
+    const ThreadOptions& thread_options, const std::string& name_prefix,
+    int num_threads)
+    : name_prefix_(name_prefix), thread_options_(thread_options) {
+  num_threads_ = (num_threads == 0) ? 1 : num_threads;
+  for (int i = 0; i < num_threads_; ++i) {
+    queues_.push_back(std::make_unique<WorkerQueue>());
+  }
+}
+
+WorkStealingThreadPool::~WorkStealingThreadPool() {
+  sleep_mutex_.Lock();
+  stopped_ = true;
+  sleep_condition_.SignalAll();
+  sleep_mutex_.Unlock();
+
+  for (std::thread& thread : threads_) {
+    thread.join();
+  }
+  threads_.clear();
+}
+
+void WorkStealingThreadPool::StartWorkers() {
+  for (int i = 0; i < num_threads_; ++i) {
+    threads_.emplace_back([this, i]() {
+      SetUpWorkerThread(i);
+      RunWorker(i);
+    });
+  }
+}
+
+void WorkStealingThreadPool::Schedule(std::function<void()> callback) {
+  int index;
+  if (current_pool == this) {
+    index = current_worker_index;
+  } else {
+    index = next_queue_.fetch_add(1, std::memory_order_relaxed) % num_threads_;
+  }
+  WorkerQueue& queue = *queues_[index];
+  queue.mutex.Lock();
+  queue.tasks.push_back(std::move(callback));
+  queue.mutex.Unlock();
+
+  // The increment of num_pending_tasks_ and the load of num_sleeping_workers_
+  // pair with the increment of num_sleeping_workers_ and the load of
+  // num_pending_tasks_ in RunWorker (all sequentially consistent), so either
+  // this thread sees the sleeping worker or the worker sees the new task.
+  num_pending_tasks_.fetch_add(1);
+  if (num_sleeping_workers_.load() > 0) {
+    sleep_mutex_.Lock();
+    sleep_condition_.Signal();
+    sleep_mutex_.Unlock();
+  }
+}
+
+int WorkStealingThreadPool::num_threads() const { return num_threads_; }
+
+const ThreadOptions& WorkStealingThreadPool::thread_options() const {
+  return thread_options_;
+}
+
+int64_t WorkStealingThreadPool::num_stolen_tasks() const {
+  return num_stolen_tasks_.load(std::memory_order_relaxed);
+}
+
+void WorkStealingThreadPool::RunWorker(int worker_index) {
+  current_pool = this;
+  current_worker_index = worker_index;
+  std::function<void()> task;
+  while (true) {
+    if (PopTask(worker_index, &task)) {
+      task();
+      task = nullptr;
+      continue;
+    }
+    sleep_mutex_.Lock();
+    num_sleeping_workers_.fetch_add(1);
+    while (num_pending_tasks_.load() == 0 && !stopped_) {
+      sleep_condition_.Wait(&sleep_mutex_);
+    }
+    num_sleeping_workers_.fetch_sub(1);
+    // Like ThreadPool, drain all pending callbacks before exiting.
+    const bool done = stopped_ && num_pending_tasks_.load() == 0;
+    sleep_mutex_.Unlock();
+    if (done) break;
+  }
+  current_pool = nullptr;
+  current_worker_index = -1;
+}
+
+bool WorkStealingThreadPool::PopTask(int worker_index,
+                                     std::function<void()>* task) {
+  WorkerQueue& queue = *queues_[worker_index];
+  queue.mutex.Lock();
+  if (!queue.tasks.empty()) {
+    *task = std::move(queue.tasks.front());
+    queue.tasks.pop_front();
+    queue.mutex.Unlock();
+    num_pending_tasks_.fetch_sub(1);
+    return true;
+  }
+  queue.mutex.Unlock();
+  // First try not to wait on queues that are busy, then fall back to
+  // blocking so that a pending task is never missed.
+  return StealTask(worker_index, /*blocking=*/false, task) ||
+         StealTask(worker_index, /*blocking=*/true, task);
+}
+
+bool WorkStealingThreadPool::StealTask(int worker_index, bool blocking,
+                                       std::function<void()>* task) {
+  for (int i = 1; i < num_threads_; ++i) {
+    if (num_pending_tasks_.load(std::memory_order_relaxed) == 0) return false;
+    WorkerQueue& victim = *queues_[(worker_index + i) % num_threads_];
+    if (blocking) {
+      victim.mutex.Lock();
+    } else if (!victim.mutex.TryLock()) {
+      continue;
+    }
+    if (!victim.tasks.empty()) {
+      // Take the callback that the owner would run last.
+      *task = std::move(victim.tasks.back());
+      victim.tasks.pop_back();
+      victim.mutex.Unlock();
+      num_pending_tasks_.fetch_sub(1);
+      num_stolen_tasks_.fetch_add(1, std::memory_order_relaxed);
+      return true;
+    }
+    victim.mutex.Unlock();
+  }
+  return false;
+}
+
+void WorkStealingThreadPool::SetUpWorkerThread(int worker_index) {
+  const int nice_priority_level = thread_options_.nice_priority_level();
+  std::set<int> selected_cpus = thread_options_.cpu_set();
+  if (thread_options_.pin_threads_to_cores()) {
+    selected_cpus = {ProcessorForWorker(thread_options_, worker_index)};
+  }
+#if defined(__linux__)
+  const std::string name =
+      internal::CreateThreadName(name_prefix_, syscall(SYS_gettid));
+  if (nice_priority_level != 0) {
+    if (nice(nice_priority_level) != -1 || errno == 0) {
+      VLOG(1) << "Changed the nice priority level by " << nice_priority_level;
+    } else {
+      LOG(ERROR) << "Error : " << strerror(errno) << std::endl
+                 << "Could not change the nice priority level by "
+                 << nice_priority_level;
+    }
+  }
+  if (!selected_cpus.empty()) {
+    cpu_set_t cpu_set;
+    CPU_ZERO(&cpu_set);
+    for (const int cpu : selected_cpus) {
+      CPU_SET(cpu, &cpu_set);
+    }
+    if (sched_setaffinity(syscall(SYS_gettid), sizeof(cpu_set_t), &cpu_set) !=
+            -1 ||
+        errno == 0) {
+      VLOG(1) << "Pinned worker " << worker_index << " to processor "
+              << absl::StrJoin(selected_cpus, ", processor ") << ".";
+    } else {
+      LOG(ERROR) << "Error : " << strerror(errno) << std::endl
+                 << "Failed to set processor affinity. Ignore processor "
+                    "affinity setting for now.";
+    }
+  }
+  int error = pthread_setname_np(pthread_self(), name.c_str());
+  if (error != 0) {
+    LOG(ERROR) << "Error : " << strerror(error) << std::endl
+               << "Failed to set name for thread: " << name;
+  }
+#else
+  const std::string name = internal::CreateThreadName(name_prefix_, 0);
+  if (nice_priority_level != 0 || !selected_cpus.empty()) {
+    LOG(ERROR) << "Thread priority and processor affinity feature aren't "
+                  "supported on the current platform.";
+  }
+#if __APPLE__
+  int error = pthread_setname_np(name.c_str());
+  if (error != 0) {
+    LOG(ERROR) << "Error : " << strerror(error) << std::endl
+               << "Failed to set name for thread: " << name;
+  }
+#endif  // __APPLE__
+#endif  // __linux__
+}
+
+}  // namespace mediapipe
@@ -0,0 +1,133 @@
+// Copyright 2022 The MediaPipe Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef MEDIAPIPE_DEPS_WORK_STEALING_THREADPOOL_H_
+#define MEDIAPIPE_DEPS_WORK_STEALING_THREADPOOL_H_
+
+#include <atomic>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <string>
+#include <thread>  // NOLINT(build/c++11)
+#include <vector>
+
+#include "absl/synchronization/mutex.h"
+#include "mediapipe/framework/deps/thread_options.h"
+
+namespace mediapipe {
+
+// A thread pool in which every worker thread owns its own task queue.
+//
+// ThreadPool keeps all pending callbacks in a single queue guarded by a
+// single mutex, which becomes the main point of contention when many busy
+// graphs share a machine with many cores. WorkStealingThreadPool instead
+// gives each worker its own queue:
+//
+// - Schedule() called from one of the pool's worker threads appends the
+//   callback to that worker's queue. Since the MediaPipe scheduler schedules
+//   follow-up work from inside running tasks, most callbacks never touch
+//   another thread's queue.
+// - Schedule() called from any other thread distributes callbacks over the
+//   worker queues in round-robin order.
+// - A worker whose queue is empty steals callbacks from the other queues
+//   before going to sleep.
+//
+// The pool is a drop-in replacement for ThreadPool, with the same interface
+// and the same shutdown semantics: the destructor waits for all scheduled
+// callbacks to complete. Unlike ThreadPool, callbacks are not guaranteed to
+// run in FIFO order, even with a single thread.
+//
+// If ThreadOptions::pin_threads_to_cores() is set, each worker thread is
+// bound to a single processor: the i-th worker to the i-th processor of
+// ThreadOptions::cpu_set() (wrapping around), or to processor i modulo the
+// number of processors if no cpu set is given.
+class WorkStealingThreadPool {
+ public:
+  // Creates a pool with "num_threads" worker threads, each with a private
+  // queue. "name_prefix" specifies the thread name prefix.
+  WorkStealingThreadPool(const std::string& name_prefix, int num_threads);
+  WorkStealingThreadPool(const ThreadOptions& thread_options,
+                         const std::string& name_prefix, int num_threads);
+  WorkStealingThreadPool(const WorkStealingThreadPool&) = delete;
+  WorkStealingThreadPool& operator=(const WorkStealingThreadPool&) = delete;
+
+  // Waits for closures (if any) to complete. May be called without
+  // having called StartWorkers().
+  ~WorkStealingThreadPool();
+
+  // REQUIRES: StartWorkers has not been called
+  // Actually start the worker threads.
+  void StartWorkers();
+
+  // REQUIRES: StartWorkers has been called
+  // Add specified callback to one of the worker queues. Eventually a
+  // thread will pull this callback off the queue and execute it.
+  void Schedule(std::function<void()> callback);
+
+  // Provided for debugging and testing only.
+  int num_threads() const;
+
+  // Standard thread options.  Use this accessor to get them.
+  const ThreadOptions& thread_options() const;
+
+  // Provided for debugging and testing only. Returns the number of
+  // callbacks that were run by a worker other than the one whose queue they
+  // were scheduled on.
+  int64_t num_stolen_tasks() const;
+
+ private:
+  // A per-worker queue. Aligned to a cache line so that queues of
+  // neighbouring workers do not share one.
+  struct alignas(64) WorkerQueue {
+    absl::Mutex mutex;
+    std::deque<std::function<void()>> tasks ABSL_GUARDED_BY(mutex);
+  };
+
+  // Applies the thread options (name, priority, affinity) to the calling
+  // worker thread.
+  void SetUpWorkerThread(int worker_index);
+  void RunWorker(int worker_index);
+
+  // Pops a callback from the worker's own queue, or steals one from another
+  // queue. Returns false if no callback was found.
+  bool PopTask(int worker_index, std::function<void()>* task);
+  bool StealTask(int worker_index, bool blocking, std::function<void()>* task);
+
+  std::string name_prefix_;
+  int num_threads_;
+  ThreadOptions thread_options_;
+
+  std::vector<std::unique_ptr<WorkerQueue>> queues_;
+  std::vector<std::thread> threads_;
+
+  // The number of callbacks that have been scheduled but not yet popped
+  // from a queue. Lets idle workers decide whether to sleep without locking
+  // every queue.
+  std::atomic<int64_t> num_pending_tasks_{0};
+  // The number of workers blocked on sleep_condition_. Schedule() only takes
+  // sleep_mutex_ when this is non-zero.
+  std::atomic<int> num_sleeping_workers_{0};
+  // Round-robin cursor for callbacks scheduled from non-worker threads.
+  std::atomic<uint32_t> next_queue_{0};
+  std::atomic<int64_t> num_stolen_tasks_{0};
+
+  absl::Mutex sleep_mutex_;
+  absl::CondVar sleep_condition_;
+  bool stopped_ ABSL_GUARDED_BY(sleep_mutex_) = false;
+};
+
+}  // namespace mediapipe
+
+#endif  // MEDIAPIPE_DEPS_WORK_STEALING_THREADPOOL_H_
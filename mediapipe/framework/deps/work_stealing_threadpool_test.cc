@@ -0,0 +1,124 @@
+// Copyright 2022 The MediaPipe Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "mediapipe/framework/deps/work_stealing_threadpool.h"
+
+#include <functional>
+
+#include "absl/synchronization/blocking_counter.h"
+#include "absl/synchronization/mutex.h"
+#include "absl/synchronization/notification.h"
+#include "mediapipe/framework/port/gtest.h"
+
+namespace mediapipe {
+
+TEST(WorkStealingThreadPoolTest, DestroyWithoutStart) {
+  WorkStealingThreadPool thread_pool("testpool", 10);
+}
+
+TEST(WorkStealingThreadPoolTest, EmptyThread) {
+  WorkStealingThreadPool thread_pool("testpool", 0);
+  ASSERT_EQ(1, thread_pool.num_threads());
+  thread_pool.StartWorkers();
+}
+
+TEST(WorkStealingThreadPoolTest, SingleThread) {
+  absl::Mutex mu;
+  int n = 100;
+  {
+    WorkStealingThreadPool thread_pool("testpool", 1);
+    ASSERT_EQ(1, thread_pool.num_threads());
+    thread_pool.StartWorkers();
+
+    for (int i = 0; i < 100; ++i) {
+      thread_pool.Schedule([&n, &mu]() mutable {
+        absl::MutexLock l(&mu);
+        --n;
+      });
+    }
+  }
+
+  EXPECT_EQ(0, n);
+}
+
+TEST(WorkStealingThreadPoolTest, MultiThreads) {
+  absl::Mutex mu;
+  int n = 100;
+  {
+    WorkStealingThreadPool thread_pool("testpool", 10);
+    ASSERT_EQ(10, thread_pool.num_threads());
+    thread_pool.StartWorkers();
+
+    for (int i = 0; i < 100; ++i) {
+      thread_pool.Schedule([&n, &mu]() mutable {
+        absl::MutexLock l(&mu);
+        --n;
+      });
+    }
+  }
+
+  EXPECT_EQ(0, n);
+}
+
+// Callbacks scheduled from a worker thread go to that worker's own queue, so
+// the other workers have to steal them while that worker is busy.
+TEST(WorkStealingThreadPoolTest, IdleWorkersStealNestedTasks) {
+  constexpr int kNumTasks = 1000;
+  absl::BlockingCounter done(kNumTasks);
+  absl::Notification all_done;
+  WorkStealingThreadPool thread_pool("testpool", 4);
+  thread_pool.StartWorkers();
+  thread_pool.Schedule([&]() {
+    for (int i = 0; i < kNumTasks; ++i) {
+      thread_pool.Schedule([&]() { done.DecrementCount(); });
+    }
+    // Keep this worker busy until the other workers have drained its queue.
+    all_done.WaitForNotification();
+  });
+  done.Wait();
+  all_done.Notify();
+  EXPECT_EQ(kNumTasks, thread_pool.num_stolen_tasks());
+}
+
+TEST(WorkStealingThreadPoolTest, TasksScheduledDuringShutdownRun) {
+  absl::Mutex mu;
+  int n = 0;
+  {
+    WorkStealingThreadPool thread_pool("testpool", 4);
+    thread_pool.StartWorkers();
+    for (int i = 0; i < 10; ++i) {
+      thread_pool.Schedule([&]() {
+        for (int j = 0; j < 10; ++j) {
+          thread_pool.Schedule([&]() {
+            absl::MutexLock l(&mu);
+            ++n;
+          });
+        }
+      });
+    }
+  }
+
+  EXPECT_EQ(100, n);
+}
+
+TEST(WorkStealingThreadPoolTest, CreateWithCorePinning) {
+  ThreadOptions thread_options =
+      ThreadOptions().set_cpu_set({0}).set_pin_threads_to_cores(true);
+  WorkStealingThreadPool thread_pool(thread_options, "testpool", 4);
+  ASSERT_EQ(4, thread_pool.num_threads());
+  ASSERT_TRUE(thread_pool.thread_options().pin_threads_to_cores());
+  thread_pool.StartWorkers();
+}
+
+}  // namespace mediapipe
@@ -15,6 +15,7 @@
 #include "mediapipe/framework/formats/image_frame_pool.h"
 
 #include "absl/synchronization/mutex.h"
+#include "mediapipe/framework/port/logging.h"
 
 namespace mediapipe {
 
@@ -85,4 +86,21 @@ void ImageFramePool::TrimAvailable(
   }
 }
 
+std::unique_ptr<ImageFrame> CreateImageFrameFromPool(
+    ImageFormat::Format format, int width, int height,
+    uint32 alignment_boundary, SharedBufferPool* pool) {
+  CHECK_NE(ImageFormat::UNKNOWN, format);
+  CHECK_GT(alignment_boundary, 0);
+  CHECK_EQ(alignment_boundary & (alignment_boundary - 1), 0);
+  CHECK_LE(alignment_boundary, SharedBufferPool::kAlignment);
+  int width_step = width * ImageFrame::NumberOfChannelsForFormat(format) *
+                   ImageFrame::ByteDepthForFormat(format);
+  width_step = ((width_step - 1) | (alignment_boundary - 1)) + 1;
+  const size_t size = static_cast<size_t>(height) * width_step;
+  uint8* pixel_data = static_cast<uint8*>(pool->Allocate(size));
+  return std::make_unique<ImageFrame>(
+      format, width, height, width_step, pixel_data,
+      [pool, size](uint8* data) { pool->Release(data, size); });
+}
+
 }  // namespace mediapipe
@@ -23,6 +23,7 @@
 
 #include "absl/synchronization/mutex.h"
 #include "mediapipe/framework/formats/image_frame.h"
+#include "mediapipe/framework/formats/shared_buffer_pool.h"
 
 namespace mediapipe {
 
@@ -73,6 +74,16 @@ class ImageFramePool : public std::enable_shared_from_this<ImageFramePool> {
   std::vector<std::unique_ptr<ImageFrame>> available_ ABSL_GUARDED_BY(mutex_);
 };
 
+// Creates an ImageFrame whose pixel data is allocated from "pool", and returned
+// to it when the ImageFrame is destroyed. Unlike ImageFramePool, the pool is
+// shared by ImageFrames of any dimensions and format. The rows are aligned as
+// by ImageFrame(format, width, height, alignment_boundary), which must be at
+// most SharedBufferPool::kAlignment.
+std::unique_ptr<ImageFrame> CreateImageFrameFromPool(
+    ImageFormat::Format format, int width, int height,
+    uint32 alignment_boundary = ImageFrame::kDefaultAlignmentBoundary,
+    SharedBufferPool* pool = &SharedBufferPool::Get());
+
 }  // namespace mediapipe
 
 #endif  // MEDIAPIPE_FRAMEWORK_FORMATS_IMAGE_FRAME_POOL_H_
@@ -0,0 +1,171 @@
+// Copyright 2022 The MediaPipe Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "mediapipe/framework/formats/shared_buffer_pool.h"
+
+#include <utility>
+
+#include "mediapipe/framework/deps/no_destructor.h"
+#include "mediapipe/framework/port/aligned_malloc_and_free.h"
+#include "mediapipe/framework/port/logging.h"
+
+namespace mediapipe {
+
+namespace {
+
+void FreeBuffers(const std::vector<void*>& buffers) {
+  for (void* buffer : buffers) {
+    aligned_free(buffer);
+  }
+}
+
+}  // namespace
+
+SharedBufferPool::SharedBufferPool(int64 byte_budget) {
+  stats_.byte_budget = byte_budget;
+}
+
+SharedBufferPool::~SharedBufferPool() {
+  Trim();
+  absl::MutexLock lock(&mutex_);
+  LOG_IF(ERROR, stats_.bytes_in_use > 0)
+      << "SharedBufferPool destroyed with " << stats_.bytes_in_use
+      << " bytes in use.";
+}
+
+SharedBufferPool& SharedBufferPool::Get() { return *GetShared(); }
+
+const std::shared_ptr<SharedBufferPool>& SharedBufferPool::GetShared() {
+  static NoDestructor<std::shared_ptr<SharedBufferPool>> pool(
+      std::make_shared<SharedBufferPool>());
+  return *pool;
+}
+
+size_t SharedBufferPool::SizeClass(size_t size) {
+  if (size <= kMinSizeClass) {
+    return kMinSizeClass;
+  }
+  // Rounds up to a multiple of a quarter of the largest power of two below
+  // "size".
+  int log2 = 0;
+  for (size_t x = size - 1; x > 1; x >>= 1) {
+    ++log2;
+  }
+  const size_t step = size_t{1} << (log2 - 2);
+  return (size + step - 1) & ~(step - 1);
+}
+
+void* SharedBufferPool::Allocate(size_t size) {
+  const size_t size_class = SizeClass(size);
+  std::vector<void*> trimmed;
+  void* buffer = nullptr;
+  {
+    absl::MutexLock lock(&mutex_);
+    auto it = available_.find(size_class);
+    if (it != available_.end() && !it->second.buffers.empty()) {
+      buffer = it->second.buffers.back();
+      it->second.buffers.pop_back();
+      stats_.bytes_available -= size_class;
+      ++stats_.hit_count;
+    } else {
+      TrimToBudget(size_class, &trimmed);
+      ++stats_.miss_count;
+    }
+    stats_.bytes_in_use += size_class;
+  }
+  FreeBuffers(trimmed);
+  if (!buffer) {
+    buffer = aligned_malloc(size_class, kAlignment);
+    CHECK(buffer) << "Failed to allocate " << size_class << " bytes.";
+  }
+  return buffer;
+}
+
+void SharedBufferPool::Release(void* buffer, size_t size) {
+  const size_t size_class = SizeClass(size);
+  {
+    absl::MutexLock lock(&mutex_);
+    stats_.bytes_in_use -= size_class;
+    if (stats_.bytes_in_use + stats_.bytes_available + size_class <=
+        stats_.byte_budget) {
+      SizeClassBuffers& buffers = available_[size_class];
+      buffers.buffers.push_back(buffer);
+      buffers.last_release = ++release_count_;
+      stats_.bytes_available += size_class;
+      return;
+    }
+    stats_.bytes_trimmed += size_class;
+  }
+  aligned_free(buffer);
+}
+
+void SharedBufferPool::SetByteBudget(int64 byte_budget) {
+  std::vector<void*> trimmed;
+  {
+    absl::MutexLock lock(&mutex_);
+    stats_.byte_budget = byte_budget;
+    TrimToBudget(0, &trimmed);
+  }
+  FreeBuffers(trimmed);
+}
+
+void SharedBufferPool::Trim() {
+  std::vector<void*> trimmed;
+  {
+    absl::MutexLock lock(&mutex_);
+    for (auto& size_class_and_buffers : available_) {
+      std::vector<void*>& buffers = size_class_and_buffers.second.buffers;
+      trimmed.insert(trimmed.end(), buffers.begin(), buffers.end());
+      buffers.clear();
+    }
+    available_.clear();
+    stats_.bytes_available = 0;
+  }
+  FreeBuffers(trimmed);
+}
+
+SharedBufferPool::Stats SharedBufferPool::GetStats() const {
+  absl::MutexLock lock(&mutex_);
+  return stats_;
+}
+
+void SharedBufferPool::TrimToBudget(size_t size, std::vector<void*>* trimmed) {
+  while (stats_.bytes_available > 0 &&
+         stats_.bytes_in_use + stats_.bytes_available + size >
+             stats_.byte_budget) {
+    auto oldest = available_.end();
+    for (auto it = available_.begin(); it != available_.end(); ++it) {
+      if (!it->second.buffers.empty() &&
+          (oldest == available_.end() ||
+           it->second.last_release < oldest->second.last_release)) {
+        oldest = it;
+      }
+    }
+    const size_t size_class = oldest->first;
+    std::vector<void*>& buffers = oldest->second.buffers;
+    while (!buffers.empty() &&
+           stats_.bytes_in_use + stats_.bytes_available + size >
+               stats_.byte_budget) {
+      trimmed->push_back(buffers.back());
+      buffers.pop_back();
+      stats_.bytes_available -= size_class;
+      stats_.bytes_trimmed += size_class;
+    }
+    if (buffers.empty()) {
+      available_.erase(oldest);
+    }
+  }
+}
+
+}  // namespace mediapipe
@@ -0,0 +1,124 @@
+// Copyright 2022 The MediaPipe Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef MEDIAPIPE_FRAMEWORK_FORMATS_SHARED_BUFFER_POOL_H_
+#define MEDIAPIPE_FRAMEWORK_FORMATS_SHARED_BUFFER_POOL_H_
+
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+#include "absl/container/flat_hash_map.h"
+#include "absl/synchronization/mutex.h"
+#include "mediapipe/framework/port/integral_types.h"
+
+namespace mediapipe {
+
+// A pool of CPU buffers for the pixel data of ImageFrames and the elements of
+// Tensors. SharedBufferPool::Get() returns a pool shared by all the graphs of
+// the process.
+//
+// Unlike ImageFramePool, which keeps buffers of one width, height and format,
+// buffers are bucketed by size class: a request is rounded up to its size
+// class, and any buffer of that class can serve it. Each power of two is
+// divided into four size classes, so that less than a quarter of the requested
+// size is wasted.
+//
+// Released buffers are kept for reuse as long as the bytes of the buffers
+// allocated from the pool, in use or available, stay within the byte budget.
+// An allocation that would exceed the budget first frees available buffers,
+// from the size classes that were released to least recently. Buffers in use
+// are never freed, so the budget is exceeded if they don't fit in it.
+//
+// The pool is thread-safe.
+class SharedBufferPool {
+ public:
+  // Alignment of all the buffers, which is the largest alignment that
+  // ImageFrame and Tensor use.
+  static constexpr int kAlignment = 64;
+  // Smallest size class.
+  static constexpr size_t kMinSizeClass = 256;
+  // Byte budget of the pool returned by Get(), unless changed.
+  static constexpr int64 kDefaultByteBudget = int64{256} << 20;
+
+  struct Stats {
+    // Number of allocations served by an available buffer.
+    int64 hit_count = 0;
+    // Number of allocations of new buffers.
+    int64 miss_count = 0;
+    // Bytes of the buffers in use.
+    int64 bytes_in_use = 0;
+    // Bytes of the buffers available for reuse.
+    int64 bytes_available = 0;
+    // Bytes of the available buffers freed to stay within the budget.
+    int64 bytes_trimmed = 0;
+    int64 byte_budget = 0;
+  };
+
+  explicit SharedBufferPool(int64 byte_budget = kDefaultByteBudget);
+  // All the buffers must have been released.
+  ~SharedBufferPool();
+
+  SharedBufferPool(const SharedBufferPool&) = delete;
+  SharedBufferPool& operator=(const SharedBufferPool&) = delete;
+
+  // Returns the pool shared by all the graphs of the process, which is never
+  // destroyed.
+  static SharedBufferPool& Get();
+  // Same as Get(), for owners of a std::shared_ptr such as Tensor.
+  static const std::shared_ptr<SharedBufferPool>& GetShared();
+
+  // Returns a buffer of SizeClass(size) bytes aligned to kAlignment, which
+  // must be released with Release(buffer, size).
+  void* Allocate(size_t size);
+
+  // Returns a buffer obtained from Allocate(size) to the pool.
+  void Release(void* buffer, size_t size);
+
+  // Sets the byte budget, freeing the available buffers in excess of it.
+  void SetByteBudget(int64 byte_budget);
+
+  // Frees all the available buffers.
+  void Trim();
+
+  Stats GetStats() const;
+
+  // Returns the size of the buffers allocated for requests of "size" bytes.
+  static size_t SizeClass(size_t size);
+
+ private:
+  struct SizeClassBuffers {
+    // Available buffers, the most recently released last.
+    std::vector<void*> buffers;
+    // Value of release_count_ when a buffer was last released to the class.
+    int64 last_release = 0;
+  };
+
+  // Removes available buffers, from the size classes released to least
+  // recently, until "size" more bytes fit in the budget or no buffer is
+  // available. The removed buffers are appended to "trimmed" to be freed
+  // without holding the lock.
+  void TrimToBudget(size_t size, std::vector<void*>* trimmed)
+      ABSL_EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+
+  mutable absl::Mutex mutex_;
+  absl::flat_hash_map<size_t, SizeClassBuffers> available_
+      ABSL_GUARDED_BY(mutex_);
+  int64 release_count_ ABSL_GUARDED_BY(mutex_) = 0;
+  Stats stats_ ABSL_GUARDED_BY(mutex_);
+};
+
+}  // namespace mediapipe
+
+#endif  // MEDIAPIPE_FRAMEWORK_FORMATS_SHARED_BUFFER_POOL_H_
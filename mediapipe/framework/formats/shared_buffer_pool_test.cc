@@ -0,0 +1,217 @@
+// Copyright 2022 The MediaPipe Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "mediapipe/framework/formats/shared_buffer_pool.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "mediapipe/framework/formats/image_frame.h"
+#include "mediapipe/framework/formats/image_frame_pool.h"
+#include "mediapipe/framework/formats/tensor.h"
+#include "mediapipe/framework/port/benchmark.h"
+#include "mediapipe/framework/port/gmock.h"
+#include "mediapipe/framework/port/gtest.h"
+#include "mediapipe/framework/port/threadpool.h"
+#include "absl/synchronization/blocking_counter.h"
+
+namespace mediapipe {
+namespace {
+
+bool IsAligned(const void* buffer) {
+  return reinterpret_cast<uintptr_t>(buffer) % SharedBufferPool::kAlignment ==
+         0;
+}
+
+TEST(SharedBufferPoolTest, SizeClass) {
+  EXPECT_EQ(SharedBufferPool::SizeClass(0), 256);
+  EXPECT_EQ(SharedBufferPool::SizeClass(1), 256);
+  EXPECT_EQ(SharedBufferPool::SizeClass(256), 256);
+  EXPECT_EQ(SharedBufferPool::SizeClass(257), 320);
+  EXPECT_EQ(SharedBufferPool::SizeClass(320), 320);
+  EXPECT_EQ(SharedBufferPool::SizeClass(321), 384);
+  EXPECT_EQ(SharedBufferPool::SizeClass(512), 512);
+  EXPECT_EQ(SharedBufferPool::SizeClass(513), 640);
+  EXPECT_EQ(SharedBufferPool::SizeClass(640 * 480 * 3), 1048576);
+  EXPECT_EQ(SharedBufferPool::SizeClass(1920 * 1080 * 3), 6291456);
+  for (size_t size = 1; size < (1 << 16); size += 7) {
+    const size_t size_class = SharedBufferPool::SizeClass(size);
+    EXPECT_GE(size_class, size);
+    EXPECT_LE(size_class, std::max<size_t>(size + size / 4, 256));
+    EXPECT_EQ(SharedBufferPool::SizeClass(size_class), size_class);
+  }
+}
+
+TEST(SharedBufferPoolTest, ReusesBuffersOfSizeClass) {
+  SharedBufferPool pool;
+  void* buffer = pool.Allocate(1000);
+  EXPECT_TRUE(IsAligned(buffer));
+  SharedBufferPool::Stats stats = pool.GetStats();
+  EXPECT_EQ(stats.miss_count, 1);
+  EXPECT_EQ(stats.hit_count, 0);
+  EXPECT_EQ(stats.bytes_in_use, 1024);
+  pool.Release(buffer, 1000);
+  stats = pool.GetStats();
+  EXPECT_EQ(stats.bytes_in_use, 0);
+  EXPECT_EQ(stats.bytes_available, 1024);
+
+  // A request of the same size class reuses the buffer.
+  void* reused = pool.Allocate(900);
+  EXPECT_EQ(reused, buffer);
+  stats = pool.GetStats();
+  EXPECT_EQ(stats.hit_count, 1);
+  EXPECT_EQ(stats.bytes_available, 0);
+
+  // A request of another size class doesn't.
+  void* other = pool.Allocate(2000);
+  EXPECT_NE(other, buffer);
+  EXPECT_EQ(pool.GetStats().miss_count, 2);
+  pool.Release(reused, 900);
+  pool.Release(other, 2000);
+  EXPECT_EQ(pool.GetStats().bytes_available, 1024 + 2048);
+
+  pool.Trim();
+  stats = pool.GetStats();
+  EXPECT_EQ(stats.bytes_available, 0);
+  EXPECT_EQ(stats.bytes_in_use, 0);
+}
+
+TEST(SharedBufferPoolTest, StaysWithinByteBudget) {
+  SharedBufferPool pool(/*byte_budget=*/4096);
+  void* a = pool.Allocate(1024);
+  void* b = pool.Allocate(2048);
+  void* c = pool.Allocate(1024);
+  pool.Release(b, 2048);
+  pool.Release(a, 1024);
+  EXPECT_EQ(pool.GetStats().bytes_available, 3072);
+
+  // Allocating 2048 new bytes frees the least recently released class first.
+  void* d = pool.Allocate(1536);
+  SharedBufferPool::Stats stats = pool.GetStats();
+  EXPECT_EQ(stats.bytes_trimmed, 2048);
+  EXPECT_EQ(stats.bytes_available, 1024);
+  EXPECT_EQ(stats.bytes_in_use, 1024 + 1536);
+
+  // Buffers in use are never freed, but aren't kept once released in excess
+  // of the budget.
+  void* e = pool.Allocate(4096);
+  stats = pool.GetStats();
+  EXPECT_EQ(stats.bytes_available, 0);
+  EXPECT_EQ(stats.bytes_in_use, 1024 + 1536 + 4096);
+  pool.Release(e, 4096);
+  stats = pool.GetStats();
+  EXPECT_EQ(stats.bytes_available, 0);
+  EXPECT_EQ(stats.bytes_trimmed, 2048 + 1024 + 4096);
+
+  pool.Release(c, 1024);
+  pool.Release(d, 1536);
+  EXPECT_EQ(pool.GetStats().bytes_available, 1024 + 1536);
+  pool.SetByteBudget(2000);
+  stats = pool.GetStats();
+  EXPECT_LE(stats.bytes_available, 2000);
+  EXPECT_EQ(stats.byte_budget, 2000);
+}
+
+TEST(SharedBufferPoolTest, CreatesImageFrames) {
+  SharedBufferPool pool;
+  const uint8* pixel_data;
+  {
+    std::unique_ptr<ImageFrame> frame =
+        CreateImageFrameFromPool(ImageFormat::SRGB, 101, 20,
+                                 ImageFrame::kDefaultAlignmentBoundary, &pool);
+    EXPECT_EQ(frame->Width(), 101);
+    EXPECT_EQ(frame->Height(), 20);
+    EXPECT_EQ(frame->WidthStep(), 304);
+    EXPECT_TRUE(frame->IsAligned(ImageFrame::kDefaultAlignmentBoundary));
+    pixel_data = frame->PixelData();
+    EXPECT_EQ(pool.GetStats().bytes_in_use,
+              SharedBufferPool::SizeClass(304 * 20));
+  }
+  EXPECT_EQ(pool.GetStats().bytes_in_use, 0);
+  // A frame of another format and dimensions but the same size class reuses
+  // the pixel data.
+  std::unique_ptr<ImageFrame> frame = CreateImageFrameFromPool(
+      ImageFormat::GRAY8, 300, 20, ImageFrame::kDefaultAlignmentBoundary,
+      &pool);
+  EXPECT_EQ(frame->PixelData(), pixel_data);
+  EXPECT_EQ(pool.GetStats().hit_count, 1);
+}
+
+TEST(SharedBufferPoolTest, CreatesTensors) {
+  auto pool = std::make_shared<SharedBufferPool>();
+  const void* buffer;
+  {
+    Tensor tensor(Tensor::ElementType::kFloat32, Tensor::Shape{1, 8, 8, 3},
+                  pool);
+    // The buffer is allocated on first access.
+    EXPECT_EQ(pool->GetStats().miss_count, 0);
+    auto view = tensor.GetCpuWriteView();
+    buffer = view.buffer<float>();
+    EXPECT_TRUE(IsAligned(buffer));
+    EXPECT_EQ(pool->GetStats().bytes_in_use, 768);
+  }
+  EXPECT_EQ(pool->GetStats().bytes_in_use, 0);
+  Tensor tensor(Tensor::ElementType::kFloat32, Tensor::Shape{1, 8, 8, 3},
+                pool);
+  // The buffer moves with the tensor.
+  Tensor moved(std::move(tensor));
+  EXPECT_EQ(moved.GetCpuWriteView().buffer<float>(), buffer);
+  EXPECT_EQ(pool->GetStats().hit_count, 1);
+}
+
+TEST(SharedBufferPoolTest, IsThreadSafe) {
+  constexpr int kNumThreads = 8;
+  constexpr int kNumIterations = 1000;
+  SharedBufferPool pool(/*byte_budget=*/1 << 16);
+  {
+    ThreadPool thread_pool("shared_buffer_pool_test", kNumThreads);
+    thread_pool.StartWorkers();
+    absl::BlockingCounter done(kNumThreads);
+    for (int t = 0; t < kNumThreads; ++t) {
+      thread_pool.Schedule([&pool, &done, t] {
+        for (int i = 0; i < kNumIterations; ++i) {
+          const size_t size = 256 * (1 + (i + t) % 16);
+          void* buffer = pool.Allocate(size);
+          static_cast<char*>(buffer)[size - 1] = 1;
+          pool.Release(buffer, size);
+        }
+        done.DecrementCount();
+      });
+    }
+    done.Wait();
+  }
+  const SharedBufferPool::Stats stats = pool.GetStats();
+  EXPECT_EQ(stats.hit_count + stats.miss_count, kNumThreads * kNumIterations);
+  EXPECT_EQ(stats.bytes_in_use, 0);
+  EXPECT_LE(stats.bytes_available, 1 << 16);
+}
+
+// Creates, fills and destroys a 1280x720 RGB ImageFrame, with its pixel data
+// allocated from the shared pool if state.range(0) is 1.
+void BM_CreateImageFrame(benchmark::State& state) {
+  const bool use_pool = state.range(0);
+  for (auto _ : state) {
+    std::unique_ptr<ImageFrame> frame =
+        use_pool ? CreateImageFrameFromPool(ImageFormat::SRGB, 1280, 720)
+                 : std::make_unique<ImageFrame>(ImageFormat::SRGB, 1280, 720);
+    frame->SetToZero();
+    benchmark::DoNotOptimize(frame->MutablePixelData());
+  }
+}
+BENCHMARK(BM_CreateImageFrame)->Arg(0)->Arg(1);
+
+}  // namespace
+}  // namespace mediapipe
@@ -25,7 +25,7 @@
 #include <mach/mach_init.h>
 #include <mach/vm_map.h>
 #else
-#include <cstdlib>
+#include "mediapipe/framework/port/aligned_malloc_and_free.h"
 #endif  // MEDIAPIPE_METAL_ENABLED
 
 namespace mediapipe {
@@ -370,6 +370,7 @@ void Tensor::Move(Tensor* src) {
   src->element_type_ = ElementType::kNone;  // Mark as invalidated.
   cpu_buffer_ = src->cpu_buffer_;
   src->cpu_buffer_ = nullptr;
+  cpu_buffer_pool_ = std::move(src->cpu_buffer_pool_);
 #if MEDIAPIPE_METAL_ENABLED
   device_ = src->device_;
   command_buffer_ = src->command_buffer_;
@@ -395,6 +396,12 @@ void Tensor::Move(Tensor* src) {
 Tensor::Tensor(ElementType element_type, const Shape& shape)
     : element_type_(element_type), shape_(shape) {}
 
+Tensor::Tensor(ElementType element_type, const Shape& shape,
+               std::shared_ptr<SharedBufferPool> cpu_buffer_pool)
+    : element_type_(element_type),
+      shape_(shape),
+      cpu_buffer_pool_(std::move(cpu_buffer_pool)) {}
+
 void Tensor::Invalidate() {
 #if MEDIAPIPE_OPENGL_ES_VERSION >= MEDIAPIPE_OPENGL_ES_30
   GLuint cleanup_gl_tex = GL_INVALID_INDEX;
@@ -411,8 +418,10 @@ void Tensor::Invalidate() {
     }
     metal_buffer_ = nil;
 #else
-    if (cpu_buffer_) {
-      free(cpu_buffer_);
+    if (cpu_buffer_ && cpu_buffer_pool_) {
+      cpu_buffer_pool_->Release(cpu_buffer_, bytes());
+    } else if (cpu_buffer_) {
+      aligned_free(cpu_buffer_);
     }
 #endif  // MEDIAPIPE_METAL_ENABLED
     cpu_buffer_ = nullptr;
@@ -448,6 +457,14 @@ void Tensor::Invalidate() {
 }
 
 Tensor::CpuReadView Tensor::GetCpuReadView() const {
+  {
+    // Readers share the mutex unless the content must first be transferred to
+    // the CPU.
+    auto reader_lock = absl::make_unique<absl::ReaderMutexLock>(&view_mutex_);
+    if (valid_ & kValidCpu) {
+      return {cpu_buffer_, std::move(reader_lock)};
+    }
+  }
   auto lock = absl::make_unique<absl::MutexLock>(&view_mutex_);
   LOG_IF(FATAL, valid_ == kValidNone)
       << "Tensor must be written prior to read from.";
@@ -527,7 +544,13 @@ void Tensor::AllocateCpuBuffer() const {
 #if MEDIAPIPE_METAL_ENABLED
     cpu_buffer_ = AllocateVirtualMemory(bytes());
 #else
-    cpu_buffer_ = malloc(bytes());
+    if (cpu_buffer_pool_) {
+      static_assert(SharedBufferPool::kAlignment % kCpuBufferAlignment == 0,
+                    "Pooled buffers must be aligned as CPU buffers.");
+      cpu_buffer_ = cpu_buffer_pool_->Allocate(bytes());
+    } else {
+      cpu_buffer_ = aligned_malloc(bytes(), kCpuBufferAlignment);
+    }
 #endif  // MEDIAPIPE_METAL_ENABLED
   }
 }
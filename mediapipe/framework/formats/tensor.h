@@ -17,6 +17,7 @@
 
 #include <algorithm>
 #include <initializer_list>
+#include <memory>
 #include <tuple>
 #include <type_traits>
 #include <utility>
@@ -24,6 +25,7 @@
 
 #include "absl/memory/memory.h"
 #include "absl/synchronization/mutex.h"
+#include "mediapipe/framework/formats/shared_buffer_pool.h"
 #include "mediapipe/framework/port.h"
 
 #if MEDIAPIPE_METAL_ENABLED
@@ -42,7 +44,10 @@ namespace mediapipe {
 // Texture2DView is limited to 4 dimensions.
 // The content is accessible through requesting device specific views.
 // Acquiring a view guarantees that the content is not changed by another thread
-// until the view is released.
+// until the view is released. CPU read views of a tensor whose content is
+// already on the CPU don't exclude each other, so that calculators on parallel
+// branches of a graph can read one tensor concurrently. All the other views are
+// exclusive.
 //
 // Tensor::MtlBufferView view = tensor.GetMtlBufferWriteView(mtl_device);
 // mtl_device is used to create MTLBuffer
@@ -71,7 +76,10 @@ class Tensor {
 
    protected:
     View(std::unique_ptr<absl::MutexLock>&& lock) : lock_(std::move(lock)) {}
+    View(std::unique_ptr<absl::ReaderMutexLock>&& reader_lock)
+        : reader_lock_(std::move(reader_lock)) {}
     std::unique_ptr<absl::MutexLock> lock_;
+    std::unique_ptr<absl::ReaderMutexLock> reader_lock_;
   };
 
  public:
@@ -90,6 +98,11 @@ class Tensor {
   };
 
   Tensor(ElementType element_type, const Shape& shape);
+  // Allocates the CPU buffer from "cpu_buffer_pool", if not null, and returns
+  // it to the pool when the tensor is destroyed. The pool is not used on
+  // platforms where the CPU buffer is shared with Metal.
+  Tensor(ElementType element_type, const Shape& shape,
+         std::shared_ptr<SharedBufferPool> cpu_buffer_pool);
 
   // Non-copyable.
   Tensor(const Tensor&) = delete;
@@ -116,8 +129,13 @@ class Tensor {
     friend class Tensor;
     CpuView(T* buffer, std::unique_ptr<absl::MutexLock>&& lock)
         : View(std::move(lock)), buffer_(buffer) {}
+    CpuView(T* buffer, std::unique_ptr<absl::ReaderMutexLock>&& reader_lock)
+        : View(std::move(reader_lock)), buffer_(buffer) {}
     T* buffer_;
   };
+  // CPU buffers are aligned to kCpuBufferAlignment bytes, so that inference
+  // engines can read from and write into them without copying.
+  static constexpr int kCpuBufferAlignment = 64;
   using CpuReadView = CpuView<const void>;
   CpuReadView GetCpuReadView() const;
   using CpuWriteView = CpuView<void>;
@@ -250,10 +268,12 @@ class Tensor {
   // A list of resource which are currently allocated and synchronized between
   // each-other: valid_ = kValidCpu | kValidMetalBuffer;
   mutable int valid_ = 0;
-  // The mutex is locked by Get*View and is kept by all Views.
+  // The mutex is locked by Get*View and is kept by all Views. CPU read views
+  // of valid CPU content keep a reader lock, the other views a writer lock.
   mutable absl::Mutex view_mutex_;
 
   mutable void* cpu_buffer_ = nullptr;
+  std::shared_ptr<SharedBufferPool> cpu_buffer_pool_;
   void AllocateCpuBuffer() const;
 #if MEDIAPIPE_METAL_ENABLED
   mutable id<MTLCommandBuffer> command_buffer_;
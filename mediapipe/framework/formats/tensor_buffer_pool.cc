@@ -0,0 +1,30 @@
+// Copyright 2022 The MediaPipe Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "mediapipe/framework/formats/tensor_buffer_pool.h"
+
+namespace mediapipe {
+
+const GraphService<TensorBufferPool> kTensorBufferPoolService(
+    "kTensorBufferPoolService");
+
+TensorBufferPool::TensorBufferPool(int64 byte_budget)
+    : buffer_pool_(std::make_shared<SharedBufferPool>(byte_budget)) {}
+
+Tensor TensorBufferPool::CreateTensor(Tensor::ElementType element_type,
+                                      const Tensor::Shape& shape) const {
+  return Tensor(element_type, shape, buffer_pool_);
+}
+
+}  // namespace mediapipe
@@ -0,0 +1,73 @@
+// Copyright 2022 The MediaPipe Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef MEDIAPIPE_FRAMEWORK_FORMATS_TENSOR_BUFFER_POOL_H_
+#define MEDIAPIPE_FRAMEWORK_FORMATS_TENSOR_BUFFER_POOL_H_
+
+#include <memory>
+
+#include "mediapipe/framework/formats/shared_buffer_pool.h"
+#include "mediapipe/framework/formats/tensor.h"
+#include "mediapipe/framework/graph_service.h"
+#include "mediapipe/framework/port/integral_types.h"
+
+namespace mediapipe {
+
+// A pool of Tensor CPU buffers for the calculators of a graph. A tensor drawn
+// from the pool returns its buffer when it is destroyed, that is when the last
+// packet holding it is released, and the next tensor of the same element type
+// and shape reuses the buffer. A graph producing tensors of the same shapes for
+// every frame therefore allocates no tensor memory in steady state.
+//
+// The pool is provided to a graph as a service:
+//
+//   MP_RETURN_IF_ERROR(graph.SetServiceObject(
+//       kTensorBufferPoolService, std::make_shared<TensorBufferPool>()));
+//
+// and used by the calculators requesting it:
+//
+//   cc->UseService(kTensorBufferPoolService).Optional();
+//   ...
+//   if (cc->Service(kTensorBufferPoolService).IsAvailable()) {
+//     pool = cc->Service(kTensorBufferPoolService).GetObject().buffer_pool();
+//   }
+//   Tensor tensor(Tensor::ElementType::kFloat32, shape, pool);
+//
+// Tensors may outlive the TensorBufferPool and the graph: the buffers are kept
+// until the last tensor drawn from the pool is destroyed.
+class TensorBufferPool {
+ public:
+  explicit TensorBufferPool(
+      int64 byte_budget = SharedBufferPool::kDefaultByteBudget);
+
+  // Returns a tensor whose CPU buffer is drawn from the pool.
+  Tensor CreateTensor(Tensor::ElementType element_type,
+                      const Tensor::Shape& shape) const;
+
+  // The pool of the tensor buffers, to be passed to the Tensor constructor.
+  const std::shared_ptr<SharedBufferPool>& buffer_pool() const {
+    return buffer_pool_;
+  }
+
+  SharedBufferPool::Stats GetStats() const { return buffer_pool_->GetStats(); }
+
+ private:
+  std::shared_ptr<SharedBufferPool> buffer_pool_;
+};
+
+extern const GraphService<TensorBufferPool> kTensorBufferPoolService;
+
+}  // namespace mediapipe
+
+#endif  // MEDIAPIPE_FRAMEWORK_FORMATS_TENSOR_BUFFER_POOL_H_
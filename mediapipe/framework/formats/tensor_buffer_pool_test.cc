@@ -0,0 +1,59 @@
+// Copyright 2022 The MediaPipe Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "mediapipe/framework/formats/tensor_buffer_pool.h"
+
+#include <memory>
+#include <vector>
+
+#include "mediapipe/framework/port/gmock.h"
+#include "mediapipe/framework/port/gtest.h"
+
+namespace mediapipe {
+namespace {
+
+TEST(TensorBufferPoolTest, ReusesBuffersOfReleasedTensors) {
+  TensorBufferPool pool;
+  const Tensor::Shape shape{1, 128, 128, 3};
+  const void* buffer;
+  {
+    Tensor tensor = pool.CreateTensor(Tensor::ElementType::kFloat32, shape);
+    buffer = tensor.GetCpuWriteView().buffer<float>();
+  }
+  // Tensors of the same element type and shape reuse the buffer.
+  for (int i = 0; i < 10; ++i) {
+    Tensor tensor = pool.CreateTensor(Tensor::ElementType::kFloat32, shape);
+    EXPECT_EQ(tensor.GetCpuWriteView().buffer<float>(), buffer);
+  }
+  const SharedBufferPool::Stats stats = pool.GetStats();
+  EXPECT_EQ(stats.miss_count, 1);
+  EXPECT_EQ(stats.hit_count, 10);
+  EXPECT_EQ(stats.bytes_in_use, 0);
+}
+
+TEST(TensorBufferPoolTest, TensorsOutliveThePool) {
+  auto pool = std::make_unique<TensorBufferPool>();
+  std::vector<Tensor> tensors;
+  tensors.push_back(pool->CreateTensor(Tensor::ElementType::kUInt8, {1000}));
+  tensors.back().GetCpuWriteView().buffer<uint8>()[999] = 1;
+  std::shared_ptr<SharedBufferPool> buffer_pool = pool->buffer_pool();
+  pool.reset();
+  EXPECT_EQ(buffer_pool->GetStats().bytes_in_use, 1024);
+  EXPECT_EQ(tensors.back().GetCpuReadView().buffer<uint8>()[999], 1);
+  tensors.clear();
+  EXPECT_EQ(buffer_pool->GetStats().bytes_in_use, 0);
+}
+
+}  // namespace
+}  // namespace mediapipe
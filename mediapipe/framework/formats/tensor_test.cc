@@ -1,5 +1,12 @@
 #include "mediapipe/framework/formats/tensor.h"
 
+#include <algorithm>
+#include <numeric>
+#include <thread>  // NOLINT(build/c++11)
+
+#include "absl/synchronization/notification.h"
+#include "absl/time/time.h"
+#include "mediapipe/framework/port/benchmark.h"
 #include "mediapipe/framework/port/gmock.h"
 #include "mediapipe/framework/port/gtest.h"
 #if !MEDIAPIPE_DISABLE_GPU
@@ -32,6 +39,16 @@ TEST(Cpu, TestMemoryAllocation) {
   EXPECT_NE(f1, nullptr);
 }
 
+TEST(Cpu, TestMemoryAlignment) {
+  for (int size : {1, 7, 1000, 256 * 256 * 3}) {
+    Tensor t(Tensor::ElementType::kFloat32, Tensor::Shape{size});
+    auto view = t.GetCpuWriteView();
+    EXPECT_EQ(reinterpret_cast<uintptr_t>(view.buffer<float>()) %
+                  Tensor::kCpuBufferAlignment,
+              0);
+  }
+}
+
 TEST(Cpu, TestTensorMove) {
   Tensor t1(Tensor::ElementType::kFloat32, Tensor::Shape{4, 3, 2, 3});
   void* p1 = t1.GetCpuWriteView().buffer<float>();
@@ -54,6 +71,61 @@ TEST(Cpu, TestViewMove) {
   EXPECT_EQ(v1.buffer<float>(), nullptr);  // NOLINT
 }
 
+TEST(Cpu, TestConcurrentReadViews) {
+  Tensor t(Tensor::ElementType::kFloat32, Tensor::Shape{4, 3, 2, 3});
+  t.GetCpuWriteView().buffer<float>()[0] = 1.0f;
+  auto v1 = t.GetCpuReadView();
+  // Another thread can read the tensor while the view is held.
+  absl::Notification read;
+  std::thread reader([&t, &read] {
+    auto v2 = t.GetCpuReadView();
+    EXPECT_EQ(v2.buffer<float>()[0], 1.0f);
+    read.Notify();
+  });
+  EXPECT_TRUE(read.WaitForNotificationWithTimeout(absl::Seconds(10)));
+  reader.join();
+  EXPECT_EQ(v1.buffer<float>()[0], 1.0f);
+}
+
+TEST(Cpu, TestWriteViewWaitsForReadViews) {
+  Tensor t(Tensor::ElementType::kFloat32, Tensor::Shape{1});
+  t.GetCpuWriteView().buffer<float>()[0] = 1.0f;
+  absl::Notification written;
+  std::thread writer;
+  {
+    auto v1 = t.GetCpuReadView();
+    writer = std::thread([&t, &written] {
+      t.GetCpuWriteView().buffer<float>()[0] = 2.0f;
+      written.Notify();
+    });
+    EXPECT_FALSE(written.WaitForNotificationWithTimeout(absl::Milliseconds(50)));
+    EXPECT_EQ(v1.buffer<float>()[0], 1.0f);
+  }
+  writer.join();
+  EXPECT_TRUE(written.HasBeenNotified());
+  EXPECT_EQ(t.GetCpuReadView().buffer<float>()[0], 2.0f);
+}
+
+// Reads one tensor from state.threads() threads, as calculators on parallel
+// branches of a graph read a shared inference output.
+void BM_ParallelCpuReadViews(benchmark::State& state) {
+  static Tensor* tensor = [] {
+    auto* tensor =
+        new Tensor(Tensor::ElementType::kFloat32, Tensor::Shape{1, 64, 64, 4});
+    auto view = tensor->GetCpuWriteView();
+    std::fill_n(view.buffer<float>(), tensor->shape().num_elements(), 1.0f);
+    return tensor;
+  }();
+  const int num_elements = tensor->shape().num_elements();
+  for (auto _ : state) {
+    auto view = tensor->GetCpuReadView();
+    const float* data = view.buffer<float>();
+    benchmark::DoNotOptimize(std::accumulate(data, data + num_elements, 0.0f));
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_ParallelCpuReadViews)->ThreadRange(1, 8)->UseRealTime();
+
 }  // namespace mediapipe
 
 int main(int argc, char** argv) {
@@ -158,9 +158,19 @@ bool InputStreamHandler::ScheduleInvocations(int max_allowance,
     // Sets *input_bound iff the latest node readiness is kNotReady before the
     // function returns regardless of how many invocations have been scheduled.
     if (node_readiness == NodeReadiness::kNotReady) {
-      if (batch_size_ > 1 &&
+      if (batch_size_ > 1 && schedule_incomplete_batches_ &&
           calculator_context_manager_->ContextHasInputTimestamp(
               *calculator_context_manager_->GetDefaultCalculatorContext())) {
+        // The incomplete batch is scheduled. Since it has not been processed
+        // yet, the input timestamp bound is not propagated, and stays
+        // Timestamp::Unset().
+        schedule_callback_(
+            calculator_context_manager_->GetDefaultCalculatorContext());
+        ++invocations_scheduled;
+      } else if (batch_size_ > 1 &&
+                 calculator_context_manager_->ContextHasInputTimestamp(
+                     *calculator_context_manager_
+                          ->GetDefaultCalculatorContext())) {
         // When batching is in progress, input_bound stays equal to the first
         // timestamp in the calculator context. This allows timestamp
         // propagation to be performed only for the first timestamp, and
@@ -187,13 +197,17 @@ bool InputStreamHandler::ScheduleInvocations(int max_allowance,
         FillInputSet(min_stream_timestamp, &calculator_context->Inputs());
       }
       if (calculator_context_manager_->NumberOfContextTimestamps(
-              *calculator_context) == batch_size_) {
+              *calculator_context) == batch_size_ ||
+          (max_batch_span_ > TimestampDiff(0) &&
+           min_stream_timestamp - calculator_context->InputTimestamp() >=
+               max_batch_span_)) {
         schedule_callback_(calculator_context);
         ++invocations_scheduled;
       }
       mediapipe::LogEvent(calculator_context->GetProfilingContext(),
                           TraceEvent(TraceEvent::READY_FOR_PROCESS)
-                              .set_node_id(calculator_context->NodeId()));
+                              .set_node_id(calculator_context->NodeId())
+                              .set_input_ts(min_stream_timestamp));
     } else {
       CHECK(node_readiness == NodeReadiness::kReadyForClose);
       // If any parallel invocations are in progress or a calculator context has
@@ -417,7 +431,7 @@ void SyncSet::FillInputSet(Timestamp input_timestamp,
 
 void SyncSet::FillInputBounds(InputStreamShardSet* input_set) {
   for (CollectionItemId id : stream_ids_) {
-    const auto* stream = input_stream_handler_->input_stream_managers_.Get(id);
+    auto* stream = input_stream_handler_->input_stream_managers_.Get(id);
     Timestamp bound = stream->MinTimestampOrBound(nullptr);
     input_stream_handler_->AddPacketToShard(
         &input_set->Get(id), Packet().At(bound.PreviousAllowedInStream()),
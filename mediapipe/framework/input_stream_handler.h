@@ -92,6 +92,11 @@ class InputStreamHandler {
   // Sets up the InputStreamShardSet by propagating data from the managers.
   absl::Status SetupInputShards(InputStreamShardSet* input_shards);
 
+  // Returns an error if the options of the input stream handler are invalid.
+  // The CalculatorNode calls this once the handler is created, so that a bad
+  // config fails the graph initialization.
+  virtual absl::Status ValidateOptions() const { return absl::OkStatus(); }
+
   // Returns a vector of pairs of stream name and queue size for monitoring
   // purpose.
   std::vector<std::pair<std::string, int>> GetMonitoringInfo();
@@ -237,6 +242,20 @@ class InputStreamHandler {
   // Batching cannot be combined with late_preparation_ behavior.
   void SetBatchSize(int batch_size);
 
+  // When true, an incomplete batch is scheduled as soon as the node is not
+  // ready for another input set, instead of waiting until the batch is full.
+  // Each invocation then handles the input sets that are ready, up to the
+  // batch size.
+  void SetScheduleIncompleteBatches(bool schedule_incomplete_batches) {
+    schedule_incomplete_batches_ = schedule_incomplete_batches;
+  }
+
+  // When positive, a batch is also scheduled once the difference between its
+  // last and first input timestamps reaches "max_batch_span".
+  void SetMaxBatchSpan(TimestampDiff max_batch_span) {
+    max_batch_span_ = max_batch_span;
+  }
+
   // Subclasses can enable late preparation; however it cannot be used along
   // with batching.
   void SetLatePreparation(bool late_preparation);
@@ -299,6 +318,8 @@ class InputStreamHandler {
   // Determines how many sets of input packets are collected before a
   // CalculatorNode is scheduled.
   int batch_size_ = 1;
+  bool schedule_incomplete_batches_ = false;
+  TimestampDiff max_batch_span_ = TimestampDiff(0);
 
   // When true, any increase in timestamp bound invokes Calculator::Process.
   bool process_timestamps_ = false;
@@ -14,15 +14,18 @@
 
 #include "mediapipe/framework/input_stream_manager.h"
 
+#include <algorithm>
 #include <type_traits>
 #include <utility>
 
+#include "absl/memory/memory.h"
 #include "absl/strings/str_cat.h"
 #include "absl/synchronization/mutex.h"
 #include "mediapipe/framework/packet.h"
 #include "mediapipe/framework/port/logging.h"
 #include "mediapipe/framework/port/source_location.h"
 #include "mediapipe/framework/port/status_builder.h"
+#include "mediapipe/framework/port/status_macros.h"
 #include "mediapipe/framework/tool/status_util.h"
 
 namespace mediapipe {
@@ -37,6 +40,12 @@ absl::Status InputStreamManager::Initialize(const std::string& name,
   return absl::OkStatus();
 }
 
+void InputStreamManager::EnableLockFreeQueue(int capacity) {
+  staged_packets_ =
+      absl::make_unique<internal::PacketRingBuffer>(std::max(capacity, 1));
+  PrepareForRun();
+}
+
 const std::string& InputStreamManager::Name() const { return name_; }
 
 void InputStreamManager::SetQueueSizeCallbacks(
@@ -47,23 +56,35 @@ void InputStreamManager::SetQueueSizeCallbacks(
 }
 
 void InputStreamManager::PrepareForRun() {
+  absl::MutexLock producer_lock(&producer_mutex_);
   absl::MutexLock stream_lock(&stream_mutex_);
   queue_.clear();
   last_reported_stream_full_ = false;
   num_packets_added_ = 0;
+  num_staged_packets_added_ = 0;
   next_timestamp_bound_ = Timestamp::PreStream();
   last_select_timestamp_ = Timestamp::Unstarted();
   closed_ = false;
   header_ = Packet();
+  if (staged_packets_) {
+    staged_packets_->Clear();
+    staged_next_timestamp_bound_ = Timestamp::PreStream();
+    staged_closed_ = false;
+    staged_queue_size_ = 0;
+  }
 }
 
 bool InputStreamManager::IsEmpty() const {
+  if (staged_packets_) {
+    return staged_queue_size_.load() == 0;
+  }
   absl::MutexLock stream_lock(&stream_mutex_);
   return queue_.empty();
 }
 
-Packet InputStreamManager::QueueHead() const {
+Packet InputStreamManager::QueueHead() {
   absl::MutexLock stream_lock(&stream_mutex_);
+  DrainStagedPackets();
   if (queue_.empty()) {
     return Packet();
   }
@@ -90,12 +111,62 @@ absl::Status InputStreamManager::MovePackets(std::list<Packet>* container,
   return AddOrMovePacketsInternal<std::list<Packet>&>(*container, notify);
 }
 
+absl::Status InputStreamManager::ValidatePacket(
+    const Packet& packet, Timestamp next_timestamp_bound,
+    int64 num_packets_added) const {
+  absl::Status result = packet_type_->Validate(packet);
+  if (!result.ok()) {
+    return tool::AddStatusPrefix(
+        absl::StrCat(
+            "Packet type mismatch on a calculator receiving from stream \"",
+            name_, "\": "),
+        result);
+  }
+
+  const Timestamp timestamp = packet.Timestamp();
+  if (!timestamp.IsAllowedInStream()) {
+    return mediapipe::InvalidArgumentErrorBuilder(MEDIAPIPE_LOC)
+           << "In stream \"" << name_
+           << "\", timestamp not specified or set to illegal value: "
+           << timestamp.DebugString();
+  }
+  if (enable_timestamps_) {
+    // Check that PostStream(), if used, is the only timestamp used.  This
+    // is also true for PreStream() but doesn't need to be checked because
+    // Timestamp::PreStream().NextAllowedInStream() is
+    // Timestamp::OneOverPostStream().
+    if (timestamp == Timestamp::PostStream() && num_packets_added > 0) {
+      return mediapipe::InvalidArgumentErrorBuilder(MEDIAPIPE_LOC)
+             << "In stream \"" << name_
+             << "\", a packet at Timestamp::PostStream() must be the only "
+                "Packet in an InputStream.";
+    }
+    if (timestamp < next_timestamp_bound) {
+      return mediapipe::InvalidArgumentErrorBuilder(MEDIAPIPE_LOC)
+             << "Packet timestamp mismatch on a calculator receiving from "
+                "stream \""
+             << name_ << "\". Current minimum expected timestamp is "
+             << next_timestamp_bound.DebugString() << " but received "
+             << timestamp.DebugString()
+             << ". Are you using a custom InputStreamHandler? Note that "
+                "some InputStreamHandlers allow timestamps that are not "
+                "strictly monotonically increasing. See for example the "
+                "ImmediateInputStreamHandler class comment.";
+    }
+  }
+  return absl::OkStatus();
+}
+
 template <typename Container>
 absl::Status InputStreamManager::AddOrMovePacketsInternal(Container container,
                                                           bool* notify) {
+  if (staged_packets_) {
+    return StagePacketsInternal<Container>(container, notify);
+  }
   *notify = false;
   bool queue_became_non_empty = false;
   bool queue_became_full = false;
+  int queue_size = 0;
   {
     // Scope to prevent locking the stream when notification is called.
     absl::MutexLock stream_lock(&stream_mutex_);
@@ -108,46 +179,9 @@ absl::Status InputStreamManager::AddOrMovePacketsInternal(Container container,
     // Check if the queue becomes non-empty.
     queue_became_non_empty = queue_.empty() && !container.empty();
     for (auto& packet : container) {
-      absl::Status result = packet_type_->Validate(packet);
-      if (!result.ok()) {
-        return tool::AddStatusPrefix(
-            absl::StrCat(
-                "Packet type mismatch on a calculator receiving from stream \"",
-                name_, "\": "),
-            result);
-      }
-
+      MP_RETURN_IF_ERROR(
+          ValidatePacket(packet, next_timestamp_bound_, num_packets_added_));
       const Timestamp timestamp = packet.Timestamp();
-      if (!timestamp.IsAllowedInStream()) {
-        return mediapipe::InvalidArgumentErrorBuilder(MEDIAPIPE_LOC)
-               << "In stream \"" << name_
-               << "\", timestamp not specified or set to illegal value: "
-               << timestamp.DebugString();
-      }
-      if (enable_timestamps_) {
-        // Check that PostStream(), if used, is the only timestamp used.  This
-        // is also true for PreStream() but doesn't need to be checked because
-        // Timestamp::PreStream().NextAllowedInStream() is
-        // Timestamp::OneOverPostStream().
-        if (timestamp == Timestamp::PostStream() && num_packets_added_ > 0) {
-          return mediapipe::InvalidArgumentErrorBuilder(MEDIAPIPE_LOC)
-                 << "In stream \"" << name_
-                 << "\", a packet at Timestamp::PostStream() must be the only "
-                    "Packet in an InputStream.";
-        }
-        if (timestamp < next_timestamp_bound_) {
-          return mediapipe::InvalidArgumentErrorBuilder(MEDIAPIPE_LOC)
-                 << "Packet timestamp mismatch on a calculator receiving from "
-                    "stream \""
-                 << name_ << "\". Current minimum expected timestamp is "
-                 << next_timestamp_bound_.DebugString() << " but received "
-                 << timestamp.DebugString()
-                 << ". Are you using a custom InputStreamHandler? Note that "
-                    "some InputStreamHandlers allow timestamps that are not "
-                    "strictly monotonically increasing. See for example the "
-                    "ImmediateInputStreamHandler class comment.";
-        }
-      }
       next_timestamp_bound_ = timestamp.NextAllowedInStream();
 
       // If the caller is MovePackets(), packet's underlying holder should be
@@ -164,6 +198,7 @@ absl::Status InputStreamManager::AddOrMovePacketsInternal(Container container,
     }
     queue_became_full = (!was_queue_full && max_queue_size_ != -1 &&
                          queue_.size() >= max_queue_size_);
+    queue_size = queue_.size();
     if (queue_.size() > 1) {
       VLOG(3) << "Queue size greater than 1: stream name: " << name_
               << " queue_size: " << queue_.size();
@@ -172,16 +207,179 @@ absl::Status InputStreamManager::AddOrMovePacketsInternal(Container container,
             << " becomes non-empty status:" << queue_became_non_empty
             << " Size: " << queue_.size();
   }
+  if (queue_size_histogram_ && !container.empty()) {
+    queue_size_histogram_->Record(queue_size);
+  }
   if (queue_became_full) {
     VLOG(3) << "Queue became full: " << Name();
+    if (became_full_counter_) {
+      became_full_counter_->Increment();
+    }
     becomes_full_callback_(this, &last_reported_stream_full_);
   }
   *notify = queue_became_non_empty;
   return absl::OkStatus();
 }
 
+template <typename Container>
+absl::Status InputStreamManager::StagePacketsInternal(Container container,
+                                                      bool* notify) {
+  *notify = false;
+  absl::Status status;
+  int num_staged = 0;
+  int old_size = 0;
+  Timestamp next_timestamp_bound = Timestamp::Unset();
+  {
+    absl::MutexLock producer_lock(&producer_mutex_);
+    if (staged_closed_.load()) {
+      return absl::OkStatus();
+    }
+    Timestamp bound = staged_next_timestamp_bound_.load();
+    for (auto& packet : container) {
+      status = ValidatePacket(packet, bound, num_staged_packets_added_);
+      if (!status.ok()) {
+        break;
+      }
+      bound = packet.Timestamp().NextAllowedInStream();
+      ++num_staged_packets_added_;
+      VLOG(3) << "Input stream:" << name_
+              << " has staged packet at time: " << packet.Timestamp();
+      Packet staged_packet;
+      if (std::is_const<
+              typename std::remove_reference<Container>::type>::value) {
+        staged_packet = packet;
+      } else {
+        staged_packet = std::move(packet);
+      }
+      // Count the packet before the consumer can pop it.
+      const int size = staged_queue_size_.fetch_add(1);
+      if (num_staged == 0) {
+        old_size = size;
+      }
+      if (!staged_packets_->TryPush(std::move(staged_packet))) {
+        // The ring buffer is full. Drain it under the stream mutex to keep
+        // the packets in order, and append this packet to queue_ directly.
+        absl::MutexLock stream_lock(&stream_mutex_);
+        DrainStagedPackets();
+        queue_.emplace_back(std::move(staged_packet));
+      }
+      ++num_staged;
+    }
+    if (num_staged > 0) {
+      next_timestamp_bound = bound;
+    }
+  }
+  if (num_staged == 0) {
+    return status;
+  }
+  // Publish the bound only after the packets, see DrainStagedPackets().
+  if (enable_timestamps_) {
+    RaiseStagedBound(next_timestamp_bound);
+  } else {
+    staged_next_timestamp_bound_ = next_timestamp_bound;
+  }
+  const int max_queue_size = max_queue_size_;
+  const bool queue_became_full = max_queue_size != -1 &&
+                                 old_size < max_queue_size &&
+                                 old_size + num_staged >= max_queue_size;
+  if (!status.ok()) {
+    // Like AddOrMovePacketsInternal(), report neither a non-empty nor a full
+    // queue when a packet is rejected.
+    return status;
+  }
+  if (queue_size_histogram_) {
+    queue_size_histogram_->Record(old_size + num_staged);
+  }
+  if (queue_became_full) {
+    VLOG(3) << "Queue became full: " << Name();
+    if (became_full_counter_) {
+      became_full_counter_->Increment();
+    }
+    becomes_full_callback_(this, &last_reported_stream_full_);
+  }
+  *notify = (old_size == 0);
+  return absl::OkStatus();
+}
+
+absl::Status InputStreamManager::StageNextTimestampBound(const Timestamp bound,
+                                                         bool* notify) {
+  *notify = false;
+  absl::MutexLock producer_lock(&producer_mutex_);
+  if (staged_closed_.load()) {
+    return absl::OkStatus();
+  }
+  const Timestamp current_bound = staged_next_timestamp_bound_.load();
+  if (enable_timestamps_ && bound < current_bound) {
+    return mediapipe::UnknownErrorBuilder(MEDIAPIPE_LOC)
+           << "SetNextTimestampBound must be called with a timestamp greater "
+              "than or equal to the current bound. In stream \""
+           << name_ << "\". Current minimum expected timestamp is "
+           << current_bound.DebugString() << " but received "
+           << bound.DebugString();
+  }
+  if (RaiseStagedBound(bound) && staged_queue_size_.load() == 0) {
+    // If the queue was not empty then a change to the bound is not
+    // detectable by the consumer.
+    *notify = true;
+  }
+  return absl::OkStatus();
+}
+
+bool InputStreamManager::RaiseStagedBound(Timestamp bound) {
+  Timestamp current = staged_next_timestamp_bound_.load();
+  while (current < bound) {
+    if (staged_next_timestamp_bound_.compare_exchange_weak(current, bound)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+void InputStreamManager::DrainStagedPackets() {
+  if (!staged_packets_) {
+    return;
+  }
+  // Load the bound before popping: the producer publishes packets before
+  // the bound that follows them, so every packet below this bound is
+  // already in the ring buffer.
+  const Timestamp bound = staged_next_timestamp_bound_.load();
+  Packet packet;
+  int num_discarded = 0;
+  while (staged_packets_->TryPop(&packet)) {
+    if (closed_) {
+      // Like AddPackets(), ignore packets that arrive after Close().
+      ++num_discarded;
+      continue;
+    }
+    queue_.emplace_back(std::move(packet));
+  }
+  if (num_discarded > 0) {
+    staged_queue_size_.fetch_sub(num_discarded);
+  }
+  if (!closed_ && (bound > next_timestamp_bound_ || !enable_timestamps_)) {
+    next_timestamp_bound_ = bound;
+  }
+}
+
+bool InputStreamManager::QueueBecameNonFull(bool was_queue_full,
+                                            int num_popped) {
+  if (!staged_packets_) {
+    return was_queue_full && queue_.size() < max_queue_size_;
+  }
+  if (num_popped == 0) {
+    return false;
+  }
+  const int old_size = staged_queue_size_.fetch_sub(num_popped);
+  const int max_queue_size = max_queue_size_;
+  return max_queue_size != -1 && old_size >= max_queue_size &&
+         old_size - num_popped < max_queue_size;
+}
+
 absl::Status InputStreamManager::SetNextTimestampBound(const Timestamp bound,
                                                        bool* notify) {
+  if (staged_packets_) {
+    return StageNextTimestampBound(bound, notify);
+  }
   *notify = false;
   {
     // Scope to prevent locking the stream when notification is called.
@@ -217,17 +415,26 @@ absl::Status InputStreamManager::SetNextTimestampBound(const Timestamp bound,
 void InputStreamManager::DisableTimestamps() { enable_timestamps_ = false; }
 
 void InputStreamManager::Close() {
+  // Keeps producers from staging packets after the ring buffer is drained.
+  absl::MutexLockMaybe producer_lock(staged_packets_ ? &producer_mutex_
+                                                     : nullptr);
   absl::MutexLock stream_lock(&stream_mutex_);
   if (closed_) {
     return;
   }
+  DrainStagedPackets();
   next_timestamp_bound_ = Timestamp::Done();
   last_select_timestamp_ = Timestamp::Done();
   closed_ = true;
+  if (staged_packets_) {
+    staged_closed_ = true;
+    staged_next_timestamp_bound_ = Timestamp::Done();
+  }
 }
 
-Timestamp InputStreamManager::MinTimestampOrBound(bool* is_empty) const {
+Timestamp InputStreamManager::MinTimestampOrBound(bool* is_empty) {
   absl::MutexLock stream_lock(&stream_mutex_);
+  DrainStagedPackets();
   if (is_empty) {
     *is_empty = queue_.empty();
   }
@@ -248,7 +455,12 @@ Packet InputStreamManager::PopPacketAtTimestamp(Timestamp timestamp,
   bool queue_became_non_full = false;
   Packet packet;
   {
+    // The bound below must not be raised while a producer validates packets
+    // against it, see StagePacketsInternal().
+    absl::MutexLockMaybe producer_lock(staged_packets_ ? &producer_mutex_
+                                                       : nullptr);
     absl::MutexLock stream_lock(&stream_mutex_);
+    DrainStagedPackets();
     // Make sure timestamp didn't decrease from last time.
     CHECK_LE(last_select_timestamp_, timestamp);
     last_select_timestamp_ = timestamp;
@@ -257,6 +469,9 @@ Packet InputStreamManager::PopPacketAtTimestamp(Timestamp timestamp,
     // timestamps we have already passed.
     if (next_timestamp_bound_ <= timestamp) {
       next_timestamp_bound_ = timestamp.NextAllowedInStream();
+      if (staged_packets_) {
+        RaiseStagedBound(next_timestamp_bound_);
+      }
     }
 
     VLOG(3) << "Input stream " << name_
@@ -269,6 +484,7 @@ Packet InputStreamManager::PopPacketAtTimestamp(Timestamp timestamp,
     // Checks if queue is full.
     bool was_queue_full =
         (max_queue_size_ != -1 && queue_.size() >= max_queue_size_);
+    const size_t queue_size_before = queue_.size();
 
     while (!queue_.empty() && queue_.front().Timestamp() <= timestamp) {
       packet = std::move(queue_.front());
@@ -286,7 +502,8 @@ Packet InputStreamManager::PopPacketAtTimestamp(Timestamp timestamp,
 
     VLOG(3) << "Input stream removed packets:" << name_
             << " Size:" << queue_.size();
-    queue_became_non_full = (was_queue_full && queue_.size() < max_queue_size_);
+    queue_became_non_full = QueueBecameNonFull(
+        was_queue_full, queue_size_before - queue_.size());
     *stream_is_done = IsDone();
   }
   if (queue_became_non_full) {
@@ -303,12 +520,14 @@ Packet InputStreamManager::PopQueueHead(bool* stream_is_done) {
   Packet packet;
   {
     absl::MutexLock stream_lock(&stream_mutex_);
+    DrainStagedPackets();
 
     VLOG(3) << "Input stream " << name_ << " selecting at queue head";
 
     // Check if queue is full.
     bool was_queue_full =
         (max_queue_size_ != -1 && queue_.size() >= max_queue_size_);
+    const size_t queue_size_before = queue_.size();
 
     if (!queue_.empty()) {
       packet = std::move(queue_.front());
@@ -319,7 +538,8 @@ Packet InputStreamManager::PopQueueHead(bool* stream_is_done) {
 
     VLOG(3) << "Input stream removed a packet:" << name_
             << " Size:" << queue_.size();
-    queue_became_non_full = (was_queue_full && queue_.size() < max_queue_size_);
+    queue_became_non_full = QueueBecameNonFull(
+        was_queue_full, queue_size_before - queue_.size());
     *stream_is_done = IsDone();
   }
   if (queue_became_non_full) {
@@ -330,23 +550,25 @@ Packet InputStreamManager::PopQueueHead(bool* stream_is_done) {
 }
 
 int InputStreamManager::QueueSize() const {
+  if (staged_packets_) {
+    return staged_queue_size_.load();
+  }
   absl::MutexLock lock(&stream_mutex_);
   return static_cast<int>(queue_.size());
 }
 
-int InputStreamManager::MaxQueueSize() const {
-  absl::MutexLock lock(&stream_mutex_);
-  return max_queue_size_;
-}
+int InputStreamManager::MaxQueueSize() const { return max_queue_size_; }
 
 void InputStreamManager::SetMaxQueueSize(int max_queue_size) {
   bool was_full;
   bool is_full;
   {
     absl::MutexLock lock(&stream_mutex_);
-    was_full = (max_queue_size_ != -1 && queue_.size() >= max_queue_size_);
+    const int queue_size =
+        staged_packets_ ? staged_queue_size_.load() : queue_.size();
+    was_full = (max_queue_size_ != -1 && queue_size >= max_queue_size_);
     max_queue_size_ = max_queue_size;
-    is_full = (max_queue_size_ != -1 && queue_.size() >= max_queue_size_);
+    is_full = (max_queue_size_ != -1 && queue_size >= max_queue_size_);
   }
 
   // QueueSizeCallback is called with no mutexes held.
@@ -360,12 +582,16 @@ void InputStreamManager::SetMaxQueueSize(int max_queue_size) {
 }
 
 bool InputStreamManager::IsFull() const {
+  if (staged_packets_) {
+    return max_queue_size_ != -1 && staged_queue_size_ >= max_queue_size_;
+  }
   absl::MutexLock lock(&stream_mutex_);
   return max_queue_size_ != -1 && queue_.size() >= max_queue_size_;
 }
 
-Timestamp InputStreamManager::GetMinTimestampAmongNLatest(int n) const {
+Timestamp InputStreamManager::GetMinTimestampAmongNLatest(int n) {
   absl::MutexLock lock(&stream_mutex_);
+  DrainStagedPackets();
   if (queue_.empty()) {
     return Timestamp::Unset();
   }
@@ -376,9 +602,11 @@ void InputStreamManager::ErasePacketsEarlierThan(Timestamp timestamp) {
   bool queue_became_non_full = false;
   {
     absl::MutexLock lock(&stream_mutex_);
+    DrainStagedPackets();
     // Checks if queue is full.
     bool was_queue_full =
         (max_queue_size_ != -1 && queue_.size() >= max_queue_size_);
+    const size_t queue_size_before = queue_.size();
 
     while (!queue_.empty() && queue_.front().Timestamp() < timestamp) {
       queue_.pop_front();
@@ -386,7 +614,8 @@ void InputStreamManager::ErasePacketsEarlierThan(Timestamp timestamp) {
 
     VLOG(3) << "Input stream removed packets:" << name_
             << " Size:" << queue_.size();
-    queue_became_non_full = (was_queue_full && queue_.size() < max_queue_size_);
+    queue_became_non_full = QueueBecameNonFull(
+        was_queue_full, queue_size_before - queue_.size());
   }
   if (queue_became_non_full) {
     VLOG(3) << "Queue became non-full: " << Name();
@@ -15,18 +15,22 @@
 #ifndef MEDIAPIPE_FRAMEWORK_INPUT_STREAM_MANAGER_H_
 #define MEDIAPIPE_FRAMEWORK_INPUT_STREAM_MANAGER_H_
 
+#include <atomic>
 #include <deque>
 #include <functional>
 #include <list>
+#include <memory>
 #include <string>
 
 #include "absl/base/thread_annotations.h"
 #include "absl/synchronization/mutex.h"
 #include "mediapipe/framework/packet.h"
+#include "mediapipe/framework/packet_ring_buffer.h"
 #include "mediapipe/framework/packet_type.h"
 #include "mediapipe/framework/port.h"
 #include "mediapipe/framework/port/integral_types.h"
 #include "mediapipe/framework/port/status.h"
+#include "mediapipe/framework/profiler/metric_registry.h"
 #include "mediapipe/framework/timestamp.h"
 
 namespace mediapipe {
@@ -43,6 +47,13 @@ namespace mediapipe {
 // An input stream is written to by exactly one output stream and is read by a
 // single node. None of its methods should hold a lock when they invoke a
 // callback in the scheduler.
+//
+// By default the producer and the consumer share one mutex. If
+// EnableLockFreeQueue() is called, the producer instead stages packets in a
+// ring buffer which the consumer drains, which shortens the critical section
+// of the producer. Producers still take producer_mutex_, which the consumer
+// also takes to pop packets or close the stream, so adding packets can still
+// wait briefly for the consumer and vice versa.
 class InputStreamManager {
  public:
   // Function type for becomes_full_callback and becomes_not_full_callback.
@@ -60,6 +71,16 @@ class InputStreamManager {
   absl::Status Initialize(const std::string& name,
                           const PacketType* packet_type, bool back_edge);
 
+  // Switches the producer side (AddPackets(), MovePackets() and
+  // SetNextTimestampBound()) to a staging ring buffer with room for
+  // "capacity" packets. Producers then no longer take the stream mutex,
+  // except when the ring buffer is full. Timestamp bound and max queue size
+  // semantics are unchanged. Must be called before the graph starts running.
+  void EnableLockFreeQueue(int capacity);
+
+  // Returns true if EnableLockFreeQueue() has been called.
+  bool LockFreeQueueEnabled() const { return staged_packets_ != nullptr; }
+
   // Returns the stream name.
   const std::string& Name() const;
 
@@ -95,7 +116,7 @@ class InputStreamManager {
   absl::Status MovePackets(std::list<Packet>* container, bool* notify);
 
   // Closes the input stream.  This function can be called multiple times.
-  void Close() ABSL_LOCKS_EXCLUDED(stream_mutex_);
+  void Close() ABSL_LOCKS_EXCLUDED(stream_mutex_, producer_mutex_);
 
   // Sets the bound on the next timestamp to be added to the input stream.
   // Sets "notify" to true if the bound is advanced while the packet queue is
@@ -109,7 +130,8 @@ class InputStreamManager {
   // this input stream. This is the timestamp of the first item in the queue if
   // the queue is non-empty, or the next timestamp bound if it is empty.
   // Sets is_empty to queue_.empty() if it is not nullptr.
-  Timestamp MinTimestampOrBound(bool* is_empty) const
+  // Not const, as it first moves the staged packets into the queue.
+  Timestamp MinTimestampOrBound(bool* is_empty)
       ABSL_LOCKS_EXCLUDED(stream_mutex_);
 
   // Turns off the use of packet timestamps.
@@ -120,7 +142,7 @@ class InputStreamManager {
 
   // If the queue is not empty, returns the packet at the front of the queue.
   // Otherwise, returns an empty packet.
-  Packet QueueHead() const ABSL_LOCKS_EXCLUDED(stream_mutex_);
+  Packet QueueHead() ABSL_LOCKS_EXCLUDED(stream_mutex_);
 
   // Advances time to timestamp.  Pops and returns the packet in the queue
   // with a matching timestamp, if it exists.  Time can be advanced to any
@@ -133,7 +155,7 @@ class InputStreamManager {
   // Timestamp::Done() after the pop.
   Packet PopPacketAtTimestamp(Timestamp timestamp, int* num_packets_dropped,
                               bool* stream_is_done)
-      ABSL_LOCKS_EXCLUDED(stream_mutex_);
+      ABSL_LOCKS_EXCLUDED(stream_mutex_, producer_mutex_);
 
   // Pops and returns the packet at the head of the queue if the queue is
   // non-empty. Sets "stream_is_done" if  the next timestamp bound reaches
@@ -159,7 +181,7 @@ class InputStreamManager {
   // there are fewer than n packets in the queue, this function returns
   // Timestamp::Unset().
   // NOTE: This is a public API intended for FixedSizeInputStreamHandler only.
-  Timestamp GetMinTimestampAmongNLatest(int n) const
+  Timestamp GetMinTimestampAmongNLatest(int n)
       ABSL_LOCKS_EXCLUDED(stream_mutex_);
 
   // pop_front()s packets that are earlier than the given timestamp.
@@ -173,6 +195,16 @@ class InputStreamManager {
   void SetQueueSizeCallbacks(QueueSizeCallback becomes_full_callback,
                              QueueSizeCallback becomes_not_full_callback);
 
+  // Records the queue size into "queue_size_histogram" each time packets are
+  // added, and counts the times the queue becomes full, throttling the
+  // upstream sources, with "became_full_counter". Either may be null. Must be
+  // called before the graph starts running.
+  void SetQueueMetrics(ShardedHistogram* queue_size_histogram,
+                       ShardedCounter* became_full_counter) {
+    queue_size_histogram_ = queue_size_histogram;
+    became_full_counter_ = became_full_counter;
+  }
+
  private:
   // Adds or moves a list of timestamped packets. Sets "notify" to true if the
   // queue becomes non-empty. Returns an error if the packets have errors. Does
@@ -184,6 +216,36 @@ class InputStreamManager {
   absl::Status AddOrMovePacketsInternal(Container container, bool* notify)
       ABSL_LOCKS_EXCLUDED(stream_mutex_);
 
+  // The staging counterparts of AddOrMovePacketsInternal() and
+  // SetNextTimestampBound(), used if EnableLockFreeQueue() has been called.
+  template <typename Container>
+  absl::Status StagePacketsInternal(Container container, bool* notify)
+      ABSL_LOCKS_EXCLUDED(stream_mutex_, producer_mutex_);
+  absl::Status StageNextTimestampBound(Timestamp bound, bool* notify)
+      ABSL_LOCKS_EXCLUDED(stream_mutex_, producer_mutex_);
+
+  // Returns an error if "packet" cannot be added to the stream given the
+  // current next timestamp bound and the number of packets added so far.
+  absl::Status ValidatePacket(const Packet& packet,
+                              Timestamp next_timestamp_bound,
+                              int64 num_packets_added) const;
+
+  // Moves the staged packets into queue_ and catches next_timestamp_bound_
+  // up with the producer. Does nothing unless EnableLockFreeQueue() has been
+  // called. Every consumer method calls this before looking at queue_.
+  void DrainStagedPackets() ABSL_EXCLUSIVE_LOCKS_REQUIRED(stream_mutex_);
+
+  // Raises the next timestamp bound seen by the producer to at least "bound".
+  // Returns true if the bound was advanced.
+  bool RaiseStagedBound(Timestamp bound);
+
+  // Returns true if removing "num_popped" packets made a full queue non-full.
+  // "was_queue_full" is the fullness of queue_ before the removal; it is
+  // ignored if the staging queue is enabled, in which case the shared
+  // packet count decides.
+  bool QueueBecameNonFull(bool was_queue_full, int num_popped)
+      ABSL_EXCLUSIVE_LOCKS_REQUIRED(stream_mutex_);
+
   // Returns true if the next timestamp bound reaches Timestamp::Done().
   bool IsDone() const ABSL_EXCLUSIVE_LOCKS_REQUIRED(stream_mutex_);
 
@@ -208,8 +270,30 @@ class InputStreamManager {
   // The header packet of the input stream.
   Packet header_;
 
-  // The maximum queue size for this stream if set.
-  int max_queue_size_ ABSL_GUARDED_BY(stream_mutex_) = -1;
+  // The maximum queue size for this stream if set. Written under
+  // stream_mutex_; atomic because the staging producer reads it without
+  // the lock.
+  std::atomic<int> max_queue_size_{-1};
+
+  // State of the staging queue. Only used if EnableLockFreeQueue() has been
+  // called. The producer pushes into staged_packets_ while holding
+  // producer_mutex_, which serializes concurrent producers. The consumer
+  // pops from it while holding stream_mutex_, and also takes producer_mutex_
+  // when it raises the producer's bound or closes the stream, so that no
+  // producer validates a packet against a bound the consumer has passed.
+  std::unique_ptr<internal::PacketRingBuffer> staged_packets_;
+  absl::Mutex producer_mutex_ ABSL_ACQUIRED_BEFORE(stream_mutex_);
+  // The number of packets staged, the counterpart of num_packets_added_.
+  int64 num_staged_packets_added_ ABSL_GUARDED_BY(producer_mutex_) = 0;
+  // The producer's view of next_timestamp_bound_. The producer raises it
+  // after publishing packets, and the consumer raises it when it selects a
+  // timestamp, so the consumer reads it before draining staged_packets_.
+  std::atomic<Timestamp> staged_next_timestamp_bound_{Timestamp::PreStream()};
+  std::atomic<bool> staged_closed_{false};
+  // The number of packets in queue_ and staged_packets_ together. The
+  // producer counts a packet before pushing it, so the count never drops
+  // below the number of packets the consumer can pop.
+  std::atomic<int> staged_queue_size_{0};
 
   // Callback to notify the framework that we have hit the maximum queue size.
   QueueSizeCallback becomes_full_callback_;
@@ -218,6 +302,10 @@ class InputStreamManager {
   // the maximum specified.
   QueueSizeCallback becomes_not_full_callback_;
 
+  // The metrics set by SetQueueMetrics(), if not null.
+  ShardedHistogram* queue_size_histogram_ = nullptr;
+  ShardedCounter* became_full_counter_ = nullptr;
+
   // This variable is used by the QueueSizeCallback to record the queue
   // fullness reported in the last completed QueueSizeCallback.
   // This variable is only accessed during the QueueSizeCallback.
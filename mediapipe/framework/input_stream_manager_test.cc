@@ -15,11 +15,14 @@
 #include "mediapipe/framework/input_stream_manager.h"
 
 #include <memory>
+#include <thread>  // NOLINT(build/c++11)
 
 #include "absl/memory/memory.h"
+#include "absl/synchronization/mutex.h"
 #include "mediapipe/framework/input_stream_shard.h"
 #include "mediapipe/framework/lifetime_tracker.h"
 #include "mediapipe/framework/packet.h"
+#include "mediapipe/framework/port/benchmark.h"
 #include "mediapipe/framework/port/gmock.h"
 #include "mediapipe/framework/port/gtest.h"
 #include "mediapipe/framework/port/status_matchers.h"
@@ -922,5 +925,245 @@ TEST_F(InputStreamManagerTest, BackwardsInTimeUntimed) {
   EXPECT_TRUE(notify_);
 }
 
+// Runs InputStreamManager with the lock-free staging queue enabled.
+class LockFreeInputStreamManagerTest : public InputStreamManagerTest {
+ protected:
+  static constexpr int kRingCapacity = 4;
+
+  void SetUp() override {
+    InputStreamManagerTest::SetUp();
+    input_stream_manager_->EnableLockFreeQueue(kRingCapacity);
+    input_stream_manager_->SetQueueSizeCallbacks(queue_full_callback_,
+                                                 queue_not_full_callback_);
+  }
+};
+
+TEST_F(LockFreeInputStreamManagerTest, AddAndPopPackets) {
+  EXPECT_TRUE(input_stream_manager_->LockFreeQueueEnabled());
+  std::list<Packet> packets;
+  packets.push_back(MakePacket<std::string>("packet 1").At(Timestamp(10)));
+  packets.push_back(MakePacket<std::string>("packet 2").At(Timestamp(20)));
+  MP_ASSERT_OK(
+      input_stream_manager_->AddPackets(packets, &notify_));  // Notification
+  EXPECT_TRUE(notify_);
+  EXPECT_EQ(2, input_stream_manager_->QueueSize());
+  EXPECT_FALSE(input_stream_manager_->IsEmpty());
+
+  // The consumer sees the staged packets and the staged bound.
+  bool is_empty;
+  EXPECT_EQ(Timestamp(10),
+            input_stream_manager_->MinTimestampOrBound(&is_empty));
+  EXPECT_FALSE(is_empty);
+  popped_packet_ = input_stream_manager_->PopPacketAtTimestamp(
+      Timestamp(10), &num_packets_dropped_, &stream_is_done_);
+  EXPECT_EQ("packet 1", popped_packet_.Get<std::string>());
+  popped_packet_ = input_stream_manager_->PopPacketAtTimestamp(
+      Timestamp(20), &num_packets_dropped_, &stream_is_done_);
+  EXPECT_EQ("packet 2", popped_packet_.Get<std::string>());
+  EXPECT_EQ(0, num_packets_dropped_);
+  EXPECT_TRUE(input_stream_manager_->IsEmpty());
+  EXPECT_EQ(Timestamp(21),
+            input_stream_manager_->MinTimestampOrBound(&is_empty));
+  EXPECT_TRUE(is_empty);
+
+  // Timestamps are still validated against the bound.
+  packets.clear();
+  packets.push_back(MakePacket<std::string>("packet 3").At(Timestamp(15)));
+  notify_ = false;
+  EXPECT_FALSE(input_stream_manager_->AddPackets(packets, &notify_).ok());
+  EXPECT_FALSE(notify_);
+}
+
+TEST_F(LockFreeInputStreamManagerTest, OverflowsIntoQueue) {
+  std::list<Packet> packets;
+  for (int i = 0; i < 3 * kRingCapacity; ++i) {
+    packets.push_back(MakePacket<std::string>("packet").At(Timestamp(i)));
+  }
+  MP_ASSERT_OK(input_stream_manager_->MovePackets(&packets, &notify_));
+  EXPECT_TRUE(notify_);
+  EXPECT_EQ(3 * kRingCapacity, input_stream_manager_->QueueSize());
+  for (int i = 0; i < 3 * kRingCapacity; ++i) {
+    popped_packet_ = input_stream_manager_->PopPacketAtTimestamp(
+        Timestamp(i), &num_packets_dropped_, &stream_is_done_);
+    EXPECT_EQ(Timestamp(i), popped_packet_.Timestamp());
+  }
+  EXPECT_EQ(0, num_packets_dropped_);
+  EXPECT_TRUE(input_stream_manager_->IsEmpty());
+}
+
+TEST_F(LockFreeInputStreamManagerTest, SetNextTimestampBound) {
+  MP_ASSERT_OK(input_stream_manager_->SetNextTimestampBound(
+      Timestamp(50), &notify_));  // Notification
+  EXPECT_TRUE(notify_);
+  bool is_empty;
+  EXPECT_EQ(Timestamp(50),
+            input_stream_manager_->MinTimestampOrBound(&is_empty));
+
+  notify_ = false;
+  MP_ASSERT_OK(input_stream_manager_->SetNextTimestampBound(
+      Timestamp(50), &notify_));  // No notification
+  EXPECT_FALSE(notify_);
+  EXPECT_FALSE(
+      input_stream_manager_->SetNextTimestampBound(Timestamp(40), &notify_)
+          .ok());
+
+  // Selecting a timestamp raises the bound seen by the producer as well.
+  input_stream_manager_->PopPacketAtTimestamp(
+      Timestamp(60), &num_packets_dropped_, &stream_is_done_);
+  std::list<Packet> packets;
+  packets.push_back(MakePacket<std::string>("packet 1").At(Timestamp(60)));
+  EXPECT_FALSE(input_stream_manager_->AddPackets(packets, &notify_).ok());
+}
+
+TEST_F(LockFreeInputStreamManagerTest, QueueSizeCallbacks) {
+  input_stream_manager_->SetMaxQueueSize(2);
+  std::list<Packet> packets;
+  packets.push_back(MakePacket<std::string>("packet 1").At(Timestamp(10)));
+  packets.push_back(MakePacket<std::string>("packet 2").At(Timestamp(20)));
+  packets.push_back(MakePacket<std::string>("packet 3").At(Timestamp(30)));
+  MP_ASSERT_OK(input_stream_manager_->AddPackets(packets, &notify_));
+  EXPECT_TRUE(input_stream_manager_->IsFull());
+
+  input_stream_manager_->PopPacketAtTimestamp(
+      Timestamp(10), &num_packets_dropped_, &stream_is_done_);
+  EXPECT_TRUE(input_stream_manager_->IsFull());
+  input_stream_manager_->PopPacketAtTimestamp(
+      Timestamp(20), &num_packets_dropped_, &stream_is_done_);
+  EXPECT_FALSE(input_stream_manager_->IsFull());
+
+  expected_queue_becomes_full_count_ = 1;
+  expected_queue_becomes_not_full_count_ = 1;
+}
+
+TEST_F(LockFreeInputStreamManagerTest, Close) {
+  std::list<Packet> packets;
+  packets.push_back(MakePacket<std::string>("packet 1").At(Timestamp(10)));
+  MP_ASSERT_OK(input_stream_manager_->AddPackets(packets, &notify_));
+  input_stream_manager_->Close();
+  // Packets staged before Close() are kept.
+  bool is_empty;
+  EXPECT_EQ(Timestamp(10),
+            input_stream_manager_->MinTimestampOrBound(&is_empty));
+  EXPECT_FALSE(is_empty);
+
+  // Packets added after Close() are ignored.
+  packets.clear();
+  packets.push_back(MakePacket<std::string>("packet 2").At(Timestamp(20)));
+  notify_ = false;
+  MP_ASSERT_OK(input_stream_manager_->AddPackets(packets, &notify_));
+  EXPECT_FALSE(notify_);
+
+  // A new run starts with an empty queue.
+  input_stream_manager_->PrepareForRun();
+  EXPECT_TRUE(input_stream_manager_->IsEmpty());
+  EXPECT_EQ(Timestamp::PreStream(),
+            input_stream_manager_->MinTimestampOrBound(&is_empty));
+}
+
+// One thread adds packets while another pops them; all packets arrive in
+// order.
+TEST_F(LockFreeInputStreamManagerTest, ConcurrentProducerAndConsumer) {
+  constexpr int kNumPackets = 10000;
+  std::thread producer([this]() {
+    bool notify;
+    for (int i = 0; i < kNumPackets; ++i) {
+      MEDIAPIPE_CHECK_OK(input_stream_manager_->AddPackets(
+          {MakePacket<std::string>("packet").At(Timestamp(i))}, &notify));
+    }
+  });
+  int64 expected = 0;
+  while (expected < kNumPackets) {
+    bool is_empty;
+    Timestamp min_timestamp =
+        input_stream_manager_->MinTimestampOrBound(&is_empty);
+    if (is_empty) {
+      // The bound never runs ahead of the packets.
+      ASSERT_LE(min_timestamp, Timestamp(expected));
+      continue;
+    }
+    ASSERT_EQ(Timestamp(expected), min_timestamp);
+    popped_packet_ = input_stream_manager_->PopPacketAtTimestamp(
+        min_timestamp, &num_packets_dropped_, &stream_is_done_);
+    ASSERT_EQ(Timestamp(expected), popped_packet_.Timestamp());
+    ++expected;
+  }
+  producer.join();
+  EXPECT_TRUE(input_stream_manager_->IsEmpty());
+}
+
+// The consumer selects timestamps while the producer adds packets. A packet
+// is either rejected like in the mutex-guarded path, or it is queued after
+// the selected timestamp.
+TEST_F(LockFreeInputStreamManagerTest, ConcurrentSelectRejectsPassedPackets) {
+  constexpr int kNumPackets = 10000;
+  int num_added = 0;
+  std::thread producer([this, &num_added]() {
+    bool notify;
+    for (int i = 0; i < kNumPackets; ++i) {
+      if (input_stream_manager_
+              ->AddPackets({MakePacket<std::string>("packet").At(Timestamp(i))},
+                           &notify)
+              .ok()) {
+        ++num_added;
+      }
+    }
+  });
+  int num_removed = 0;
+  for (int64 t = 0; t < kNumPackets; t += 3) {
+    popped_packet_ = input_stream_manager_->PopPacketAtTimestamp(
+        Timestamp(t), &num_packets_dropped_, &stream_is_done_);
+    num_removed += num_packets_dropped_ + (popped_packet_.IsEmpty() ? 0 : 1);
+    ASSERT_GE(input_stream_manager_->QueueSize(), 0);
+    bool is_empty;
+    ASSERT_GT(input_stream_manager_->MinTimestampOrBound(&is_empty),
+              Timestamp(t));
+  }
+  producer.join();
+  EXPECT_EQ(num_added - num_removed, input_stream_manager_->QueueSize());
+  input_stream_manager_->Close();
+  EXPECT_EQ(num_added - num_removed, input_stream_manager_->QueueSize());
+}
+
+// Measures packets per second through one stream with one producer and one
+// consumer thread. state.range(0) selects the lock-free queue (1) or the
+// mutex-guarded deque (0).
+void BM_InputStreamThroughput(benchmark::State& state) {
+  constexpr int kNumPackets = 10000;
+  PacketType packet_type;
+  packet_type.Set<int>();
+  InputStreamManager stream;
+  MEDIAPIPE_CHECK_OK(
+      stream.Initialize("stream", &packet_type, /*back_edge=*/false));
+  // Pop with PopQueueHead(), like the immediate input stream handler.
+  stream.DisableTimestamps();
+  if (state.range(0)) {
+    stream.EnableLockFreeQueue(100);
+  }
+  auto no_op = [](InputStreamManager*, bool*) {};
+  const Packet payload = MakePacket<int>(0);
+  for (auto _ : state) {
+    stream.PrepareForRun();
+    stream.SetQueueSizeCallbacks(no_op, no_op);
+    std::thread producer([&stream, &payload]() {
+      bool notify;
+      for (int i = 0; i < kNumPackets; ++i) {
+        MEDIAPIPE_CHECK_OK(
+            stream.AddPackets({payload.At(Timestamp(i))}, &notify));
+      }
+    });
+    int num_popped = 0;
+    bool stream_is_done;
+    while (num_popped < kNumPackets) {
+      if (!stream.PopQueueHead(&stream_is_done).IsEmpty()) {
+        ++num_popped;
+      }
+    }
+    producer.join();
+    stream.Close();
+  }
+  state.SetItemsProcessed(state.iterations() * kNumPackets);
+}
+BENCHMARK(BM_InputStreamThroughput)->Arg(0)->Arg(1)->UseRealTime();
+
 }  // namespace
 }  // namespace mediapipe
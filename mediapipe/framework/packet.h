@@ -307,6 +307,8 @@ Packet AdoptAsSyncedPacket(const T* ptr) {
 // Create a packet containing an object of type T initialized with the
 // provided arguments. Similar to MakeUnique. Especially convenient for arrays,
 // since it ensures the packet gets the right type (see below).
+// For types sent at high rates, see also MakePooledPacket() in
+// pooled_packet.h, which recycles the packet holder.
 //
 // Version for scalars.
 template <typename T,
@@ -0,0 +1,100 @@
+// Copyright 2022 The MediaPipe Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef MEDIAPIPE_FRAMEWORK_PACKET_RING_BUFFER_H_
+#define MEDIAPIPE_FRAMEWORK_PACKET_RING_BUFFER_H_
+
+#include <atomic>
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+#include "mediapipe/framework/packet.h"
+
+namespace mediapipe {
+namespace internal {
+
+// A bounded, lock-free, single-producer single-consumer queue of packets.
+//
+// At most one thread may call TryPush() at a time, and at most one thread
+// may call TryPop() at a time; callers with several producers or consumers
+// must serialize each side themselves. A push and a pop may run
+// concurrently without any locking.
+class PacketRingBuffer {
+ public:
+  // The capacity is rounded up to the next power of two.
+  explicit PacketRingBuffer(size_t capacity) {
+    size_t size = 1;
+    while (size < capacity) size <<= 1;
+    slots_.resize(size);
+    mask_ = size - 1;
+  }
+  PacketRingBuffer(const PacketRingBuffer&) = delete;
+  PacketRingBuffer& operator=(const PacketRingBuffer&) = delete;
+
+  size_t capacity() const { return slots_.size(); }
+
+  // Producer side. Moves "packet" into the buffer and returns true, or
+  // returns false and leaves "packet" untouched if the buffer is full.
+  bool TryPush(Packet&& packet) {
+    const size_t tail = tail_.load(std::memory_order_relaxed);
+    if (tail - cached_head_ == slots_.size()) {
+      cached_head_ = head_.load(std::memory_order_acquire);
+      if (tail - cached_head_ == slots_.size()) return false;
+    }
+    slots_[tail & mask_] = std::move(packet);
+    tail_.store(tail + 1, std::memory_order_release);
+    return true;
+  }
+
+  // Consumer side. Moves the oldest packet into "packet" and returns true,
+  // or returns false if the buffer is empty.
+  bool TryPop(Packet* packet) {
+    const size_t head = head_.load(std::memory_order_relaxed);
+    if (head == cached_tail_) {
+      cached_tail_ = tail_.load(std::memory_order_acquire);
+      if (head == cached_tail_) return false;
+    }
+    *packet = std::move(slots_[head & mask_]);
+    head_.store(head + 1, std::memory_order_release);
+    return true;
+  }
+
+  // Drops all packets. Must not be called concurrently with TryPush() or
+  // TryPop().
+  void Clear() {
+    for (Packet& slot : slots_) slot = Packet();
+    head_.store(0, std::memory_order_relaxed);
+    tail_.store(0, std::memory_order_relaxed);
+    cached_head_ = 0;
+    cached_tail_ = 0;
+  }
+
+ private:
+  std::vector<Packet> slots_;
+  size_t mask_;
+  // Consumer-owned cache line: the read position and the consumer's last
+  // observed value of tail_.
+  alignas(64) std::atomic<size_t> head_{0};
+  size_t cached_tail_ = 0;
+  // Producer-owned cache line: the write position and the producer's last
+  // observed value of head_.
+  alignas(64) std::atomic<size_t> tail_{0};
+  size_t cached_head_ = 0;
+};
+
+}  // namespace internal
+}  // namespace mediapipe
+
+#endif  // MEDIAPIPE_FRAMEWORK_PACKET_RING_BUFFER_H_
@@ -0,0 +1,168 @@
+// Copyright 2022 The MediaPipe Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "mediapipe/framework/pooled_packet.h"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <new>
+#include <vector>
+
+#include "absl/base/thread_annotations.h"
+#include "absl/synchronization/mutex.h"
+#include "mediapipe/framework/deps/no_destructor.h"
+
+namespace mediapipe {
+namespace packet_internal {
+
+namespace {
+
+// Returns the index of the smallest size class that fits "size", or -1 if
+// the block is too large to be cached.
+int SizeClass(size_t size) {
+  if (size == 0 || size > HolderBlockCache::kMaxBlockBytes) return -1;
+  return (size - 1) / HolderBlockCache::kSizeClassBytes;
+}
+
+size_t SizeClassBytes(int size_class) {
+  return (size_class + 1) * HolderBlockCache::kSizeClassBytes;
+}
+
+// The free blocks shared by all threads, for one size class.
+struct alignas(64) SharedFreeList {
+  absl::Mutex mutex;
+  std::vector<void*> blocks ABSL_GUARDED_BY(mutex);
+  // blocks.size(), readable without the mutex so that threads need not lock
+  // an empty list.
+  std::atomic<int> num_blocks{0};
+};
+
+using SharedFreeLists =
+    std::array<SharedFreeList, HolderBlockCache::kNumSizeClasses>;
+
+SharedFreeLists& GetSharedFreeLists() {
+  static NoDestructor<SharedFreeLists> shared_free_lists;
+  return *shared_free_lists;
+}
+
+// Set once the calling thread's ThreadCache has been destroyed. Holders freed
+// after that, e.g. by other thread_local objects, bypass the cache.
+thread_local bool thread_cache_destroyed = false;
+
+// The free blocks of one thread.
+struct ThreadCache {
+  ThreadCache() {
+    for (std::vector<void*>& blocks : free_blocks) {
+      blocks.reserve(HolderBlockCache::kMaxThreadBlocks);
+    }
+  }
+
+  ~ThreadCache() {
+    for (int size_class = 0; size_class < HolderBlockCache::kNumSizeClasses;
+         ++size_class) {
+      ReleaseBlocks(size_class, free_blocks[size_class].size());
+    }
+    thread_cache_destroyed = true;
+  }
+
+  // Moves up to a batch of blocks from the shared list.
+  void AcquireBlocks(int size_class) {
+    SharedFreeList& shared = GetSharedFreeLists()[size_class];
+    if (shared.num_blocks.load(std::memory_order_relaxed) == 0) return;
+    absl::MutexLock lock(&shared.mutex);
+    const int n = std::min<int>(HolderBlockCache::kBatchSize,
+                                shared.blocks.size());
+    std::vector<void*>& blocks = free_blocks[size_class];
+    blocks.insert(blocks.end(), shared.blocks.end() - n, shared.blocks.end());
+    shared.blocks.resize(shared.blocks.size() - n);
+    shared.num_blocks.store(shared.blocks.size(), std::memory_order_relaxed);
+  }
+
+  // Moves the last "n" blocks to the shared list, or frees them if the
+  // shared list is full.
+  void ReleaseBlocks(int size_class, int n) {
+    if (n == 0) return;
+    SharedFreeList& shared = GetSharedFreeLists()[size_class];
+    std::vector<void*>& blocks = free_blocks[size_class];
+    absl::MutexLock lock(&shared.mutex);
+    for (int i = 0; i < n; ++i) {
+      if (shared.blocks.size() < HolderBlockCache::kMaxSharedBlocks) {
+        shared.blocks.push_back(blocks.back());
+      } else {
+        ::operator delete(blocks.back());
+      }
+      blocks.pop_back();
+    }
+    shared.num_blocks.store(shared.blocks.size(), std::memory_order_relaxed);
+  }
+
+  std::array<std::vector<void*>, HolderBlockCache::kNumSizeClasses>
+      free_blocks;
+  int64 num_allocated_blocks = 0;
+  int64 num_reused_blocks = 0;
+};
+
+thread_local ThreadCache thread_cache;
+
+}  // namespace
+
+void* HolderBlockCache::Allocate(size_t size) {
+  const int size_class = SizeClass(size);
+  if (size_class < 0) {
+    return ::operator new(size);
+  }
+  if (thread_cache_destroyed) {
+    // Round up, since the block may still be cached by another thread.
+    return ::operator new(SizeClassBytes(size_class));
+  }
+  ThreadCache& cache = thread_cache;
+  std::vector<void*>& blocks = cache.free_blocks[size_class];
+  if (blocks.empty()) {
+    cache.AcquireBlocks(size_class);
+  }
+  if (!blocks.empty()) {
+    void* block = blocks.back();
+    blocks.pop_back();
+    ++cache.num_reused_blocks;
+    return block;
+  }
+  ++cache.num_allocated_blocks;
+  return ::operator new(SizeClassBytes(size_class));
+}
+
+void HolderBlockCache::Deallocate(void* block, size_t size) {
+  const int size_class = SizeClass(size);
+  if (size_class < 0 || thread_cache_destroyed) {
+    ::operator delete(block);
+    return;
+  }
+  ThreadCache& cache = thread_cache;
+  std::vector<void*>& blocks = cache.free_blocks[size_class];
+  if (blocks.size() >= kMaxThreadBlocks) {
+    cache.ReleaseBlocks(size_class, kBatchSize);
+  }
+  blocks.push_back(block);
+}
+
+int64 HolderBlockCache::NumAllocatedBlocks() {
+  return thread_cache.num_allocated_blocks;
+}
+
+int64 HolderBlockCache::NumReusedBlocks() {
+  return thread_cache.num_reused_blocks;
+}
+
+}  // namespace packet_internal
+}  // namespace mediapipe
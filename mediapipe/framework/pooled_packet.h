@@ -0,0 +1,115 @@
+// Copyright 2022 The MediaPipe Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef MEDIAPIPE_FRAMEWORK_POOLED_PACKET_H_
+#define MEDIAPIPE_FRAMEWORK_POOLED_PACKET_H_
+
+#include <cstddef>
+#include <memory>
+#include <type_traits>
+#include <utility>
+
+#include "mediapipe/framework/packet.h"
+#include "mediapipe/framework/port/integral_types.h"
+
+namespace mediapipe {
+
+namespace packet_internal {
+
+// A cache of the small memory blocks that hold a packet Holder together with
+// its std::shared_ptr control block. Blocks are grouped into size classes.
+//
+// Each thread keeps its own free blocks, so allocating and freeing a block
+// normally takes no lock. A thread whose cache runs empty or full moves a
+// batch of blocks from or to a shared list, so that blocks freed by a
+// consumer thread are reused by the producer thread.
+class HolderBlockCache {
+ public:
+  // Size classes are multiples of kSizeClassBytes up to kMaxBlockBytes.
+  // Larger blocks are not cached.
+  static constexpr size_t kSizeClassBytes = 32;
+  static constexpr size_t kMaxBlockBytes = 256;
+  static constexpr int kNumSizeClasses = kMaxBlockBytes / kSizeClassBytes;
+  // The number of blocks moved to or from the shared list at a time.
+  static constexpr int kBatchSize = 32;
+  // The number of free blocks kept per size class by each thread, and by
+  // the shared list.
+  static constexpr int kMaxThreadBlocks = 2 * kBatchSize;
+  static constexpr int kMaxSharedBlocks = 64 * kBatchSize;
+
+  static void* Allocate(size_t size);
+  static void Deallocate(void* block, size_t size);
+
+  // Provided for debugging and testing only. The number of blocks that the
+  // calling thread has taken from the global allocator, and from the cache.
+  static int64 NumAllocatedBlocks();
+  static int64 NumReusedBlocks();
+};
+
+// A stateless standard allocator backed by HolderBlockCache.
+template <typename T>
+class HolderBlockAllocator {
+ public:
+  using value_type = T;
+
+  HolderBlockAllocator() = default;
+  template <typename U>
+  HolderBlockAllocator(const HolderBlockAllocator<U>&) {}  // NOLINT
+
+  T* allocate(size_t n) {
+    return static_cast<T*>(HolderBlockCache::Allocate(n * sizeof(T)));
+  }
+  void deallocate(T* p, size_t n) {
+    HolderBlockCache::Deallocate(p, n * sizeof(T));
+  }
+
+  template <typename U>
+  bool operator==(const HolderBlockAllocator<U>&) const {
+    return true;
+  }
+  template <typename U>
+  bool operator!=(const HolderBlockAllocator<U>&) const {
+    return false;
+  }
+};
+
+}  // namespace packet_internal
+
+// Like MakePacket<T>(args...), but recycles the memory of the packet holder.
+//
+// MakePacket<T>() performs three heap allocations: the payload, the
+// packet_internal::Holder<T>, and the std::shared_ptr control block that
+// counts the references to the holder. MakePooledPacket<T>() places the
+// holder and the control block in one block taken from
+// packet_internal::HolderBlockCache, so that in steady state only the payload
+// itself is allocated. The payload is still created with new, so the packet
+// behaves exactly like one from MakePacket<T>(), including Packet::Consume().
+//
+// Prefer this for types that are sent at high rates, such as
+// std::vector<Detection>, NormalizedLandmarkList and Tensor. Arrays are not
+// supported.
+template <typename T, typename... Args>
+Packet MakePooledPacket(Args&&... args) {  // NOLINT(build/c++11)
+  static_assert(!std::is_array<T>::value,
+                "MakePooledPacket does not support arrays.");
+  return packet_internal::Create(
+      std::allocate_shared<packet_internal::Holder<T>>(
+          packet_internal::HolderBlockAllocator<packet_internal::Holder<T>>(),
+          new T(std::forward<Args>(args)...)),
+      Timestamp::Unset());
+}
+
+}  // namespace mediapipe
+
+#endif  // MEDIAPIPE_FRAMEWORK_POOLED_PACKET_H_
@@ -0,0 +1,165 @@
+// Copyright 2022 The MediaPipe Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// To run the benchmarks:
+// $ bazel run -c opt mediapipe/framework:pooled_packet_test -- \
+//   --benchmark_filter=all
+
+#include "mediapipe/framework/pooled_packet.h"
+
+#include <atomic>
+#include <cstdlib>
+#include <functional>
+#include <memory>
+#include <new>
+#include <string>
+#include <thread>  // NOLINT(build/c++11)
+#include <vector>
+
+#include "mediapipe/framework/packet.h"
+#include "mediapipe/framework/packet_test.pb.h"
+#include "mediapipe/framework/port/benchmark.h"
+#include "mediapipe/framework/port/gmock.h"
+#include "mediapipe/framework/port/gtest.h"
+#include "mediapipe/framework/port/status_matchers.h"
+
+// Counts heap allocations, so that the benchmarks can report allocations per
+// packet.
+namespace {
+std::atomic<int64_t> num_heap_allocations{0};
+}  // namespace
+
+void* operator new(size_t size) {
+  num_heap_allocations.fetch_add(1, std::memory_order_relaxed);
+  if (void* p = std::malloc(size == 0 ? 1 : size)) return p;
+  throw std::bad_alloc();
+}
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete(void* p, size_t) noexcept { std::free(p); }
+
+namespace mediapipe {
+namespace {
+
+using packet_internal::HolderBlockCache;
+
+TEST(PooledPacketTest, MakesPackets) {
+  Packet packet = MakePooledPacket<std::string>("hello").At(Timestamp(7));
+  EXPECT_EQ("hello", packet.Get<std::string>());
+  EXPECT_EQ(Timestamp(7), packet.Timestamp());
+  MP_EXPECT_OK(packet.ValidateAsType<std::string>());
+
+  PacketTestProto proto;
+  proto.add_x(1);
+  Packet proto_packet = MakePooledPacket<PacketTestProto>(proto);
+  EXPECT_EQ(1, proto_packet.Get<PacketTestProto>().x(0));
+  EXPECT_EQ(&proto_packet.Get<PacketTestProto>(),
+            &proto_packet.GetProtoMessageLite());
+}
+
+TEST(PooledPacketTest, ReusesFreedHolders) {
+  Packet packet = MakePooledPacket<int>(1);
+  packet = Packet();
+  const int64 num_allocated = HolderBlockCache::NumAllocatedBlocks();
+  const int64 num_reused = HolderBlockCache::NumReusedBlocks();
+  for (int i = 0; i < 10; ++i) {
+    packet = MakePooledPacket<int>(i);
+    EXPECT_EQ(i, packet.Get<int>());
+    packet = Packet();
+  }
+  EXPECT_EQ(num_allocated, HolderBlockCache::NumAllocatedBlocks());
+  EXPECT_EQ(num_reused + 10, HolderBlockCache::NumReusedBlocks());
+}
+
+TEST(PooledPacketTest, ConsumesPayload) {
+  Packet packet = MakePooledPacket<std::vector<int>>(10, 1);
+  Packet copy = packet;
+  EXPECT_FALSE(packet.Consume<std::vector<int>>().ok());
+  copy = Packet();
+  auto consumed = packet.Consume<std::vector<int>>();
+  MP_ASSERT_OK(consumed);
+  EXPECT_EQ(10, consumed.value()->size());
+  EXPECT_TRUE(packet.IsEmpty());
+}
+
+// Packets made on one thread and dropped on another return their holders to
+// the producing thread through the shared free list.
+TEST(PooledPacketTest, RecyclesAcrossThreads) {
+  constexpr int kNumPackets = 4 * HolderBlockCache::kMaxThreadBlocks;
+  for (int round = 0; round < 3; ++round) {
+    std::vector<Packet> packets;
+    for (int i = 0; i < kNumPackets; ++i) {
+      packets.push_back(MakePooledPacket<int>(i));
+    }
+    std::thread consumer([&packets]() { packets.clear(); });
+    consumer.join();
+  }
+  EXPECT_GT(HolderBlockCache::NumReusedBlocks(), kNumPackets);
+}
+
+TEST(PooledPacketTest, IsThreadSafe) {
+  constexpr int kNumThreads = 4;
+  constexpr int kNumPackets = 1000;
+  std::vector<std::vector<Packet>> packets(kNumThreads);
+  auto run_threads = [](const std::function<void(int)>& fn) {
+    std::vector<std::thread> threads;
+    for (int t = 0; t < kNumThreads; ++t) {
+      threads.emplace_back(fn, t);
+    }
+    for (std::thread& thread : threads) {
+      thread.join();
+    }
+  };
+  for (int round = 0; round < 3; ++round) {
+    // Each thread makes packets, then drops those made by another thread.
+    run_threads([&packets](int t) {
+      for (int i = 0; i < kNumPackets; ++i) {
+        packets[t].push_back(MakePooledPacket<int>(i));
+      }
+    });
+    run_threads([&packets](int t) {
+      std::vector<Packet>& other = packets[(t + 1) % kNumThreads];
+      for (int i = 0; i < kNumPackets; ++i) {
+        EXPECT_EQ(i, other[i].Get<int>());
+      }
+      other.clear();
+    });
+  }
+}
+
+// Creates and drops packets holding a small vector, as a calculator emitting
+// detections would. Reports the heap allocations per packet, including the
+// payload. state.range(0) selects MakePooledPacket (1) or MakePacket (0).
+void BM_MakePacket(benchmark::State& state) {
+  const bool pooled = state.range(0);
+  constexpr int kNumPackets = 1000;
+  std::vector<Packet> packets(8);
+  int64 num_allocations = 0;
+  for (auto _ : state) {
+    const int64 start = num_heap_allocations.load();
+    for (int i = 0; i < kNumPackets; ++i) {
+      Packet& packet = packets[i % packets.size()];
+      packet = (pooled ? MakePooledPacket<std::vector<float>>(4, 1.0f)
+                       : MakePacket<std::vector<float>>(4, 1.0f))
+                   .At(Timestamp(i));
+    }
+    num_allocations += num_heap_allocations.load() - start;
+  }
+  state.SetItemsProcessed(state.iterations() * kNumPackets);
+  state.counters["allocs_per_packet"] =
+      static_cast<double>(num_allocations) / (state.iterations() * kNumPackets);
+}
+BENCHMARK(BM_MakePacket)->Arg(0)->Arg(1);
+
+}  // namespace
+}  // namespace mediapipe
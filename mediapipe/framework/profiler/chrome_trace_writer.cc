@@ -0,0 +1,164 @@
+// Copyright 2022 The MediaPipe Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "mediapipe/framework/profiler/chrome_trace_writer.h"
+
+#include "absl/strings/str_cat.h"
+#include "absl/strings/str_format.h"
+#include "absl/strings/string_view.h"
+
+namespace mediapipe {
+
+namespace {
+
+// The process id of all events.
+constexpr int kProcessId = 1;
+
+// The name of events not attributed to a calculator node.
+constexpr char kGraphEventName[] = "CalculatorGraph";
+
+// Appends "value" as a JSON string.
+void AppendJsonString(absl::string_view value, std::string* output) {
+  output->push_back('"');
+  for (char c : value) {
+    if (c == '"' || c == '\\') {
+      output->push_back('\\');
+      output->push_back(c);
+    } else if (static_cast<unsigned char>(c) < 0x20) {
+      absl::StrAppend(output, absl::StrFormat("\\u%04x", c));
+    } else {
+      output->push_back(c);
+    }
+  }
+  output->push_back('"');
+}
+
+// Appends the fields common to all events, leaving the event object open.
+void BeginEvent(absl::string_view name, absl::string_view category,
+                absl::string_view phase, int64 time, int32 thread_id,
+                std::string* output) {
+  output->append("{\"name\":");
+  AppendJsonString(name, output);
+  output->append(",\"cat\":");
+  AppendJsonString(category, output);
+  absl::StrAppend(output, ",\"ph\":\"", phase, "\",\"ts\":", time,
+                  ",\"pid\":", kProcessId, ",\"tid\":", thread_id);
+}
+
+// Closes an event object.
+void EndEvent(std::string* output) { output->append("},\n"); }
+
+}  // namespace
+
+ChromeTraceWriter::ChromeTraceWriter(std::vector<std::string> node_names)
+    : node_names_(std::move(node_names)) {}
+
+std::string ChromeTraceWriter::FileHeader() const {
+  return absl::StrCat("[\n{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":",
+                      kProcessId, ",\"args\":{\"name\":\"MediaPipe\"}},\n");
+}
+
+const ChromeTraceWriter::PacketSource* ChromeTraceWriter::FindPacketSource(
+    const PacketKey& key) const {
+  auto it = packet_sources_.find(key);
+  if (it != packet_sources_.end()) {
+    return &it->second;
+  }
+  it = previous_packet_sources_.find(key);
+  if (it != previous_packet_sources_.end()) {
+    return &it->second;
+  }
+  return nullptr;
+}
+
+void ChromeTraceWriter::AppendEvents(const GraphTrace& trace,
+                                     std::string* output) {
+  // Packets are connected across two consecutive GraphTraces at most, which
+  // bounds the memory used for packets that are never received.
+  previous_packet_sources_ = std::move(packet_sources_);
+  packet_sources_.clear();
+  const int64 base_time = trace.base_time();
+  const int64 base_timestamp = trace.base_timestamp();
+
+  // Record the packet sources first, since an invocation can precede the
+  // invocation that output its input packets in the GraphTrace.
+  for (const GraphTrace::CalculatorTrace& ct : trace.calculator_trace()) {
+    if (!ct.has_start_time() && !ct.has_finish_time()) {
+      continue;
+    }
+    const PacketSource source = {
+        ct.thread_id(),
+        base_time + (ct.has_start_time() ? ct.start_time() : ct.finish_time())};
+    for (const GraphTrace::StreamTrace& st : ct.output_trace()) {
+      const PacketKey key = {st.stream_id(),
+                             base_timestamp + st.packet_timestamp()};
+      packet_sources_[key] = source;
+    }
+  }
+
+  for (const GraphTrace::CalculatorTrace& ct : trace.calculator_trace()) {
+    if (!ct.has_start_time() && !ct.has_finish_time()) {
+      continue;
+    }
+    const absl::string_view name =
+        ct.node_id() >= 0 &&
+                ct.node_id() < static_cast<int>(node_names_.size())
+            ? absl::string_view(node_names_[ct.node_id()])
+            : absl::string_view(kGraphEventName);
+    const std::string& category = GraphTrace::EventType_Name(ct.event_type());
+    if (ct.has_start_time() && ct.has_finish_time()) {
+      BeginEvent(name, category, "X", base_time + ct.start_time(),
+                 ct.thread_id(), output);
+      absl::StrAppend(output, ",\"dur\":", ct.finish_time() - ct.start_time());
+    } else {
+      BeginEvent(name, category, "i",
+                 base_time + (ct.has_start_time() ? ct.start_time()
+                                                  : ct.finish_time()),
+                 ct.thread_id(), output);
+      output->append(",\"s\":\"t\"");
+    }
+    if (ct.has_input_timestamp()) {
+      absl::StrAppend(output, ",\"args\":{\"input_timestamp\":",
+                      base_timestamp + ct.input_timestamp(), "}");
+    }
+    EndEvent(output);
+
+    // Draw an arrow to the start of this invocation for each input packet.
+    if (!ct.has_start_time()) {
+      continue;
+    }
+    for (const GraphTrace::StreamTrace& st : ct.input_trace()) {
+      const PacketSource* source = FindPacketSource(
+          {st.stream_id(), base_timestamp + st.packet_timestamp()});
+      if (source == nullptr) {
+        continue;
+      }
+      const absl::string_view stream_name =
+          st.stream_id() < trace.stream_name_size()
+              ? absl::string_view(trace.stream_name(st.stream_id()))
+              : absl::string_view();
+      const int64 flow_id = next_flow_id_++;
+      BeginEvent(stream_name, "packet", "s", source->time, source->thread_id,
+                 output);
+      absl::StrAppend(output, ",\"id\":", flow_id);
+      EndEvent(output);
+      BeginEvent(stream_name, "packet", "f", base_time + ct.start_time(),
+                 ct.thread_id(), output);
+      absl::StrAppend(output, ",\"bp\":\"e\",\"id\":", flow_id);
+      EndEvent(output);
+    }
+  }
+}
+
+}  // namespace mediapipe
@@ -0,0 +1,74 @@
+// Copyright 2022 The MediaPipe Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef MEDIAPIPE_FRAMEWORK_PROFILER_CHROME_TRACE_WRITER_H_
+#define MEDIAPIPE_FRAMEWORK_PROFILER_CHROME_TRACE_WRITER_H_
+
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "absl/container/flat_hash_map.h"
+#include "mediapipe/framework/calculator_profile.pb.h"
+#include "mediapipe/framework/port/integral_types.h"
+
+namespace mediapipe {
+
+// Converts GraphTraces into the Chrome Trace Event Format, which is read by
+// chrome://tracing and by Perfetto.
+//
+// The events are written in the JSON Array Format without the closing
+// bracket, which the format makes optional, so that a trace file can be
+// extended with the events of each GraphTrace as soon as it is captured.
+// Each calculator invocation is written as a complete event on the track of
+// its thread, and each packet as a flow arrow from the invocation that output
+// it to each invocation that received it.
+//
+// The GraphTraces must come from the same GraphTracer, in order.
+class ChromeTraceWriter {
+ public:
+  // "node_names" are the calculator node names, indexed by node id.
+  explicit ChromeTraceWriter(std::vector<std::string> node_names);
+
+  // Returns the beginning of a trace file.
+  std::string FileHeader() const;
+
+  // Appends the events of "trace" to "output". Packets output in the previous
+  // GraphTrace and received in this one are connected as well.
+  void AppendEvents(const GraphTrace& trace, std::string* output);
+
+ private:
+  // The invocation that output a packet.
+  struct PacketSource {
+    int32 thread_id;
+    int64 time;
+  };
+  // Identifies a packet by stream id and timestamp.
+  using PacketKey = std::pair<int32, int64>;
+  using PacketSources = absl::flat_hash_map<PacketKey, PacketSource>;
+
+  // Returns the source of a packet, or null if it is not traced.
+  const PacketSource* FindPacketSource(const PacketKey& key) const;
+
+  std::vector<std::string> node_names_;
+  // The packets output in the current and in the previous GraphTrace.
+  PacketSources packet_sources_;
+  PacketSources previous_packet_sources_;
+  // The id of the next flow arrow.
+  int64 next_flow_id_ = 1;
+};
+
+}  // namespace mediapipe
+
+#endif  // MEDIAPIPE_FRAMEWORK_PROFILER_CHROME_TRACE_WRITER_H_
@@ -0,0 +1,124 @@
+// Copyright 2022 The MediaPipe Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "mediapipe/framework/profiler/chrome_trace_writer.h"
+
+#include <string>
+
+#include "mediapipe/framework/calculator_profile.pb.h"
+#include "mediapipe/framework/port/gmock.h"
+#include "mediapipe/framework/port/gtest.h"
+#include "mediapipe/framework/port/parse_text_proto.h"
+
+namespace mediapipe {
+namespace {
+
+using ::testing::HasSubstr;
+using ::testing::Not;
+
+// A packet output by "Source" on stream "input" at timestamp 100.
+GraphTrace SourceTrace() {
+  return ParseTextProtoOrDie<GraphTrace>(R"pb(
+    base_time: 1000000
+    base_timestamp: 100
+    stream_name: ""
+    stream_name: "input"
+    calculator_trace {
+      node_id: 0
+      event_type: PROCESS
+      input_timestamp: 0
+      start_time: 10
+      finish_time: 30
+      thread_id: 2
+      output_trace { stream_id: 1 packet_timestamp: 0 }
+    }
+  )pb");
+}
+
+// The packet received by "Sink", which then waits for input.
+GraphTrace SinkTrace() {
+  return ParseTextProtoOrDie<GraphTrace>(R"pb(
+    base_time: 1000000
+    base_timestamp: 100
+    stream_name: ""
+    stream_name: "input"
+    calculator_trace {
+      node_id: 1
+      event_type: PROCESS
+      input_timestamp: 0
+      start_time: 40
+      finish_time: 55
+      thread_id: 3
+      input_trace {
+        stream_id: 1
+        packet_timestamp: 0
+        start_time: 30
+        finish_time: 40
+      }
+    }
+    calculator_trace {
+      node_id: 1
+      event_type: NOT_READY
+      start_time: 60
+      thread_id: 3
+    }
+  )pb");
+}
+
+TEST(ChromeTraceWriterTest, WritesEventsAndFlows) {
+  ChromeTraceWriter writer({"Source", "Sink"});
+  std::string json = writer.FileHeader();
+  writer.AppendEvents(SourceTrace(), &json);
+  writer.AppendEvents(SinkTrace(), &json);
+  EXPECT_EQ(
+      json,
+      "[\n"
+      R"({"name":"process_name","ph":"M","pid":1,"args":{"name":"MediaPipe"}},)"
+      "\n"
+      R"({"name":"Source","cat":"PROCESS","ph":"X","ts":1000010,"pid":1,)"
+      R"("tid":2,"dur":20,"args":{"input_timestamp":100}},)"
+      "\n"
+      R"({"name":"Sink","cat":"PROCESS","ph":"X","ts":1000040,"pid":1,)"
+      R"("tid":3,"dur":15,"args":{"input_timestamp":100}},)"
+      "\n"
+      R"({"name":"input","cat":"packet","ph":"s","ts":1000010,"pid":1,)"
+      R"("tid":2,"id":1},)"
+      "\n"
+      R"({"name":"input","cat":"packet","ph":"f","ts":1000040,"pid":1,)"
+      R"("tid":3,"bp":"e","id":1},)"
+      "\n"
+      R"({"name":"Sink","cat":"NOT_READY","ph":"i","ts":1000060,"pid":1,)"
+      R"("tid":3,"s":"t"},)"
+      "\n");
+}
+
+TEST(ChromeTraceWriterTest, ForgetsPacketsAfterOneTrace) {
+  ChromeTraceWriter writer({"Source", "Sink"});
+  std::string json;
+  writer.AppendEvents(SourceTrace(), &json);
+  writer.AppendEvents(GraphTrace(), &json);
+  writer.AppendEvents(SinkTrace(), &json);
+  EXPECT_THAT(json, HasSubstr(R"("name":"Sink","cat":"PROCESS")"));
+  EXPECT_THAT(json, Not(HasSubstr(R"("cat":"packet")")));
+}
+
+TEST(ChromeTraceWriterTest, EscapesNames) {
+  ChromeTraceWriter writer({"Source\"\\\n"});
+  std::string json;
+  writer.AppendEvents(SourceTrace(), &json);
+  EXPECT_THAT(json, HasSubstr(R"({"name":"Source\"\\\u000a",)"));
+}
+
+}  // namespace
+}  // namespace mediapipe
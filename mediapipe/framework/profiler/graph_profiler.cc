@@ -14,12 +14,20 @@
 
 #include "mediapipe/framework/profiler/graph_profiler.h"
 
+#include <algorithm>
+#include <deque>
 #include <fstream>
+#include <limits>
 #include <list>
+#include <string>
+#include <utility>
+#include <vector>
 
+#include "absl/container/flat_hash_map.h"
 #include "absl/strings/substitute.h"
 #include "absl/synchronization/mutex.h"
 #include "absl/time/time.h"
+#include "mediapipe/framework/formats/shared_buffer_pool.h"
 #include "mediapipe/framework/port/advanced_proto_lite_inc.h"
 #include "mediapipe/framework/port/canonical_errors.h"
 #include "mediapipe/framework/port/logging.h"
@@ -45,6 +53,9 @@ const char kDefaultLogFilePrefix[] = "mediapipe_trace_";
 // The number of recent timestamps tracked for each input stream.
 const int kPacketInfoRecentCount = 100;
 
+// The number of recent samples from which latency percentiles are computed.
+const int kLatencySampleCount = 1000;
+
 std::string PacketIdToString(const PacketId& packet_id) {
   return absl::Substitute("stream_name: $0, timestamp_usec: $1",
                           packet_id.stream_name, packet_id.timestamp_usec);
@@ -118,6 +129,63 @@ PacketInfo* GetPacketInfo(PacketInfoMap* map, const PacketId& packet_id) {
   return nullptr;
 }
 
+using ReadyTimeMap = ShardedMap<int, std::list<std::pair<int64, int64>>>;
+
+// Inserts the time a node became ready for an input timestamp.
+void InsertReadyTime(ReadyTimeMap* map, int node_id, int64 timestamp_usec,
+                     int64 ready_time_usec) {
+  auto entry = map->find(node_id);
+  if (entry == map->end()) {
+    entry = map->insert({node_id, {}}).first;
+  }
+  auto& list = entry->second;
+  list.push_back({timestamp_usec, ready_time_usec});
+  while (list.size() > kPacketInfoRecentCount) {
+    list.pop_front();
+  }
+}
+
+// Returns the time a node became ready for an input timestamp, or
+// |default_usec| if it is not recorded.
+int64 GetReadyTime(ReadyTimeMap* map, int node_id, int64 timestamp_usec,
+                   int64 default_usec) {
+  auto entry = map->find(node_id);
+  if (entry == map->end()) {
+    return default_usec;
+  }
+  auto& list = entry->second;
+  for (auto iter = list.rbegin(); iter != list.rend(); ++iter) {
+    if (iter->first == timestamp_usec) {
+      return iter->second;
+    }
+  }
+  return default_usec;
+}
+
+// Adds a latency sample, discarding the oldest ones.
+void AddLatencySample(int64 time_usec, std::deque<int64>* samples) {
+  samples->push_back(time_usec);
+  while (samples->size() > kLatencySampleCount) {
+    samples->pop_front();
+  }
+}
+
+// Computes nearest-rank percentiles of latency samples.
+void SetTimePercentiles(const std::deque<int64>& samples,
+                        TimePercentiles* percentiles) {
+  std::vector<int64> sorted(samples.begin(), samples.end());
+  std::sort(sorted.begin(), sorted.end());
+  percentiles->set_sample_count(sorted.size());
+  if (sorted.empty()) {
+    return;
+  }
+  auto percentile = [&sorted](int64 percent) {
+    return sorted[(sorted.size() * percent + 99) / 100 - 1];
+  };
+  percentiles->set_p50_usec(percentile(50));
+  percentiles->set_p99_usec(percentile(99));
+}
+
 }  // namespace
 
 // Builds GraphProfile records from profiler timing data.
@@ -167,10 +235,12 @@ void GraphProfiler::Initialize(
   if (IsTracerEnabled(profiler_config_)) {
     packet_tracer_ = absl::make_unique<GraphTracer>(profiler_config_);
   }
+  std::vector<std::string> node_names;
   for (int node_id = 0;
        node_id < validated_graph_config.CalculatorInfos().size(); ++node_id) {
     std::string node_name =
         tool::CanonicalNodeName(validated_graph_config.Config(), node_id);
+    node_names.push_back(node_name);
     CalculatorProfile profile;
     profile.set_name(node_name);
     InitializeTimeHistogram(interval_size_usec, num_intervals,
@@ -186,12 +256,22 @@ void GraphProfiler::Initialize(
       InitializeOutputStreams(node_config);
       InitializeInputStreams(node_config, interval_size_usec, num_intervals,
                              &profile);
+      LatencySamples latency_samples;
+      latency_samples.input_stream_queueing_delays.resize(
+          profile.input_stream_profiles_size());
+      latency_samples_.insert({node_name, latency_samples});
     }
 
     auto iter = calculator_profiles_.insert({node_name, profile});
     CHECK(iter.second) << absl::Substitute(
         "Calculator \"$0\" has already been added.", node_name);
   }
+  if (IsTraceLogEnabled(profiler_config_) &&
+      profiler_config_.trace_log_format() ==
+          ProfilerConfig::CHROME_TRACE_JSON) {
+    chrome_trace_writer_ =
+        absl::make_unique<ChromeTraceWriter>(std::move(node_names));
+  }
   profile_builder_ = std::make_unique<GraphProfileBuilder>(this);
   is_initialized_ = true;
 }
@@ -233,6 +313,16 @@ void GraphProfiler::Reset() {
       ResetTimeHistogram(input_stream_profile.mutable_latency());
     }
   }
+  for (auto& entry : latency_samples_) {
+    LatencySamples& latency_samples = entry.second;
+    latency_samples.end_to_end.clear();
+    latency_samples.queueing_delay.clear();
+    latency_samples.scheduler_wait.clear();
+    latency_samples.execution_time.clear();
+    for (auto& samples : latency_samples.input_stream_queueing_delays) {
+      samples.clear();
+    }
+  }
 }
 
 // Begins profiling for a single graph run.
@@ -288,6 +378,19 @@ void GraphProfiler::LogEvent(const TraceEvent& event) {
   if (event.event_type == GraphTrace::PROCESS && event.node_id == -1) {
     AddPacketInfo(event);
   }
+  if (event.event_type == GraphTrace::READY_FOR_PROCESS) {
+    AddReadyTime(event);
+  }
+}
+
+void GraphProfiler::AddReadyTime(const TraceEvent& event) {
+  absl::ReaderMutexLock lock(&profiler_mutex_);
+  if (!is_profiling_ || !profiler_config_.enable_stream_latency() ||
+      !event.input_ts.IsRangeValue()) {
+    return;
+  }
+  InsertReadyTime(&ready_times_, event.node_id, event.input_ts.Value(),
+                  TimeNowUsec());
 }
 
 void GraphProfiler::AddPacketInfo(const TraceEvent& packet_info) {
@@ -315,7 +418,8 @@ void GraphProfiler::AddPacketInfo(const TraceEvent& packet_info) {
           ? packet_timestamp.Value()
           : TimeNowUsec();
   AddPacketInfoInternal(PacketId({stream_name, packet_timestamp.Value()}),
-                        production_time_usec, production_time_usec);
+                        production_time_usec, production_time_usec,
+                        PacketLatencyPath());
 }
 
 absl::Status GraphProfiler::GetCalculatorProfiles(
@@ -323,9 +427,43 @@ absl::Status GraphProfiler::GetCalculatorProfiles(
   absl::ReaderMutexLock lock(&profiler_mutex_);
   RET_CHECK(is_initialized_)
       << "GetCalculatorProfiles can only be called after Initialize()";
+  const size_t first_profile = profiles->size();
   for (auto& entry : calculator_profiles_) {
     profiles->push_back(entry.second);
   }
+  if (!profiler_config_.enable_stream_latency()) {
+    return absl::OkStatus();
+  }
+  absl::flat_hash_map<std::string, CalculatorProfile*> profiles_by_name;
+  for (size_t i = first_profile; i < profiles->size(); ++i) {
+    profiles_by_name[(*profiles)[i].name()] = &(*profiles)[i];
+  }
+  for (auto& entry : latency_samples_) {
+    const LatencySamples& latency_samples = entry.second;
+    auto profile_iter = profiles_by_name.find(entry.first);
+    if (profile_iter == profiles_by_name.end() ||
+        latency_samples.end_to_end.empty()) {
+      continue;
+    }
+    CalculatorProfile* profile = profile_iter->second;
+    LatencyBreakdown* breakdown = profile->mutable_latency_breakdown();
+    SetTimePercentiles(latency_samples.end_to_end,
+                       breakdown->mutable_end_to_end());
+    SetTimePercentiles(latency_samples.queueing_delay,
+                       breakdown->mutable_queueing_delay());
+    SetTimePercentiles(latency_samples.scheduler_wait,
+                       breakdown->mutable_scheduler_wait());
+    SetTimePercentiles(latency_samples.execution_time,
+                       breakdown->mutable_execution_time());
+    for (int i = 0; i < profile->input_stream_profiles_size(); ++i) {
+      const std::deque<int64>& samples =
+          latency_samples.input_stream_queueing_delays[i];
+      if (!samples.empty()) {
+        SetTimePercentiles(samples, profile->mutable_input_stream_profiles(i)
+                                        ->mutable_queueing_delay());
+      }
+    }
+  }
   return absl::OkStatus();
 }
 
@@ -391,35 +529,75 @@ void GraphProfiler::ResetTimeHistogram(TimeHistogram* histogram) {
   }
 }
 
-void GraphProfiler::AddPacketInfoInternal(const PacketId& packet_id,
-                                          int64 production_time_usec,
-                                          int64 source_process_start_usec) {
-  PacketInfo packet_info = {0, production_time_usec, source_process_start_usec};
+void GraphProfiler::AddPacketInfoInternal(
+    const PacketId& packet_id, int64 production_time_usec,
+    int64 source_process_start_usec, const PacketLatencyPath& latency_path) {
+  PacketInfo packet_info = {0, production_time_usec, source_process_start_usec,
+                            latency_path};
   InsertPacketInfo(&packets_info_, packet_id, packet_info);
 }
 
 void GraphProfiler::AddPacketInfoForOutputPackets(
     const OutputStreamShardSet& output_stream_shard_set,
-    int64 production_time_usec, int64 source_process_start_usec) {
+    int64 production_time_usec, int64 source_process_start_usec,
+    const PacketLatencyPath& latency_path) {
   for (const OutputStreamShard& output_stream_shard : output_stream_shard_set) {
     for (const Packet& output_packet : *output_stream_shard.OutputQueue()) {
       AddPacketInfoInternal(PacketId({output_stream_shard.Name(),
                                       output_packet.Timestamp().Value()}),
-                            production_time_usec, source_process_start_usec);
+                            production_time_usec, source_process_start_usec,
+                            latency_path);
     }
   }
 }
 
 int64 GraphProfiler::AddStreamLatencies(
     const CalculatorContext& calculator_context, int64 start_time_usec,
-    int64 end_time_usec, CalculatorProfile* calculator_profile) {
+    int64 end_time_usec, CalculatorProfile* calculator_profile,
+    LatencySamples* latency_samples) {
+  // Without a READY_FOR_PROCESS event, all of the wait is queueing delay.
+  int64 ready_time_usec =
+      GetReadyTime(&ready_times_, calculator_context.NodeId(),
+                   calculator_context.InputTimestamp().Value(),
+                   start_time_usec);
+
   // Update input streams profiles.
+  PacketInfo last_input = {0, std::numeric_limits<int64>::min(),
+                           start_time_usec};
   int64 min_source_process_start_usec = AddInputStreamTimeSamples(
-      calculator_context, start_time_usec, calculator_profile);
+      calculator_context, start_time_usec, ready_time_usec, calculator_profile,
+      &last_input, latency_samples);
+  if (last_input.production_time_usec == std::numeric_limits<int64>::min()) {
+    // Without input packets, the critical path begins with this Process().
+    last_input.production_time_usec = start_time_usec;
+  }
+
+  // The calculator became ready when its last input packet arrived at the
+  // earliest, which puts that packet on the critical path.
+  ready_time_usec =
+      std::min(std::max(ready_time_usec, last_input.production_time_usec),
+               start_time_usec);
+  PacketLatencyPath latency_path = last_input.latency_path;
+  latency_path.queueing_delay_usec += std::max<int64>(
+      0, ready_time_usec - last_input.production_time_usec);
+  latency_path.scheduler_wait_usec += start_time_usec - ready_time_usec;
+  latency_path.execution_time_usec += end_time_usec - start_time_usec;
+  if (latency_samples != nullptr) {
+    AddLatencySample(latency_path.queueing_delay_usec +
+                         latency_path.scheduler_wait_usec +
+                         latency_path.execution_time_usec,
+                     &latency_samples->end_to_end);
+    AddLatencySample(latency_path.queueing_delay_usec,
+                     &latency_samples->queueing_delay);
+    AddLatencySample(latency_path.scheduler_wait_usec,
+                     &latency_samples->scheduler_wait);
+    AddLatencySample(latency_path.execution_time_usec,
+                     &latency_samples->execution_time);
+  }
 
   // Update output production times.
   AddPacketInfoForOutputPackets(calculator_context.Outputs(), end_time_usec,
-                                min_source_process_start_usec);
+                                min_source_process_start_usec, latency_path);
   return min_source_process_start_usec;
 }
 
@@ -441,7 +619,7 @@ void GraphProfiler::SetOpenRuntime(const CalculatorContext& calculator_context,
 
   if (profiler_config_.enable_stream_latency()) {
     AddStreamLatencies(calculator_context, start_time_usec, end_time_usec,
-                       calculator_profile);
+                       calculator_profile, /*latency_samples=*/nullptr);
   }
 }
 
@@ -463,7 +641,7 @@ void GraphProfiler::SetCloseRuntime(const CalculatorContext& calculator_context,
 
   if (profiler_config_.enable_stream_latency()) {
     AddStreamLatencies(calculator_context, start_time_usec, end_time_usec,
-                       calculator_profile);
+                       calculator_profile, /*latency_samples=*/nullptr);
   }
 }
 
@@ -487,7 +665,8 @@ void GraphProfiler::AddTimeSample(int64 start_time_usec, int64 end_time_usec,
 
 int64 GraphProfiler::AddInputStreamTimeSamples(
     const CalculatorContext& calculator_context, int64 start_time_usec,
-    CalculatorProfile* calculator_profile) {
+    int64 ready_time_usec, CalculatorProfile* calculator_profile,
+    PacketInfo* last_input, LatencySamples* latency_samples) {
   int64 input_timestamp_usec = calculator_context.InputTimestamp().Value();
   int64 min_source_process_start_usec = start_time_usec;
   int64 input_stream_counter = -1;
@@ -518,6 +697,15 @@ int64 GraphProfiler::AddInputStreamTimeSamples(
 
     min_source_process_start_usec = std::min(
         min_source_process_start_usec, packet_info->source_process_start_usec);
+    if (packet_info->production_time_usec > last_input->production_time_usec) {
+      *last_input = *packet_info;
+    }
+    if (latency_samples != nullptr) {
+      AddLatencySample(
+          std::max<int64>(0, std::min(ready_time_usec, start_time_usec) -
+                                 packet_info->production_time_usec),
+          &latency_samples->input_stream_queueing_delays[input_stream_counter]);
+    }
   }
 
   return min_source_process_start_usec;
@@ -543,8 +731,11 @@ void GraphProfiler::AddProcessSample(
                 calculator_profile->mutable_process_runtime());
 
   if (profiler_config_.enable_stream_latency()) {
+    auto samples_iter = latency_samples_.find(node_name);
     int64 min_source_process_start_usec = AddStreamLatencies(
-        calculator_context, start_time_usec, end_time_usec, calculator_profile);
+        calculator_context, start_time_usec, end_time_usec, calculator_profile,
+        samples_iter != latency_samples_.end() ? &samples_iter->second
+                                               : nullptr);
     // Update input and output trace latencies.
     AddTimeSample(min_source_process_start_usec, start_time_usec,
                   calculator_profile->mutable_process_input_latency());
@@ -624,6 +815,21 @@ void CleanTimeHistogram(TimeHistogram* histogram) {
   }
 }
 
+// Records the usage of the shared buffer pool, if it has been used.
+void CaptureBufferPoolStats(GraphProfile* result) {
+  const SharedBufferPool::Stats stats = SharedBufferPool::Get().GetStats();
+  if (stats.hit_count + stats.miss_count == 0) {
+    return;
+  }
+  BufferPoolStats* pool_stats = result->mutable_buffer_pool_stats();
+  pool_stats->set_hit_count(stats.hit_count);
+  pool_stats->set_miss_count(stats.miss_count);
+  pool_stats->set_bytes_in_use(stats.bytes_in_use);
+  pool_stats->set_bytes_available(stats.bytes_available);
+  pool_stats->set_bytes_trimmed(stats.bytes_trimmed);
+  pool_stats->set_byte_budget(stats.byte_budget);
+}
+
 // Clears fields containing their default values.
 void CleanCalculatorProfiles(GraphProfile* profile) {
   for (CalculatorProfile& p : *profile->mutable_calculator_profiles()) {
@@ -684,6 +890,7 @@ absl::Status GraphProfiler::CaptureProfile(
     *result->mutable_config() = validated_graph_->Config();
     AssignNodeNames(result);
   }
+  CaptureBufferPoolStats(result);
   return status;
 }
 
@@ -714,13 +921,23 @@ absl::Status GraphProfiler::WriteProfile() {
 
   // Write the GraphProfile to the trace_log_path.
   int log_index = previous_log_index_ / log_interval_count % log_file_count;
-  std::string log_path = absl::StrCat(trace_log_path, log_index, ".binarypb");
+  std::string log_path =
+      absl::StrCat(trace_log_path, log_index,
+                   chrome_trace_writer_ ? ".json" : ".binarypb");
   std::ofstream ofs;
   if (is_new_file) {
     ofs.open(log_path, std::ofstream::out | std::ofstream::trunc);
   } else {
     ofs.open(log_path, std::ofstream::out | std::ofstream::app);
   }
+  if (chrome_trace_writer_) {
+    std::string json =
+        is_new_file ? chrome_trace_writer_->FileHeader() : std::string();
+    chrome_trace_writer_->AppendEvents(trace, &json);
+    ofs << json;
+    RET_CHECK(ofs.good()) << "Could not write Chrome trace to: " << log_path;
+    return absl::OkStatus();
+  }
   OstreamStream out(&ofs);
   RET_CHECK(profile.SerializeToZeroCopyStream(&out))
       << "Could not write binary GraphProfile to: " << log_path;
@@ -17,6 +17,8 @@
 
 #include <atomic>
 #include <cstddef>
+#include <deque>
+#include <list>
 #include <memory>
 #include <set>
 #include <string>
@@ -30,6 +32,7 @@
 #include "mediapipe/framework/deps/monotonic_clock.h"
 #include "mediapipe/framework/executor.h"
 #include "mediapipe/framework/port/integral_types.h"
+#include "mediapipe/framework/profiler/chrome_trace_writer.h"
 #include "mediapipe/framework/profiler/graph_tracer.h"
 #include "mediapipe/framework/profiler/sharded_map.h"
 #include "mediapipe/framework/validated_graph_config.h"
@@ -50,6 +53,24 @@ struct PacketId {
   }
 };
 
+// The critical-path latency of a packet since the start of its source
+// Process(), see LatencyBreakdown in calculator_profile.proto.
+struct PacketLatencyPath {
+  // Time spent in input streams before calculators became ready.
+  int64 queueing_delay_usec = 0;
+  // Time calculators spent ready before their Process() started.
+  int64 scheduler_wait_usec = 0;
+  // Time spent in Process().
+  int64 execution_time_usec = 0;
+
+  // For testing.
+  bool operator==(const PacketLatencyPath& other) const {
+    return (queueing_delay_usec == other.queueing_delay_usec) &&
+           (scheduler_wait_usec == other.scheduler_wait_usec) &&
+           (execution_time_usec == other.execution_time_usec);
+  }
+};
+
 struct PacketInfo {
   // Number of remained consumer of this packet.
   // This is used to decide if this PacketInfo should be discarded.
@@ -59,12 +80,15 @@ struct PacketInfo {
   // The time when the Process(), that generated the corresponding source
   // packet, was started.
   int64 source_process_start_usec;
+  // The critical path that led to the packet.
+  PacketLatencyPath latency_path;
 
   // For testing.
   bool operator==(const PacketInfo& other) const {
     return (remaining_consumer_count == other.remaining_consumer_count) &&
            (production_time_usec == other.production_time_usec) &&
-           (source_process_start_usec == other.source_process_start_usec);
+           (source_process_start_usec == other.source_process_start_usec) &&
+           (latency_path == other.latency_path);
   }
 };
 
@@ -83,6 +107,9 @@ enum class PopulateGraphConfig { kNo, kFull };
 // the graph (source nodes) to reach the Calculator.
 // - Process input latency: Process input latency + process runtime for a
 // packet.
+// - Latency breakdown: Percentiles of the end-to-end latency of each input
+// timestamp, attributed along its critical path to queueing delay, scheduler
+// wait and Process() runtime.
 //
 // The profiler can be configured in the graph definition:
 //   profiler_config {
@@ -264,18 +291,37 @@ class GraphProfiler : public std::enable_shared_from_this<ProfilingContext> {
   std::set<int> GetBackEdgeIds(const CalculatorGraphConfig::Node& node_config,
                                const tool::TagMap& input_tag_map);
 
+  // Recent samples of the latency breakdown of a calculator, from which the
+  // LatencyBreakdown percentiles are computed.
+  struct LatencySamples {
+    std::deque<int64> end_to_end;
+    std::deque<int64> queueing_delay;
+    std::deque<int64> scheduler_wait;
+    std::deque<int64> execution_time;
+    // Indexed like CalculatorProfile::input_stream_profiles.
+    std::vector<std::deque<int64>> input_stream_queueing_delays;
+  };
+
+  // Records when a calculator became ready to process an input timestamp.
+  void AddReadyTime(const TraceEvent& event)
+      ABSL_LOCKS_EXCLUDED(profiler_mutex_);
+
   void AddPacketInfoInternal(const PacketId& packet_id,
                              int64 production_time_usec,
-                             int64 source_process_start_usec);
+                             int64 source_process_start_usec,
+                             const PacketLatencyPath& latency_path);
   // Adds packet info for non-empty output packets.
   void AddPacketInfoForOutputPackets(
       const OutputStreamShardSet& output_stream_shard_set,
-      int64 production_time_usec, int64 source_process_start_usec);
+      int64 production_time_usec, int64 source_process_start_usec,
+      const PacketLatencyPath& latency_path);
 
   // Updates the production time for outputs and the stream profile for inputs.
+  // Also records the latency breakdown in |latency_samples|, if not null.
   int64 AddStreamLatencies(const CalculatorContext& calculator_context,
                            int64 start_time_usec, int64 end_time_usec,
-                           CalculatorProfile* calculator_profile);
+                           CalculatorProfile* calculator_profile,
+                           LatencySamples* latency_samples);
 
   void SetOpenRuntime(const CalculatorContext& calculator_context,
                       int64 start_time_usec, int64 end_time_usec)
@@ -287,9 +333,14 @@ class GraphProfiler : public std::enable_shared_from_this<ProfilingContext> {
   // Updates the input streams profiles for the calculator and returns the
   // minimum |source_process_start_usec| of all input packets, excluding empty
   // packets and back-edge packets. Returns -1 if there is no input packets.
+  // Sets |last_input| to the info of the input packet produced last, and
+  // records the queueing delay of each input packet until |ready_time_usec|
+  // in |latency_samples|, if not null.
   int64 AddInputStreamTimeSamples(const CalculatorContext& calculator_context,
-                                  int64 start_time_usec,
-                                  CalculatorProfile* calculator_profile);
+                                  int64 start_time_usec, int64 ready_time_usec,
+                                  CalculatorProfile* calculator_profile,
+                                  PacketInfo* last_input,
+                                  LatencySamples* latency_samples);
 
   // Updates the Process() data for calculator.
   // Requires ReaderLock for is_profiling_.
@@ -326,6 +377,13 @@ class GraphProfiler : public std::enable_shared_from_this<ProfilingContext> {
   using PacketInfoMap =
       ShardedMap<std::string, std::list<std::pair<int64, PacketInfo>>>;
   PacketInfoMap packets_info_;
+  // Stores when each calculator became ready to process recent input
+  // timestamps, based on profiler's clock.
+  using ReadyTimeMap = ShardedMap<int, std::list<std::pair<int64, int64>>>;
+  ReadyTimeMap ready_times_;
+  // Stores the recent latency samples with the calculator name as the key.
+  using LatencySamplesMap = ShardedMap<std::string, LatencySamples>;
+  LatencySamplesMap latency_samples_;
 
   // Global mutex for the profiler.
   mutable absl::Mutex profiler_mutex_;
@@ -345,6 +403,9 @@ class GraphProfiler : public std::enable_shared_from_this<ProfilingContext> {
   // The index number of the previous output log.
   int previous_log_index_;
 
+  // Converts the trace log to JSON, if trace_log_format is CHROME_TRACE_JSON.
+  std::unique_ptr<ChromeTraceWriter> chrome_trace_writer_;
+
   // The configuration for the graph being profiled.
   const ValidatedGraphConfig* validated_graph_;
 
@@ -18,6 +18,7 @@
 #include "absl/synchronization/mutex.h"
 #include "absl/time/time.h"
 #include "mediapipe/framework/calculator_framework.h"
+#include "mediapipe/framework/formats/shared_buffer_pool.h"
 #include "mediapipe/framework/mediapipe_profiling.h"
 #include "mediapipe/framework/port/core_proto_inc.h"
 #include "mediapipe/framework/port/gmock.h"
@@ -735,9 +736,11 @@ TEST_F(GraphProfilerTestPeer, SetOpenRuntimeWithStreamLatency) {
 
   // Check packets_info_ map has been updated.
   ASSERT_EQ(GetPacketsInfoMap()->size(), 1);
-  PacketInfo expected_packet_info = {0,
-                                     /*production_time_usec=*/1000 + 150,
-                                     /*source_process_start_usec=*/1000 + 0};
+  PacketInfo expected_packet_info = {
+      0,
+      /*production_time_usec=*/1000 + 150,
+      /*source_process_start_usec=*/1000 + 0,
+      /*latency_path=*/{0, 0, /*execution_time_usec=*/150}};
   ASSERT_EQ(*GetPacketInfo(GetPacketsInfoMap(), {"stream_1", 100}),
             expected_packet_info);
 }
@@ -863,9 +866,11 @@ TEST_F(GraphProfilerTestPeer, SetCloseRuntimeWithStreamLatency) {
                   }
                 }
               )pb"));
-  PacketInfo expected_packet_info = {0,
-                                     /*production_time_usec=*/1000 + 100,
-                                     /*source_process_start_usec=*/1000 + 0};
+  PacketInfo expected_packet_info = {
+      0,
+      /*production_time_usec=*/1000 + 100,
+      /*source_process_start_usec=*/1000 + 0,
+      /*latency_path=*/{0, 0, /*execution_time_usec=*/100}};
   PacketId packet_id = {"output_stream", Timestamp::PostStream().Value()};
   ASSERT_EQ(*GetPacketInfo(GetPacketsInfoMap(), packet_id),
             expected_packet_info);
@@ -1086,7 +1091,8 @@ TEST_F(GraphProfilerTestPeer, AddProcessSampleWithStreamLatency) {
   PacketInfo expected_packet_info = {
       0,
       /*production_time_usec=*/when_source_finished,
-      /*source_process_start_usec=*/when_source_started};
+      /*source_process_start_usec=*/when_source_started,
+      /*latency_path=*/{0, 0, /*execution_time_usec=*/150}};
   ASSERT_EQ(*GetPacketInfo(GetPacketsInfoMap(), {"stream_1", 100}),
             expected_packet_info);
 
@@ -1132,6 +1138,150 @@ TEST_F(GraphProfilerTestPeer, AddProcessSampleWithStreamLatency) {
   ASSERT_NE(GetPacketInfo(GetPacketsInfoMap(), {"stream_1", 100}), nullptr);
 }
 
+// Tests that the latency of a timestamp is attributed along the input packets
+// that arrived last.
+TEST_F(GraphProfilerTestPeer, AddProcessSampleWithLatencyBreakdown) {
+  InitializeProfilerWithGraphConfig(R"(
+    profiler_config {
+      enable_profiler: true
+      enable_stream_latency: true
+    }
+    input_stream: "stream_0"
+    node {
+      calculator: "DummyTestCalculator"
+      name: "source_calc"
+      output_stream: "stream_1"
+    }
+    node {
+      calculator: "DummyTestCalculator"
+      name: "consumer_calc"
+      input_stream: "stream_0"
+      input_stream: "stream_1"
+    })");
+  std::shared_ptr<mediapipe::SimulationClock> simulation_clock(
+      new SimulationClock());
+  simulation_clock->ThreadStart();
+  profiler_.SetClock(simulation_clock);
+
+  // A graph input packet is added to "stream_0" at 1000.
+  std::string stream_0 = "stream_0";
+  simulation_clock->SleepUntil(absl::FromUnixMicros(1000));
+  profiler_.LogEvent(TraceEvent(GraphTrace::PROCESS)
+                         .set_stream_id(&stream_0)
+                         .set_input_ts(Timestamp(100)));
+
+  // "source_calc" outputs a packet to "stream_1" from 1100 to 1300.
+  TestContextBuilder source_context("source_calc", /*node_id=*/0, {},
+                                    {"stream_1"});
+  source_context.AddInputs({});
+  source_context.AddOutputs(
+      {{MakePacket<std::string>("15").At(Timestamp(100))}});
+  simulation_clock->SleepUntil(absl::FromUnixMicros(1100));
+  {
+    GraphProfiler::Scope profiler_scope(GraphTrace::PROCESS,
+                                        source_context.get(), &profiler_);
+    simulation_clock->Sleep(absl::Microseconds(200));
+  }
+
+  // "consumer_calc" becomes ready at 1400 and runs from 1500 to 1550.
+  TestContextBuilder consumer_context("consumer_calc", /*node_id=*/1,
+                                      {"stream_0", "stream_1"}, {});
+  consumer_context.AddInputs(
+      {MakePacket<std::string>("5").At(Timestamp(100)),
+       MakePacket<std::string>("15").At(Timestamp(100))});
+  simulation_clock->SleepUntil(absl::FromUnixMicros(1400));
+  profiler_.LogEvent(TraceEvent(GraphTrace::READY_FOR_PROCESS)
+                         .set_node_id(1)
+                         .set_input_ts(Timestamp(100)));
+  simulation_clock->SleepUntil(absl::FromUnixMicros(1500));
+  {
+    GraphProfiler::Scope profiler_scope(GraphTrace::PROCESS,
+                                        consumer_context.get(), &profiler_);
+    simulation_clock->Sleep(absl::Microseconds(50));
+  }
+
+  std::vector<CalculatorProfile> profiles = Profiles();
+  simulation_clock->ThreadFinish();
+
+  EXPECT_THAT(GetProfileWithName(profiles, "source_calc"),
+              Partially(EqualsProto(R"pb(
+                latency_breakdown {
+                  end_to_end { sample_count: 1 p50_usec: 200 p99_usec: 200 }
+                  queueing_delay { sample_count: 1 p50_usec: 0 p99_usec: 0 }
+                  scheduler_wait { sample_count: 1 p50_usec: 0 p99_usec: 0 }
+                  execution_time { sample_count: 1 p50_usec: 200 p99_usec: 200 }
+                }
+              )pb")));
+
+  // The critical path runs through "stream_1", which arrived last at 1300.
+  // "stream_1" waited 100 until 1400, and "consumer_calc" waited 100 for the
+  // scheduler. The end-to-end latency is 1550 - 1100 = 450.
+  EXPECT_THAT(GetProfileWithName(profiles, "consumer_calc"),
+              Partially(EqualsProto(R"pb(
+                input_stream_profiles {
+                  name: "stream_0"
+                  queueing_delay { sample_count: 1 p50_usec: 400 p99_usec: 400 }
+                }
+                input_stream_profiles {
+                  name: "stream_1"
+                  queueing_delay { sample_count: 1 p50_usec: 100 p99_usec: 100 }
+                }
+                latency_breakdown {
+                  end_to_end { sample_count: 1 p50_usec: 450 p99_usec: 450 }
+                  queueing_delay { sample_count: 1 p50_usec: 100 p99_usec: 100 }
+                  scheduler_wait { sample_count: 1 p50_usec: 100 p99_usec: 100 }
+                  execution_time { sample_count: 1 p50_usec: 250 p99_usec: 250 }
+                }
+              )pb")));
+}
+
+// Tests that latency percentiles are computed from the samples since the last
+// Reset().
+TEST_F(GraphProfilerTestPeer, LatencyBreakdownPercentiles) {
+  InitializeProfilerWithGraphConfig(R"(
+    profiler_config {
+      enable_profiler: true
+      enable_stream_latency: true
+    }
+    node {
+      calculator: "DummyTestCalculator"
+      name: "source_calc"
+      output_stream: "stream_0"
+    })");
+  std::shared_ptr<mediapipe::SimulationClock> simulation_clock(
+      new SimulationClock());
+  simulation_clock->ThreadStart();
+  profiler_.SetClock(simulation_clock);
+
+  TestContextBuilder source_context("source_calc", /*node_id=*/0, {},
+                                    {"stream_0"});
+  source_context.AddInputs({});
+  auto run_process = [&](int64 runtime_usec) {
+    GraphProfiler::Scope profiler_scope(GraphTrace::PROCESS,
+                                        source_context.get(), &profiler_);
+    simulation_clock->Sleep(absl::Microseconds(runtime_usec));
+  };
+  run_process(5000);
+  profiler_.Reset();
+  // Runtimes of 1 to 200 usec.
+  for (int i = 200; i > 0; --i) {
+    run_process(i);
+  }
+
+  std::vector<CalculatorProfile> profiles = Profiles();
+  simulation_clock->ThreadFinish();
+  EXPECT_THAT(profiles[0], Partially(EqualsProto(R"pb(
+                latency_breakdown {
+                  end_to_end { sample_count: 200 p50_usec: 100 p99_usec: 198 }
+                  execution_time {
+                    sample_count: 200
+                    p50_usec: 100
+                    p99_usec: 198
+                  }
+                }
+              )pb")));
+}
+
 // This test shows that CalculatorGraph::GetCalculatorProfiles and
 // GraphProfiler::AddProcessSample() can be called in parallel.
 // Without the GraphProfiler::profiler_mutex_ this test should
@@ -1311,5 +1461,28 @@ TEST(GraphProfilerTest, CaptureProfilePopulateConfig) {
                   )pb"))));
 }
 
+TEST(GraphProfilerTest, CaptureProfileBufferPoolStats) {
+  CalculatorGraphConfig config;
+  QCHECK(proto2::TextFormat::ParseFromString(R"(
+    profiler_config { enable_profiler: true }
+    input_stream: "input_stream"
+    node { calculator: "DummyTestCalculator" input_stream: "input_stream" }
+    )",
+                                             &config));
+  CalculatorGraph graph;
+  MP_ASSERT_OK(graph.Initialize(config));
+  SharedBufferPool& pool = SharedBufferPool::Get();
+  void* buffer = pool.Allocate(4096);
+  pool.Release(buffer, 4096);
+  pool.Release(pool.Allocate(4096), 4096);
+  GraphProfile profile;
+  MP_ASSERT_OK(graph.profiler()->CaptureProfile(&profile));
+  ASSERT_TRUE(profile.has_buffer_pool_stats());
+  EXPECT_GE(profile.buffer_pool_stats().hit_count(), 1);
+  EXPECT_GE(profile.buffer_pool_stats().miss_count(), 1);
+  EXPECT_EQ(profile.buffer_pool_stats().byte_budget(),
+            pool.GetStats().byte_budget);
+}
+
 }  // namespace
 }  // namespace mediapipe
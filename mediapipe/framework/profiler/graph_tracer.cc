@@ -14,12 +14,15 @@
 
 #include "mediapipe/framework/profiler/graph_tracer.h"
 
+#include <algorithm>
+
 #include "absl/time/time.h"
 #include "mediapipe/framework/calculator_context.h"
 #include "mediapipe/framework/calculator_profile.pb.h"
 #include "mediapipe/framework/input_stream_shard.h"
 #include "mediapipe/framework/output_stream_shard.h"
 #include "mediapipe/framework/packet.h"
+#include "mediapipe/framework/port/integral_types.h"
 #include "mediapipe/framework/profiler/trace_builder.h"
 #include "mediapipe/framework/timestamp.h"
 
@@ -52,7 +55,10 @@ int64 GraphTracer::GetTraceLogCapacity() {
 }
 
 GraphTracer::GraphTracer(const ProfilerConfig& profiler_config)
-    : profiler_config_(profiler_config), trace_buffer_(GetTraceLogCapacity()) {
+    : profiler_config_(profiler_config),
+      trace_sample_interval_(
+          std::max(1, profiler_config.trace_sample_interval())),
+      trace_buffer_(GetTraceLogCapacity()) {
   for (int disabled : profiler_config_.trace_event_types_disabled()) {
     EventType event_type = static_cast<EventType>(disabled);
     (*trace_event_registry())[event_type].set_enabled(false);
@@ -64,13 +70,25 @@ TraceEventRegistry* GraphTracer::trace_event_registry() {
 }
 
 void GraphTracer::LogEvent(TraceEvent event) {
-  if (!(*trace_event_registry())[event.event_type].enabled()) {
+  if (!(*trace_event_registry())[event.event_type].enabled() ||
+      !IsTimestampSampled(event.input_ts)) {
     return;
   }
   event.set_thread_id(GetCurrentThreadId());
   trace_buffer_.push_back(event);
 }
 
+bool GraphTracer::IsTimestampSampled(Timestamp ts) const {
+  if (trace_sample_interval_ == 1 || !ts.IsRangeValue()) {
+    return true;
+  }
+  // Timestamps are selected by a hash of their value rather than by their
+  // order, so that every calculator selects the same timestamps and the
+  // selection doesn't depend on the spacing of timestamps.
+  const uint64 hash = static_cast<uint64>(ts.Value()) * 0x9E3779B97F4A7C15ull;
+  return (hash >> 32) % trace_sample_interval_ == 0;
+}
+
 void GraphTracer::LogInputEvents(GraphTrace::EventType event_type,
                                  const CalculatorContext* context,
                                  absl::Time event_time) {
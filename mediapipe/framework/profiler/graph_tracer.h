@@ -58,9 +58,13 @@ class GraphTracer {
   // Returns the registry of trace event types.
   TraceEventRegistry* trace_event_registry();
 
-  // Append a TraceEvent to the TraceBuffer.
+  // Append a TraceEvent to the TraceBuffer, unless its input timestamp is
+  // excluded by ProfilerConfig::trace_sample_interval.
   void LogEvent(TraceEvent event);
 
+  // Returns true if events for the input timestamp "ts" are logged.
+  bool IsTimestampSampled(Timestamp ts) const;
+
   // Append TraceEvents to the TraceBuffer for task input.
   void LogInputEvents(GraphTrace::EventType event_type,
                       const CalculatorContext* context, absl::Time event_time);
@@ -88,6 +92,9 @@ class GraphTracer {
   // The settings for this tracer.
   ProfilerConfig profiler_config_;
 
+  // One in this many input timestamps is traced.
+  int trace_sample_interval_;
+
   // The circular buffer of TraceEvents.
   TraceBuffer trace_buffer_;
 
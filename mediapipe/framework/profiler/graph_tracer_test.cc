@@ -22,6 +22,8 @@
 #include <vector>
 
 #include "absl/flags/flag.h"
+#include "absl/strings/match.h"
+#include "absl/strings/str_split.h"
 #include "absl/time/time.h"
 #include "mediapipe/framework/calculator.pb.h"
 #include "mediapipe/framework/calculator_framework.h"
@@ -329,6 +331,39 @@ TEST_F(GraphTracerTest, GraphTrace) {
 }
 
 // Tests showing GraphTracer logging packet latencies.
+TEST_F(GraphTracerTest, SampledTimestamps) {
+  ProfilerConfig profiler_config;
+  profiler_config.set_trace_enabled(true);
+  profiler_config.set_trace_sample_interval(4);
+  tracer_ = absl::make_unique<GraphTracer>(profiler_config);
+
+  // About one in four timestamps of a 30 fps stream are traced.
+  int num_sampled = 0;
+  for (int i = 0; i < 300; ++i) {
+    Timestamp ts = start_timestamp_ + i * 33333;
+    if (tracer_->IsTimestampSampled(ts)) {
+      ++num_sampled;
+    }
+    tracer_->LogEvent(TraceEvent(GraphTrace::PROCESS)
+                          .set_event_time(start_time_)
+                          .set_input_ts(ts)
+                          .set_node_id(0));
+  }
+  EXPECT_GT(num_sampled, 50);
+  EXPECT_LT(num_sampled, 100);
+  int num_logged = 0;
+  for (auto iter = tracer_->GetTraceBuffer().begin();
+       iter < tracer_->GetTraceBuffer().end(); ++iter) {
+    ++num_logged;
+  }
+  EXPECT_EQ(num_logged, num_sampled);
+
+  // Events without a packet timestamp are always traced.
+  EXPECT_TRUE(tracer_->IsTimestampSampled(Timestamp::Unset()));
+  EXPECT_TRUE(tracer_->IsTimestampSampled(Timestamp::PreStream()));
+  EXPECT_TRUE(tracer_->IsTimestampSampled(Timestamp::PostStream()));
+}
+
 class GraphTracerE2ETest : public ::testing::Test {
  protected:
   void SetUpPassThroughGraph() {
@@ -632,7 +667,17 @@ TEST_F(GraphTracerE2ETest, PassThroughGraphProfile) {
         name: "LambdaCalculator"
         open_runtime: 0
         close_runtime: 0
-        input_stream_profiles { name: "input_0" back_edge: false })pb");
+        input_stream_profiles {
+          name: "input_0"
+          back_edge: false
+          queueing_delay { sample_count: 6 p50_usec: 30000 p99_usec: 75000 }
+        }
+        latency_breakdown {
+          end_to_end { sample_count: 6 p50_usec: 50001 p99_usec: 95001 }
+          queueing_delay { sample_count: 6 p50_usec: 30000 p99_usec: 75000 }
+          scheduler_wait { sample_count: 6 p50_usec: 0 p99_usec: 0 }
+          execution_time { sample_count: 6 p50_usec: 20001 p99_usec: 20001 }
+        })pb");
 
   FillHistogram({20001, 20001, 20001, 20001, 20001, 20001},
                 expected.mutable_process_runtime());
@@ -681,25 +726,25 @@ TEST_F(GraphTracerE2ETest, DemuxGraphLog) {
                 calculator_trace { node_id: 3 input_timestamp: 10000 }
                 calculator_trace { node_id: 0 input_timestamp: 20000 }
                 calculator_trace { node_id: 1 input_timestamp: 20000 }
-                calculator_trace { node_id: 1 input_timestamp: 10000 }
+                calculator_trace { node_id: 1 input_timestamp: 20000 }
                 calculator_trace { node_id: 1 input_timestamp: 20000 }
                 calculator_trace { node_id: 1 input_timestamp: 20000 }
                 calculator_trace { node_id: 2 input_timestamp: 20000 }
-                calculator_trace { node_id: 2 input_timestamp: 10000 }
+                calculator_trace { node_id: 2 input_timestamp: 20000 }
                 calculator_trace { node_id: 1 input_timestamp: 10000 }
                 calculator_trace { node_id: 2 input_timestamp: 20000 }
                 calculator_trace { node_id: 2 input_timestamp: 20000 }
                 calculator_trace { node_id: 4 input_timestamp: 20000 }
-                calculator_trace { node_id: 4 input_timestamp: 10000 }
+                calculator_trace { node_id: 4 input_timestamp: 20000 }
                 calculator_trace { node_id: 2 input_timestamp: 10000 }
                 calculator_trace { node_id: 4 input_timestamp: 20000 }
                 calculator_trace { node_id: 0 input_timestamp: 30000 }
                 calculator_trace { node_id: 1 input_timestamp: 30000 }
-                calculator_trace { node_id: 1 input_timestamp: 10000 }
+                calculator_trace { node_id: 1 input_timestamp: 30000 }
                 calculator_trace { node_id: 1 input_timestamp: 30000 }
                 calculator_trace { node_id: 1 input_timestamp: 30000 }
                 calculator_trace { node_id: 2 input_timestamp: 30000 }
-                calculator_trace { node_id: 2 input_timestamp: 10000 }
+                calculator_trace { node_id: 2 input_timestamp: 30000 }
                 calculator_trace { node_id: 1 input_timestamp: 10000 }
                 calculator_trace { node_id: 2 input_timestamp: 30000 }
                 calculator_trace { node_id: 2 input_timestamp: 30000 }
@@ -707,11 +752,11 @@ TEST_F(GraphTracerE2ETest, DemuxGraphLog) {
                 calculator_trace { node_id: 2 input_timestamp: 10000 }
                 calculator_trace { node_id: 0 input_timestamp: 40000 }
                 calculator_trace { node_id: 1 input_timestamp: 40000 }
-                calculator_trace { node_id: 1 input_timestamp: 10000 }
+                calculator_trace { node_id: 1 input_timestamp: 40000 }
                 calculator_trace { node_id: 1 input_timestamp: 40000 }
                 calculator_trace { node_id: 1 input_timestamp: 40000 }
                 calculator_trace { node_id: 2 input_timestamp: 40000 }
-                calculator_trace { node_id: 2 input_timestamp: 10000 }
+                calculator_trace { node_id: 2 input_timestamp: 40000 }
                 calculator_trace { node_id: 1 input_timestamp: 10000 }
                 calculator_trace { node_id: 2 input_timestamp: 40000 }
                 calculator_trace { node_id: 2 input_timestamp: 40000 }
@@ -720,7 +765,7 @@ TEST_F(GraphTracerE2ETest, DemuxGraphLog) {
                 calculator_trace { node_id: 3 input_timestamp: 10000 }
                 calculator_trace { node_id: 5 input_timestamp: 10000 }
                 calculator_trace { node_id: 5 input_timestamp: 10000 }
-                calculator_trace { node_id: 3 input_timestamp: 10000 }
+                calculator_trace { node_id: 3 input_timestamp: 30000 }
                 calculator_trace { node_id: 5 input_timestamp: 10000 }
                 calculator_trace { node_id: 5 input_timestamp: 10000 }
                 calculator_trace { node_id: 5 input_timestamp: 10000 }
@@ -732,11 +777,11 @@ TEST_F(GraphTracerE2ETest, DemuxGraphLog) {
                 calculator_trace { node_id: 1 input_timestamp: 10000 }
                 calculator_trace { node_id: 0 input_timestamp: 50000 }
                 calculator_trace { node_id: 1 input_timestamp: 50000 }
-                calculator_trace { node_id: 1 input_timestamp: 10000 }
+                calculator_trace { node_id: 1 input_timestamp: 50000 }
                 calculator_trace { node_id: 1 input_timestamp: 50000 }
                 calculator_trace { node_id: 1 input_timestamp: 50000 }
                 calculator_trace { node_id: 2 input_timestamp: 50000 }
-                calculator_trace { node_id: 2 input_timestamp: 10000 }
+                calculator_trace { node_id: 2 input_timestamp: 50000 }
                 calculator_trace { node_id: 1 input_timestamp: 10000 }
                 calculator_trace { node_id: 2 input_timestamp: 50000 }
                 calculator_trace { node_id: 2 input_timestamp: 50000 }
@@ -744,65 +789,65 @@ TEST_F(GraphTracerE2ETest, DemuxGraphLog) {
                 calculator_trace { node_id: 2 input_timestamp: 10000 }
                 calculator_trace { node_id: 0 input_timestamp: 60000 }
                 calculator_trace { node_id: 1 input_timestamp: 60000 }
-                calculator_trace { node_id: 1 input_timestamp: 10000 }
+                calculator_trace { node_id: 1 input_timestamp: 60000 }
                 calculator_trace { node_id: 1 input_timestamp: 60000 }
                 calculator_trace { node_id: 2 input_timestamp: 10000 }
                 calculator_trace { node_id: 1 input_timestamp: 10000 }
-                calculator_trace { node_id: 1 input_timestamp: 10000 }
+                calculator_trace { node_id: 1 input_timestamp: 9223372036854775804 }
                 calculator_trace { node_id: 2 input_timestamp: 10000 }
                 calculator_trace { node_id: 1 input_timestamp: 10000 }
                 calculator_trace { node_id: 4 input_timestamp: 20000 }
                 calculator_trace { node_id: 5 input_timestamp: 20000 }
-                calculator_trace { node_id: 5 input_timestamp: 10000 }
-                calculator_trace { node_id: 4 input_timestamp: 10000 }
+                calculator_trace { node_id: 5 input_timestamp: 20000 }
+                calculator_trace { node_id: 4 input_timestamp: 40000 }
                 calculator_trace { node_id: 5 input_timestamp: 20000 }
                 calculator_trace { node_id: 5 input_timestamp: 20000 }
                 calculator_trace { node_id: 5 input_timestamp: 20000 }
                 calculator_trace { node_id: 1 input_timestamp: 20000 }
-                calculator_trace { node_id: 1 input_timestamp: 10000 }
+                calculator_trace { node_id: 1 input_timestamp: 20000 }
                 calculator_trace { node_id: 5 input_timestamp: 10000 }
                 calculator_trace { node_id: 4 input_timestamp: 40000 }
                 calculator_trace { node_id: 1 input_timestamp: 20000 }
                 calculator_trace { node_id: 1 input_timestamp: 10000 }
                 calculator_trace { node_id: 3 input_timestamp: 30000 }
                 calculator_trace { node_id: 5 input_timestamp: 30000 }
-                calculator_trace { node_id: 5 input_timestamp: 10000 }
-                calculator_trace { node_id: 3 input_timestamp: 10000 }
+                calculator_trace { node_id: 5 input_timestamp: 30000 }
+                calculator_trace { node_id: 3 input_timestamp: 50000 }
                 calculator_trace { node_id: 5 input_timestamp: 30000 }
                 calculator_trace { node_id: 5 input_timestamp: 30000 }
                 calculator_trace { node_id: 5 input_timestamp: 30000 }
                 calculator_trace { node_id: 1 input_timestamp: 30000 }
-                calculator_trace { node_id: 1 input_timestamp: 10000 }
+                calculator_trace { node_id: 1 input_timestamp: 30000 }
                 calculator_trace { node_id: 5 input_timestamp: 10000 }
                 calculator_trace { node_id: 3 input_timestamp: 50000 }
                 calculator_trace { node_id: 1 input_timestamp: 30000 }
                 calculator_trace { node_id: 1 input_timestamp: 10000 }
                 calculator_trace { node_id: 3 input_timestamp: 50000 }
                 calculator_trace { node_id: 5 input_timestamp: 50000 }
-                calculator_trace { node_id: 5 input_timestamp: 10000 }
+                calculator_trace { node_id: 5 input_timestamp: 50000 }
                 calculator_trace { node_id: 3 input_timestamp: 10000 }
                 calculator_trace { node_id: 5 input_timestamp: 50000 }
                 calculator_trace { node_id: 5 input_timestamp: 50000 }
                 calculator_trace { node_id: 5 input_timestamp: 50000 }
                 calculator_trace { node_id: 1 input_timestamp: 50000 }
-                calculator_trace { node_id: 1 input_timestamp: 10000 }
-                calculator_trace { node_id: 5 input_timestamp: 10000 }
+                calculator_trace { node_id: 1 input_timestamp: 50000 }
                 calculator_trace { node_id: 5 input_timestamp: 10000 }
+                calculator_trace { node_id: 5 input_timestamp: 20001 }
                 calculator_trace { node_id: 5 input_timestamp: 10000 }
                 calculator_trace { node_id: 1 input_timestamp: 50000 }
                 calculator_trace { node_id: 1 input_timestamp: 10000 }
                 calculator_trace { node_id: 4 input_timestamp: 40000 }
                 calculator_trace { node_id: 5 input_timestamp: 40000 }
-                calculator_trace { node_id: 5 input_timestamp: 10000 }
+                calculator_trace { node_id: 5 input_timestamp: 40000 }
                 calculator_trace { node_id: 4 input_timestamp: 10000 }
                 calculator_trace { node_id: 5 input_timestamp: 40000 }
                 calculator_trace { node_id: 5 input_timestamp: 40000 }
                 calculator_trace { node_id: 1 input_timestamp: 50001 }
-                calculator_trace { node_id: 1 input_timestamp: 10000 }
+                calculator_trace { node_id: 1 input_timestamp: 50001 }
                 calculator_trace { node_id: 5 input_timestamp: 10000 }
                 calculator_trace { node_id: 5 input_timestamp: 10000 }
                 calculator_trace { node_id: 1 input_timestamp: 50001 }
-                calculator_trace { node_id: 1 input_timestamp: 10000 }
+                calculator_trace { node_id: 1 input_timestamp: 9223372036854775804 }
                 calculator_trace { node_id: 1 input_timestamp: 10000 }
               )pb")));
 
@@ -844,11 +889,13 @@ TEST_F(GraphTracerE2ETest, DemuxGraphLog) {
             }
             calculator_trace {
               node_id: 5
+              input_timestamp: 0
               event_type: READY_FOR_PROCESS
               start_time: 25002
             }
             calculator_trace {
               node_id: 3
+              input_timestamp: 20000
               event_type: READY_FOR_PROCESS
               start_time: 25002
             }
@@ -882,6 +929,7 @@ TEST_F(GraphTracerE2ETest, DemuxGraphLog) {
             }
             calculator_trace {
               node_id: 1
+              input_timestamp: 0
               event_type: READY_FOR_PROCESS
               start_time: 25002
             }
@@ -925,6 +973,7 @@ TEST_F(GraphTracerE2ETest, DemuxGraphLog) {
             }
             calculator_trace {
               node_id: 1
+              input_timestamp: 40000
               event_type: READY_FOR_PROCESS
               start_time: 25005
             }
@@ -951,6 +1000,7 @@ TEST_F(GraphTracerE2ETest, DemuxGraphLog) {
             }
             calculator_trace {
               node_id: 2
+              input_timestamp: 40000
               event_type: READY_FOR_PROCESS
               start_time: 25005
             }
@@ -1010,6 +1060,34 @@ TEST_F(GraphTracerE2ETest, DemuxGraphLogFile) {
   EXPECT_EQ(113, profile.graph_trace(0).calculator_trace().size());
 }
 
+TEST_F(GraphTracerE2ETest, DemuxGraphChromeTraceFile) {
+  std::string log_path = absl::StrCat(getenv("TEST_TMPDIR"), "/chrome_trace_");
+  SetUpDemuxInFlightGraph();
+  graph_config_.mutable_profiler_config()->set_trace_log_path(log_path);
+  graph_config_.mutable_profiler_config()->set_trace_log_interval_usec(2500);
+  graph_config_.mutable_profiler_config()->set_trace_log_format(
+      ProfilerConfig::CHROME_TRACE_JSON);
+  RunDemuxInFlightGraph();
+  std::string json;
+  MP_ASSERT_OK(file::GetContents(absl::StrCat(log_path, 0, ".json"), &json));
+
+  // The file is a JSON array of events, without the optional closing bracket.
+  EXPECT_TRUE(absl::StartsWith(json, "[\n"));
+  EXPECT_TRUE(absl::EndsWith(json, "},\n"));
+  EXPECT_THAT(json,
+              testing::HasSubstr(R"({"name":"RoundRobinDemuxCalculator",)"
+                                 R"("cat":"PROCESS","ph":"X",)"));
+  // Each packet received by the demux and the mux is drawn as a flow arrow.
+  int num_flow_starts = 0;
+  int num_flow_ends = 0;
+  for (absl::string_view line : absl::StrSplit(json, '\n')) {
+    num_flow_starts += absl::StrContains(line, R"("cat":"packet","ph":"s")");
+    num_flow_ends += absl::StrContains(line, R"("cat":"packet","ph":"f")");
+  }
+  EXPECT_GE(num_flow_starts, 8);
+  EXPECT_EQ(num_flow_starts, num_flow_ends);
+}
+
 TEST_F(GraphTracerE2ETest, DemuxGraphLogFiles) {
   std::string log_path = absl::StrCat(getenv("TEST_TMPDIR"), "/log_files_");
   SetUpDemuxInFlightGraph();
@@ -1086,6 +1164,7 @@ TEST_F(GraphTracerE2ETest, DemuxGraphLogFiles) {
                   }
                   calculator_trace {
                     node_id: 5
+                    input_timestamp: 40000
                     event_type: READY_FOR_PROCESS
                     start_time: 70004
                   }
@@ -1122,6 +1201,7 @@ TEST_F(GraphTracerE2ETest, DemuxGraphLogFiles) {
                   }
                   calculator_trace {
                     node_id: 1
+                    input_timestamp: 50001
                     event_type: READY_FOR_PROCESS
                     start_time: 70004
                   }
@@ -1149,6 +1229,7 @@ TEST_F(GraphTracerE2ETest, DemuxGraphLogFiles) {
                   }
                   calculator_trace {
                     node_id: 1
+                    input_timestamp: 9223372036854775804
                     event_type: READY_FOR_PROCESS
                     start_time: 70004
                   }
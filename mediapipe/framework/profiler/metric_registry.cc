@@ -0,0 +1,252 @@
+// Copyright 2022 The MediaPipe Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "mediapipe/framework/profiler/metric_registry.h"
+
+#include <limits>
+
+#include "absl/numeric/bits.h"
+#include "absl/strings/str_cat.h"
+
+namespace mediapipe {
+
+const GraphService<MetricRegistry> kMetricRegistryService(
+    "kMetricRegistryService");
+
+namespace internal {
+
+int MetricShardIndex() {
+  static std::atomic<int> next_index{0};
+  thread_local const int index =
+      next_index.fetch_add(1, std::memory_order_relaxed) % kNumMetricShards;
+  return index;
+}
+
+}  // namespace internal
+
+namespace {
+
+// Returns true if "c" may appear in a metric or label name, other than as
+// the first character.
+bool IsNameChar(char c, bool allow_colon) {
+  return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') ||
+         (c >= '0' && c <= '9') || c == '_' || (allow_colon && c == ':');
+}
+
+// Appends "name" with the characters not allowed in it replaced by '_'.
+void AppendSanitizedName(absl::string_view name, bool allow_colon,
+                         std::string* output) {
+  if (name.empty() || (name[0] >= '0' && name[0] <= '9')) {
+    output->push_back('_');
+  }
+  for (char c : name) {
+    output->push_back(IsNameChar(c, allow_colon) ? c : '_');
+  }
+}
+
+// Splits a metric key into its name and its labels, including the braces.
+std::pair<absl::string_view, absl::string_view> SplitKey(
+    absl::string_view key) {
+  const size_t brace = key.find('{');
+  if (brace == absl::string_view::npos) {
+    return {key, absl::string_view()};
+  }
+  return {key.substr(0, brace), key.substr(brace)};
+}
+
+// Returns "labels" with one more label appended.
+std::string AppendLabel(absl::string_view labels, absl::string_view name,
+                        absl::string_view value) {
+  if (labels.empty()) {
+    return absl::StrCat("{", name, "=\"", value, "\"}");
+  }
+  labels.remove_suffix(1);
+  return absl::StrCat(labels, ",", name, "=\"", value, "\"}");
+}
+
+// The metrics of one type grouped by name, then sorted by labels.
+template <typename T>
+using MetricFamilies =
+    std::map<std::string, std::map<std::string, std::shared_ptr<T>>>;
+
+template <typename T>
+MetricFamilies<T> GroupByName(
+    ShardedMap<std::string, std::shared_ptr<T>>* metrics) {
+  MetricFamilies<T> result;
+  for (auto it = metrics->begin(); it != metrics->end(); ++it) {
+    auto name_and_labels = SplitKey(it->first);
+    result[std::string(name_and_labels.first)]
+          [std::string(name_and_labels.second)] = it->second;
+  }
+  return result;
+}
+
+}  // namespace
+
+int64 ShardedCounter::Get() {
+  int64 result = 0;
+  for (const Cell& cell : cells_) {
+    result += cell.value.load(std::memory_order_relaxed);
+  }
+  return result;
+}
+
+void ShardedHistogram::Record(int64 value) {
+  Cell& cell = cells_[internal::MetricShardIndex()];
+  cell.bucket_counts[BucketIndex(value)].fetch_add(1,
+                                                   std::memory_order_relaxed);
+  cell.sum.fetch_add(value, std::memory_order_relaxed);
+}
+
+ShardedHistogram::Snapshot ShardedHistogram::GetSnapshot() const {
+  Snapshot result;
+  for (const Cell& cell : cells_) {
+    for (int i = 0; i < kNumBuckets; ++i) {
+      const int64 count =
+          cell.bucket_counts[i].load(std::memory_order_relaxed);
+      result.bucket_counts[i] += count;
+      result.count += count;
+    }
+    result.sum += cell.sum.load(std::memory_order_relaxed);
+  }
+  return result;
+}
+
+int64 ShardedHistogram::BucketUpperBound(int index) {
+  if (index >= kNumBuckets - 1) {
+    return std::numeric_limits<int64>::max();
+  }
+  return index <= 0 ? 0 : int64{1} << (index - 1);
+}
+
+int ShardedHistogram::BucketIndex(int64 value) {
+  if (value <= 0) {
+    return 0;
+  }
+  const int index = absl::bit_width(static_cast<uint64>(value - 1)) + 1;
+  return index < kNumBuckets ? index : kNumBuckets - 1;
+}
+
+std::string MetricRegistry::MetricKey(absl::string_view name,
+                                      const Labels& labels) {
+  std::string result;
+  AppendSanitizedName(name, /*allow_colon=*/true, &result);
+  if (labels.empty()) {
+    return result;
+  }
+  result.push_back('{');
+  for (int i = 0; i < labels.size(); ++i) {
+    if (i > 0) {
+      result.push_back(',');
+    }
+    AppendSanitizedName(labels[i].first, /*allow_colon=*/false, &result);
+    result.append("=\"");
+    for (char c : labels[i].second) {
+      if (c == '\\' || c == '"') {
+        result.push_back('\\');
+        result.push_back(c);
+      } else if (c == '\n') {
+        result.append("\\n");
+      } else {
+        result.push_back(c);
+      }
+    }
+    result.push_back('"');
+  }
+  result.push_back('}');
+  return result;
+}
+
+template <typename T>
+T* MetricRegistry::GetOrCreate(const std::string& key, MetricMap<T>* metrics) {
+  auto result = metrics->insert({key, nullptr});
+  if (result.second) {
+    result.first->second = std::make_shared<T>();
+  }
+  return result.first->second.get();
+}
+
+ShardedCounter* MetricRegistry::GetCounter(const std::string& key) {
+  return GetOrCreate(key, &counters_);
+}
+
+Gauge* MetricRegistry::GetGauge(const std::string& key) {
+  return GetOrCreate(key, &gauges_);
+}
+
+ShardedHistogram* MetricRegistry::GetHistogram(const std::string& key) {
+  return GetOrCreate(key, &histograms_);
+}
+
+void MetricRegistry::SetCollector(const std::string& name,
+                                  Collector collector) {
+  absl::MutexLock lock(&collectors_mutex_);
+  collectors_[name] = std::move(collector);
+}
+
+void MetricRegistry::RemoveCollector(const std::string& name) {
+  absl::MutexLock lock(&collectors_mutex_);
+  collectors_.erase(name);
+}
+
+std::string MetricRegistry::ExportText() {
+  {
+    absl::MutexLock lock(&collectors_mutex_);
+    for (auto& collector : collectors_) {
+      collector.second(this);
+    }
+  }
+
+  std::string output;
+  for (auto& family : GroupByName(&counters_)) {
+    absl::StrAppend(&output, "# TYPE ", family.first, " counter\n");
+    for (auto& metric : family.second) {
+      absl::StrAppend(&output, family.first, metric.first, " ",
+                      metric.second->Get(), "\n");
+    }
+  }
+  for (auto& family : GroupByName(&gauges_)) {
+    absl::StrAppend(&output, "# TYPE ", family.first, " gauge\n");
+    for (auto& metric : family.second) {
+      absl::StrAppend(&output, family.first, metric.first, " ",
+                      metric.second->Get(), "\n");
+    }
+  }
+  for (auto& family : GroupByName(&histograms_)) {
+    const std::string& name = family.first;
+    absl::StrAppend(&output, "# TYPE ", name, " histogram\n");
+    for (auto& metric : family.second) {
+      const std::string& labels = metric.first;
+      const ShardedHistogram::Snapshot snapshot = metric.second->GetSnapshot();
+      // Prometheus buckets are cumulative.
+      int64 cumulative_count = 0;
+      for (int i = 0; i < ShardedHistogram::kNumBuckets; ++i) {
+        cumulative_count += snapshot.bucket_counts[i];
+        const std::string upper_bound =
+            i < ShardedHistogram::kNumBuckets - 1
+                ? absl::StrCat(ShardedHistogram::BucketUpperBound(i))
+                : "+Inf";
+        absl::StrAppend(&output, name, "_bucket",
+                        AppendLabel(labels, "le", upper_bound), " ",
+                        cumulative_count, "\n");
+      }
+      absl::StrAppend(&output, name, "_sum", labels, " ", snapshot.sum, "\n");
+      absl::StrAppend(&output, name, "_count", labels, " ", snapshot.count,
+                      "\n");
+    }
+  }
+  return output;
+}
+
+}  // namespace mediapipe
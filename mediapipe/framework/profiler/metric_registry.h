@@ -0,0 +1,206 @@
+// Copyright 2022 The MediaPipe Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef MEDIAPIPE_FRAMEWORK_PROFILER_METRIC_REGISTRY_H_
+#define MEDIAPIPE_FRAMEWORK_PROFILER_METRIC_REGISTRY_H_
+
+#include <array>
+#include <atomic>
+#include <functional>
+#include <map>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "absl/base/thread_annotations.h"
+#include "absl/strings/string_view.h"
+#include "absl/synchronization/mutex.h"
+#include "mediapipe/framework/counter.h"
+#include "mediapipe/framework/graph_service.h"
+#include "mediapipe/framework/port/integral_types.h"
+#include "mediapipe/framework/profiler/sharded_map.h"
+
+namespace mediapipe {
+
+namespace internal {
+
+// The number of cells each sharded metric is split into. A thread always
+// updates the same cell, so threads contend only if they share a cell.
+constexpr int kNumMetricShards = 16;
+
+// The size of a cell, which keeps two cells out of the same cache line.
+constexpr int kMetricCellAlignment = 64;
+
+// Returns the cell of the calling thread, in [0, kNumMetricShards).
+int MetricShardIndex();
+
+}  // namespace internal
+
+// A counter that can be incremented from many threads without contention.
+// Each thread adds to its own cache-line padded cell, and Get() adds up the
+// cells. Increments are relaxed atomic adds, so Get() may miss increments
+// made concurrently with it.
+class ShardedCounter : public Counter {
+ public:
+  ShardedCounter() = default;
+  ShardedCounter(const ShardedCounter&) = delete;
+  ShardedCounter& operator=(const ShardedCounter&) = delete;
+
+  void Increment() override { IncrementBy(1); }
+  void IncrementBy(int amount) override {
+    cells_[internal::MetricShardIndex()].value.fetch_add(
+        amount, std::memory_order_relaxed);
+  }
+  int64 Get() override;
+
+ private:
+  struct alignas(internal::kMetricCellAlignment) Cell {
+    std::atomic<int64> value{0};
+  };
+  std::array<Cell, internal::kNumMetricShards> cells_;
+};
+
+// A value that is set rather than incremented, such as the bytes in use by a
+// buffer pool. Gauges are usually set by the collectors of a MetricRegistry
+// just before the metrics are exported.
+class Gauge {
+ public:
+  void Set(int64 value) { value_.store(value, std::memory_order_relaxed); }
+  int64 Get() const { return value_.load(std::memory_order_relaxed); }
+
+ private:
+  std::atomic<int64> value_{0};
+};
+
+// A histogram of non-negative values, such as queue sizes or durations in
+// microseconds, with fixed exponential buckets. Like ShardedCounter, each
+// thread records into its own cells, which are merged by GetSnapshot().
+class ShardedHistogram {
+ public:
+  // Bucket 0 counts the values <= 0, bucket i counts the values in
+  // (2^(i-2), 2^(i-1)], and the last bucket counts the larger values.
+  static constexpr int kNumBuckets = 24;
+
+  // The merged counts of a histogram.
+  struct Snapshot {
+    // The number of values in each bucket, not cumulative.
+    std::array<int64, kNumBuckets> bucket_counts = {};
+    int64 count = 0;
+    int64 sum = 0;
+  };
+
+  ShardedHistogram() = default;
+  ShardedHistogram(const ShardedHistogram&) = delete;
+  ShardedHistogram& operator=(const ShardedHistogram&) = delete;
+
+  void Record(int64 value);
+
+  Snapshot GetSnapshot() const;
+
+  // Returns the largest value counted in bucket "index". The last bucket has
+  // no upper bound and returns the largest int64.
+  static int64 BucketUpperBound(int index);
+
+  // Returns the bucket that counts "value".
+  static int BucketIndex(int64 value);
+
+ private:
+  struct alignas(internal::kMetricCellAlignment) Cell {
+    std::array<std::atomic<int64>, kNumBuckets> bucket_counts = {};
+    std::atomic<int64> sum{0};
+  };
+  std::array<Cell, internal::kNumMetricShards> cells_;
+};
+
+// Holds named counters, gauges and histograms, and exports their values in
+// the Prometheus text exposition format, which a local scraper can poll while
+// the graphs run, without enabling the GraphProfiler or the GraphTracer.
+//
+// A metric is identified by its name and labels, as returned by MetricKey().
+// Metrics are created on first use and live as long as the registry, so the
+// pointers returned by GetCounter(), GetGauge() and GetHistogram() can be kept
+// and updated on hot paths without any lookup. Looking a metric up takes a
+// shard lock, and should be done when a calculator or stream is set up.
+//
+// The registry is provided to graphs as a service:
+//
+//   auto registry = std::make_shared<MetricRegistry>();
+//   MP_RETURN_IF_ERROR(
+//       graph.SetServiceObject(kMetricRegistryService, registry));
+//   ...
+//   std::string metrics = registry->ExportText();
+//
+// The graph then reports its input stream queue sizes, throttling events and
+// buffer pool statistics, and calculators such as FlowLimiterCalculator report
+// their own metrics. Several graphs may share a registry, in which case the
+// metrics with the same key are added up.
+//
+// This class is thread-safe.
+class MetricRegistry {
+ public:
+  // The labels of a metric, as (name, value) pairs.
+  using Labels = std::vector<std::pair<std::string, std::string>>;
+  // Updates metrics just before they are exported.
+  using Collector = std::function<void(MetricRegistry*)>;
+
+  MetricRegistry() = default;
+  MetricRegistry(const MetricRegistry&) = delete;
+  MetricRegistry& operator=(const MetricRegistry&) = delete;
+
+  // Returns the key of the metric "name" with "labels", such as
+  // mediapipe_input_queue_size{node="detector",stream="image"}. Characters
+  // not allowed in Prometheus names are replaced by '_', and label values are
+  // escaped.
+  static std::string MetricKey(absl::string_view name,
+                               const Labels& labels = {});
+
+  // Returns the metric for "key", creating it if needed. A key identifies
+  // metrics of one type only.
+  ShardedCounter* GetCounter(const std::string& key);
+  Gauge* GetGauge(const std::string& key);
+  ShardedHistogram* GetHistogram(const std::string& key);
+
+  // Registers "collector" under "name", replacing any collector registered
+  // under the same name. Collectors are run by ExportText(), and must stay
+  // valid until they are removed or the registry is destroyed.
+  void SetCollector(const std::string& name, Collector collector);
+  void RemoveCollector(const std::string& name);
+
+  // Runs the collectors and returns all the metrics in the Prometheus text
+  // exposition format, sorted by key.
+  std::string ExportText();
+
+ private:
+  template <typename T>
+  using MetricMap = ShardedMap<std::string, std::shared_ptr<T>>;
+
+  // Returns the metric for "key" in "metrics", creating it if needed.
+  template <typename T>
+  static T* GetOrCreate(const std::string& key, MetricMap<T>* metrics);
+
+  MetricMap<ShardedCounter> counters_;
+  MetricMap<Gauge> gauges_;
+  MetricMap<ShardedHistogram> histograms_;
+
+  absl::Mutex collectors_mutex_;
+  std::map<std::string, Collector> collectors_
+      ABSL_GUARDED_BY(collectors_mutex_);
+};
+
+extern const GraphService<MetricRegistry> kMetricRegistryService;
+
+}  // namespace mediapipe
+
+#endif  // MEDIAPIPE_FRAMEWORK_PROFILER_METRIC_REGISTRY_H_
@@ -0,0 +1,164 @@
+// Copyright 2022 The MediaPipe Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "mediapipe/framework/profiler/metric_registry.h"
+
+#include <memory>
+#include <string>
+#include <thread>  // NOLINT(build/c++11)
+#include <vector>
+
+#include "absl/synchronization/mutex.h"
+#include "mediapipe/framework/port/benchmark.h"
+#include "mediapipe/framework/port/gmock.h"
+#include "mediapipe/framework/port/gtest.h"
+
+namespace mediapipe {
+namespace {
+
+using ::testing::HasSubstr;
+
+TEST(MetricRegistryTest, CountsIncrementsFromManyThreads) {
+  ShardedCounter counter;
+  std::vector<std::thread> threads;
+  for (int i = 0; i < 8; ++i) {
+    threads.emplace_back([&counter] {
+      for (int j = 0; j < 1000; ++j) {
+        counter.Increment();
+      }
+      counter.IncrementBy(5);
+    });
+  }
+  for (std::thread& thread : threads) {
+    thread.join();
+  }
+  EXPECT_EQ(counter.Get(), 8 * 1005);
+}
+
+TEST(MetricRegistryTest, BucketsValuesByPowersOfTwo) {
+  EXPECT_EQ(ShardedHistogram::BucketIndex(-3), 0);
+  EXPECT_EQ(ShardedHistogram::BucketIndex(0), 0);
+  EXPECT_EQ(ShardedHistogram::BucketIndex(1), 1);
+  EXPECT_EQ(ShardedHistogram::BucketIndex(2), 2);
+  EXPECT_EQ(ShardedHistogram::BucketIndex(3), 3);
+  EXPECT_EQ(ShardedHistogram::BucketIndex(4), 3);
+  EXPECT_EQ(ShardedHistogram::BucketIndex(5), 4);
+  EXPECT_EQ(ShardedHistogram::BucketIndex(int64{1} << 40),
+            ShardedHistogram::kNumBuckets - 1);
+  for (int i = 0; i < ShardedHistogram::kNumBuckets - 1; ++i) {
+    EXPECT_EQ(
+        ShardedHistogram::BucketIndex(ShardedHistogram::BucketUpperBound(i)),
+        i);
+  }
+
+  ShardedHistogram histogram;
+  histogram.Record(0);
+  histogram.Record(3);
+  histogram.Record(4);
+  histogram.Record(100);
+  const ShardedHistogram::Snapshot snapshot = histogram.GetSnapshot();
+  EXPECT_EQ(snapshot.count, 4);
+  EXPECT_EQ(snapshot.sum, 107);
+  EXPECT_EQ(snapshot.bucket_counts[0], 1);
+  EXPECT_EQ(snapshot.bucket_counts[3], 2);
+  EXPECT_EQ(snapshot.bucket_counts[8], 1);
+}
+
+TEST(MetricRegistryTest, FormatsKeys) {
+  EXPECT_EQ(MetricRegistry::MetricKey("mediapipe_packets"),
+            "mediapipe_packets");
+  EXPECT_EQ(MetricRegistry::MetricKey("drops.total", {{"node", "a\"b"}}),
+            "drops_total{node=\"a\\\"b\"}");
+  EXPECT_EQ(MetricRegistry::MetricKey("size", {{"node", "n"}, {"1st", "s"}}),
+            "size{node=\"n\",_1st=\"s\"}");
+}
+
+TEST(MetricRegistryTest, ReturnsTheSameMetricForAKey) {
+  MetricRegistry registry;
+  ShardedCounter* counter = registry.GetCounter("drops");
+  counter->Increment();
+  EXPECT_EQ(registry.GetCounter("drops"), counter);
+  EXPECT_NE(registry.GetCounter("drops{node=\"a\"}"), counter);
+  EXPECT_EQ(registry.GetCounter("drops")->Get(), 1);
+}
+
+TEST(MetricRegistryTest, ExportsText) {
+  MetricRegistry registry;
+  registry.GetCounter("drops_total{node=\"b\"}")->IncrementBy(2);
+  registry.GetCounter("drops_total{node=\"a\"}")->Increment();
+  registry.GetCounter("drops_total_extra")->Increment();
+  registry.SetCollector("pool", [](MetricRegistry* registry) {
+    registry->GetGauge("pool_bytes")->Set(1024);
+  });
+  registry.GetHistogram("queue_size{stream=\"in\"}")->Record(3);
+
+  const std::string text = registry.ExportText();
+  EXPECT_THAT(text, HasSubstr("# TYPE drops_total counter\n"
+                              "drops_total{node=\"a\"} 1\n"
+                              "drops_total{node=\"b\"} 2\n"
+                              "# TYPE drops_total_extra counter\n"
+                              "drops_total_extra 1\n"
+                              "# TYPE pool_bytes gauge\n"
+                              "pool_bytes 1024\n"
+                              "# TYPE queue_size histogram\n"
+                              "queue_size_bucket{stream=\"in\",le=\"0\"} 0\n"
+                              "queue_size_bucket{stream=\"in\",le=\"1\"} 0\n"
+                              "queue_size_bucket{stream=\"in\",le=\"2\"} 0\n"
+                              "queue_size_bucket{stream=\"in\",le=\"4\"} 1\n"));
+  EXPECT_THAT(text, HasSubstr("queue_size_bucket{stream=\"in\",le=\"+Inf\"} 1\n"
+                              "queue_size_sum{stream=\"in\"} 3\n"
+                              "queue_size_count{stream=\"in\"} 1\n"));
+
+  registry.RemoveCollector("pool");
+  registry.GetGauge("pool_bytes")->Set(0);
+  EXPECT_THAT(registry.ExportText(), HasSubstr("pool_bytes 0\n"));
+}
+
+// A counter guarded by a mutex, as BasicCounterFactory used to create.
+class MutexCounter : public Counter {
+ public:
+  void Increment() override { IncrementBy(1); }
+  void IncrementBy(int amount) override {
+    absl::MutexLock lock(&mutex_);
+    value_ += amount;
+  }
+  int64 Get() override {
+    absl::MutexLock lock(&mutex_);
+    return value_;
+  }
+
+ private:
+  absl::Mutex mutex_;
+  int64 value_ = 0;
+};
+
+// Increments one counter from "state.threads()" threads.
+template <typename CounterType>
+void BM_IncrementCounter(benchmark::State& state) {
+  static CounterType* counter = nullptr;
+  if (state.thread_index() == 0) {
+    counter = new CounterType();
+  }
+  for (auto _ : state) {
+    counter->Increment();
+  }
+  if (state.thread_index() == 0) {
+    delete counter;
+  }
+}
+BENCHMARK_TEMPLATE(BM_IncrementCounter, MutexCounter)->ThreadRange(1, 8);
+BENCHMARK_TEMPLATE(BM_IncrementCounter, ShardedCounter)->ThreadRange(1, 8);
+
+}  // namespace
+}  // namespace mediapipe
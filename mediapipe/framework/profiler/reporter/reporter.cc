@@ -91,6 +91,38 @@ absl::btree_map<std::string,
         {"input_latency_total",
          [](const CalculatorData& d) -> const std::string {
            return ToString(d.input_latency_stat.total());
+         }},
+        {"e2e_p50",
+         [](const CalculatorData& d) -> const std::string {
+           return ToStringF(d.end_to_end_stat.p50());
+         }},
+        {"e2e_p99",
+         [](const CalculatorData& d) -> const std::string {
+           return ToStringF(d.end_to_end_stat.p99());
+         }},
+        {"queue_p50",
+         [](const CalculatorData& d) -> const std::string {
+           return ToStringF(d.queueing_delay_stat.p50());
+         }},
+        {"queue_p99",
+         [](const CalculatorData& d) -> const std::string {
+           return ToStringF(d.queueing_delay_stat.p99());
+         }},
+        {"sched_wait_p50",
+         [](const CalculatorData& d) -> const std::string {
+           return ToStringF(d.scheduler_wait_stat.p50());
+         }},
+        {"sched_wait_p99",
+         [](const CalculatorData& d) -> const std::string {
+           return ToStringF(d.scheduler_wait_stat.p99());
+         }},
+        {"exec_p50",
+         [](const CalculatorData& d) -> const std::string {
+           return ToStringF(d.execution_time_stat.p50());
+         }},
+        {"exec_p99",
+         [](const CalculatorData& d) -> const std::string {
+           return ToStringF(d.execution_time_stat.p99());
          }}};
 
 // Holds calculator traces that have an output trace with a provided stream ID
@@ -108,6 +140,20 @@ typedef std::map<std::pair<int64_t, std::pair<int32_t, int32_t>>,
 // Maps node IDs to names.
 typedef std::map<int32_t, std::string> NameLookup;
 
+void PercentileStatistic::Push(const TimePercentiles& percentiles) {
+  sample_count_ += percentiles.sample_count();
+  p50_total_ += percentiles.sample_count() * percentiles.p50_usec();
+  p99_total_ += percentiles.sample_count() * percentiles.p99_usec();
+}
+
+double PercentileStatistic::p50() const {
+  return sample_count_ > 0 ? p50_total_ / sample_count_ : 0.0;
+}
+
+double PercentileStatistic::p99() const {
+  return sample_count_ > 0 ? p99_total_ / sample_count_ : 0.0;
+}
+
 Reporter::Reporter() { MEDIAPIPE_CHECK_OK(set_columns({"*"})); }
 
 int64_t RecursePacketStartTime(
@@ -295,6 +341,20 @@ void Reporter::Accumulate(const mediapipe::GraphProfile& profile) {
       }
     }
   }
+
+  // Add the latency breakdowns recorded by the GraphProfiler.
+  for (const auto& calculator_profile : profile.calculator_profiles()) {
+    if (!calculator_profile.has_latency_breakdown()) {
+      continue;
+    }
+    auto& calc_data = calculator_data_[calculator_profile.name()];
+    calc_data.name = calculator_profile.name();
+    const auto& breakdown = calculator_profile.latency_breakdown();
+    calc_data.end_to_end_stat.Push(breakdown.end_to_end());
+    calc_data.queueing_delay_stat.Push(breakdown.queueing_delay());
+    calc_data.scheduler_wait_stat.Push(breakdown.scheduler_wait());
+    calc_data.execution_time_stat.Push(breakdown.execution_time());
+  }
 }
 
 absl::Status Reporter::set_columns(const std::vector<std::string>& columns) {
@@ -22,6 +22,26 @@ struct GraphData {
   int64_t total_time = 0;
 };
 
+// Combines the TimePercentiles reported in several CalculatorProfiles, which
+// cover consecutive periods. Each percentile is approximated by the mean of the
+// reported percentiles, weighted by their sample counts.
+class PercentileStatistic {
+ public:
+  // Adds the percentiles reported for one period.
+  void Push(const TimePercentiles& percentiles);
+
+  // Returns the approximate median.
+  double p50() const;
+
+  // Returns the approximate 99th percentile.
+  double p99() const;
+
+ private:
+  int64_t sample_count_ = 0;
+  double p50_total_ = 0;
+  double p99_total_ = 0;
+};
+
 // Holds all of the measured data for a calculator.
 struct CalculatorData {
   // Name of the calculator.
@@ -63,6 +83,13 @@ struct CalculatorData {
 
   // The threads on which this calculator ran.
   std::set<int> threads;
+
+  // Records the critical-path latency breakdown (microseconds) reported in
+  // the calculator profiles. See LatencyBreakdown in calculator_profile.proto.
+  PercentileStatistic end_to_end_stat;
+  PercentileStatistic queueing_delay_stat;
+  PercentileStatistic scheduler_wait_stat;
+  PercentileStatistic execution_time_stat;
 };
 
 // A snapshot of statistics generated by Reporter.
@@ -228,4 +228,24 @@ TEST(Reporter, LatencyCalculatedCorrectly) {
       testing::DoubleEq(1500));
 }
 
+// Tests that the latency breakdowns of several profiles are combined.
+TEST(Reporter, LatencyBreakdownCombined) {
+  auto reporter = loadReporter({
+      "profile_breakdown_0.binarypb",
+      "profile_breakdown_1.binarypb",
+  });
+  MEDIAPIPE_CHECK_OK(reporter->set_columns({"e2e_*", "queue_*", "sched_*"}));
+  auto report = reporter->Report();
+  EXPECT_THAT(report->headers(),
+              ElementsAre("calculator", "e2e_p50", "e2e_p99", "queue_p50",
+                          "queue_p99", "sched_wait_p50", "sched_wait_p99"));
+  EXPECT_THAT(report->lines(),
+              ElementsAre(ElementsAre("ACalculator", "700.00", "1750.00",
+                                      "400.00", "1200.00", "50.00",
+                                      "125.00")));
+  EXPECT_THAT(
+      report->calculator_data().at("ACalculator").execution_time_stat.p99(),
+      testing::DoubleEq(425));
+}
+
 }  // namespace mediapipe
@@ -72,6 +72,19 @@ void Scheduler::Reset() {
   }
   shared_.stopping = false;
   shared_.has_error = false;
+  shared_.earliest_deadline_first = false;
+  shared_.latency_budget = 0;
+  shared_.critical_nodes.clear();
+}
+
+void Scheduler::SetEarliestDeadlineFirst(int64 latency_budget,
+                                         std::vector<bool> critical_nodes) {
+  CHECK_EQ(state_, STATE_NOT_STARTED)
+      << "SetEarliestDeadlineFirst must not be called after the scheduler "
+         "has started";
+  shared_.earliest_deadline_first = true;
+  shared_.latency_budget = latency_budget;
+  shared_.critical_nodes = std::move(critical_nodes);
 }
 
 void Scheduler::CloseAllSourceNodes() { shared_.stopping = true; }
@@ -151,6 +151,12 @@ class Scheduler {
 
   void SetHasError(bool error) { shared_.has_error = error; }
 
+  // Enables EARLIEST_DEADLINE_FIRST scheduling for the next run.
+  // critical_nodes is indexed by node id and marks the nodes on the critical
+  // path. Must be called after Reset() and before Start().
+  void SetEarliestDeadlineFirst(int64 latency_budget,
+                                std::vector<bool> critical_nodes);
+
   // Notifies the scheduler that a packet was added to a graph input stream.
   // The scheduler needs to check whether it is still deadlocked, and
   // unthrottle again if so.
@@ -14,6 +14,7 @@
 
 #include "mediapipe/framework/scheduler_queue.h"
 
+#include <limits>
 #include <memory>
 #include <queue>
 #include <utility>
@@ -81,6 +82,10 @@ bool SchedulerQueue::Item::operator<(const SchedulerQueue::Item& that) const {
   } else {
     // Non-sources run before sources.
     if (that.is_source_) return false;
+    // Later deadlines run after earlier deadlines.
+    if (has_deadline_ && that.has_deadline_ && deadline_ != that.deadline_) {
+      return deadline_ > that.deadline_;
+    }
     // For non-sources, higher ids run before lower ids.
     return id_ < that.id_;
   }
@@ -120,7 +125,27 @@ void SchedulerQueue::AddNode(CalculatorNode* node, CalculatorContext* cc) {
     CHECK(node->IsSource()) << node->DebugName();
     return;
   }
-  AddItemToQueue(Item(node, cc));
+  Item item(node, cc);
+  if (shared_->earliest_deadline_first && !node->IsSource()) {
+    item.SetDeadline(Deadline(node, cc));
+  }
+  AddItemToQueue(std::move(item));
+}
+
+int64 SchedulerQueue::Deadline(const CalculatorNode* node,
+                               CalculatorContext* cc) const {
+  const int64 timestamp = cc->InputTimestamp().Value();
+  const int id = node->Id();
+  if (id >= 0 && id < static_cast<int>(shared_->critical_nodes.size()) &&
+      shared_->critical_nodes[id]) {
+    return timestamp;
+  }
+  // Saturate, since special timestamps such as Timestamp::Done() are close
+  // to the limits of int64.
+  if (timestamp > std::numeric_limits<int64>::max() - shared_->latency_budget) {
+    return std::numeric_limits<int64>::max();
+  }
+  return timestamp + shared_->latency_budget;
 }
 
 void SchedulerQueue::AddNodeForOpen(CalculatorNode* node) {
@@ -62,10 +62,17 @@ class SchedulerQueue : public TaskQueue {
     // - Sources are sorted by layer (lower layer numbers run first), then by
     //   Calculator::SourceProcessOrder (smaller values run first), then by
     //   node id: smaller ids run first, since they come earlier in the config.
-    // - Non-sources are sorted by node id: larger ids run first, because they
-    //   are closer to the leaves.
+    // - Non-sources are sorted by deadline, if they have one (smaller
+    //   deadlines run first), then by node id: larger ids run first, because
+    //   they are closer to the leaves.
     bool operator<(const Item& that) const;
 
+    // Sets the deadline used to order non-source items. See SchedulerConfig.
+    void SetDeadline(int64 deadline) {
+      deadline_ = deadline;
+      has_deadline_ = true;
+    }
+
    private:
     int64 source_process_order_ = 0;
     CalculatorNode* node_;
@@ -74,6 +81,8 @@ class SchedulerQueue : public TaskQueue {
     int layer_ = 0;
     bool is_source_ = false;
     bool is_open_node_ = false;  // True if the task should run OpenNode().
+    int64 deadline_ = 0;
+    bool has_deadline_ = false;
   };
 
   explicit SchedulerQueue(SchedulerShared* shared) : shared_(shared) {}
@@ -133,6 +142,10 @@ class SchedulerQueue : public TaskQueue {
   void CleanupAfterRun() ABSL_LOCKS_EXCLUDED(mutex_);
 
  private:
+  // Returns the deadline of a non-source node under EARLIEST_DEADLINE_FIRST
+  // scheduling.
+  int64 Deadline(const CalculatorNode* node, CalculatorContext* cc) const;
+
   // Used internally by RunNextTask. Invokes ProcessNode or CloseNode, followed
   // by EndScheduling.
   void RunCalculatorNode(CalculatorNode* node, CalculatorContext* cc)
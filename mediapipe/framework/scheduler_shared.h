@@ -20,6 +20,7 @@
 #include <memory>
 #include <queue>
 #include <utility>
+#include <vector>
 
 #include "absl/base/macros.h"
 #include "absl/synchronization/mutex.h"
@@ -108,6 +109,12 @@ struct SchedulerShared {
   std::function<void(const absl::Status& error)> error_callback;
   // Collects timing information for measuring overhead.
   internal::SchedulerTimer timer;
+  // Deadline-aware scheduling, see SchedulerConfig. These are set before the
+  // graph starts running and do not change while it runs.
+  bool earliest_deadline_first = false;
+  int64 latency_budget = 0;
+  // Indexed by node id. True if the node is on the critical path.
+  std::vector<bool> critical_nodes;
 };
 
 }  // namespace internal
@@ -0,0 +1,91 @@
+// Copyright 2022 The MediaPipe Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <memory>
+
+#include "mediapipe/framework/input_stream_handler.h"
+#include "mediapipe/framework/port/status.h"
+#include "mediapipe/framework/stream_handler/batching_input_stream_handler.pb.h"
+#include "mediapipe/framework/stream_handler/default_input_stream_handler.h"
+
+namespace mediapipe {
+
+// Input stream handler that hands all the input sets that are ready, up to
+// max_batch_size of them, to a single invocation of the calculator. Input
+// sets are aligned by timestamp as in DefaultInputStreamHandler.
+//
+// Unlike the batch_size of DefaultInputStreamHandler, this handler never waits
+// for a batch to fill up: as soon as no further input set is ready, the input
+// sets gathered so far are scheduled. Under light load, each invocation gets a
+// single input set and no latency is added; under heavy load, the input sets
+// that queued up while the calculator was busy are drained together.
+//
+// A calculator that sets CalculatorContract::SetProcessBatches() gets all the
+// input sets of an invocation in one Process() call, see
+// CalculatorContext::BatchSize(). Other calculators get one Process() call
+// per input set, which still saves one scheduling round trip per input set.
+//
+// Batching is disabled for calculators that run in parallel.
+//
+// Example config:
+//   node {
+//     calculator: "AudioClassifierCalculator"
+//     input_stream: "AUDIO:audio"
+//     output_stream: "SCORES:scores"
+//     input_stream_handler {
+//       input_stream_handler: "BatchingInputStreamHandler"
+//       options {
+//         [mediapipe.BatchingInputStreamHandlerOptions.ext] {
+//           max_batch_size: 8
+//         }
+//       }
+//     }
+//   }
+class BatchingInputStreamHandler : public DefaultInputStreamHandler {
+ public:
+  BatchingInputStreamHandler() = delete;
+  BatchingInputStreamHandler(std::shared_ptr<tool::TagMap> tag_map,
+                             CalculatorContextManager* cc_manager,
+                             const MediaPipeOptions& options,
+                             bool calculator_run_in_parallel)
+      : DefaultInputStreamHandler(std::move(tag_map), cc_manager, options,
+                                  calculator_run_in_parallel) {
+    if (calculator_run_in_parallel) {
+      return;
+    }
+    const auto& ext =
+        options.GetExtension(BatchingInputStreamHandlerOptions::ext);
+    if (ext.max_batch_size() < 1) {
+      // Reported by ValidateOptions().
+      return;
+    }
+    SetBatchSize(ext.max_batch_size());
+    SetScheduleIncompleteBatches(true);
+    SetMaxBatchSpan(TimestampDiff(ext.max_batch_span_us()));
+  }
+
+  absl::Status ValidateOptions() const override {
+    const auto& ext =
+        options().GetExtension(BatchingInputStreamHandlerOptions::ext);
+    if (ext.max_batch_size() < 1) {
+      return mediapipe::InvalidArgumentErrorBuilder(MEDIAPIPE_LOC)
+             << "max_batch_size must be at least 1, got "
+             << ext.max_batch_size() << ".";
+    }
+    return absl::OkStatus();
+  }
+};
+REGISTER_INPUT_STREAM_HANDLER(BatchingInputStreamHandler);
+
+}  // namespace mediapipe
@@ -0,0 +1,287 @@
+// Copyright 2022 The MediaPipe Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <string>
+#include <vector>
+
+#include "absl/strings/substitute.h"
+#include "absl/synchronization/mutex.h"
+#include "absl/synchronization/notification.h"
+#include "mediapipe/framework/calculator_framework.h"
+#include "mediapipe/framework/port/benchmark.h"
+#include "mediapipe/framework/port/gmock.h"
+#include "mediapipe/framework/port/gtest.h"
+#include "mediapipe/framework/port/parse_text_proto.h"
+#include "mediapipe/framework/port/status.h"
+#include "mediapipe/framework/port/status_matchers.h"
+
+namespace mediapipe {
+namespace {
+
+// Records the batches processed by BatchRecorderCalculator. When "block" is
+// true, the first Process() call waits for "release", so that the input sets
+// sent meanwhile queue up.
+struct BatchLog {
+  absl::Mutex mutex;
+  std::vector<std::vector<int64>> batches ABSL_GUARDED_BY(mutex);
+  bool block = false;
+  absl::Notification started;
+  absl::Notification release;
+};
+
+// Passes its input packets through, processing batches of input sets in a
+// single Process() call.
+class BatchRecorderCalculator : public CalculatorBase {
+ public:
+  static absl::Status GetContract(CalculatorContract* cc) {
+    cc->Inputs().Index(0).SetAny();
+    cc->Outputs().Index(0).SetSameAs(&cc->Inputs().Index(0));
+    if (cc->InputSidePackets().HasTag("LOG")) {
+      cc->InputSidePackets().Tag("LOG").Set<BatchLog*>();
+    }
+    cc->SetProcessBatches(true);
+    return absl::OkStatus();
+  }
+
+  absl::Status Open(CalculatorContext* cc) override {
+    if (cc->InputSidePackets().HasTag("LOG")) {
+      log_ = cc->InputSidePackets().Tag("LOG").Get<BatchLog*>();
+    }
+    return absl::OkStatus();
+  }
+
+  absl::Status Process(CalculatorContext* cc) override {
+    std::vector<int64> batch;
+    for (int i = 0; i < cc->BatchSize(); ++i) {
+      const Packet& packet = cc->Inputs().Index(0).BatchValue(i);
+      RET_CHECK_EQ(packet.Timestamp(), cc->BatchTimestamp(i));
+      batch.push_back(cc->BatchTimestamp(i).Value());
+      cc->Outputs().Index(0).AddPacket(packet);
+    }
+    if (log_ == nullptr) {
+      return absl::OkStatus();
+    }
+    {
+      absl::MutexLock lock(&log_->mutex);
+      log_->batches.push_back(batch);
+    }
+    if (log_->block && !log_->started.HasBeenNotified()) {
+      log_->started.Notify();
+      log_->release.WaitForNotification();
+    }
+    return absl::OkStatus();
+  }
+
+ private:
+  BatchLog* log_ = nullptr;
+};
+REGISTER_CALCULATOR(BatchRecorderCalculator);
+
+CalculatorGraphConfig BatchingGraphConfig(const std::string& handler_options) {
+  return ParseTextProtoOrDie<CalculatorGraphConfig>(absl::Substitute(
+      R"pb(
+        input_stream: "input"
+        input_side_packet: "log"
+        num_threads: 2
+        node {
+          calculator: "BatchRecorderCalculator"
+          input_stream: "input"
+          output_stream: "output"
+          input_side_packet: "LOG:log"
+          input_stream_handler {
+            input_stream_handler: "BatchingInputStreamHandler"
+            options {
+              [mediapipe.BatchingInputStreamHandlerOptions.ext] { $0 }
+            }
+          }
+        }
+      )pb",
+      handler_options));
+}
+
+// Runs "config" on the input timestamps "first" and "rest". The calculator is
+// blocked in the Process() call for "first", while "rest" are sent.
+std::vector<Timestamp> RunBlockedGraph(const CalculatorGraphConfig& config,
+                                       BatchLog* log, int64 first,
+                                       const std::vector<int64>& rest) {
+  std::vector<Timestamp> output;
+  CalculatorGraph graph;
+  MEDIAPIPE_CHECK_OK(graph.Initialize(config));
+  MEDIAPIPE_CHECK_OK(
+      graph.ObserveOutputStream("output", [&output](const Packet& packet) {
+        output.push_back(packet.Timestamp());
+        return absl::OkStatus();
+      }));
+  log->block = true;
+  MEDIAPIPE_CHECK_OK(graph.StartRun({{"log", MakePacket<BatchLog*>(log)}}));
+  MEDIAPIPE_CHECK_OK(graph.AddPacketToInputStream(
+      "input", MakePacket<int>(0).At(Timestamp(first))));
+  log->started.WaitForNotification();
+  for (int64 timestamp : rest) {
+    MEDIAPIPE_CHECK_OK(graph.AddPacketToInputStream(
+        "input", MakePacket<int>(0).At(Timestamp(timestamp))));
+  }
+  log->release.Notify();
+  MEDIAPIPE_CHECK_OK(graph.CloseAllInputStreams());
+  MEDIAPIPE_CHECK_OK(graph.WaitUntilDone());
+  return output;
+}
+
+std::vector<Timestamp> Timestamps(int64 begin, int64 end) {
+  std::vector<Timestamp> result;
+  for (int64 t = begin; t < end; ++t) {
+    result.push_back(Timestamp(t));
+  }
+  return result;
+}
+
+std::vector<int64> Values(int64 begin, int64 end) {
+  std::vector<int64> result;
+  for (int64 t = begin; t < end; ++t) {
+    result.push_back(t);
+  }
+  return result;
+}
+
+// The input sets that queue up while the calculator is busy are processed in
+// batches of at most max_batch_size input sets, in timestamp order.
+TEST(BatchingInputStreamHandlerTest, DrainsQueuedInputSets) {
+  BatchLog log;
+  std::vector<Timestamp> output =
+      RunBlockedGraph(BatchingGraphConfig("max_batch_size: 4"), &log, 0,
+                      Values(1, 10));
+  EXPECT_EQ(output, Timestamps(0, 10));
+  absl::MutexLock lock(&log.mutex);
+  EXPECT_THAT(log.batches,
+              testing::ElementsAre(Values(0, 1), Values(1, 5), Values(5, 9),
+                                   Values(9, 10)));
+}
+
+// A batch is closed once its timestamps span max_batch_span_us.
+TEST(BatchingInputStreamHandlerTest, LimitsBatchSpan) {
+  BatchLog log;
+  std::vector<Timestamp> output =
+      RunBlockedGraph(BatchingGraphConfig("max_batch_span_us: 3"), &log, 0,
+                      Values(10, 20));
+  std::vector<Timestamp> expected = Timestamps(10, 20);
+  expected.insert(expected.begin(), Timestamp(0));
+  EXPECT_EQ(output, expected);
+  absl::MutexLock lock(&log.mutex);
+  EXPECT_THAT(log.batches,
+              testing::ElementsAre(Values(0, 1), Values(10, 14),
+                                   Values(14, 18), Values(18, 20)));
+}
+
+// A max_batch_size below 1 fails the graph initialization.
+TEST(BatchingInputStreamHandlerTest, RejectsInvalidBatchSize) {
+  CalculatorGraph graph;
+  absl::Status status =
+      graph.Initialize(BatchingGraphConfig("max_batch_size: 0"));
+  EXPECT_EQ(status.code(), absl::StatusCode::kInvalidArgument);
+  EXPECT_THAT(status.message(), testing::HasSubstr("max_batch_size"));
+}
+
+// A calculator that does not process batches gets one Process() call per
+// input set, and the timestamp bounds of its outputs keep advancing without
+// waiting for a batch to fill up.
+TEST(BatchingInputStreamHandlerTest, PropagatesTimestampBounds) {
+  CalculatorGraphConfig config =
+      ParseTextProtoOrDie<CalculatorGraphConfig>(R"pb(
+        input_stream: "input"
+        input_stream: "other"
+        num_threads: 2
+        node {
+          calculator: "PassThroughCalculator"
+          input_stream: "input"
+          output_stream: "batched"
+          input_stream_handler {
+            input_stream_handler: "BatchingInputStreamHandler"
+            options {
+              [mediapipe.BatchingInputStreamHandlerOptions.ext] {
+                max_batch_size: 16
+              }
+            }
+          }
+        }
+        node {
+          calculator: "PassThroughCalculator"
+          input_stream: "batched"
+          input_stream: "other"
+          output_stream: "output"
+          output_stream: "other_output"
+        }
+      )pb");
+  CalculatorGraph graph;
+  MP_ASSERT_OK(graph.Initialize(config));
+  std::vector<Timestamp> output;
+  MP_ASSERT_OK(graph.ObserveOutputStream("other_output",
+                                         [&output](const Packet& packet) {
+                                           output.push_back(packet.Timestamp());
+                                           return absl::OkStatus();
+                                         }));
+  MP_ASSERT_OK(graph.StartRun({}));
+  for (int t = 0; t < 5; ++t) {
+    MP_ASSERT_OK(graph.AddPacketToInputStream(
+        "input", MakePacket<int>(t).At(Timestamp(2 * t))));
+    MP_ASSERT_OK(graph.AddPacketToInputStream(
+        "other", MakePacket<int>(t).At(Timestamp(2 * t + 1))));
+  }
+  // "other" packets are synchronized with the bounds of "batched", which are
+  // propagated as soon as the batched node is idle.
+  MP_ASSERT_OK(graph.WaitUntilIdle());
+  EXPECT_THAT(output, testing::ElementsAre(Timestamp(1), Timestamp(3),
+                                           Timestamp(5), Timestamp(7)));
+  MP_ASSERT_OK(graph.CloseAllInputStreams());
+  MP_ASSERT_OK(graph.WaitUntilDone());
+  EXPECT_EQ(output.size(), 5);
+}
+
+// Sends kNumPackets through a BatchRecorderCalculator using either the default
+// input stream handler or the BatchingInputStreamHandler.
+void BM_InputStreamHandler(benchmark::State& state) {
+  constexpr int kNumPackets = 1000;
+  CalculatorGraphConfig config = BatchingGraphConfig("max_batch_size: 16");
+  config.clear_input_side_packet();
+  config.mutable_node(0)->clear_input_side_packet();
+  if (state.range(0) == 0) {
+    config.mutable_node(0)->clear_input_stream_handler();
+  }
+  for (auto _ : state) {
+    CalculatorGraph graph;
+    CHECK(graph.Initialize(config).ok());
+    int num_outputs = 0;
+    CHECK(graph
+              .ObserveOutputStream("output",
+                                   [&num_outputs](const Packet&) {
+                                     ++num_outputs;
+                                     return absl::OkStatus();
+                                   })
+              .ok());
+    CHECK(graph.StartRun({}).ok());
+    for (int t = 0; t < kNumPackets; ++t) {
+      CHECK(graph
+                .AddPacketToInputStream("input",
+                                        MakePacket<int>(t).At(Timestamp(t)))
+                .ok());
+    }
+    CHECK(graph.CloseAllInputStreams().ok());
+    CHECK(graph.WaitUntilDone().ok());
+    CHECK_EQ(num_outputs, kNumPackets);
+  }
+  state.SetItemsProcessed(state.iterations() * kNumPackets);
+}
+BENCHMARK(BM_InputStreamHandler)->Arg(0)->Arg(1);
+
+}  // namespace
+}  // namespace mediapipe
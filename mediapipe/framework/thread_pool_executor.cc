@@ -14,6 +14,8 @@
 
 #include "mediapipe/framework/thread_pool_executor.h"
 
+#include <memory>
+#include <string>
 #include <utility>
 
 #include "mediapipe/framework/port/canonical_errors.h"
@@ -71,21 +73,38 @@ absl::StatusOr<Executor*> ThreadPoolExecutor::Create(
       break;
   }
 #endif
-  return new ThreadPoolExecutor(thread_options, options.num_threads());
+  const bool work_stealing =
+      options.queue_type() == ThreadPoolExecutorOptions::WORK_STEALING;
+  if (options.pin_threads_to_cores()) {
+    if (!work_stealing) {
+      return mediapipe::InvalidArgumentErrorBuilder(MEDIAPIPE_LOC)
+             << "The pin_threads_to_cores field in ThreadPoolExecutorOptions "
+                "requires queue_type WORK_STEALING.";
+    }
+    thread_options.set_pin_threads_to_cores(true);
+  }
+  return new ThreadPoolExecutor(thread_options, options.num_threads(),
+                                work_stealing);
 }
 
 ThreadPoolExecutor::ThreadPoolExecutor(int num_threads)
-    : thread_pool_("mediapipe", num_threads) {
+    : thread_pool_(
+          std::make_unique<mediapipe::ThreadPool>("mediapipe", num_threads)) {
   Start();
 }
 
 ThreadPoolExecutor::ThreadPoolExecutor(const ThreadOptions& thread_options,
-                                       int num_threads)
-    : thread_pool_(thread_options,
-                   thread_options.name_prefix().empty()
-                       ? "mediapipe"
-                       : thread_options.name_prefix(),
-                   num_threads) {
+                                       int num_threads, bool work_stealing) {
+  const std::string name_prefix = thread_options.name_prefix().empty()
+                                      ? "mediapipe"
+                                      : thread_options.name_prefix();
+  if (work_stealing) {
+    work_stealing_pool_ = std::make_unique<mediapipe::WorkStealingThreadPool>(
+        thread_options, name_prefix, num_threads);
+  } else {
+    thread_pool_ = std::make_unique<mediapipe::ThreadPool>(
+        thread_options, name_prefix, num_threads);
+  }
   Start();
 }
 
@@ -94,14 +113,28 @@ ThreadPoolExecutor::~ThreadPoolExecutor() {
 }
 
 void ThreadPoolExecutor::Schedule(std::function<void()> task) {
-  thread_pool_.Schedule(std::move(task));
+  if (work_stealing_pool_) {
+    work_stealing_pool_->Schedule(std::move(task));
+  } else {
+    thread_pool_->Schedule(std::move(task));
+  }
+}
+
+int ThreadPoolExecutor::num_threads() const {
+  return work_stealing_pool_ ? work_stealing_pool_->num_threads()
+                             : thread_pool_->num_threads();
 }
 
 void ThreadPoolExecutor::Start() {
-  stack_size_ = thread_pool_.thread_options().stack_size();
-  thread_pool_.StartWorkers();
-  VLOG(2) << "Started thread pool with " << thread_pool_.num_threads()
-          << " threads.";
+  if (work_stealing_pool_) {
+    stack_size_ = work_stealing_pool_->thread_options().stack_size();
+    work_stealing_pool_->StartWorkers();
+  } else {
+    stack_size_ = thread_pool_->thread_options().stack_size();
+    thread_pool_->StartWorkers();
+  }
+  VLOG(2) << "Started " << (work_stealing_pool_ ? "work-stealing " : "")
+          << "thread pool with " << num_threads() << " threads.";
 }
 
 REGISTER_EXECUTOR(ThreadPoolExecutor);
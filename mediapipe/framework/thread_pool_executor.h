@@ -15,14 +15,19 @@
 #ifndef MEDIAPIPE_FRAMEWORK_THREAD_POOL_EXECUTOR_H_
 #define MEDIAPIPE_FRAMEWORK_THREAD_POOL_EXECUTOR_H_
 
+#include <memory>
+
 #include "mediapipe/framework/deps/thread_options.h"
 #include "mediapipe/framework/executor.h"
 #include "mediapipe/framework/port/statusor.h"
 #include "mediapipe/framework/port/threadpool.h"
+#include "mediapipe/framework/port/work_stealing_threadpool.h"
 
 namespace mediapipe {
 
-// A multithreaded executor based on a thread pool.
+// A multithreaded executor based on a thread pool. By default all worker
+// threads share one task queue; ThreadPoolExecutorOptions::queue_type selects
+// a WorkStealingThreadPool with one queue per worker instead.
 class ThreadPoolExecutor : public Executor {
  public:
   static absl::StatusOr<Executor*> Create(
@@ -33,20 +38,26 @@ class ThreadPoolExecutor : public Executor {
   void Schedule(std::function<void()> task) override;
 
   // For testing.
-  int num_threads() const { return thread_pool_.num_threads(); }
+  int num_threads() const;
+  // For testing. Returns true if the executor uses a WorkStealingThreadPool.
+  bool is_work_stealing() const { return work_stealing_pool_ != nullptr; }
   // Returns the thread stack size (in bytes).
   size_t stack_size() const { return stack_size_; }
 
  private:
-  ThreadPoolExecutor(const ThreadOptions& thread_options, int num_threads);
+  ThreadPoolExecutor(const ThreadOptions& thread_options, int num_threads,
+                     bool work_stealing);
 
   // Saves the value of the stack size option and starts the thread pool.
   void Start();
 
-  mediapipe::ThreadPool thread_pool_;
+  // Exactly one of the two thread pools is created, depending on the
+  // queue_type option.
+  std::unique_ptr<mediapipe::ThreadPool> thread_pool_;
+  std::unique_ptr<mediapipe::WorkStealingThreadPool> work_stealing_pool_;
 
   // Records the stack size in ThreadOptions right before we call
-  // thread_pool_.StartWorkers().
+  // StartWorkers().
   //
   // The actual stack size passed to pthread_attr_setstacksize() for the
   // worker threads differs from the stack size we specified. It includes the
@@ -0,0 +1,224 @@
+// Copyright 2022 The MediaPipe Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Tests ThreadPoolExecutor and measures scheduling contention of its queue
+// types. To run the benchmarks:
+// $ bazel run -c opt mediapipe/framework:thread_pool_executor_test -- \
+//   --benchmark_filter=all
+
+#include "mediapipe/framework/thread_pool_executor.h"
+
+#include <memory>
+#include <string>
+#include <thread>  // NOLINT(build/c++11)
+#include <vector>
+
+#include "absl/strings/str_cat.h"
+#include "absl/synchronization/blocking_counter.h"
+#include "mediapipe/framework/calculator_framework.h"
+#include "mediapipe/framework/port/benchmark.h"
+#include "mediapipe/framework/port/gmock.h"
+#include "mediapipe/framework/port/gtest.h"
+#include "mediapipe/framework/port/parse_text_proto.h"
+#include "mediapipe/framework/port/status_matchers.h"
+#include "mediapipe/framework/thread_pool_executor.pb.h"
+#include "mediapipe/framework/tool/sink.h"
+
+namespace mediapipe {
+namespace {
+
+absl::StatusOr<std::unique_ptr<Executor>> CreateExecutor(
+    const std::string& options_text) {
+  MediaPipeOptions extendable_options;
+  *extendable_options.MutableExtension(ThreadPoolExecutorOptions::ext) =
+      ParseTextProtoOrDie<ThreadPoolExecutorOptions>(options_text);
+  ASSIGN_OR_RETURN(Executor * executor,
+                   ThreadPoolExecutor::Create(extendable_options));
+  return std::unique_ptr<Executor>(executor);
+}
+
+TEST(ThreadPoolExecutorTest, DefaultsToSharedQueue) {
+  auto executor = CreateExecutor("num_threads: 4");
+  MP_ASSERT_OK(executor);
+  auto* thread_pool_executor =
+      static_cast<ThreadPoolExecutor*>(executor.value().get());
+  EXPECT_FALSE(thread_pool_executor->is_work_stealing());
+  EXPECT_EQ(4, thread_pool_executor->num_threads());
+}
+
+TEST(ThreadPoolExecutorTest, CreatesWorkStealingPool) {
+  auto executor = CreateExecutor(
+      "num_threads: 4 queue_type: WORK_STEALING stack_size: 262144");
+  MP_ASSERT_OK(executor);
+  auto* thread_pool_executor =
+      static_cast<ThreadPoolExecutor*>(executor.value().get());
+  EXPECT_TRUE(thread_pool_executor->is_work_stealing());
+  EXPECT_EQ(4, thread_pool_executor->num_threads());
+  EXPECT_EQ(262144, thread_pool_executor->stack_size());
+
+  constexpr int kNumTasks = 100;
+  absl::BlockingCounter done(kNumTasks);
+  for (int i = 0; i < kNumTasks; ++i) {
+    thread_pool_executor->Schedule([&done]() { done.DecrementCount(); });
+  }
+  done.Wait();
+}
+
+TEST(ThreadPoolExecutorTest, PinningRequiresWorkStealing) {
+  EXPECT_EQ(
+      CreateExecutor("num_threads: 4 pin_threads_to_cores: true")
+          .status()
+          .code(),
+      absl::StatusCode::kInvalidArgument);
+  MP_EXPECT_OK(CreateExecutor(
+      "num_threads: 4 queue_type: WORK_STEALING pin_threads_to_cores: true"));
+}
+
+TEST(ThreadPoolExecutorTest, RunsGraphWithWorkStealingExecutor) {
+  CalculatorGraphConfig config =
+      ParseTextProtoOrDie<CalculatorGraphConfig>(R"pb(
+        input_stream: "in"
+        executor {
+          options {
+            [mediapipe.ThreadPoolExecutorOptions.ext] {
+              num_threads: 4
+              queue_type: WORK_STEALING
+            }
+          }
+        }
+        node {
+          calculator: "PassThroughCalculator"
+          input_stream: "in"
+          output_stream: "mid"
+        }
+        node {
+          calculator: "PassThroughCalculator"
+          input_stream: "mid"
+          output_stream: "out"
+        }
+      )pb");
+  std::vector<Packet> output_packets;
+  tool::AddVectorSink("out", &config, &output_packets);
+  CalculatorGraph graph;
+  MP_ASSERT_OK(graph.Initialize(config));
+  MP_ASSERT_OK(graph.StartRun({}));
+  for (int i = 0; i < 100; ++i) {
+    MP_ASSERT_OK(graph.AddPacketToInputStream(
+        "in", MakePacket<int>(i).At(Timestamp(i))));
+  }
+  MP_ASSERT_OK(graph.CloseAllInputStreams());
+  MP_ASSERT_OK(graph.WaitUntilDone());
+  ASSERT_EQ(100, output_packets.size());
+  for (int i = 0; i < 100; ++i) {
+    EXPECT_EQ(i, output_packets[i].Get<int>());
+  }
+}
+
+// Runs a chain of "remaining" tasks, each scheduling the next one from inside
+// the executor, the way the scheduler queues the next ready node from inside
+// a running node.
+void ScheduleChain(Executor* executor, absl::BlockingCounter* done,
+                   int remaining) {
+  if (remaining == 0) {
+    done->DecrementCount();
+    return;
+  }
+  executor->Schedule([executor, done, remaining]() {
+    ScheduleChain(executor, done, remaining - 1);
+  });
+}
+
+// state.range(0) selects WORK_STEALING (1) or SHARED_QUEUE (0) and
+// state.range(1) is the number of worker threads.
+void BM_ScheduleChainedTasks(benchmark::State& state) {
+  const bool work_stealing = state.range(0);
+  const int num_threads = state.range(1);
+  constexpr int kNumChains = 64;
+  constexpr int kChainLength = 256;
+  auto executor =
+      CreateExecutor(absl::StrCat("num_threads: ", num_threads,
+                                  work_stealing ? " queue_type: WORK_STEALING"
+                                                : ""))
+          .value();
+  for (auto _ : state) {
+    absl::BlockingCounter done(kNumChains);
+    for (int i = 0; i < kNumChains; ++i) {
+      ScheduleChain(executor.get(), &done, kChainLength);
+    }
+    done.Wait();
+  }
+  state.SetItemsProcessed(state.iterations() * kNumChains * kChainLength);
+}
+BENCHMARK(BM_ScheduleChainedTasks)
+    ->ArgsProduct({{0, 1}, {4, 16, 32}})
+    ->UseRealTime();
+
+// Runs several graphs concurrently, each with its own default executor, and
+// feeds them from separate threads. This models many graphs per process.
+// state.range(0) selects the queue type as above and state.range(1) is the
+// number of graphs.
+void BM_ConcurrentGraphs(benchmark::State& state) {
+  const bool work_stealing = state.range(0);
+  const int num_graphs = state.range(1);
+  constexpr int kNumPackets = 500;
+  CalculatorGraphConfig config =
+      ParseTextProtoOrDie<CalculatorGraphConfig>(R"pb(
+        input_stream: "in"
+        node {
+          calculator: "PassThroughCalculator"
+          input_stream: "in"
+          output_stream: "a"
+        }
+        node {
+          calculator: "PassThroughCalculator"
+          input_stream: "a"
+          output_stream: "b"
+        }
+        node {
+          calculator: "PassThroughCalculator"
+          input_stream: "b"
+          output_stream: "out"
+        }
+      )pb");
+  auto* options = config.add_executor()->mutable_options()->MutableExtension(
+      ThreadPoolExecutorOptions::ext);
+  options->set_num_threads(4);
+  if (work_stealing) {
+    options->set_queue_type(ThreadPoolExecutorOptions::WORK_STEALING);
+  }
+  for (auto _ : state) {
+    std::vector<std::thread> threads;
+    for (int g = 0; g < num_graphs; ++g) {
+      threads.emplace_back([&config]() {
+        CalculatorGraph graph;
+        MEDIAPIPE_CHECK_OK(graph.Initialize(config));
+        MEDIAPIPE_CHECK_OK(graph.StartRun({}));
+        for (int i = 0; i < kNumPackets; ++i) {
+          MEDIAPIPE_CHECK_OK(graph.AddPacketToInputStream(
+              "in", MakePacket<int>(i).At(Timestamp(i))));
+        }
+        MEDIAPIPE_CHECK_OK(graph.CloseAllInputStreams());
+        MEDIAPIPE_CHECK_OK(graph.WaitUntilDone());
+      });
+    }
+    for (std::thread& thread : threads) {
+      thread.join();
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * num_graphs * kNumPackets);
+}
+BENCHMARK(BM_ConcurrentGraphs)->ArgsProduct({{0, 1}, {1, 8}})->UseRealTime();
+
+}  // namespace
+}  // namespace mediapipe
@@ -22,8 +22,13 @@ load("//mediapipe/framework/tool:build_defs.bzl", "clean_dep")
 load("//mediapipe/framework/deps:descriptor_set.bzl", "direct_descriptor_set", "transitive_descriptor_set")
 load("@org_tensorflow//tensorflow/lite/core/shims:cc_library_with_tflite.bzl", "cc_library_with_tflite")
 
-def mediapipe_binary_graph(name, graph = None, output_name = None, deps = [], testonly = False, **kwargs):
-    """Converts a graph from text format to binary format."""
+def mediapipe_binary_graph(name, graph = None, output_name = None, deps = [], testonly = False, expand_graph = False, **kwargs):
+    """Converts a graph from text format to binary format.
+
+    If expand_graph is True, the graph is validated at build time and written
+    with its subgraphs expanded, so that it is quicker to initialize. The deps
+    must then include the calculators and subgraphs used by the graph.
+    """
 
     if not graph:
         fail("No input graph file specified.")
@@ -44,7 +49,7 @@ def mediapipe_binary_graph(name, graph = None, output_name = None, deps = [], te
         deps = [
             clean_dep("//mediapipe/framework/tool:text_to_binary_graph"),
             name + "_gather_cc_protos",
-        ],
+        ] + (deps if expand_graph else []),
         tags = ["manual"],
         testonly = testonly,
     )
@@ -57,7 +62,8 @@ def mediapipe_binary_graph(name, graph = None, output_name = None, deps = [], te
         cmd = (
             "$(location " + name + "_text_to_binary_graph" + ") " +
             ("--proto_source=$(location %s) " % graph) +
-            ("--proto_output=\"$@\" ")
+            ("--proto_output=\"$@\" ") +
+            ("--expand_graph " if expand_graph else "")
         ),
         tools = [name + "_text_to_binary_graph"],
         testonly = testonly,
@@ -26,12 +26,17 @@
 #include "mediapipe/framework/port/canonical_errors.h"
 #include "mediapipe/framework/port/ret_check.h"
 #include "mediapipe/framework/port/status.h"
+#include "mediapipe/framework/validated_graph_config.h"
 
 ABSL_FLAG(std::string, proto_source, "",
           "The template source file containing CalculatorGraphConfig "
           "protobuf text with inline template params.");
 ABSL_FLAG(std::string, proto_output, "",
           "An output template file in binary CalculatorGraphTemplate form.");
+ABSL_FLAG(bool, expand_graph, false,
+          "If true, the graph is validated and written with its subgraphs "
+          "expanded, which saves the expansion when the graph is loaded. "
+          "The calculators and subgraphs of the graph must be linked in.");
 
 #define EXIT_IF_ERROR(status) \
   if (!status.ok()) {         \
@@ -88,6 +93,15 @@ absl::Status WriteFile(const std::string& proto_output, bool write_text,
   return absl::OkStatus();
 }
 
+// Replaces "config" with its expanded and canonicalized form, in which the
+// subgraphs are expanded and the input stream handlers and executors are set.
+absl::Status ExpandGraph(CalculatorGraphConfig* config) {
+  ValidatedGraphConfig validated_graph;
+  MP_RETURN_IF_ERROR(validated_graph.Initialize(*config));
+  *config = validated_graph.Config();
+  return absl::OkStatus();
+}
+
 }  // namespace mediapipe
 
 int main(int argc, char** argv) {
@@ -110,6 +124,9 @@ int main(int argc, char** argv) {
   mediapipe::CalculatorGraphConfig config;
   EXIT_IF_ERROR(
       mediapipe::ReadFile(absl::GetFlag(FLAGS_proto_source), true, &config));
+  if (absl::GetFlag(FLAGS_expand_graph)) {
+    EXIT_IF_ERROR(mediapipe::ExpandGraph(&config));
+  }
   EXIT_IF_ERROR(
       mediapipe::WriteFile(absl::GetFlag(FLAGS_proto_output), false, config));
   return EXIT_SUCCESS;
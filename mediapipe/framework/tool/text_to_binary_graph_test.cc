@@ -0,0 +1,83 @@
+// Copyright 2022 The MediaPipe Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <set>
+#include <string>
+
+#include "absl/strings/str_cat.h"
+#include "absl/strings/str_join.h"
+#include "mediapipe/framework/calculator_framework.h"
+#include "mediapipe/framework/port/gmock.h"
+#include "mediapipe/framework/port/gtest.h"
+#include "mediapipe/framework/port/parse_text_proto.h"
+#include "mediapipe/framework/port/status_matchers.h"
+#include "mediapipe/framework/validated_graph_config.h"
+
+namespace mediapipe {
+namespace {
+
+// The text graph, which uses the DubQuadTestSubgraph.
+static const char kTextGraph[] =
+#include "mediapipe/framework/tool/nested_test_subgraph_pbtxt.inc"
+    ;  // NOLINT(whitespace/semicolon)
+
+// The same graph written by text_to_binary_graph with --expand_graph.
+static const char kExpandedGraph[] =
+#include "mediapipe/framework/tool/expanded_test_binarypb.inc"
+    ;  // NOLINT(whitespace/semicolon)
+
+// Returns the calculators of the nodes with their input and output streams.
+std::multiset<std::string> NodeSet(const ValidatedGraphConfig& graph) {
+  std::multiset<std::string> result;
+  for (const CalculatorGraphConfig::Node& node : graph.Config().node()) {
+    result.insert(absl::StrCat(node.calculator(), "(",
+                               absl::StrJoin(node.input_stream(), ","), ")->(",
+                               absl::StrJoin(node.output_stream(), ","), ")"));
+  }
+  return result;
+}
+
+// Returns the names of the streams of the graph.
+std::set<std::string> StreamSet(const ValidatedGraphConfig& graph) {
+  std::set<std::string> result;
+  for (const EdgeInfo& edge : graph.OutputStreamInfos()) {
+    result.insert(edge.name);
+  }
+  return result;
+}
+
+TEST(TextToBinaryGraphTest, ExpandedGraphMatchesTextGraph) {
+  CalculatorGraphConfig expanded_config;
+  ASSERT_TRUE(expanded_config.ParseFromArray(kExpandedGraph,
+                                             sizeof(kExpandedGraph) - 1));
+  // The subgraphs are expanded at build time.
+  for (const CalculatorGraphConfig::Node& node : expanded_config.node()) {
+    EXPECT_NE(node.calculator(), "DubQuadTestSubgraph");
+  }
+
+  ValidatedGraphConfig text_graph;
+  MP_ASSERT_OK(text_graph.Initialize(
+      ParseTextProtoOrDie<CalculatorGraphConfig>(kTextGraph)));
+  ValidatedGraphConfig expanded_graph;
+  MP_ASSERT_OK(expanded_graph.Initialize(expanded_config));
+
+  EXPECT_EQ(NodeSet(expanded_graph), NodeSet(text_graph));
+  EXPECT_EQ(StreamSet(expanded_graph), StreamSet(text_graph));
+  EXPECT_EQ(NodeSet(expanded_graph).size(), 3);
+  // Validating the expanded graph again doesn't change it.
+  EXPECT_THAT(expanded_graph.Config(), EqualsProto(expanded_config));
+}
+
+}  // namespace
+}  // namespace mediapipe
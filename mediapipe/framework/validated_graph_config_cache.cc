@@ -0,0 +1,97 @@
+// Copyright 2022 The MediaPipe Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "mediapipe/framework/validated_graph_config_cache.h"
+
+#include "google/protobuf/io/coded_stream.h"
+#include "google/protobuf/io/zero_copy_stream_impl_lite.h"
+#include "mediapipe/framework/deps/no_destructor.h"
+#include "mediapipe/framework/port/core_proto_inc.h"
+#include "mediapipe/framework/port/status.h"
+
+namespace mediapipe {
+
+namespace {
+
+// Returns the serialization of "config", which is the same for equal configs
+// even if they contain map fields.
+std::string SerializeDeterministically(const CalculatorGraphConfig& config) {
+  std::string result;
+  {
+    proto_ns::io::StringOutputStream stream(&result);
+    proto_ns::io::CodedOutputStream output(&stream);
+    output.SetSerializationDeterministic(true);
+    config.SerializeToCodedStream(&output);
+  }
+  return result;
+}
+
+}  // namespace
+
+ValidatedGraphConfigCache::ValidatedGraphConfigCache(int capacity)
+    : capacity_(capacity) {}
+
+// static
+ValidatedGraphConfigCache& ValidatedGraphConfigCache::Get() {
+  static NoDestructor<ValidatedGraphConfigCache> cache;
+  return *cache;
+}
+
+absl::StatusOr<std::shared_ptr<const ValidatedGraphConfig>>
+ValidatedGraphConfigCache::GetOrCreate(const CalculatorGraphConfig& config) {
+  std::string key = SerializeDeterministically(config);
+  {
+    absl::MutexLock lock(&mutex_);
+    auto it = index_.find(key);
+    if (it != index_.end()) {
+      entries_.splice(entries_.begin(), entries_, it->second);
+      return it->second->second;
+    }
+  }
+
+  // Validate without holding the lock, which lets other configs be looked up
+  // meanwhile. Two threads may validate the same config, in which case the
+  // first one to finish is cached.
+  auto validated_graph = std::make_shared<ValidatedGraphConfig>();
+  MP_RETURN_IF_ERROR(validated_graph->Initialize(config));
+
+  absl::MutexLock lock(&mutex_);
+  auto it = index_.find(key);
+  if (it != index_.end()) {
+    return it->second->second;
+  }
+  if (capacity_ <= 0) {
+    return validated_graph;
+  }
+  while (static_cast<int>(entries_.size()) >= capacity_) {
+    index_.erase(entries_.back().first);
+    entries_.pop_back();
+  }
+  entries_.emplace_front(std::move(key), std::move(validated_graph));
+  index_[entries_.front().first] = entries_.begin();
+  return entries_.front().second;
+}
+
+int ValidatedGraphConfigCache::size() const {
+  absl::MutexLock lock(&mutex_);
+  return entries_.size();
+}
+
+void ValidatedGraphConfigCache::Clear() {
+  absl::MutexLock lock(&mutex_);
+  index_.clear();
+  entries_.clear();
+}
+
+}  // namespace mediapipe
@@ -0,0 +1,93 @@
+// Copyright 2022 The MediaPipe Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef MEDIAPIPE_FRAMEWORK_VALIDATED_GRAPH_CONFIG_CACHE_H_
+#define MEDIAPIPE_FRAMEWORK_VALIDATED_GRAPH_CONFIG_CACHE_H_
+
+#include <list>
+#include <memory>
+#include <string>
+#include <utility>
+
+#include "absl/base/thread_annotations.h"
+#include "absl/container/flat_hash_map.h"
+#include "absl/strings/string_view.h"
+#include "absl/synchronization/mutex.h"
+#include "mediapipe/framework/calculator.pb.h"
+#include "mediapipe/framework/port/statusor.h"
+#include "mediapipe/framework/validated_graph_config.h"
+
+namespace mediapipe {
+
+// Caches the ValidatedGraphConfigs of CalculatorGraphConfigs, so that graphs
+// initialized repeatedly from the same config, such as one graph per video
+// session or per client, expand the subgraphs, resolve the packet types and
+// sort the nodes only once:
+//
+//   ASSIGN_OR_RETURN(std::shared_ptr<const ValidatedGraphConfig> validated,
+//                    ValidatedGraphConfigCache::Get().GetOrCreate(config));
+//   CalculatorGraph graph;
+//   MP_RETURN_IF_ERROR(graph.Initialize(validated, side_packets));
+//
+// An initialized ValidatedGraphConfig is never modified, so any number of
+// graphs can share it. Configs are identified by their deterministic binary
+// serialization. They are validated without graph services, so a graph whose
+// subgraphs depend on graph services should not be cached.
+//
+// The least recently used config is evicted when the cache is full. Graphs
+// keep the configs they were initialized from.
+//
+// This class is thread-safe.
+class ValidatedGraphConfigCache {
+ public:
+  static constexpr int kDefaultCapacity = 32;
+
+  explicit ValidatedGraphConfigCache(int capacity = kDefaultCapacity);
+
+  ValidatedGraphConfigCache(const ValidatedGraphConfigCache&) = delete;
+  ValidatedGraphConfigCache& operator=(const ValidatedGraphConfigCache&) =
+      delete;
+
+  // Returns the cache shared by the process, which is never destroyed.
+  static ValidatedGraphConfigCache& Get();
+
+  // Returns the ValidatedGraphConfig of "config", validating "config" if it
+  // is not cached. Configs that fail validation are not cached.
+  absl::StatusOr<std::shared_ptr<const ValidatedGraphConfig>> GetOrCreate(
+      const CalculatorGraphConfig& config) ABSL_LOCKS_EXCLUDED(mutex_);
+
+  // Returns the number of cached configs.
+  int size() const ABSL_LOCKS_EXCLUDED(mutex_);
+
+  // Removes all the cached configs.
+  void Clear() ABSL_LOCKS_EXCLUDED(mutex_);
+
+ private:
+  // A serialized CalculatorGraphConfig and its ValidatedGraphConfig.
+  using Entry =
+      std::pair<std::string, std::shared_ptr<const ValidatedGraphConfig>>;
+
+  const int capacity_;
+  mutable absl::Mutex mutex_;
+  // The cached configs, the most recently used first.
+  std::list<Entry> entries_ ABSL_GUARDED_BY(mutex_);
+  // The entries by serialized config. The keys refer to the strings owned by
+  // entries_.
+  absl::flat_hash_map<absl::string_view, std::list<Entry>::iterator> index_
+      ABSL_GUARDED_BY(mutex_);
+};
+
+}  // namespace mediapipe
+
+#endif  // MEDIAPIPE_FRAMEWORK_VALIDATED_GRAPH_CONFIG_CACHE_H_
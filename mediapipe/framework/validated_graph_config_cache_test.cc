@@ -0,0 +1,173 @@
+// Copyright 2022 The MediaPipe Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "mediapipe/framework/validated_graph_config_cache.h"
+
+#include <memory>
+#include <vector>
+
+#include "absl/strings/substitute.h"
+#include "mediapipe/framework/calculator_framework.h"
+#include "mediapipe/framework/port/benchmark.h"
+#include "mediapipe/framework/port/gmock.h"
+#include "mediapipe/framework/port/gtest.h"
+#include "mediapipe/framework/port/parse_text_proto.h"
+#include "mediapipe/framework/port/status_matchers.h"
+#include "mediapipe/framework/subgraph.h"
+
+namespace mediapipe {
+namespace {
+
+// A subgraph of two PassThroughCalculators, which is expanded when a config
+// using it is validated.
+class TwoPassThroughsSubgraph : public Subgraph {
+ public:
+  absl::StatusOr<CalculatorGraphConfig> GetConfig(
+      const SubgraphOptions& options) override {
+    return ParseTextProtoOrDie<CalculatorGraphConfig>(R"pb(
+      input_stream: "IN:in"
+      output_stream: "OUT:out"
+      node {
+        calculator: "PassThroughCalculator"
+        input_stream: "in"
+        output_stream: "mid"
+      }
+      node {
+        calculator: "PassThroughCalculator"
+        input_stream: "mid"
+        output_stream: "out"
+      }
+    )pb");
+  }
+};
+REGISTER_MEDIAPIPE_GRAPH(TwoPassThroughsSubgraph);
+
+CalculatorGraphConfig GraphConfig(const std::string& output_stream) {
+  return ParseTextProtoOrDie<CalculatorGraphConfig>(absl::Substitute(
+      R"pb(
+        input_stream: "input"
+        node {
+          calculator: "TwoPassThroughsSubgraph"
+          input_stream: "IN:input"
+          output_stream: "OUT:$0"
+        }
+      )pb",
+      output_stream));
+}
+
+// Returns the cached config for the graph with "output_stream".
+std::shared_ptr<const ValidatedGraphConfig> GetOrCreate(
+    ValidatedGraphConfigCache& cache, const std::string& output_stream) {
+  auto result = cache.GetOrCreate(GraphConfig(output_stream));
+  MEDIAPIPE_CHECK_OK(result.status());
+  return *result;
+}
+
+TEST(ValidatedGraphConfigCacheTest, ReturnsSameConfigForEqualConfigs) {
+  ValidatedGraphConfigCache cache;
+  auto first = GetOrCreate(cache, "out");
+  auto second = GetOrCreate(cache, "out");
+  auto other = GetOrCreate(cache, "other");
+  EXPECT_EQ(first, second);
+  EXPECT_NE(first, other);
+  EXPECT_EQ(cache.size(), 2);
+  // The subgraph is expanded.
+  EXPECT_EQ(first->Config().node_size(), 2);
+
+  cache.Clear();
+  EXPECT_EQ(cache.size(), 0);
+  auto third = GetOrCreate(cache, "out");
+  EXPECT_NE(first, third);
+}
+
+TEST(ValidatedGraphConfigCacheTest, EvictsLeastRecentlyUsedConfig) {
+  ValidatedGraphConfigCache cache(/*capacity=*/2);
+  auto a = GetOrCreate(cache, "a");
+  auto b = GetOrCreate(cache, "b");
+  // Makes "b" the least recently used config.
+  auto a_again = GetOrCreate(cache, "a");
+  EXPECT_EQ(a, a_again);
+  auto c = GetOrCreate(cache, "c");
+  EXPECT_EQ(cache.size(), 2);
+
+  a_again = GetOrCreate(cache, "a");
+  EXPECT_EQ(a, a_again);
+  auto b_again = GetOrCreate(cache, "b");
+  EXPECT_NE(b, b_again);
+  EXPECT_EQ(cache.size(), 2);
+}
+
+TEST(ValidatedGraphConfigCacheTest, DoesNotCacheInvalidConfigs) {
+  ValidatedGraphConfigCache cache;
+  CalculatorGraphConfig config;
+  config.add_node()->set_calculator("NotARegisteredCalculator");
+  EXPECT_FALSE(cache.GetOrCreate(config).ok());
+  EXPECT_EQ(cache.size(), 0);
+}
+
+TEST(ValidatedGraphConfigCacheTest, ZeroCapacityDisablesCaching) {
+  ValidatedGraphConfigCache cache(/*capacity=*/0);
+  auto first = GetOrCreate(cache, "out");
+  auto second = GetOrCreate(cache, "out");
+  EXPECT_NE(first, second);
+  EXPECT_EQ(cache.size(), 0);
+}
+
+TEST(ValidatedGraphConfigCacheTest, GraphsShareCachedConfig) {
+  ValidatedGraphConfigCache cache;
+  for (int run = 0; run < 3; ++run) {
+    auto validated_graph = GetOrCreate(cache, "out");
+    CalculatorGraph graph;
+    MP_ASSERT_OK(graph.Initialize(validated_graph));
+    std::vector<Packet> output;
+    MP_ASSERT_OK(graph.ObserveOutputStream("out", [&output](const Packet& p) {
+      output.push_back(p);
+      return absl::OkStatus();
+    }));
+    MP_ASSERT_OK(graph.StartRun({}));
+    MP_ASSERT_OK(graph.AddPacketToInputStream(
+        "input", MakePacket<int>(run).At(Timestamp(run))));
+    MP_ASSERT_OK(graph.CloseAllInputStreams());
+    MP_ASSERT_OK(graph.WaitUntilDone());
+    ASSERT_EQ(output.size(), 1);
+    EXPECT_EQ(output[0].Get<int>(), run);
+  }
+  EXPECT_EQ(cache.size(), 1);
+}
+
+TEST(ValidatedGraphConfigCacheTest, RejectsUninitializedConfig) {
+  CalculatorGraph graph;
+  EXPECT_FALSE(
+      graph.Initialize(std::make_shared<const ValidatedGraphConfig>()).ok());
+}
+
+void BM_InitializeGraph(benchmark::State& state) {
+  const bool use_cache = state.range(0);
+  ValidatedGraphConfigCache cache;
+  const CalculatorGraphConfig config = GraphConfig("out");
+  for (auto _ : state) {
+    CalculatorGraph graph;
+    if (use_cache) {
+      auto validated_graph = cache.GetOrCreate(config);
+      CHECK(validated_graph.ok());
+      CHECK(graph.Initialize(*validated_graph).ok());
+    } else {
+      CHECK(graph.Initialize(config).ok());
+    }
+  }
+}
+BENCHMARK(BM_InitializeGraph)->Arg(0)->Arg(1);
+
+}  // namespace
+}  // namespace mediapipe
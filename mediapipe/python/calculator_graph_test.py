@@ -16,6 +16,7 @@
 
 # Dependency imports
 
+import asyncio
 from absl.testing import absltest
 import mediapipe as mp
 from google.protobuf import text_format
@@ -239,5 +240,115 @@ class GraphTest(absltest.TestCase):
       self.assertEqual(mp.packet_getter.get_str(out[i]), 'hello world')
 
 
+  def test_add_packets_to_input_stream(self):
+    text_config = """
+      input_stream: 'in'
+      output_stream: 'out'
+      node {
+        calculator: 'PassThroughCalculator'
+        input_stream: 'in'
+        output_stream: 'out'
+      }
+    """
+    out = []
+    graph = mp.CalculatorGraph(graph_config=text_config)
+    graph.observe_output_stream('out', lambda _, packet: out.append(packet))
+    graph.start_run()
+    graph.add_packets_to_input_stream(
+        stream='in',
+        packets=[mp.packet_creator.create_int(i).at(i) for i in range(10)])
+    graph.add_packets_to_input_stream(stream='in', packets=[])
+    with self.assertRaisesRegex(ValueError, 'can\'t be the timestamp'):
+      graph.add_packets_to_input_stream(
+          stream='in', packets=[mp.packet_creator.create_int(10)])
+    graph.close()
+    self.assertFalse(graph.has_error())
+    self.assertEqual([packet.timestamp for packet in out], list(range(10)))
+    self.assertEqual([mp.packet_getter.get_int(packet) for packet in out],
+                     list(range(10)))
+
+  def test_output_stream_poller(self):
+    text_config = """
+      max_queue_size: 1
+      input_stream: 'in'
+      output_stream: 'out'
+      node {
+        calculator: 'PassThroughCalculator'
+        input_stream: 'in'
+        output_stream: 'out'
+      }
+    """
+    graph = mp.CalculatorGraph(graph_config=text_config)
+    poller = graph.add_output_stream_poller('out')
+    graph.start_run()
+    graph.add_packets_to_input_stream(
+        stream='in',
+        packets=[mp.packet_creator.create_int(i).at(i) for i in range(10)])
+    graph.wait_until_idle()
+    self.assertEqual(poller.queue_size, 10)
+    packets = poller.get_packets(max_packets=4)
+    self.assertEqual([packet.timestamp for packet in packets], [0, 1, 2, 3])
+    graph.close_all_packet_sources()
+    packets = poller.get_packets()
+    self.assertEqual([packet.timestamp for packet in packets],
+                     [4, 5, 6, 7, 8, 9])
+    # The stream is done.
+    self.assertEmpty(poller.get_packets())
+    graph.wait_until_done()
+    self.assertFalse(graph.has_error())
+
+  def test_output_stream_poller_async(self):
+    text_config = """
+      input_stream: 'in'
+      output_stream: 'out'
+      node {
+        calculator: 'PassThroughCalculator'
+        input_stream: 'in'
+        output_stream: 'out'
+      }
+    """
+    graph = mp.CalculatorGraph(graph_config=text_config)
+    poller = graph.add_output_stream_poller('out')
+    graph.start_run()
+
+    async def get_values():
+      values = []
+      while True:
+        packets = await poller.get_packets_async()
+        if not packets:
+          return values
+        values.extend(mp.packet_getter.get_int(packet) for packet in packets)
+
+    async def add_packets_and_get_values():
+      values = asyncio.ensure_future(get_values())
+      for i in range(100):
+        graph.add_packet_to_input_stream(
+            stream='in', packet=mp.packet_creator.create_int(i), timestamp=i)
+        await asyncio.sleep(0)
+      graph.close_all_packet_sources()
+      return await values
+
+    self.assertEqual(
+        asyncio.run(add_packets_and_get_values()), list(range(100)))
+    graph.wait_until_done()
+    self.assertFalse(graph.has_error())
+
+  def test_output_stream_poller_invalid_arguments(self):
+    graph = mp.CalculatorGraph(graph_config="""
+      input_stream: 'in'
+      output_stream: 'out'
+      node {
+        calculator: 'PassThroughCalculator'
+        input_stream: 'in'
+        output_stream: 'out'
+      }
+    """)
+    with self.assertRaisesRegex(RuntimeError, 'doesn\'t exist'):
+      graph.add_output_stream_poller('no_such_stream')
+    with self.assertRaises(ValueError):
+      graph.add_output_stream_poller('out', max_queue_size=-2)
+    with self.assertRaises(ValueError):
+      graph.add_output_stream_poller('out', max_queue_size=0)
+
 if __name__ == '__main__':
   absltest.main()
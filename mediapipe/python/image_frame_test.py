@@ -166,8 +166,9 @@ class ImageFrameTest(absltest.TestCase):
     self.assertEqual(sys.getrefcount(image_frame), initial_ref_count)
 
   # For image frames that store non contiguous data, the output of numpy_view()
-  # stores a copy of the pixel data of the image frame object. The life cycle of
-  # the data array doesn't tie to the image frame object.
+  # also points to the pixel data of the original ImageFrame object, with the
+  # row stride of the padded data. The life cycle of the data array should tie
+  # to the ImageFrame object.
   def test_image_frame_numpy_view_with_non_contiguous_data(self):
     w, h = 641, 481
     mat = np.random.randint(2**8 - 1, size=(h, w, 3), dtype=np.uint8)
@@ -176,11 +177,34 @@ class ImageFrameTest(absltest.TestCase):
     initial_ref_count = sys.getrefcount(image_frame)
     self.assertTrue(np.array_equal(mat, image_frame.numpy_view()))
     np_view = image_frame.numpy_view()
-    self.assertEqual(sys.getrefcount(image_frame), initial_ref_count)
+    self.assertFalse(np_view.flags.c_contiguous)
+    self.assertFalse(np_view.flags.writeable)
+    self.assertGreater(np_view.strides[0], w * 3)
+    self.assertEqual(sys.getrefcount(image_frame), initial_ref_count + 1)
     del np_view
     gc.collect()
     self.assertEqual(sys.getrefcount(image_frame), initial_ref_count)
 
+  def test_image_frame_from_padded_rows(self):
+    w, h, offset = 64, 48, 5
+    mat = np.random.randint(2**8 - 1, size=(h, w, 3), dtype=np.uint8)
+    cropped_mat = mat[offset:-offset, offset:-offset, :]
+    self.assertFalse(cropped_mat.flags.c_contiguous)
+    image_frame = mp.ImageFrame(
+        image_format=mp.ImageFormat.SRGB, data=cropped_mat)
+    self.assertTrue(np.array_equal(cropped_mat, image_frame.numpy_view()))
+    # The data is copied, even though the pixel data of each row is contiguous.
+    self.assertFalse(np.shares_memory(mat, image_frame.numpy_view()))
+    gray_mat = np.random.randint(2**8 - 1, size=(h, w), dtype=np.uint8)
+    image_frame = mp.ImageFrame(
+        image_format=mp.ImageFormat.GRAY8, data=gray_mat[:, offset:-offset])
+    self.assertTrue(
+        np.array_equal(gray_mat[:, offset:-offset], image_frame.numpy_view()))
+    # Arrays whose pixels are not stored contiguously are copied as well.
+    image_frame = mp.ImageFrame(
+        image_format=mp.ImageFormat.SRGB, data=mat[:, :, ::-1])
+    self.assertTrue(np.array_equal(mat[:, :, ::-1], image_frame.numpy_view()))
+
 
 if __name__ == '__main__':
   absltest.main()
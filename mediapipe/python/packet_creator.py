@@ -76,7 +76,12 @@ def create_image_frame(data: Union[image_frame.ImageFrame, np.ndarray],
 
   iii) Reference mode (dangerous)
   If copy is set to False, the data will be forced to be shared. If the data is
-  mutable (data.flags.writeable is True), a warning will be raised.
+  mutable (data.flags.writeable is True), a warning will be raised. The rows of
+  the data may be padded, e.g., when the data is a crop of a larger array, but
+  the pixels of each row must be stored contiguously.
+  The packet and every packet derived from it, including those held by the
+  graph, read the numpy array directly, so the array must not be modified
+  while any of them is alive.
 
   Args:
     data: A MediaPipe ImageFrame object or the raw pixel data that is
@@ -90,7 +95,8 @@ def create_image_frame(data: Union[image_frame.ImageFrame, np.ndarray],
   Raises:
     ValueError:
       i) When "data" is a numpy ndarray, "image_format" is not provided or
-        the "data" array is not c_contiguous in the reference mode.
+        the pixels of each row of the "data" array are not stored contiguously
+        in the reference mode.
       ii) When "data" is an ImageFrame object, the "image_format" arg doesn't
         match the image format of the "data" ImageFrame object or "copy" is
         explicitly set to False.
@@ -133,11 +139,8 @@ def create_image_frame(data: Union[image_frame.ImageFrame, np.ndarray],
     if copy is None:
       copy = True if data.flags.writeable else False
     if not copy:
-      # TODO: Investigate why the first 2 bytes of the data has data
-      # corruption when "data" is not c_contiguous.
-      if not data.flags.c_contiguous:
-        raise ValueError(
-            'Reference mode is unavailable if \'data\' is not c_contiguous.')
+      # The rows of "data" may be padded, e.g., when "data" is a crop of a
+      # larger array. Other layouts are rejected by the pixel data creator.
       if data.flags.writeable:
         warnings.warn(
             '\'data\' is still writeable. Taking a reference of the data to create ImageFrame packet is dangerous.',
@@ -174,7 +177,12 @@ def create_image(data: Union[image.Image, np.ndarray],
 
   iii) Reference mode (dangerous)
   If copy is set to False, the data will be forced to be shared. If the data is
-  mutable (data.flags.writeable is True), a warning will be raised.
+  mutable (data.flags.writeable is True), a warning will be raised. The rows of
+  the data may be padded, e.g., when the data is a crop of a larger array, but
+  the pixels of each row must be stored contiguously.
+  The packet and every packet derived from it, including those held by the
+  graph, read the numpy array directly, so the array must not be modified
+  while any of them is alive.
 
   Args:
     data: A MediaPipe Image object or the raw pixel data that is represnted as a
@@ -188,7 +196,8 @@ def create_image(data: Union[image.Image, np.ndarray],
   Raises:
     ValueError:
       i) When "data" is a numpy ndarray, "image_format" is not provided or
-        the "data" array is not c_contiguous in the reference mode.
+        the pixels of each row of the "data" array are not stored contiguously
+        in the reference mode.
       ii) When "data" is an Image object, the "image_format" arg doesn't
         match the image format of the "data" Image object or "copy" is
         explicitly set to False.
@@ -231,11 +240,8 @@ def create_image(data: Union[image.Image, np.ndarray],
     if copy is None:
       copy = True if data.flags.writeable else False
     if not copy:
-      # TODO: Investigate why the first 2 bytes of the data has data
-      # corruption when "data" is not c_contiguous.
-      if not data.flags.c_contiguous:
-        raise ValueError(
-            'Reference mode is unavailable if \'data\' is not c_contiguous.')
+      # The rows of "data" may be padded, e.g., when "data" is a crop of a
+      # larger array. Other layouts are rejected by the pixel data creator.
       if data.flags.writeable:
         warnings.warn(
             '\'data\' is still writeable. Taking a reference of the data to create Image packet is dangerous.',
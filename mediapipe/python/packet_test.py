@@ -16,7 +16,9 @@
 
 import gc
 import random
+import subprocess
 import sys
+import textwrap
 from absl.testing import absltest
 import mediapipe as mp
 import numpy as np
@@ -374,6 +376,101 @@ class PacketTest(absltest.TestCase):
     # copy mode.
     self.assertEqual(sys.getrefcount(rgb_data), initial_ref_count)
 
+  def test_image_frame_packet_reference_creation_with_cropping(self):
+    w, h, channels = random.randrange(40, 100), random.randrange(40, 100), 3
+    offset = 10
+    rgb_data = np.random.randint(255, size=(h, w, channels), dtype=np.uint8)
+    cropped_data = rgb_data[offset:-offset, offset:-offset, :]
+    cropped_data.flags.writeable = False
+    initial_ref_count = sys.getrefcount(cropped_data)
+    p = mp.packet_creator.create_image_frame(
+        image_format=mp.ImageFormat.SRGB, data=cropped_data)
+    # The padded rows of cropped_data are referred to, not copied.
+    self.assertEqual(sys.getrefcount(cropped_data), initial_ref_count + 1)
+    output_ndarray = mp.packet_getter.get_image_frame(p).numpy_view()
+    self.assertTrue(np.shares_memory(output_ndarray, rgb_data))
+    self.assertEqual(output_ndarray.strides, cropped_data.strides)
+    self.assertTrue(np.array_equal(output_ndarray, cropped_data))
+    del p
+    gc.collect()
+    # The numpy view keeps the packet and so the data alive.
+    self.assertEqual(sys.getrefcount(cropped_data), initial_ref_count + 1)
+    self.assertTrue(np.array_equal(output_ndarray, cropped_data))
+    del output_ndarray
+    gc.collect()
+    self.assertEqual(sys.getrefcount(cropped_data), initial_ref_count)
+    # Reference mode is unavailable if the pixels of each row are not stored
+    # contiguously.
+    with self.assertRaises(ValueError):
+      mp.packet_creator.create_image_frame(
+          image_format=mp.ImageFormat.SRGB, data=cropped_data[:, :, ::-1])
+
+  def test_image_frame_packet_reference_released_by_graph(self):
+    w, h, channels = random.randrange(3, 100), random.randrange(3, 100), 3
+    rgb_data = np.random.randint(255, size=(h, w, channels), dtype=np.uint8)
+    rgb_data.flags.writeable = False
+    initial_ref_count = sys.getrefcount(rgb_data)
+    text_config = """
+      input_stream: 'in'
+      output_stream: 'out'
+      node {
+        calculator: 'PassThroughCalculator'
+        input_stream: 'in'
+        output_stream: 'out'
+      }
+    """
+    out = []
+    graph = mp.CalculatorGraph(graph_config=text_config)
+    graph.observe_output_stream(
+        'out', lambda _, packet: out.append(
+            np.array(mp.packet_getter.get_image_frame(packet).numpy_view())))
+    graph.start_run()
+    for timestamp in range(10):
+      graph.add_packet_to_input_stream(
+          stream='in',
+          packet=mp.packet_creator.create_image_frame(
+              image_format=mp.ImageFormat.SRGB, data=rgb_data),
+          timestamp=timestamp)
+    graph.close()
+    self.assertFalse(graph.has_error())
+    self.assertLen(out, 10)
+    for output_ndarray in out:
+      self.assertTrue(np.array_equal(output_ndarray, rgb_data))
+    del graph
+    gc.collect()
+    # The graph threads released their packets, and with them the references
+    # to rgb_data, without holding the GIL.
+    self.assertEqual(sys.getrefcount(rgb_data), initial_ref_count)
+
+  def test_image_frame_packet_reference_outlives_interpreter(self):
+    # The graph still holds a reference mode packet when the interpreter shuts
+    # down, so its deleter runs while or after the interpreter finalizes.
+    script = textwrap.dedent("""
+        import mediapipe as mp
+        import numpy as np
+
+        data = np.zeros((32, 32, 3), dtype=np.uint8)
+        data.flags.writeable = False
+        graph = mp.CalculatorGraph(graph_config='''
+          input_stream: 'in'
+          node {
+            calculator: 'PassThroughCalculator'
+            input_stream: 'in'
+            output_stream: 'out'
+          }
+        ''')
+        graph.start_run()
+        graph.add_packet_to_input_stream(
+            stream='in',
+            packet=mp.packet_creator.create_image_frame(
+                image_format=mp.ImageFormat.SRGB, data=data),
+            timestamp=0)
+        """)
+    result = subprocess.run([sys.executable, '-c', script],
+                            capture_output=True,
+                            check=False)
+    self.assertEqual(result.returncode, 0, result.stderr)
+
   def test_image_packet_creation_copy_mode(self):
     w, h, channels = random.randrange(3, 100), random.randrange(3, 100), 3
     rgb_data = np.random.randint(255, size=(h, w, channels), dtype=np.uint8)
@@ -14,10 +14,14 @@
 
 #include "mediapipe/python/pybind/calculator_graph.h"
 
+#include <utility>
+#include <vector>
+
 #include "absl/memory/memory.h"
 #include "absl/strings/str_cat.h"
 #include "mediapipe/framework/calculator.pb.h"
 #include "mediapipe/framework/calculator_graph.h"
+#include "mediapipe/framework/output_stream_poller.h"
 #include "mediapipe/framework/packet.h"
 #include "mediapipe/framework/port/map_util.h"
 #include "mediapipe/framework/port/parse_text_proto.h"
@@ -61,6 +65,99 @@ void CalculatorGraphSubmodule(pybind11::module* module) {
       .value("ADD_IF_NOT_FULL", GraphInputStreamAddMode::ADD_IF_NOT_FULL)
       .export_values();
 
+  // Output Stream Poller
+  py::class_<OutputStreamPoller> output_stream_poller(
+      m, "OutputStreamPoller",
+      R"doc(A queue of the packets emitted by a graph output stream.
+
+  The graph worker threads add the packets to the queue without running any
+  Python code or acquiring the GIL, so that Python doesn't slow down the graph.
+  Python gets the packets in batches, either by blocking with the GIL released
+  or by awaiting them in asyncio. Use CalculatorGraph.add_output_stream_poller()
+  to create an OutputStreamPoller.)doc");
+
+  output_stream_poller.def(
+      "get_packets",
+      [](OutputStreamPoller* self, int max_packets) {
+        std::vector<Packet> packets;
+        py::gil_scoped_release gil_release;
+        Packet packet;
+        // Only the first packet is waited for.
+        while ((max_packets <= 0 ||
+                static_cast<int>(packets.size()) < max_packets) &&
+               (packets.empty() || self->QueueSize() > 0) &&
+               self->Next(&packet)) {
+          packets.push_back(std::move(packet));
+        }
+        return packets;
+      },
+      R"doc(Get the queued packets, waiting for one if the queue is empty.
+
+  The GIL is released while waiting. An empty list is returned when the output
+  stream is done or the graph encounters an error.
+
+  Args:
+    max_packets: The maximum number of packets to return, or 0 to return all
+      the queued packets.
+
+  Returns:
+    A list of packets by increasing timestamp.
+
+  Examples:
+    poller = graph.add_output_stream_poller('out')
+    graph.start_run()
+    graph.add_packet_to_input_stream(
+        stream='in', packet=packet_creator.create_int(0), timestamp=0)
+    graph.close_all_packet_sources()
+    while True:
+      packets = poller.get_packets()
+      if not packets:
+        break
+      values = [packet_getter.get_int(packet) for packet in packets]
+    graph.wait_until_done()
+)doc",
+      py::arg("max_packets") = 0);
+
+  output_stream_poller.def(
+      "get_packets_async",
+      [](py::object self, int max_packets) {
+        // Waits on a thread of the default executor of the running event loop.
+        py::object loop =
+            py::module::import("asyncio").attr("get_running_loop")();
+        return loop.attr("run_in_executor")(
+            py::none(), self.attr("get_packets"), max_packets);
+      },
+      R"doc(Return an asyncio future of the result of get_packets().
+
+  Must be called from a coroutine or callback of a running asyncio event loop.
+  The packets are waited for on a thread of the default executor of the loop.
+
+  Args:
+    max_packets: The maximum number of packets to return, or 0 to return all
+      the queued packets.
+
+  Returns:
+    An asyncio future of a list of packets by increasing timestamp, which is
+    empty when the output stream is done or the graph encounters an error.
+
+  Raises:
+    RuntimeError: If there is no running event loop.
+
+  Examples:
+    async def get_values(poller):
+      values = []
+      while True:
+        packets = await poller.get_packets_async()
+        if not packets:
+          return values
+        values.extend(packet_getter.get_int(packet) for packet in packets)
+)doc",
+      py::arg("max_packets") = 0);
+
+  output_stream_poller.def_property_readonly(
+      "queue_size", [](OutputStreamPoller* self) { return self->QueueSize(); },
+      R"doc(The number of packets in the queue.)doc");
+
   // Calculator Graph
   py::class_<CalculatorGraph> calculator_graph(
       m, "CalculatorGraph", R"doc(The primary API for the MediaPipe Framework.
@@ -207,10 +304,57 @@ void CalculatorGraphSubmodule(pybind11::module* module) {
       py::arg("stream"), py::arg("packet"),
       py::arg("timestamp") = Timestamp::Unset());
 
+  calculator_graph.def(
+      "add_packets_to_input_stream",
+      [](CalculatorGraph* self, const std::string& stream,
+         std::vector<Packet> packets) {
+        for (const Packet& packet : packets) {
+          if (!packet.Timestamp().IsAllowedInStream()) {
+            throw RaisePyError(
+                PyExc_ValueError,
+                absl::StrCat(packet.Timestamp().DebugString(),
+                             " can't be the timestamp of a Packet in a stream.")
+                    .c_str());
+          }
+        }
+        auto input_stream = self->GetGraphInputStreamHandle(stream);
+        RaisePyErrorIfNotOk(input_stream.status());
+        py::gil_scoped_release gil_release;
+        RaisePyErrorIfNotOk(input_stream->AddPackets(std::move(packets)),
+                            /**acquire_gil=*/true);
+      },
+      R"doc(Add a batch of packets to a graph input stream.
+
+  Same as calling add_packet_to_input_stream() on each packet, but the GIL is
+  released and the graph is notified only once for the whole batch. The packets
+  must have increasing timestamps. In the WAIT_TILL_NOT_FULL mode, the call
+  waits once before adding the batch, so that the queues may exceed the max
+  queue size by up to the batch size.
+
+  Args:
+    stream: The name of the graph input stream.
+    packets: A list of packets with timestamps.
+
+  Raises:
+    RuntimeError: If the stream is not a graph input stream or the packets can't
+      be added into the input stream due to the limited queue size or the wrong
+      packet type.
+    ValueError: If the timestamp of a Packet is invalid to be the timestamp of
+      a Packet in a stream.
+
+  Examples:
+    graph.add_packets_to_input_stream(
+        stream='in',
+        packets=[packet_creator.create_int(i).at(i) for i in range(10)])
+)doc",
+      py::arg("stream"), py::arg("packets"));
+
   calculator_graph.def(
       "close_input_stream",
       [](CalculatorGraph* self, const std::string& stream) {
-        RaisePyErrorIfNotOk(self->CloseInputStream(stream));
+        py::gil_scoped_release gil_release;
+        RaisePyErrorIfNotOk(self->CloseInputStream(stream),
+                            /**acquire_gil=*/true);
       },
       R"doc(Close the named graph input stream.
 
@@ -225,7 +369,9 @@ void CalculatorGraphSubmodule(pybind11::module* module) {
   calculator_graph.def(
       "close_all_packet_sources",
       [](CalculatorGraph* self) {
-        RaisePyErrorIfNotOk(self->CloseAllPacketSources());
+        py::gil_scoped_release gil_release;
+        RaisePyErrorIfNotOk(self->CloseAllPacketSources(),
+                            /**acquire_gil=*/true);
       },
       R"doc(Closes all the graph input streams and source calculator nodes.)doc");
 
@@ -238,7 +384,9 @@ void CalculatorGraphSubmodule(pybind11::module* module) {
                              kv_pair.first.cast<std::string>(),
                              kv_pair.second.cast<Packet>());
         }
-        RaisePyErrorIfNotOk(self->StartRun(input_side_packet_map));
+        py::gil_scoped_release gil_release;
+        RaisePyErrorIfNotOk(self->StartRun(input_side_packet_map),
+                            /**acquire_gil=*/true);
       },
 
       R"doc(Start a run of the calculator graph.
@@ -419,7 +567,10 @@ void CalculatorGraphSubmodule(pybind11::module* module) {
       R"doc(Observe the named output stream.
 
   callback_fn will be invoked on every packet emitted by the output stream.
-  This method can only be called before start_run().
+  This method can only be called before start_run(). The callbacks run on the
+  graph worker threads, which hold the GIL and a lock shared by all callbacks
+  while running them. Use add_output_stream_poller() instead to get the packets
+  without blocking the graph on Python.
 
   Args:
     stream_name: The name of the output stream.
@@ -442,11 +593,63 @@ void CalculatorGraphSubmodule(pybind11::module* module) {
       py::arg("stream_name"), py::arg("callback_fn"),
       py::arg("observe_timestamp_bounds") = false);
 
+  calculator_graph.def(
+      "add_output_stream_poller",
+      [](CalculatorGraph* self, const std::string& stream_name,
+         bool observe_timestamp_bounds, int max_queue_size) {
+        // A queue of size 0 would never accept a packet and stall the graph.
+        if (max_queue_size == 0 || max_queue_size < -1) {
+          throw RaisePyError(PyExc_ValueError,
+                             "max_queue_size must be either -1 or positive.");
+        }
+        auto status_or_poller =
+            self->AddOutputStreamPoller(stream_name, observe_timestamp_bounds);
+        RaisePyErrorIfNotOk(status_or_poller.status());
+        OutputStreamPoller poller = std::move(status_or_poller).value();
+        poller.SetMaxQueueSize(max_queue_size);
+        return poller;
+      },
+      R"doc(Queue the packets emitted by the named output stream.
+
+  The graph worker threads add the packets emitted by the output stream to the
+  returned OutputStreamPoller without acquiring the GIL, and Python gets them
+  from the poller in batches. This method can only be called before start_run().
+
+  Args:
+    stream_name: The name of the output stream.
+    observe_timestamp_bounds: If true, queues an empty packet at
+      timestamp_bound -1 when timestamp bound changes.
+    max_queue_size: The maximum number of packets in the queue, or -1 for no
+      limit. A full queue throttles the graph like a full input stream queue
+      until packets are taken from it.
+
+  Returns:
+    An OutputStreamPoller, which keeps the graph alive.
+
+  Raises:
+    RuntimeError: If the calculator graph isn't initialized or the stream
+      doesn't exist.
+    ValueError: If max_queue_size is 0 or less than -1.
+
+  Examples:
+    graph = mp.CalculatorGraph(graph_config=graph_config)
+    poller = graph.add_output_stream_poller('out')
+    graph.start_run()
+    graph.add_packets_to_input_stream(
+        stream='in',
+        packets=[packet_creator.create_int(i).at(i) for i in range(10)])
+    packets = poller.get_packets()
+
+)doc",
+      py::arg("stream_name"), py::arg("observe_timestamp_bounds") = false,
+      py::arg("max_queue_size") = -1, py::keep_alive<0, 1>());
+
   calculator_graph.def(
       "close",
       [](CalculatorGraph* self) {
-        RaisePyErrorIfNotOk(self->CloseAllPacketSources());
         py::gil_scoped_release gil_release;
+        RaisePyErrorIfNotOk(self->CloseAllPacketSources(),
+                            /**acquire_gil=*/true);
         RaisePyErrorIfNotOk(self->WaitUntilDone(), /**acquire_gil=*/true);
       },
       R"doc(Close all the input sources and shutdown the graph.)doc");
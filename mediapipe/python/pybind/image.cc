@@ -76,7 +76,7 @@ void ImageSubmodule(pybind11::module* module) {
   image
       .def(
           py::init([](mediapipe::ImageFormat::Format format,
-                      const py::array_t<uint8, py::array::c_style>& data) {
+                      const py::array_t<uint8>& data) {
             if (format != mediapipe::ImageFormat::GRAY8 &&
                 format != mediapipe::ImageFormat::SRGB &&
                 format != mediapipe::ImageFormat::SRGBA) {
@@ -91,7 +91,7 @@ void ImageSubmodule(pybind11::module* module) {
           py::arg("image_format"), py::arg("data").noconvert())
       .def(
           py::init([](mediapipe::ImageFormat::Format format,
-                      const py::array_t<uint16, py::array::c_style>& data) {
+                      const py::array_t<uint16>& data) {
             if (format != mediapipe::ImageFormat::GRAY16 &&
                 format != mediapipe::ImageFormat::SRGB48 &&
                 format != mediapipe::ImageFormat::SRGBA64) {
@@ -107,7 +107,7 @@ void ImageSubmodule(pybind11::module* module) {
           py::arg("image_format"), py::arg("data").noconvert())
       .def(
           py::init([](mediapipe::ImageFormat::Format format,
-                      const py::array_t<float, py::array::c_style>& data) {
+                      const py::array_t<float>& data) {
             if (format != mediapipe::ImageFormat::VEC32F1 &&
                 format != mediapipe::ImageFormat::VEC32F2) {
               throw RaisePyError(
@@ -126,27 +126,19 @@ void ImageSubmodule(pybind11::module* module) {
       [](Image& self) {
         py::object py_object =
             py::cast(self, py::return_value_policy::reference);
-        // If the image data is contiguous, generates the data pyarray object
-        // on demand because 1) making a pyarray by referring to the existing
-        // image pixel data is relatively cheap and 2) caching the pyarray
-        // object in an attribute of the image is problematic: the image object
-        // and the data pyarray object refer to each other, which causes gc
-        // fails to free the pyarray after use.
-        // For the non-contiguous cases, gets a cached data pyarray object from
-        // the image pyobject attribute. This optimization is to avoid the
-        // expensive data realignment and copy operations happening more than
-        // once.
-        return self.GetImageFrameSharedPtr()->IsContiguous()
-                   ? GenerateDataPyArrayOnDemand(*self.GetImageFrameSharedPtr(),
-                                                 py_object)
-                   : GetCachedContiguousDataAttr(*self.GetImageFrameSharedPtr(),
-                                                 py_object);
+        // The data pyarray object refers to the pixel data and keeps the image
+        // object alive. It isn't cached in an attribute of the image because
+        // they would refer to each other, which causes gc fails to free the
+        // pyarray after use.
+        return GenerateDataPyArray(*self.GetImageFrameSharedPtr(), py_object);
       },
       R"doc(Return the image pixel data as an unwritable numpy ndarray.
 
-  Realign the pixel data to be stored contiguously and return a reference to the
-  unwritable numpy ndarray. If the callers want to modify the numpy array data,
-  it's required to obtain a copy of the ndarray.
+  Return a reference to the pixel data as an unwritable numpy ndarray, without
+  copying it. If the rows of the pixel data are padded (see is_contiguous()),
+  the ndarray has the same row stride and is not c_contiguous. If the callers
+  want to modify the numpy array data, it's required to obtain a copy of the
+  ndarray.
 
   Returns:
     An unwritable numpy ndarray.
@@ -113,7 +113,7 @@ void ImageFrameSubmodule(pybind11::module* module) {
   image_frame
       .def(
           py::init([](mediapipe::ImageFormat::Format format,
-                      const py::array_t<uint8, py::array::c_style>& data) {
+                      const py::array_t<uint8>& data) {
             if (format != mediapipe::ImageFormat::GRAY8 &&
                 format != mediapipe::ImageFormat::SRGB &&
                 format != mediapipe::ImageFormat::SRGBA) {
@@ -127,7 +127,7 @@ void ImageFrameSubmodule(pybind11::module* module) {
           py::arg("image_format"), py::arg("data").noconvert())
       .def(
           py::init([](mediapipe::ImageFormat::Format format,
-                      const py::array_t<uint16, py::array::c_style>& data) {
+                      const py::array_t<uint16>& data) {
             if (format != mediapipe::ImageFormat::GRAY16 &&
                 format != mediapipe::ImageFormat::SRGB48 &&
                 format != mediapipe::ImageFormat::SRGBA64) {
@@ -142,7 +142,7 @@ void ImageFrameSubmodule(pybind11::module* module) {
           py::arg("image_format"), py::arg("data").noconvert())
       .def(
           py::init([](mediapipe::ImageFormat::Format format,
-                      const py::array_t<float, py::array::c_style>& data) {
+                      const py::array_t<float>& data) {
             if (format != mediapipe::ImageFormat::VEC32F1 &&
                 format != mediapipe::ImageFormat::VEC32F2) {
               throw RaisePyError(
@@ -160,25 +160,19 @@ void ImageFrameSubmodule(pybind11::module* module) {
       [](ImageFrame& self) {
         py::object py_object =
             py::cast(self, py::return_value_policy::reference);
-        // If the image frame data is contiguous, generates the data pyarray
-        // object on demand because 1) making a pyarray by referring to the
-        // existing image frame pixel data is relatively cheap and 2) caching
-        // the pyarray object in an attribute of the image frame is problematic:
-        // the image frame object and the data pyarray object refer to each
-        // other, which causes gc fails to free the pyarray after use.
-        // For the non-contiguous cases, gets a cached data pyarray object from
-        // the image frame pyobject attribute. This optimization is to avoid the
-        // expensive data realignment and copy operations happening more than
-        // once.
-        return self.IsContiguous()
-                   ? GenerateDataPyArrayOnDemand(self, py_object)
-                   : GetCachedContiguousDataAttr(self, py_object);
+        // The data pyarray object refers to the pixel data and keeps the
+        // image frame object alive. It isn't cached in an attribute of the
+        // image frame because they would refer to each other, which causes gc
+        // fails to free the pyarray after use.
+        return GenerateDataPyArray(self, py_object);
       },
       R"doc(Return the image frame pixel data as an unwritable numpy ndarray.
 
-  Realign the pixel data to be stored contiguously and return a reference to the
-  unwritable numpy ndarray. If the callers want to modify the numpy array data,
-  it's required to obtain a copy of the ndarray.
+  Return a reference to the pixel data as an unwritable numpy ndarray, without
+  copying it. If the rows of the pixel data are padded (see is_contiguous()),
+  the ndarray has the same row stride and is not c_contiguous. If the callers
+  want to modify the numpy array data, it's required to obtain a copy of the
+  ndarray.
 
   Returns:
     An unwritable numpy ndarray.
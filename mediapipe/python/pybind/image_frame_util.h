@@ -15,6 +15,9 @@
 #ifndef MEDIAPIPE_PYTHON_PYBIND_IMAGE_FRAME_UTIL_H_
 #define MEDIAPIPE_PYTHON_PYBIND_IMAGE_FRAME_UTIL_H_
 
+#include <memory>
+#include <vector>
+
 #include "absl/memory/memory.h"
 #include "absl/strings/str_cat.h"
 #include "mediapipe/framework/formats/image_format.pb.h"
@@ -29,18 +32,77 @@ namespace python {
 
 namespace py = pybind11;
 
+// Returns true if "data" stores T values and the pixels of each of its rows
+// are stored contiguously, so that an ImageFrame can refer to the array data
+// with the row stride of "data" as its width step. Arrays with padded rows,
+// such as crops of a larger image, qualify.
+template <typename T>
+bool HasContiguousRows(const py::array& data) {
+  if (!py::isinstance<py::array_t<T>>(data) || data.ndim() < 2 ||
+      data.ndim() > 3) {
+    return false;
+  }
+  py::ssize_t stride = sizeof(T);
+  for (int i = data.ndim() - 1; i > 0; --i) {
+    if (data.shape(i) > 1 && data.strides(i) != stride) {
+      return false;
+    }
+    stride *= data.shape(i);
+  }
+  return data.shape(0) <= 1 || data.strides(0) >= stride;
+}
+
+// Returns true if the interpreter is initialized and not shutting down, so
+// that a thread may acquire the GIL.
+inline bool IsPythonRunning() {
+#if PY_VERSION_HEX >= 0x030D0000
+  return Py_IsInitialized() && !Py_IsFinalizing();
+#else
+  return Py_IsInitialized() && !_Py_IsFinalizing();
+#endif  // PY_VERSION_HEX >= 0x030D0000
+}
+
+// Creates an ImageFrame from the pixel data of "data", a numpy array of shape
+// (height, width) or (height, width, channels).
+//
+// If "copy" is true, the data is copied into an ImageFrame that is aligned for
+// both GPU and CPU processing. Otherwise, the ImageFrame refers to the array
+// data, using the row stride of "data" as its width step, and holds a
+// reference to "data" until it is destroyed. The pixels of each row must then
+// be stored contiguously (see HasContiguousRows()), and the array must not be
+// modified while the ImageFrame, or any packet holding it, is alive. In the
+// copy mode, other arrays are first converted to a contiguous array of T
+// values.
 template <typename T>
 std::unique_ptr<ImageFrame> CreateImageFrame(
-    mediapipe::ImageFormat::Format format,
-    const py::array_t<T, py::array::c_style>& data, bool copy = true) {
-  int rows = data.shape()[0];
-  int cols = data.shape()[1];
-  int width_step = ImageFrame::NumberOfChannelsForFormat(format) *
-                   ImageFrame::ByteDepthForFormat(format) * cols;
+    mediapipe::ImageFormat::Format format, const py::array& data,
+    bool copy = true) {
+  if (!HasContiguousRows<T>(data)) {
+    if (!copy) {
+      throw RaisePyError(PyExc_ValueError,
+                         "Reference mode is unavailable if the pixels of each "
+                         "row of 'data' are not stored contiguously.");
+    }
+    auto contiguous_data =
+        py::array_t<T, py::array::c_style | py::array::forcecast>::ensure(
+            data);
+    if (!contiguous_data || !HasContiguousRows<T>(contiguous_data)) {
+      throw RaisePyError(PyExc_TypeError,
+                         "'data' can't be converted to the data type of the "
+                         "image format.");
+    }
+    return CreateImageFrame<T>(format, contiguous_data, copy);
+  }
+  const int rows = data.shape(0);
+  const int cols = data.shape(1);
+  const int row_size = ImageFrame::NumberOfChannelsForFormat(format) *
+                       ImageFrame::ByteDepthForFormat(format) * cols;
+  const int width_step = rows > 1 ? data.strides(0) : row_size;
+  // ImageFrame doesn't modify the pixel data it refers to.
+  uint8* pixel_data = static_cast<uint8*>(const_cast<void*>(data.data()));
   if (copy) {
     auto image_frame = absl::make_unique<ImageFrame>(
-        format, /*width=*/cols, /*height=*/rows, width_step,
-        static_cast<uint8*>(data.request().ptr),
+        format, /*width=*/cols, /*height=*/rows, width_step, pixel_data,
         ImageFrame::PixelDataDeleter::kNone);
     auto image_frame_copy = absl::make_unique<ImageFrame>();
     // Set alignment_boundary to kGlDefaultAlignmentBoundary so that both
@@ -50,59 +112,59 @@ std::unique_ptr<ImageFrame> CreateImageFrame(
     return image_frame_copy;
   }
   PyObject* data_pyobject = data.ptr();
-  auto image_frame = absl::make_unique<ImageFrame>(
-      format, /*width=*/cols, /*height=*/rows, width_step,
-      static_cast<uint8*>(data.request().ptr),
-      /*deleter=*/[data_pyobject](uint8*) { Py_XDECREF(data_pyobject); });
   Py_XINCREF(data_pyobject);
-  return image_frame;
+  return absl::make_unique<ImageFrame>(
+      format, /*width=*/cols, /*height=*/rows, width_step, pixel_data,
+      /*deleter=*/[data_pyobject](uint8*) {
+        // The last packet holding the ImageFrame may be released by a graph
+        // thread, which doesn't hold the GIL, possibly while or after the
+        // interpreter shuts down. The GIL can't be acquired then, and the
+        // array is freed with the interpreter anyway.
+        if (!IsPythonRunning()) {
+          return;
+        }
+        py::gil_scoped_acquire gil_acquire;
+        Py_XDECREF(data_pyobject);
+      });
 }
 
 template <typename T>
-py::array GenerateContiguousDataArrayHelper(const ImageFrame& image_frame,
-                                            const py::object& py_object) {
-  std::vector<int> shape{image_frame.Height(), image_frame.Width()};
+py::array GenerateDataPyArrayHelper(const ImageFrame& image_frame,
+                                    const py::object& py_object) {
+  std::vector<py::ssize_t> shape{image_frame.Height(), image_frame.Width()};
+  std::vector<py::ssize_t> strides{
+      image_frame.WidthStep(),
+      static_cast<py::ssize_t>(image_frame.NumberOfChannels() * sizeof(T))};
   if (image_frame.NumberOfChannels() > 1) {
     shape.push_back(image_frame.NumberOfChannels());
+    strides.push_back(sizeof(T));
   }
-  py::array_t<T, py::array::c_style> contiguous_data;
-  if (image_frame.IsContiguous()) {
-    contiguous_data = py::array_t<T, py::array::c_style>(
-        shape, reinterpret_cast<const T*>(image_frame.PixelData()), py_object);
-  } else {
-    auto contiguous_data_copy =
-        absl::make_unique<T[]>(image_frame.Width() * image_frame.Height() *
-                               image_frame.NumberOfChannels());
-    image_frame.CopyToBuffer(contiguous_data_copy.get(),
-                             image_frame.PixelDataSizeStoredContiguously());
-    auto capsule = py::capsule(contiguous_data_copy.get(), [](void* data) {
-      if (data) {
-        delete[] reinterpret_cast<T*>(data);
-      }
-    });
-    contiguous_data = py::array_t<T, py::array::c_style>(
-        shape, contiguous_data_copy.release(), capsule);
-  }
-
-  // In both cases, the underlying data is not writable in Python.
-  py::detail::array_proxy(contiguous_data.ptr())->flags &=
+  py::array_t<T> data(shape, strides,
+                      reinterpret_cast<const T*>(image_frame.PixelData()),
+                      py_object);
+  // The underlying data is not writable in Python.
+  py::detail::array_proxy(data.ptr())->flags &=
       ~py::detail::npy_api::NPY_ARRAY_WRITEABLE_;
-  return contiguous_data;
+  return data;
 }
 
-inline py::array GenerateContiguousDataArray(const ImageFrame& image_frame,
-                                             const py::object& py_object) {
+// Generates a numpy array that refers to the pixel data of "image_frame" and
+// holds a reference to "py_object", which must keep "image_frame" alive.
+// Nothing is copied: if the rows of the image frame are padded, the array has
+// the same row stride (numpy strides) as the image frame and is not
+// c_contiguous.
+inline py::array GenerateDataPyArray(const ImageFrame& image_frame,
+                                     const py::object& py_object) {
+  if (image_frame.IsEmpty()) {
+    throw RaisePyError(PyExc_RuntimeError, "ImageFrame is unallocated.");
+  }
   switch (image_frame.ChannelSize()) {
     case sizeof(uint8):
-      return GenerateContiguousDataArrayHelper<uint8>(image_frame, py_object)
-          .cast<py::array>();
+      return GenerateDataPyArrayHelper<uint8>(image_frame, py_object);
     case sizeof(uint16):
-      return GenerateContiguousDataArrayHelper<uint16>(image_frame, py_object)
-          .cast<py::array>();
+      return GenerateDataPyArrayHelper<uint16>(image_frame, py_object);
     case sizeof(float):
-      return GenerateContiguousDataArrayHelper<float>(image_frame, py_object)
-          .cast<py::array>();
-      break;
+      return GenerateDataPyArrayHelper<float>(image_frame, py_object);
     default:
       throw RaisePyError(PyExc_RuntimeError,
                          "Unsupported image frame channel size. Data is not "
@@ -110,55 +172,10 @@ inline py::array GenerateContiguousDataArray(const ImageFrame& image_frame,
   }
 }
 
-// Generates a contiguous data pyarray object on demand.
-// This function only accepts an image frame object that already stores
-// contiguous data. The output py::array points to the raw pixel data array of
-// the image frame object directly.
-inline py::array GenerateDataPyArrayOnDemand(const ImageFrame& image_frame,
-                                             const py::object& py_object) {
-  if (!image_frame.IsContiguous()) {
-    throw RaisePyError(PyExc_RuntimeError,
-                       "GenerateDataPyArrayOnDemand must take an ImageFrame "
-                       "object that stores contiguous data.");
-  }
-  return GenerateContiguousDataArray(image_frame, py_object);
-}
-
-// Gets the cached contiguous data array from the "__contiguous_data" attribute.
-// If the attribute doesn't exist, the function calls
-// GenerateContiguousDataArray() to generate the contiguous data pyarray object,
-// which realigns and copies the data from the original image frame object.
-// Then, the data array object is cached in the "__contiguous_data" attribute.
-// This function only accepts an image frame object that stores non-contiguous
-// data.
-inline py::array GetCachedContiguousDataAttr(const ImageFrame& image_frame,
-                                             const py::object& py_object) {
-  if (image_frame.IsContiguous()) {
-    throw RaisePyError(PyExc_RuntimeError,
-                       "GetCachedContiguousDataAttr must take an ImageFrame "
-                       "object that stores non-contiguous data.");
-  }
-  py::object get_data_attr =
-      py::getattr(py_object, "__contiguous_data", py::none());
-  if (image_frame.IsEmpty()) {
-    throw RaisePyError(PyExc_RuntimeError, "ImageFrame is unallocated.");
-  }
-  // If __contiguous_data attr doesn't store data yet, generates the contiguous
-  // data array object and caches the result.
-  if (get_data_attr.is_none()) {
-    py_object.attr("__contiguous_data") =
-        GenerateContiguousDataArray(image_frame, py_object);
-  }
-  return py_object.attr("__contiguous_data").cast<py::array>();
-}
-
 template <typename T>
 py::object GetValue(const ImageFrame& image_frame, const std::vector<int>& pos,
                     const py::object& py_object) {
-  py::array_t<T, py::array::c_style> output_array =
-      image_frame.IsContiguous()
-          ? GenerateDataPyArrayOnDemand(image_frame, py_object)
-          : GetCachedContiguousDataAttr(image_frame, py_object);
+  py::array_t<T> output_array = GenerateDataPyArray(image_frame, py_object);
   if (pos.size() == 2) {
     return py::cast(static_cast<T>(output_array.at(pos[0], pos[1])));
   } else if (pos.size() == 3) {
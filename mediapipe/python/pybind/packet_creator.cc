@@ -578,9 +578,10 @@ void PublicPacketCreators(pybind11::module* m) {
       // TODO: Should take "const Eigen::Ref<const Eigen::MatrixXf>&"
       // as the input argument. Investigate why bazel non-optimized mode
       // triggers a memory allocation bug in Eigen::internal::aligned_free().
-      [](const Eigen::MatrixXf& matrix) {
-        // MakePacket copies the data.
-        return MakePacket<Matrix>(matrix);
+      // The numpy ndarray is converted into the MatrixXf argument, which is
+      // then moved into the packet so that the data is only copied once.
+      [](Eigen::MatrixXf matrix) {
+        return MakePacket<Matrix>(std::move(matrix));
       },
       R"doc(Create a MediaPipe Matrix Packet from a 2d numpy float ndarray.
 
@@ -300,7 +300,13 @@ class SolutionBase:
     Returns:
       A NamedTuple object that contains the output data of a graph run.
         The field names in the NamedTuple object are mapping to the graph output
-        stream names.
+        stream names. Output images are unwritable numpy ndarrays that refer to
+        the pixel data of the output packets without copying it.
+
+    Image data is copied into the graph unless it's marked as not writeable
+    (image.flags.writeable = False), in which case it's passed by reference.
+    The rows of the image data may be padded, e.g., when the image is a crop of
+    a larger array, but the pixels of each row must be stored contiguously.
 
     Examples:
       solution = solution_base.SolutionBase(graph_config=hand_landmark_graph)
@@ -0,0 +1,92 @@
+# Copyright 2022 The MediaPipe Authors.
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#      http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+
+"""Measures the frame rate of SolutionBase.process() on RGB images.
+
+The graph passes the images through, so that the frame rate is bound by the
+cost of exchanging the pixel data between numpy and MediaPipe. Writeable images
+are copied into the graph, while images marked as not writeable are passed by
+reference, including crops of larger images whose rows are padded.
+
+Example:
+  $ python3 -m mediapipe.python.solution_base_benchmark --width=1920 \
+      --height=1080
+"""
+
+import time
+
+from absl import app
+from absl import flags
+import numpy as np
+
+from google.protobuf import text_format
+from mediapipe.framework import calculator_pb2
+from mediapipe.python import solution_base
+from mediapipe.python.solution_base import PacketDataType
+
+_WIDTH = flags.DEFINE_integer('width', 1280, 'Width of the input images.')
+_HEIGHT = flags.DEFINE_integer('height', 720, 'Height of the input images.')
+_NUM_FRAMES = flags.DEFINE_integer('num_frames', 300,
+                                   'Number of frames processed per mode.')
+
+_PASS_THROUGH_GRAPH_CONFIG = """
+  input_stream: 'image_in'
+  output_stream: 'image_out'
+  node {
+    calculator: 'PassThroughCalculator'
+    input_stream: 'image_in'
+    output_stream: 'image_out'
+  }
+"""
+
+
+def _frames_per_second(image: np.ndarray, num_frames: int) -> float:
+  """Returns the frame rate of processing "image" "num_frames" times."""
+  config_proto = text_format.Parse(_PASS_THROUGH_GRAPH_CONFIG,
+                                   calculator_pb2.CalculatorGraphConfig())
+  with solution_base.SolutionBase(
+      graph_config=config_proto,
+      stream_type_hints={
+          'image_in': PacketDataType.IMAGE_FRAME,
+          'image_out': PacketDataType.IMAGE_FRAME
+      }) as solution:
+    # Warms up the graph.
+    solution.process(image)
+    start_time = time.perf_counter()
+    for _ in range(num_frames):
+      output_image = solution.process(image).image_out
+      # Reads one pixel, as a caller would at least do.
+      _ = output_image[0, 0, 0]
+    return num_frames / (time.perf_counter() - start_time)
+
+
+def main(argv):
+  if len(argv) > 1:
+    raise app.UsageError('Too many command-line arguments.')
+  width, height = _WIDTH.value, _HEIGHT.value
+  image = np.random.randint(255, size=(height, width, 3), dtype=np.uint8)
+  read_only_image = image.copy()
+  read_only_image.flags.writeable = False
+  padded_image = np.random.randint(
+      255, size=(height + 2, width + 2, 3), dtype=np.uint8)
+  cropped_image = padded_image[1:-1, 1:-1, :]
+  cropped_image.flags.writeable = False
+  for mode, mode_image in (('copy', image), ('reference', read_only_image),
+                           ('reference with padded rows', cropped_image)):
+    print(f'{width}x{height} {mode}: '
+          f'{_frames_per_second(mode_image, _NUM_FRAMES.value):.1f} fps')
+
+
+if __name__ == '__main__':
+  app.run(main)
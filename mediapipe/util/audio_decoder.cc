@@ -74,6 +74,8 @@ float Uint32ToFloat(uint32 raw_value) {
   return value;
 }
 
+}  // namespace
+
 std::string AvErrorToString(int error) {
   if (error >= 0) {
     return absl::StrCat("Not an error (", error, ")");
@@ -151,6 +153,16 @@ std::string AvErrorToString(int error) {
   return absl::StrCat("Unknown AVERROR number ", error);
 }
 
+void AVPacketDeleter::operator()(void* x) const {
+  AVPacket* packet = static_cast<AVPacket*>(x);
+  if (packet) {
+    av_free_packet(packet);
+    delete packet;
+  }
+}
+
+namespace {
+
 // Send a packet to the decoder.
 absl::Status SendPacket(const AVPacket& packet, AVCodecContext* avcodec_ctx) {
   const int error = avcodec_send_packet(avcodec_ctx, &packet);
@@ -203,17 +215,6 @@ absl::Status LogStatus(const absl::Status& status,
   }
 }
 
-class AVPacketDeleter {
- public:
-  void operator()(void* x) const {
-    AVPacket* packet = static_cast<AVPacket*>(x);
-    if (packet) {
-      av_free_packet(packet);
-      delete packet;
-    }
-  }
-};
-
 }  // namespace
 
 BasePacketProcessor::BasePacketProcessor()
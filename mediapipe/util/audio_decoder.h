@@ -42,6 +42,15 @@ namespace mediapipe {
 using mediapipe::AudioStreamOptions;
 using mediapipe::TimeSeriesHeader;
 
+// Returns a description of the libav error code "error".
+std::string AvErrorToString(int error);
+
+// Frees an AVPacket allocated with new and initialized with av_init_packet().
+class AVPacketDeleter {
+ public:
+  void operator()(void* x) const;
+};
+
 // The base helper class for a processor which handles decoding of a single
 // stream.
 class BasePacketProcessor {
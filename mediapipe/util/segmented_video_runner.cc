@@ -0,0 +1,246 @@
+// Copyright 2022 The MediaPipe Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "mediapipe/util/segmented_video_runner.h"
+
+#include <algorithm>
+#include <deque>
+#include <utility>
+
+#include "absl/memory/memory.h"
+#include "mediapipe/framework/port/ret_check.h"
+#include "mediapipe/framework/port/status.h"
+#include "mediapipe/framework/port/status_macros.h"
+#include "mediapipe/util/cpu_util.h"
+#include "mediapipe/util/video_decoder.h"
+
+namespace mediapipe {
+
+namespace {
+
+// Returns true if the packet at "timestamp" output by the graph of "segment"
+// is part of the stitched output.
+bool IsInSegment(const VideoSegment& segment, Timestamp timestamp,
+                 bool is_first, bool is_last) {
+  if (timestamp == Timestamp::PreStream()) {
+    return is_first;
+  }
+  if (timestamp == Timestamp::PostStream()) {
+    return is_last;
+  }
+  return timestamp >= segment.start &&
+         (segment.end == Timestamp::Max() || timestamp < segment.end);
+}
+
+}  // namespace
+
+std::vector<VideoSegment> SplitVideoAtKeyframes(
+    const std::vector<Timestamp>& keyframes, Timestamp end, int num_segments,
+    absl::Duration overlap) {
+  std::vector<VideoSegment> segments(1);
+  if (keyframes.empty() || num_segments <= 1 || end <= keyframes.front()) {
+    return segments;
+  }
+  const Timestamp first = keyframes.front();
+  const int64 length = (end - first).Value();
+  for (int i = 1; i < num_segments; ++i) {
+    // The keyframe closest to the i-th of "num_segments" equal parts.
+    const Timestamp target =
+        first + TimestampDiff(length / num_segments * i +
+                              length % num_segments * i / num_segments);
+    auto it = std::lower_bound(keyframes.begin(), keyframes.end(), target);
+    if (it == keyframes.end() ||
+        (it != keyframes.begin() && target - *(it - 1) < *it - target)) {
+      --it;
+    }
+    if (*it <= first || *it <= segments.back().start) {
+      continue;
+    }
+    segments.back().end = *it;
+    VideoSegment segment;
+    segment.start = *it;
+    segment.decode_start =
+        *it - TimestampDiff(absl::ToInt64Microseconds(overlap));
+    if (segment.decode_start <= first) {
+      segment.decode_start = Timestamp::Min();
+    }
+    segments.push_back(segment);
+  }
+  return segments;
+}
+
+VideoDecoderOptions SegmentDecoderOptions(const VideoSegment& segment,
+                                          int64 stream_index) {
+  VideoDecoderOptions options;
+  options.set_stream_index(stream_index);
+  if (segment.decode_start != Timestamp::Min()) {
+    options.set_start_time(segment.decode_start.Seconds());
+  }
+  // The decoder's end time is inclusive, the frame at segment.end is dropped
+  // when stitching.
+  if (segment.end != Timestamp::Max()) {
+    options.set_end_time(segment.end.Seconds());
+  }
+  return options;
+}
+
+struct SegmentedVideoRunner::SegmentRun {
+  VideoSegment segment;
+  CalculatorGraph graph;
+  // The pollers of options_.output_streams.
+  std::vector<OutputStreamPoller> pollers;
+};
+
+SegmentedVideoRunner::SegmentedVideoRunner(
+    const SegmentedVideoRunnerOptions& options)
+    : options_(options) {}
+
+absl::Status SegmentedVideoRunner::Run(
+    const CalculatorGraphConfig& config, const std::string& video_path,
+    const std::map<std::string, Packet>& side_packets,
+    const PacketCallback& callback) {
+  ASSIGN_OR_RETURN(VideoKeyframes keyframes,
+                   ReadVideoKeyframes(video_path, options_.stream_index));
+  const int num_segments =
+      options_.num_segments > 0 ? options_.num_segments : NumCPUCores();
+  std::vector<VideoSegment> segments = SplitVideoAtKeyframes(
+      keyframes.timestamps, keyframes.end, num_segments, options_.overlap);
+  VLOG(1) << "Split " << video_path << " with "
+          << keyframes.timestamps.size() << " keyframes into "
+          << segments.size() << " segments.";
+
+  std::map<std::string, Packet> segment_side_packets = side_packets;
+  segment_side_packets[options_.input_path_side_packet] =
+      MakePacket<std::string>(video_path);
+  return RunSegments(config, segments, segment_side_packets, callback);
+}
+
+absl::Status SegmentedVideoRunner::RunSegments(
+    const CalculatorGraphConfig& config,
+    const std::vector<VideoSegment>& segments,
+    const std::map<std::string, Packet>& side_packets,
+    const PacketCallback& callback) {
+  RET_CHECK(!segments.empty());
+  RET_CHECK(options_.max_queued_packets == -1 ||
+            options_.max_queued_packets > 0);
+  // The config is validated once for all the graphs.
+  auto validated_graph = std::make_shared<ValidatedGraphConfig>();
+  MP_RETURN_IF_ERROR(validated_graph->Initialize(config));
+
+  const int num_segments = segments.size();
+  const int max_parallel_graphs = options_.max_parallel_graphs > 0
+                                      ? options_.max_parallel_graphs
+                                      : num_segments;
+  // The graphs started and not yet stitched, in segment order.
+  std::deque<std::unique_ptr<SegmentRun>> runs;
+  auto cancel_runs = [&runs]() {
+    for (auto& run : runs) {
+      run->graph.Cancel();
+      run->graph.WaitUntilDone().IgnoreError();
+    }
+  };
+  int next_segment = 0;
+  for (int i = 0; i < num_segments; ++i) {
+    // The later segments run while the outputs of segment i are stitched,
+    // their outputs wait in the bounded queues of their pollers.
+    while (next_segment < num_segments &&
+           static_cast<int>(runs.size()) < max_parallel_graphs) {
+      auto run_or =
+          StartSegment(validated_graph, segments[next_segment], side_packets);
+      if (!run_or.ok()) {
+        cancel_runs();
+        return run_or.status();
+      }
+      runs.push_back(std::move(run_or).value());
+      ++next_segment;
+    }
+    std::unique_ptr<SegmentRun> run = std::move(runs.front());
+    runs.pop_front();
+    absl::Status status = StitchSegment(run.get(), /*is_first=*/i == 0,
+                                        /*is_last=*/i == num_segments - 1,
+                                        callback);
+    if (!status.ok()) {
+      cancel_runs();
+      return status;
+    }
+  }
+  return absl::OkStatus();
+}
+
+absl::StatusOr<std::unique_ptr<SegmentedVideoRunner::SegmentRun>>
+SegmentedVideoRunner::StartSegment(
+    std::shared_ptr<const ValidatedGraphConfig> validated_graph,
+    const VideoSegment& segment,
+    const std::map<std::string, Packet>& side_packets) {
+  auto run = absl::make_unique<SegmentRun>();
+  run->segment = segment;
+  MP_RETURN_IF_ERROR(run->graph.Initialize(std::move(validated_graph)));
+  for (const std::string& stream : options_.output_streams) {
+    ASSIGN_OR_RETURN(OutputStreamPoller poller,
+                     run->graph.AddOutputStreamPoller(stream));
+    poller.SetMaxQueueSize(options_.max_queued_packets);
+    run->pollers.push_back(std::move(poller));
+  }
+  std::map<std::string, Packet> segment_side_packets = side_packets;
+  segment_side_packets[options_.decoder_options_side_packet] =
+      MakePacket<VideoDecoderOptions>(
+          SegmentDecoderOptions(segment, options_.stream_index));
+  MP_RETURN_IF_ERROR(run->graph.StartRun(segment_side_packets));
+  return run;
+}
+
+absl::Status SegmentedVideoRunner::StitchSegment(
+    SegmentRun* run, bool is_first, bool is_last,
+    const PacketCallback& callback) {
+  // The graph runs unthrottled while its outputs are consumed, since waiting
+  // for the next packet of one stream while another stream is full would
+  // deadlock.
+  for (OutputStreamPoller& poller : run->pollers) {
+    poller.SetMaxQueueSize(-1);
+  }
+  // Merges the output streams in timestamp order, holding the next packet of
+  // each stream until the stream is done.
+  const int num_streams = run->pollers.size();
+  std::vector<Packet> next_packets(num_streams);
+  std::vector<bool> is_open(num_streams);
+  for (int i = 0; i < num_streams; ++i) {
+    is_open[i] = run->pollers[i].Next(&next_packets[i]);
+  }
+  while (true) {
+    int next = -1;
+    for (int i = 0; i < num_streams; ++i) {
+      if (is_open[i] &&
+          (next < 0 ||
+           next_packets[i].Timestamp() < next_packets[next].Timestamp())) {
+        next = i;
+      }
+    }
+    if (next < 0) {
+      break;
+    }
+    if (IsInSegment(run->segment, next_packets[next].Timestamp(), is_first,
+                    is_last)) {
+      absl::Status status = callback(next, next_packets[next]);
+      if (!status.ok()) {
+        run->graph.Cancel();
+        run->graph.WaitUntilDone().IgnoreError();
+        return status;
+      }
+    }
+    is_open[next] = run->pollers[next].Next(&next_packets[next]);
+  }
+  return run->graph.WaitUntilDone();
+}
+
+}  // namespace mediapipe
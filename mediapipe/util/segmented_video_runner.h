@@ -0,0 +1,168 @@
+// Copyright 2022 The MediaPipe Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef MEDIAPIPE_UTIL_SEGMENTED_VIDEO_RUNNER_H_
+#define MEDIAPIPE_UTIL_SEGMENTED_VIDEO_RUNNER_H_
+
+#include <functional>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "absl/time/time.h"
+#include "mediapipe/framework/calculator_framework.h"
+#include "mediapipe/framework/port/integral_types.h"
+#include "mediapipe/framework/port/status.h"
+#include "mediapipe/framework/validated_graph_config.h"
+#include "mediapipe/util/video_decoder.pb.h"
+
+namespace mediapipe {
+
+// A time range of a video processed by one graph.
+struct VideoSegment {
+  // The range [start, end) of the timestamps output for the segment.
+  // Timestamp::Min() and Timestamp::Max() leave the range open.
+  Timestamp start = Timestamp::Min();
+  Timestamp end = Timestamp::Max();
+  // The first decoded timestamp, which precedes "start" by the overlap.
+  Timestamp decode_start = Timestamp::Min();
+};
+
+// Splits a video into at most "num_segments" segments of similar durations,
+// each starting at a keyframe. "keyframes" are the timestamps of the
+// keyframes in increasing order, and "end" is the end of the video. Each
+// segment but the first is decoded from "overlap" before its start.
+std::vector<VideoSegment> SplitVideoAtKeyframes(
+    const std::vector<Timestamp>& keyframes, Timestamp end, int num_segments,
+    absl::Duration overlap);
+
+// Returns the VideoDecoderOptions decoding "segment" of the video stream
+// "stream_index".
+VideoDecoderOptions SegmentDecoderOptions(const VideoSegment& segment,
+                                          int64 stream_index);
+
+struct SegmentedVideoRunnerOptions {
+  // The number of segments the video is split into. 0 uses one segment per
+  // CPU core.
+  int num_segments = 0;
+
+  // The maximum number of graphs running at the same time. 0 runs the graphs
+  // of all the segments at once.
+  int max_parallel_graphs = 0;
+
+  // The time decoded before the start of each segment but the first, for the
+  // calculators whose outputs depend on earlier frames. Outputs within the
+  // overlap are discarded.
+  absl::Duration overlap = absl::ZeroDuration();
+
+  // The maximum number of packets queued by each output stream of a graph
+  // whose segment waits to be stitched. A full queue throttles the graph until
+  // its segment is stitched, which bounds the packets held by the waiting
+  // graphs to about max_parallel_graphs * output_streams.size() *
+  // max_queued_packets, plus the packets queued within the graphs. The queues
+  // of the segment being stitched are unbounded, so that a sparse output
+  // stream can't stall it. -1 leaves all the queues unbounded.
+  int max_queued_packets = 100;
+
+  // The video stream to split, counting only video streams.
+  int64 stream_index = 0;
+
+  // The input side packets receiving the path of the video (std::string) and
+  // the VideoDecoderOptions of the segment.
+  std::string input_path_side_packet = "input_video_path";
+  std::string decoder_options_side_packet = "decoder_options";
+
+  // The output streams whose packets are stitched back together.
+  std::vector<std::string> output_streams;
+};
+
+// Processes a video file with several instances of a CalculatorGraph running
+// in parallel. The video is split into keyframe-aligned segments, each
+// processed by its own graph, and the packets of the output streams of the
+// graphs are stitched back in timestamp order.
+//
+// The graph decodes its segment with an FFmpegVideoDecoderCalculator whose
+// OPTIONS are options.decoder_options_side_packet:
+//
+//   node {
+//     calculator: "FFmpegVideoDecoderCalculator"
+//     input_side_packet: "INPUT_FILE_PATH:input_video_path"
+//     input_side_packet: "OPTIONS:decoder_options"
+//     output_stream: "VIDEO:input_video"
+//   }
+//
+// Calculators whose outputs depend on earlier frames, such as trackers and
+// smoothing filters, start each segment in the state they reach after the
+// overlap instead of the state of a serial run. Their outputs match a serial
+// run if they depend on no more than the overlap.
+//
+// Every graph uses the executors of the config, so a config with num_threads
+// set to 1 or 2 keeps N parallel graphs from oversubscribing the cores.
+//
+// Example:
+//   SegmentedVideoRunnerOptions options;
+//   options.overlap = absl::Seconds(1);
+//   options.output_streams = {"face_detections"};
+//   SegmentedVideoRunner runner(options);
+//   MP_RETURN_IF_ERROR(runner.Run(config, "/path/to/video.mp4", {},
+//       [](int stream_index, const Packet& packet) {
+//         ...
+//         return absl::OkStatus();
+//       }));
+class SegmentedVideoRunner {
+ public:
+  // Receives the packets of options.output_streams[stream_index]. The packets
+  // of all the output streams are received in timestamp order, from the
+  // calling thread.
+  using PacketCallback =
+      std::function<absl::Status(int stream_index, const Packet& packet)>;
+
+  explicit SegmentedVideoRunner(const SegmentedVideoRunnerOptions& options);
+
+  // Splits the video at "video_path" into options.num_segments segments, and
+  // runs "config" on them. "side_packets" are passed to every graph.
+  absl::Status Run(const CalculatorGraphConfig& config,
+                   const std::string& video_path,
+                   const std::map<std::string, Packet>& side_packets,
+                   const PacketCallback& callback);
+
+  // Runs "config" on "segments", which must be ordered and must not overlap.
+  // The path of the video must be in "side_packets".
+  absl::Status RunSegments(const CalculatorGraphConfig& config,
+                           const std::vector<VideoSegment>& segments,
+                           const std::map<std::string, Packet>& side_packets,
+                           const PacketCallback& callback);
+
+ private:
+  // A graph processing a segment.
+  struct SegmentRun;
+
+  // Starts the graph processing "segment".
+  absl::StatusOr<std::unique_ptr<SegmentRun>> StartSegment(
+      std::shared_ptr<const ValidatedGraphConfig> validated_graph,
+      const VideoSegment& segment,
+      const std::map<std::string, Packet>& side_packets);
+
+  // Passes the outputs of "run" within its segment to "callback", and waits
+  // until the graph is done.
+  absl::Status StitchSegment(SegmentRun* run, bool is_first, bool is_last,
+                             const PacketCallback& callback);
+
+  const SegmentedVideoRunnerOptions options_;
+};
+
+}  // namespace mediapipe
+
+#endif  // MEDIAPIPE_UTIL_SEGMENTED_VIDEO_RUNNER_H_
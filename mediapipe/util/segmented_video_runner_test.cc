@@ -0,0 +1,333 @@
+// Copyright 2022 The MediaPipe Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "mediapipe/util/segmented_video_runner.h"
+
+#include <algorithm>
+#include <atomic>
+#include <deque>
+#include <string>
+#include <vector>
+
+#include "absl/time/clock.h"
+#include "absl/time/time.h"
+#include "mediapipe/framework/calculator_framework.h"
+#include "mediapipe/framework/port/gmock.h"
+#include "mediapipe/framework/port/gtest.h"
+#include "mediapipe/framework/port/parse_text_proto.h"
+#include "mediapipe/framework/port/status_matchers.h"
+#include "mediapipe/framework/tool/status_util.h"
+#include "mediapipe/util/video_decoder.pb.h"
+
+namespace mediapipe {
+namespace {
+
+// The frames of the fake video are 100 ms apart, from 0 to 9.9 seconds.
+constexpr int64 kFramePeriodUs = 100000;
+constexpr int kNumFrames = 100;
+
+// The number of frames output by all the FakeVideoDecoderCalculators.
+std::atomic<int> num_decoded_frames(0);
+
+// Outputs the indexes of the frames of the fake video within the time range
+// of the VideoDecoderOptions, like an FFmpegVideoDecoderCalculator, and a
+// header at Timestamp::PreStream().
+class FakeVideoDecoderCalculator : public CalculatorBase {
+ public:
+  static absl::Status GetContract(CalculatorContract* cc) {
+    cc->InputSidePackets().Tag("OPTIONS").Set<VideoDecoderOptions>();
+    cc->Outputs().Tag("VIDEO").Set<int>();
+    cc->Outputs().Tag("VIDEO_PRESTREAM").Set<std::string>();
+    return absl::OkStatus();
+  }
+
+  absl::Status Open(CalculatorContext* cc) override {
+    const auto& options =
+        cc->InputSidePackets().Tag("OPTIONS").Get<VideoDecoderOptions>();
+    if (options.has_start_time()) {
+      frame_ = (Timestamp::FromSeconds(options.start_time()).Value() +
+                kFramePeriodUs - 1) /
+               kFramePeriodUs;
+    }
+    if (options.has_end_time()) {
+      end_frame_ = std::min<int64>(
+          kNumFrames,
+          Timestamp::FromSeconds(options.end_time()).Value() / kFramePeriodUs +
+              1);
+    }
+    cc->Outputs().Tag("VIDEO_PRESTREAM").AddPacket(
+        MakePacket<std::string>("header").At(Timestamp::PreStream()));
+    cc->Outputs().Tag("VIDEO_PRESTREAM").Close();
+    return absl::OkStatus();
+  }
+
+  absl::Status Process(CalculatorContext* cc) override {
+    if (frame_ >= end_frame_) {
+      return tool::StatusStop();
+    }
+    cc->Outputs().Tag("VIDEO").AddPacket(
+        MakePacket<int>(frame_).At(Timestamp(frame_ * kFramePeriodUs)));
+    ++frame_;
+    ++num_decoded_frames;
+    return absl::OkStatus();
+  }
+
+ private:
+  int64 frame_ = 0;
+  int64 end_frame_ = kNumFrames;
+};
+REGISTER_CALCULATOR(FakeVideoDecoderCalculator);
+
+// Outputs the sum of the last 3 input values, a calculator whose outputs
+// depend on earlier frames.
+class SlidingSumCalculator : public CalculatorBase {
+ public:
+  static absl::Status GetContract(CalculatorContract* cc) {
+    cc->Inputs().Index(0).Set<int>();
+    cc->Outputs().Index(0).Set<int>();
+    return absl::OkStatus();
+  }
+
+  absl::Status Process(CalculatorContext* cc) override {
+    window_.push_back(cc->Inputs().Index(0).Get<int>());
+    if (window_.size() > 3) {
+      window_.pop_front();
+    }
+    int sum = 0;
+    for (int value : window_) {
+      sum += value;
+    }
+    cc->Outputs().Index(0).AddPacket(
+        MakePacket<int>(sum).At(cc->InputTimestamp()));
+    return absl::OkStatus();
+  }
+
+ private:
+  std::deque<int> window_;
+};
+REGISTER_CALCULATOR(SlidingSumCalculator);
+
+CalculatorGraphConfig FakeVideoGraphConfig() {
+  return ParseTextProtoOrDie<CalculatorGraphConfig>(R"pb(
+    input_side_packet: "decoder_options"
+    output_stream: "header"
+    output_stream: "frames"
+    output_stream: "sums"
+    node {
+      calculator: "FakeVideoDecoderCalculator"
+      input_side_packet: "OPTIONS:decoder_options"
+      output_stream: "VIDEO:frames"
+      output_stream: "VIDEO_PRESTREAM:header"
+    }
+    node {
+      calculator: "SlidingSumCalculator"
+      input_stream: "frames"
+      output_stream: "sums"
+    }
+  )pb");
+}
+
+// The stitched packets of one output stream.
+struct StitchedOutput {
+  std::vector<Timestamp> timestamps;
+  std::vector<int> values;
+};
+
+// Runs the fake video graph on the fake video split at "keyframes".
+std::vector<StitchedOutput> RunFakeVideo(const std::vector<int>& keyframes,
+                                         absl::Duration overlap,
+                                         int max_parallel_graphs = 0,
+                                         int max_queued_packets = 100) {
+  std::vector<Timestamp> keyframe_timestamps;
+  for (int frame : keyframes) {
+    keyframe_timestamps.push_back(Timestamp(frame * kFramePeriodUs));
+  }
+  SegmentedVideoRunnerOptions options;
+  options.overlap = overlap;
+  options.max_parallel_graphs = max_parallel_graphs;
+  options.max_queued_packets = max_queued_packets;
+  options.output_streams = {"header", "frames", "sums"};
+  SegmentedVideoRunner runner(options);
+  std::vector<StitchedOutput> outputs(3);
+  Timestamp last_timestamp = Timestamp::Unset();
+  MEDIAPIPE_CHECK_OK(runner.RunSegments(
+      FakeVideoGraphConfig(),
+      SplitVideoAtKeyframes(keyframe_timestamps,
+                            Timestamp(kNumFrames * kFramePeriodUs),
+                            keyframes.size(), overlap),
+      {}, [&](int stream_index, const Packet& packet) {
+        // The packets of all the streams are in timestamp order.
+        EXPECT_GE(packet.Timestamp(), last_timestamp);
+        last_timestamp = packet.Timestamp();
+        outputs[stream_index].timestamps.push_back(packet.Timestamp());
+        if (stream_index > 0) {
+          outputs[stream_index].values.push_back(packet.Get<int>());
+        }
+        return absl::OkStatus();
+      }));
+  return outputs;
+}
+
+std::vector<int> Range(int begin, int end) {
+  std::vector<int> result;
+  for (int i = begin; i < end; ++i) {
+    result.push_back(i);
+  }
+  return result;
+}
+
+TEST(SplitVideoAtKeyframesTest, SplitsAtClosestKeyframes) {
+  std::vector<Timestamp> keyframes = {Timestamp(0), Timestamp(90),
+                                      Timestamp(160), Timestamp(210),
+                                      Timestamp(350)};
+  std::vector<VideoSegment> segments = SplitVideoAtKeyframes(
+      keyframes, Timestamp(400), 4, absl::Microseconds(30));
+  ASSERT_EQ(segments.size(), 4);
+  EXPECT_EQ(segments[0].start, Timestamp::Min());
+  EXPECT_EQ(segments[0].decode_start, Timestamp::Min());
+  EXPECT_EQ(segments[0].end, Timestamp(90));
+  EXPECT_EQ(segments[1].start, Timestamp(90));
+  EXPECT_EQ(segments[1].decode_start, Timestamp(60));
+  EXPECT_EQ(segments[1].end, Timestamp(210));
+  EXPECT_EQ(segments[2].start, Timestamp(210));
+  EXPECT_EQ(segments[2].decode_start, Timestamp(180));
+  EXPECT_EQ(segments[2].end, Timestamp(350));
+  EXPECT_EQ(segments[3].start, Timestamp(350));
+  EXPECT_EQ(segments[3].end, Timestamp::Max());
+}
+
+TEST(SplitVideoAtKeyframesTest, MergesSegmentsWithoutKeyframes) {
+  std::vector<Timestamp> keyframes = {Timestamp(0), Timestamp(300)};
+  std::vector<VideoSegment> segments =
+      SplitVideoAtKeyframes(keyframes, Timestamp(400), 8, absl::ZeroDuration());
+  ASSERT_EQ(segments.size(), 2);
+  EXPECT_EQ(segments[0].end, Timestamp(300));
+  EXPECT_EQ(segments[1].start, Timestamp(300));
+  // An overlap reaching the first keyframe decodes from the beginning.
+  segments = SplitVideoAtKeyframes(keyframes, Timestamp(400), 2,
+                                   absl::Microseconds(300));
+  ASSERT_EQ(segments.size(), 2);
+  EXPECT_EQ(segments[1].decode_start, Timestamp::Min());
+  EXPECT_EQ(SplitVideoAtKeyframes({}, Timestamp(400), 2, absl::ZeroDuration())
+                .size(),
+            1);
+}
+
+TEST(SegmentDecoderOptionsTest, DecodesSegmentRange) {
+  VideoSegment segment;
+  VideoDecoderOptions options = SegmentDecoderOptions(segment, 1);
+  EXPECT_EQ(options.stream_index(), 1);
+  EXPECT_FALSE(options.has_start_time());
+  EXPECT_FALSE(options.has_end_time());
+  segment.start = Timestamp(2000000);
+  segment.decode_start = Timestamp(1500000);
+  segment.end = Timestamp(3000000);
+  options = SegmentDecoderOptions(segment, 0);
+  EXPECT_DOUBLE_EQ(options.start_time(), 1.5);
+  EXPECT_DOUBLE_EQ(options.end_time(), 3.0);
+}
+
+// The stitched outputs of the segments match a serial run once the overlap
+// covers the frames the sliding sum depends on.
+TEST(SegmentedVideoRunnerTest, StitchesSegmentsLikeSerialRun) {
+  std::vector<StitchedOutput> serial = RunFakeVideo({0}, absl::ZeroDuration());
+  EXPECT_EQ(serial[0].timestamps.size(), 1);
+  EXPECT_EQ(serial[1].values, Range(0, kNumFrames));
+  EXPECT_EQ(serial[2].values.size(), kNumFrames);
+
+  std::vector<StitchedOutput> segmented =
+      RunFakeVideo({0, 20, 45, 80}, absl::Milliseconds(200));
+  for (int i = 0; i < 3; ++i) {
+    EXPECT_EQ(segmented[i].timestamps, serial[i].timestamps);
+    EXPECT_EQ(segmented[i].values, serial[i].values);
+  }
+}
+
+// Without overlap, the sliding sum restarts at each segment.
+TEST(SegmentedVideoRunnerTest, RestartsStateWithoutOverlap) {
+  std::vector<StitchedOutput> outputs =
+      RunFakeVideo({0, 50}, absl::ZeroDuration());
+  EXPECT_EQ(outputs[1].values, Range(0, kNumFrames));
+  ASSERT_EQ(outputs[2].values.size(), kNumFrames);
+  EXPECT_EQ(outputs[2].values[49], 48 + 47 + 49);
+  EXPECT_EQ(outputs[2].values[50], 50);
+  EXPECT_EQ(outputs[2].values[51], 50 + 51);
+}
+
+TEST(SegmentedVideoRunnerTest, LimitsParallelGraphs) {
+  std::vector<StitchedOutput> outputs = RunFakeVideo(
+      {0, 10, 20, 30, 40}, absl::Milliseconds(200), /*max_parallel_graphs=*/2);
+  EXPECT_EQ(outputs[0].timestamps.size(), 1);
+  EXPECT_EQ(outputs[1].values, Range(0, kNumFrames));
+}
+
+// The graphs of the later segments are throttled by their full output queues
+// until their segments are stitched.
+TEST(SegmentedVideoRunnerTest, BoundsQueuedPackets) {
+  std::vector<StitchedOutput> outputs =
+      RunFakeVideo({0, 20, 45, 80}, absl::Milliseconds(200),
+                   /*max_parallel_graphs=*/0, /*max_queued_packets=*/2);
+  EXPECT_EQ(outputs[0].timestamps.size(), 1);
+  EXPECT_EQ(outputs[1].values, Range(0, kNumFrames));
+  EXPECT_EQ(outputs[2].values.size(), kNumFrames);
+
+  // Blocks the stitching of the first segment on its last frame, while the
+  // graph of the second segment can only queue max_queued_packets frames.
+  SegmentedVideoRunnerOptions options;
+  options.max_queued_packets = 2;
+  options.output_streams = {"frames"};
+  SegmentedVideoRunner runner(options);
+  num_decoded_frames = 0;
+  int blocked_decoded_frames = 0;
+  MP_ASSERT_OK(runner.RunSegments(
+      FakeVideoGraphConfig(),
+      SplitVideoAtKeyframes({Timestamp(0), Timestamp(50 * kFramePeriodUs)},
+                            Timestamp(kNumFrames * kFramePeriodUs), 2,
+                            absl::ZeroDuration()),
+      {}, [&blocked_decoded_frames](int stream_index, const Packet& packet) {
+        if (packet.Get<int>() == 49) {
+          absl::SleepFor(absl::Milliseconds(200));
+          blocked_decoded_frames = num_decoded_frames;
+        }
+        return absl::OkStatus();
+      }));
+  // The first segment decodes frames 0 to 50. The second segment decodes
+  // at most a few frames more than it can queue, instead of all 50.
+  EXPECT_GE(blocked_decoded_frames, 51);
+  EXPECT_LE(blocked_decoded_frames, 51 + 2 * options.max_queued_packets + 2);
+  EXPECT_EQ(num_decoded_frames, 101);
+}
+
+TEST(SegmentedVideoRunnerTest, ReturnsCallbackError) {
+  SegmentedVideoRunnerOptions options;
+  options.output_streams = {"frames"};
+  SegmentedVideoRunner runner(options);
+  int num_packets = 0;
+  absl::Status status = runner.RunSegments(
+      FakeVideoGraphConfig(),
+      SplitVideoAtKeyframes({Timestamp(0), Timestamp(50 * kFramePeriodUs)},
+                            Timestamp(kNumFrames * kFramePeriodUs), 2,
+                            absl::ZeroDuration()),
+      {}, [&num_packets](int stream_index, const Packet& packet) {
+        if (++num_packets == 10) {
+          return absl::InternalError("stop");
+        }
+        return absl::OkStatus();
+      });
+  EXPECT_EQ(status.code(), absl::StatusCode::kInternal);
+  EXPECT_EQ(num_packets, 10);
+}
+
+}  // namespace
+}  // namespace mediapipe
@@ -0,0 +1,489 @@
+// Copyright 2022 The MediaPipe Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "mediapipe/util/video_decoder.h"
+
+#include <algorithm>
+#include <cstdint>  // required by avutil.h
+#include <functional>
+#include <memory>
+#include <string>
+
+#include "absl/memory/memory.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/substitute.h"
+#include "mediapipe/framework/deps/cleanup.h"
+#include "mediapipe/framework/formats/image_format.pb.h"
+#include "mediapipe/framework/formats/image_frame.h"
+#include "mediapipe/framework/formats/image_frame_pool.h"
+#include "mediapipe/framework/formats/shared_buffer_pool.h"
+#include "mediapipe/framework/formats/yuv_image.h"
+#include "mediapipe/framework/port/integral_types.h"
+#include "mediapipe/framework/port/ret_check.h"
+#include "mediapipe/framework/port/status.h"
+#include "mediapipe/framework/port/status_macros.h"
+#include "mediapipe/framework/tool/status_util.h"
+
+extern "C" {
+#include "libavcodec/avcodec.h"
+#include "libavformat/avformat.h"
+#include "libavutil/avutil.h"
+#include "libavutil/frame.h"
+#include "libavutil/pixfmt.h"
+#include "libswscale/swscale.h"
+}
+
+namespace mediapipe {
+
+namespace {
+
+// Returns the video stream "stream_index" of the file, counting only video
+// streams, or nullptr if there is none.
+AVStream* FindVideoStream(AVFormatContext* avformat_ctx, int64 stream_index) {
+  for (int current_video_index = 0, stream_id = 0;
+       stream_id < static_cast<int>(avformat_ctx->nb_streams); ++stream_id) {
+    AVStream* stream = avformat_ctx->streams[stream_id];
+    // Cover art is stored as a single-frame video stream.
+    if (stream->codecpar->codec_type != AVMEDIA_TYPE_VIDEO ||
+        (stream->disposition & AV_DISPOSITION_ATTACHED_PIC)) {
+      continue;
+    }
+    if (current_video_index == stream_index) {
+      return stream;
+    }
+    ++current_video_index;
+  }
+  return nullptr;
+}
+
+// Opens "input_file" and reads its stream information.
+absl::Status OpenInput(const std::string& input_file,
+                       AVFormatContext** avformat_ctx) {
+  *avformat_ctx = avformat_alloc_context();
+  if (avformat_open_input(avformat_ctx, input_file.c_str(), NULL, NULL) < 0) {
+    return absl::InvalidArgumentError(
+        absl::StrCat("Could not open file: ", input_file));
+  }
+  if (avformat_find_stream_info(*avformat_ctx, NULL) < 0) {
+    return absl::InvalidArgumentError(absl::StrCat(
+        "Could not find stream information of file: ", input_file));
+  }
+  return absl::OkStatus();
+}
+
+}  // namespace
+
+// VideoPacketProcessor
+VideoPacketProcessor::VideoPacketProcessor(const VideoDecoderOptions& options)
+    : options_(options) {
+  if (options_.has_start_time()) {
+    start_time_ = Timestamp::FromSeconds(options_.start_time());
+  }
+}
+
+VideoPacketProcessor::~VideoPacketProcessor() {
+  if (sws_ctx_) {
+    sws_freeContext(sws_ctx_);
+    sws_ctx_ = nullptr;
+  }
+}
+
+absl::Status VideoPacketProcessor::Open(int id, AVStream* stream) {
+  id_ = id;
+  avcodec_ = avcodec_find_decoder(stream->codecpar->codec_id);
+  if (!avcodec_) {
+    return absl::InvalidArgumentError("Failed to find codec");
+  }
+  avcodec_ctx_ = avcodec_alloc_context3(avcodec_);
+  avcodec_parameters_to_context(avcodec_ctx_, stream->codecpar);
+  // Frame threading decodes consecutive frames in parallel at the cost of one
+  // frame of latency per thread, slice threading splits each frame. The codec
+  // uses whichever of them it supports.
+  avcodec_ctx_->thread_count = options_.num_threads();
+  avcodec_ctx_->thread_type = FF_THREAD_FRAME | FF_THREAD_SLICE;
+  if (avcodec_open2(avcodec_ctx_, avcodec_, &avcodec_opts_) < 0) {
+    return UnknownError("avcodec_open() failed.");
+  }
+  CHECK(avcodec_ctx_->codec);
+
+  source_time_base_ = stream->time_base;
+  source_frame_rate_ = stream->avg_frame_rate.num > 0 ? stream->avg_frame_rate
+                                                      : stream->r_frame_rate;
+  last_frame_time_regression_detected_ = false;
+  if (stream->duration != AV_NOPTS_VALUE) {
+    duration_ = stream->duration * av_q2d(source_time_base_);
+  }
+
+  if (avcodec_ctx_->width <= 0 || avcodec_ctx_->height <= 0) {
+    return UnknownError("width and height must be strictly positive.");
+  }
+
+  VLOG(0) << absl::Substitute(
+      "Opened video stream (id: $0, size: $1x$2, threads: $3, time base: "
+      "$4/$5).",
+      id_, avcodec_ctx_->width, avcodec_ctx_->height,
+      avcodec_ctx_->thread_count, source_time_base_.num,
+      source_time_base_.den);
+
+  return absl::OkStatus();
+}
+
+absl::Status VideoPacketProcessor::ProcessPacket(AVPacket* packet) {
+  CHECK(packet);
+  if (flushed_) {
+    return UnknownError(
+        "ProcessPacket was called, but VideoPacketProcessor is already "
+        "finished.");
+  }
+  RET_CHECK_EQ(packet->stream_index, id_);
+
+  return Decode(*packet, options_.ignore_decode_failures());
+}
+
+absl::Status VideoPacketProcessor::FillHeader(VideoHeader* header) const {
+  CHECK(header);
+  header->format =
+      options_.output_format() == VideoDecoderOptions::YUV_I420
+          ? ImageFormat::YCBCR420P
+          : ImageFormat::SRGB;
+  header->width = avcodec_ctx_->width;
+  header->height = avcodec_ctx_->height;
+  header->frame_rate = av_q2d(source_frame_rate_);
+  header->duration = duration_;
+  return absl::OkStatus();
+}
+
+absl::StatusOr<Timestamp> VideoPacketProcessor::DecodedFrameTimestamp() {
+  int64 pts = decoded_frame_->best_effort_timestamp;
+  if (pts == AV_NOPTS_VALUE) {
+    // Extrapolate from the frame rate.
+    RET_CHECK_GT(source_frame_rate_.num, 0)
+        << "Video frame without timestamp in a stream without frame rate.";
+    pts = av_rescale_q(num_frames_processed_, av_inv_q(source_frame_rate_),
+                       source_time_base_);
+  } else if (options_.correct_pts_for_rollover()) {
+    pts = CorrectPtsForRollover(pts);
+  }
+  return Timestamp(av_rescale_q(pts, source_time_base_, output_time_base_));
+}
+
+absl::Status VideoPacketProcessor::ProcessDecodedFrame(const AVPacket& packet) {
+  VLOG(3) << "Video packet " << avcodec_ctx_->frame_number
+          << " frame.pts:" << decoded_frame_->pts
+          << " best_effort:" << decoded_frame_->best_effort_timestamp
+          << " size:" << packet.size;
+  if (!decoded_frame_->data[0]) {
+    return UnknownError("No data in video frame.");
+  }
+  ASSIGN_OR_RETURN(const Timestamp timestamp, DecodedFrameTimestamp());
+  ++num_frames_processed_;
+
+  if (start_time_ != Timestamp::Unset() && timestamp < start_time_) {
+    // Frames between the keyframe seeked to and the start time are only
+    // needed to decode the following frames.
+    return absl::OkStatus();
+  }
+  if (last_timestamp_ != Timestamp::Unset() && timestamp <= last_timestamp_) {
+    if (!last_frame_time_regression_detected_) {
+      LOG(ERROR) << "Regressing video timestamps: " << last_timestamp_
+                 << " followed by " << timestamp << ".";
+      last_frame_time_regression_detected_ = true;
+    }
+    if (!options_.output_regressing_timestamps()) {
+      return absl::OkStatus();
+    }
+  }
+  last_timestamp_ = timestamp;
+
+  Packet frame;
+  if (options_.output_format() == VideoDecoderOptions::YUV_I420 &&
+      decoded_frame_->format == AV_PIX_FMT_YUV420P) {
+    frame = WrapDecodedFrame();
+  } else {
+    ASSIGN_OR_RETURN(frame, ConvertDecodedFrame());
+  }
+  buffer_.push_back(frame.At(timestamp));
+  return absl::OkStatus();
+}
+
+Packet VideoPacketProcessor::WrapDecodedFrame() {
+  // The clone references the decoder's reference-counted buffers, which the
+  // decoder doesn't reuse until the YUVImage releases them.
+  AVFrame* frame = av_frame_clone(decoded_frame_);
+  CHECK(frame);
+  auto image = absl::make_unique<YUVImage>();
+  image->Initialize(
+      libyuv::FOURCC_I420, [frame]() mutable { av_frame_free(&frame); },
+      frame->data[0], frame->linesize[0],  //
+      frame->data[1], frame->linesize[1],  //
+      frame->data[2], frame->linesize[2],  //
+      frame->width, frame->height);
+  return Adopt(image.release());
+}
+
+absl::StatusOr<Packet> VideoPacketProcessor::ConvertDecodedFrame() {
+  const int width = decoded_frame_->width;
+  const int height = decoded_frame_->height;
+  const bool output_yuv =
+      options_.output_format() == VideoDecoderOptions::YUV_I420;
+  sws_ctx_ = sws_getCachedContext(
+      sws_ctx_, width, height,
+      static_cast<AVPixelFormat>(decoded_frame_->format), width, height,
+      output_yuv ? AV_PIX_FMT_YUV420P : AV_PIX_FMT_RGB24, SWS_BILINEAR,
+      nullptr, nullptr, nullptr);
+  RET_CHECK(sws_ctx_) << "Cannot convert video frames of pixel format "
+                      << decoded_frame_->format;
+
+  if (output_yuv) {
+    const int chroma_width = (width + 1) / 2;
+    const int chroma_height = (height + 1) / 2;
+    const int y_size = width * height;
+    const int chroma_size = chroma_width * chroma_height;
+    // The planes are pooled like the RGB frames below.
+    SharedBufferPool* pool = &SharedBufferPool::Get();
+    const size_t size = y_size + 2 * chroma_size;
+    uint8* data = static_cast<uint8*>(pool->Allocate(size));
+    uint8* planes[] = {data, data + y_size, data + y_size + chroma_size};
+    int strides[] = {width, chroma_width, chroma_width};
+    sws_scale(sws_ctx_, decoded_frame_->data, decoded_frame_->linesize, 0,
+              height, planes, strides);
+    auto image = absl::make_unique<YUVImage>();
+    image->Initialize(
+        libyuv::FOURCC_I420,
+        [pool, data, size]() { pool->Release(data, size); },  //
+        planes[0], strides[0],                                 //
+        planes[1], strides[1],                                 //
+        planes[2], strides[2],                                 //
+        width, height);
+    return Adopt(image.release());
+  }
+
+  // Pooled frames avoid allocating and faulting in a fresh buffer per frame.
+  std::unique_ptr<ImageFrame> image_frame =
+      CreateImageFrameFromPool(ImageFormat::SRGB, width, height);
+  uint8* planes[] = {image_frame->MutablePixelData()};
+  int strides[] = {image_frame->WidthStep()};
+  sws_scale(sws_ctx_, decoded_frame_->data, decoded_frame_->linesize, 0,
+            height, planes, strides);
+  return Adopt(image_frame.release());
+}
+
+// VideoDecoder
+VideoDecoder::VideoDecoder() { av_register_all(); }
+
+VideoDecoder::~VideoDecoder() {
+  absl::Status status = Close();
+  if (!status.ok()) {
+    LOG(ERROR) << "Encountered error while closing media file: "
+               << status.message();
+  }
+}
+
+absl::Status VideoDecoder::Initialize(const std::string& input_file,
+                                      const VideoDecoderOptions& options) {
+  Cleanup<std::function<void()>> decoder_closer([this]() {
+    absl::Status status = Close();
+    if (!status.ok()) {
+      LOG(ERROR) << "Encountered error while closing media file: "
+                 << status.message();
+    }
+  });
+
+  MP_RETURN_IF_ERROR(OpenInput(input_file, &avformat_ctx_));
+  AVStream* video_stream =
+      FindVideoStream(avformat_ctx_, options.stream_index());
+  RET_CHECK(video_stream) << absl::StrCat(
+      "Could not find video stream with index ", options.stream_index(),
+      " in file ", input_file);
+  stream_id_ = video_stream->index;
+
+  video_processor_ = absl::make_unique<VideoPacketProcessor>(options);
+  MP_RETURN_IF_ERROR(video_processor_->Open(stream_id_, video_stream));
+
+  if (options.has_start_time() && options.start_time() > 0) {
+    // Seek to the last keyframe at or before the start time. If seeking fails
+    // the stream is decoded from the beginning.
+    const int64 start_pts = av_rescale_q(
+        Timestamp::FromSeconds(options.start_time()).Value(),
+        AVRational{1, 1000000}, video_stream->time_base);
+    const int ret = av_seek_frame(avformat_ctx_, stream_id_, start_pts,
+                                  AVSEEK_FLAG_BACKWARD);
+    if (ret < 0) {
+      LOG(WARNING) << "Failed to seek to " << options.start_time()
+                   << "s in file " << input_file << ": "
+                   << AvErrorToString(ret);
+    }
+  }
+  if (options.has_end_time()) {
+    end_time_ = Timestamp::FromSeconds(options.end_time());
+  }
+
+  decoder_closer.release();
+  return absl::OkStatus();
+}
+
+absl::Status VideoDecoder::GetData(Packet* data) {
+  while (true) {
+    if (video_processor_ && video_processor_->HasData()) {
+      MP_RETURN_IF_ERROR(video_processor_->GetData(data));
+      if (end_time_ != Timestamp::Unset() && data->Timestamp() > end_time_) {
+        VLOG(1) << "Stopping at video frame with timestamp "
+                << data->Timestamp() << " after end time " << end_time_;
+        *data = Packet();
+        MP_RETURN_IF_ERROR(Close());
+        return tool::StatusStop();
+      }
+      return absl::OkStatus();
+    }
+    if (flushed_ || !video_processor_) {
+      MP_RETURN_IF_ERROR(Close());
+      return tool::StatusStop();
+    }
+    MP_RETURN_IF_ERROR(ProcessPacket());
+  }
+}
+
+absl::Status VideoDecoder::Close() {
+  if (video_processor_) {
+    video_processor_->Close();
+    video_processor_.reset();
+  }
+  // Free the context.
+  if (avformat_ctx_) {
+    avformat_close_input(&avformat_ctx_);
+  }
+  return absl::OkStatus();
+}
+
+absl::Status VideoDecoder::FillVideoHeader(VideoHeader* header) const {
+  RET_CHECK(video_processor_) << "video stream is not open.";
+  return video_processor_->FillHeader(header);
+}
+
+absl::Status VideoDecoder::ProcessPacket() {
+  std::unique_ptr<AVPacket, AVPacketDeleter> av_packet(new AVPacket());
+  av_init_packet(av_packet.get());
+  av_packet->size = 0;
+  av_packet->data = nullptr;
+  int ret = av_read_frame(avformat_ctx_, av_packet.get());
+  if (ret >= 0) {
+    CHECK(av_packet->data) << "AVPacket does not include any data but "
+                              "av_read_frame was successful.";
+    if (av_packet->stream_index == stream_id_) {
+      is_first_packet_ = false;
+      MP_RETURN_IF_ERROR(video_processor_->ProcessPacket(av_packet.get()));
+    } else {
+      VLOG(3) << "Ignoring packet for stream " << av_packet->stream_index;
+    }
+    return absl::OkStatus();
+  }
+  VLOG(1) << "Demuxing returned error (or EOF): " << AvErrorToString(ret);
+  if (ret == AVERROR(EAGAIN)) {
+    // EAGAIN is used to signify that the av_packet should be skipped
+    // (maybe the demuxer is trying to re-sync).
+    return absl::OkStatus();
+  }
+
+  // Unrecoverable demuxing error with details in avformat_ctx_->pb->error.
+  int demuxing_error =
+      avformat_ctx_->pb ? avformat_ctx_->pb->error : 0 /* no error */;
+  if (ret == AVERROR_EOF && !demuxing_error) {
+    VLOG(1) << "Reached EOF.";
+    flushed_ = true;
+    return video_processor_->Flush();
+  }
+
+  RET_CHECK(!demuxing_error) << absl::Substitute(
+      "Failed to read a frame: retval = $0 ($1), avformat_ctx_->pb->error = "
+      "$2 ($3)",
+      ret, AvErrorToString(ret), demuxing_error,
+      AvErrorToString(demuxing_error));
+
+  if (is_first_packet_) {
+    RET_CHECK_FAIL() << "Couldn't even read the first frame; maybe a partial "
+                        "file with only metadata?";
+  }
+
+  // Unrecoverable demuxing error without details.
+  RET_CHECK_FAIL() << absl::Substitute(
+      "Failed to read a frame: retval = $0 ($1)", ret, AvErrorToString(ret));
+}
+
+absl::StatusOr<VideoKeyframes> ReadVideoKeyframes(const std::string& input_file,
+                                                  int64 stream_index) {
+  av_register_all();
+  AVFormatContext* avformat_ctx = nullptr;
+  Cleanup<std::function<void()>> closer([&avformat_ctx]() {
+    if (avformat_ctx) {
+      avformat_close_input(&avformat_ctx);
+    }
+  });
+  MP_RETURN_IF_ERROR(OpenInput(input_file, &avformat_ctx));
+  AVStream* video_stream = FindVideoStream(avformat_ctx, stream_index);
+  RET_CHECK(video_stream) << absl::StrCat(
+      "Could not find video stream with index ", stream_index, " in file ",
+      input_file);
+  // Only the packets of the video stream are read.
+  for (int stream_id = 0;
+       stream_id < static_cast<int>(avformat_ctx->nb_streams); ++stream_id) {
+    if (stream_id != video_stream->index) {
+      avformat_ctx->streams[stream_id]->discard = AVDISCARD_ALL;
+    }
+  }
+
+  const AVRational output_time_base = {1, 1000000};
+  VideoKeyframes keyframes;
+  int64 end_pts = AV_NOPTS_VALUE;
+  std::unique_ptr<AVPacket, AVPacketDeleter> av_packet(new AVPacket());
+  while (true) {
+    av_init_packet(av_packet.get());
+    av_packet->size = 0;
+    av_packet->data = nullptr;
+    const int ret = av_read_frame(avformat_ctx, av_packet.get());
+    if (ret == AVERROR(EAGAIN)) {
+      continue;
+    }
+    if (ret == AVERROR_EOF) {
+      break;
+    }
+    if (ret < 0) {
+      return UnknownError(absl::StrCat("Failed to read a frame of ",
+                                       input_file, ": ", AvErrorToString(ret)));
+    }
+    if (av_packet->stream_index == video_stream->index &&
+        av_packet->pts != AV_NOPTS_VALUE) {
+      if (av_packet->flags & AV_PKT_FLAG_KEY) {
+        keyframes.timestamps.push_back(Timestamp(av_rescale_q(
+            av_packet->pts, video_stream->time_base, output_time_base)));
+      }
+      end_pts = end_pts == AV_NOPTS_VALUE
+                    ? av_packet->pts + av_packet->duration
+                    : std::max(end_pts, av_packet->pts + av_packet->duration);
+    }
+    av_packet_unref(av_packet.get());
+  }
+  RET_CHECK_NE(end_pts, AV_NOPTS_VALUE)
+      << "No timestamped video packets in file " << input_file;
+
+  std::sort(keyframes.timestamps.begin(), keyframes.timestamps.end());
+  keyframes.timestamps.erase(
+      std::unique(keyframes.timestamps.begin(), keyframes.timestamps.end()),
+      keyframes.timestamps.end());
+  keyframes.end =
+      Timestamp(av_rescale_q(end_pts, video_stream->time_base,
+                             output_time_base));
+  return keyframes;
+}
+
+}  // namespace mediapipe
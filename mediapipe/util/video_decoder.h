@@ -0,0 +1,135 @@
+// Copyright 2022 The MediaPipe Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef MEDIAPIPE_UTIL_VIDEO_DECODER_H_
+#define MEDIAPIPE_UTIL_VIDEO_DECODER_H_
+
+#include <cstdint>  // required by avutil.h
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "mediapipe/framework/formats/video_stream_header.h"
+#include "mediapipe/framework/packet.h"
+#include "mediapipe/framework/port/integral_types.h"
+#include "mediapipe/framework/port/status.h"
+#include "mediapipe/framework/port/statusor.h"
+#include "mediapipe/framework/timestamp.h"
+#include "mediapipe/util/audio_decoder.h"
+#include "mediapipe/util/video_decoder.pb.h"
+
+extern "C" {
+#include "libavcodec/avcodec.h"
+#include "libavformat/avformat.h"
+#include "libswscale/swscale.h"
+}
+
+namespace mediapipe {
+
+// Class which decodes packets from a single video stream into ImageFrames or
+// YUVImages, as selected by VideoDecoderOptions::output_format.
+class VideoPacketProcessor : public BasePacketProcessor {
+ public:
+  explicit VideoPacketProcessor(const VideoDecoderOptions& options);
+  ~VideoPacketProcessor() override;
+
+  absl::Status Open(int id, AVStream* stream) override;
+
+  absl::Status ProcessPacket(AVPacket* packet) override;
+
+  absl::Status FillHeader(VideoHeader* header) const;
+
+ private:
+  // Processes a decoded video frame. decoded_frame_ must have been filled
+  // with the frame before calling this function.
+  absl::Status ProcessDecodedFrame(const AVPacket& packet) override;
+
+  // Returns the timestamp of decoded_frame_ in microseconds.
+  absl::StatusOr<Timestamp> DecodedFrameTimestamp();
+
+  // Wraps the planes of decoded_frame_, which must be I420, in a YUVImage
+  // holding a reference to the decoder's buffers.
+  Packet WrapDecodedFrame();
+
+  // Converts decoded_frame_ to the output format.
+  absl::StatusOr<Packet> ConvertDecodedFrame();
+
+  // Options for the processor.
+  VideoDecoderOptions options_;
+
+  // Frames before start_time_ are decoded but not output.
+  Timestamp start_time_ = Timestamp::Unset();
+
+  // The timestamp of the last packet added to the buffer.
+  Timestamp last_timestamp_ = Timestamp::Unset();
+
+  // The stream duration in seconds, or 0 if unknown.
+  double duration_ = 0;
+
+  // Converts decoded frames to the output pixel format. Reused across frames
+  // as long as their dimensions and pixel format don't change.
+  SwsContext* sws_ctx_ = nullptr;
+};
+
+// Decodes a video stream of a media file. The VideoDecoder is responsible for
+// demuxing the stream and seeking to the requested start time, whereas
+// decoding of the content is delegated to VideoPacketProcessor.
+class VideoDecoder {
+ public:
+  VideoDecoder();
+  ~VideoDecoder();
+
+  absl::Status Initialize(const std::string& input_file,
+                          const VideoDecoderOptions& options);
+
+  // Returns the next frame in "data", or tool::StatusStop() once the stream
+  // or the requested time range is exhausted.
+  absl::Status GetData(Packet* data);
+
+  absl::Status Close();
+
+  absl::Status FillVideoHeader(VideoHeader* header) const;
+
+ private:
+  absl::Status ProcessPacket();
+
+  std::unique_ptr<VideoPacketProcessor> video_processor_;
+  // The container stream index of the decoded stream.
+  int stream_id_ = -1;
+
+  // True until the decoded stream has seen a packet.
+  bool is_first_packet_ = true;
+  bool flushed_ = false;
+
+  Timestamp end_time_ = Timestamp::Unset();
+
+  AVFormatContext* avformat_ctx_ = nullptr;
+};
+
+// The keyframes of a video stream.
+struct VideoKeyframes {
+  // The timestamps of the keyframes, in increasing order.
+  std::vector<Timestamp> timestamps;
+  // The end of the last frame of the stream.
+  Timestamp end = Timestamp::Unset();
+};
+
+// Returns the keyframes of the video stream "stream_index" of "input_file",
+// found by demuxing the file without decoding it.
+absl::StatusOr<VideoKeyframes> ReadVideoKeyframes(const std::string& input_file,
+                                                  int64 stream_index = 0);
+
+}  // namespace mediapipe
+
+#endif  // MEDIAPIPE_UTIL_VIDEO_DECODER_H_